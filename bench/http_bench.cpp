@@ -0,0 +1,795 @@
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include "latency_histogram.h"
+
+const unsigned int DEFAULT_THREAD_NUM = 2;
+const unsigned int DEFAULT_CONNECTION_NUM = 16;
+const unsigned int DEFAULT_DURATION = 10; // 默认压测时长10秒
+const unsigned int DEFAULT_TIMEOUT_MS = 2000; // 单个请求超过2秒无响应视为超时
+const unsigned int MAX_EVENTS = 256;
+const unsigned int RECV_BUFF_LEN = 16384;
+const unsigned int PIPELINE_CHECK_REQUEST_NUM = 2;
+const uint64_t NSEC_PER_SEC = 1000000000ULL;
+const uint64_t NSEC_PER_MSEC = 1000000ULL;
+const char *HEAD_END_STR = "\r\n\r\n";
+const char *CONTENT_LENGTH_STR = "Content-Length:";
+const char *CONNECTION_CLOSE_STR = "Connection: close";
+
+struct BenchOptions {
+    std::string ipAddr { "127.0.0.1" };
+    std::string unixPath; // 非空时通过Unix域套接字连接，忽略地址和端口
+    unsigned short int port { 443 };
+    unsigned int threadNum { DEFAULT_THREAD_NUM };
+    unsigned int connectionNum { DEFAULT_CONNECTION_NUM };
+    unsigned int duration { DEFAULT_DURATION };
+    double rate { 0 }; // 每秒总请求数，0表示闭环模式
+    unsigned int pipeline { 1 }; // 每个连接同时在途的请求数
+    bool keepAlive { true };
+    bool fastOpen { false }; // 连接时使用TCP Fast Open，请求随SYN发出
+    unsigned int timeoutMs { DEFAULT_TIMEOUT_MS };
+    bool jsonOutput { false };
+    std::vector<std::string> urls;
+};
+
+enum ConnectionState : unsigned char {
+    CONNECTION_STATE_CLOSED = 0,
+    CONNECTION_STATE_CONNECTING = 1,
+    CONNECTION_STATE_CONNECTED = 2,
+};
+
+struct BenchConnection {
+    int fd { -1 };
+    ConnectionState state { CONNECTION_STATE_CLOSED };
+    std::string sendBuff; // 待发送的请求
+    size_t sendOffset { 0 };
+    std::string recvBuff; // 未解析完的回复
+    std::deque<uint64_t> inflight; // 在途请求的计时起点，开环模式为计划发送时刻
+    uint64_t lastActive { 0 };
+    bool wantWrite { false };
+};
+
+struct BenchStats {
+    uint64_t completed { 0 };
+    uint64_t success { 0 }; // 2xx回复数
+    uint64_t nonSuccess { 0 };
+    uint64_t bytes { 0 };
+    uint64_t connectErrors { 0 };
+    uint64_t ioErrors { 0 };
+    uint64_t timeouts { 0 };
+    uint64_t reconnects { 0 };
+    uint64_t missedSends { 0 }; // 开环模式下未能按计划时刻发出的请求数
+    uint64_t unfinished { 0 }; // 开环模式下结束时仍在积压队列或在途的请求数，时延按结束时刻计入
+    LatencyHistogram histogram;
+};
+
+struct BenchThreadArg {
+    const BenchOptions *options;
+    struct sockaddr_storage serverAddr;
+    socklen_t serverAddrLen;
+    unsigned int threadIdx;
+    unsigned int connectionNum;
+    double rate;
+    uint64_t startTime;
+    uint64_t endTime;
+    BenchStats stats;
+};
+
+static uint64_t NowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+class BenchWorker {
+public:
+    explicit BenchWorker(BenchThreadArg *arg) : m_arg(arg), m_options(*arg->options) {}
+    ~BenchWorker()
+    {
+        for (auto &connection : m_connections) {
+            CloseConnection(connection);
+        }
+        if (m_efd != -1) {
+            close(m_efd);
+        }
+    }
+    void Run()
+    {
+        m_efd = epoll_create(MAX_EVENTS);
+        if (m_efd == -1) {
+            printf("ERROR  epoll_create fail.\n");
+            return;
+        }
+        m_urlIdx = m_arg->threadIdx;
+        m_connections.resize(m_arg->connectionNum);
+        for (auto &connection : m_connections) {
+            Connect(connection);
+        }
+        if (m_arg->rate > 0) {
+            m_sendInterval = static_cast<uint64_t>(NSEC_PER_SEC / m_arg->rate);
+            if (m_sendInterval == 0) {
+                m_sendInterval = 1;
+            }
+            m_nextSendTime = m_arg->startTime;
+        }
+        struct epoll_event events[MAX_EVENTS];
+        while (true) {
+            uint64_t now = NowNs();
+            if (now >= m_arg->endTime) {
+                break;
+            }
+            if (m_arg->rate > 0) {
+                ScheduleOpenLoop(now);
+            }
+            int timeout = WaitTimeout(now);
+            int ret = epoll_wait(m_efd, events, MAX_EVENTS, timeout);
+            if (ret == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                printf("ERROR  epoll_wait fail, errno = %d.\n", errno);
+                break;
+            }
+            for (int i = 0; i < ret; ++i) {
+                BenchConnection &connection = m_connections[events[i].data.u32];
+                HandleEvent(connection, events[i].events);
+            }
+            CheckTimeout(NowNs());
+        }
+        if (m_arg->rate > 0) {
+            RecordUnfinished();
+        }
+    }
+private:
+    int WaitTimeout(const uint64_t now)
+    {
+        uint64_t deadline = m_arg->endTime;
+        if (m_arg->rate > 0 && m_nextSendTime < deadline) {
+            deadline = m_nextSendTime;
+        }
+        if (deadline <= now) {
+            return 0;
+        }
+        uint64_t timeout = (deadline - now + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC;
+        return timeout > 100 ? 100 : static_cast<int>(timeout); // 最多等待100毫秒，保证超时检查及时
+    }
+
+    void Connect(BenchConnection &connection)
+    {
+        connection.fd = socket(m_arg->serverAddr.ss_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (connection.fd == -1) {
+            m_arg->stats.connectErrors++;
+            return;
+        }
+        // 设置后connect立即返回成功，第一次write的数据随SYN发出，没有cookie时退化为普通握手
+        if (m_options.fastOpen && m_arg->serverAddr.ss_family != AF_UNIX) {
+            int value = 1;
+            (void)setsockopt(connection.fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &value, sizeof(value));
+        }
+        connection.state = CONNECTION_STATE_CONNECTING;
+        connection.lastActive = NowNs();
+        int ret = connect(connection.fd, reinterpret_cast<const struct sockaddr *>(&m_arg->serverAddr),
+            m_arg->serverAddrLen);
+        if (ret == -1 && errno != EINPROGRESS) {
+            m_arg->stats.connectErrors++;
+            close(connection.fd);
+            connection.fd = -1;
+            connection.state = CONNECTION_STATE_CLOSED;
+            return;
+        }
+        struct epoll_event event = { 0 };
+        event.events = EPOLLIN | EPOLLOUT;
+        event.data.u32 = static_cast<uint32_t>(&connection - &m_connections[0]);
+        connection.wantWrite = true;
+        if (epoll_ctl(m_efd, EPOLL_CTL_ADD, connection.fd, &event) == -1) {
+            m_arg->stats.connectErrors++;
+            close(connection.fd);
+            connection.fd = -1;
+            connection.state = CONNECTION_STATE_CLOSED;
+        }
+    }
+
+    void CloseConnection(BenchConnection &connection)
+    {
+        if (connection.fd != -1) {
+            epoll_ctl(m_efd, EPOLL_CTL_DEL, connection.fd, NULL);
+            close(connection.fd);
+            connection.fd = -1;
+        }
+        connection.state = CONNECTION_STATE_CLOSED;
+        connection.sendBuff.clear();
+        connection.sendOffset = 0;
+        connection.recvBuff.clear();
+        connection.wantWrite = false;
+    }
+
+    // 关闭连接并重连，开环模式下在途请求重新排队以保留其计划发送时刻
+    void Reconnect(BenchConnection &connection)
+    {
+        if (m_arg->rate > 0) {
+            for (auto iter = connection.inflight.rbegin(); iter != connection.inflight.rend(); ++iter) {
+                m_backlog.push_front(*iter);
+            }
+        }
+        connection.inflight.clear();
+        CloseConnection(connection);
+        m_arg->stats.reconnects++;
+        Connect(connection);
+    }
+
+    void HandleEvent(BenchConnection &connection, const uint32_t events)
+    {
+        if (connection.fd == -1) {
+            return;
+        }
+        if (connection.state == CONNECTION_STATE_CONNECTING) {
+            int error = 0;
+            socklen_t errorLen = sizeof(error);
+            if (getsockopt(connection.fd, SOL_SOCKET, SO_ERROR, &error, &errorLen) == -1 || error != 0) {
+                m_arg->stats.connectErrors++;
+                connection.inflight.clear();
+                CloseConnection(connection);
+                Connect(connection);
+                return;
+            }
+            connection.state = CONNECTION_STATE_CONNECTED;
+            connection.lastActive = NowNs();
+            if (m_arg->rate > 0) {
+                DispatchBacklog();
+            } else {
+                FillClosedLoop(connection);
+            }
+        }
+        if (events & EPOLLIN) {
+            if (!HandleRead(connection)) {
+                return;
+            }
+        } else if (events & (EPOLLERR | EPOLLHUP)) {
+            m_arg->stats.ioErrors++;
+            Reconnect(connection);
+            return;
+        }
+        if ((events & EPOLLOUT) && connection.wantWrite) {
+            Flush(connection);
+        }
+    }
+
+    const std::string &NextUrl()
+    {
+        const std::string &url = m_options.urls[m_urlIdx % m_options.urls.size()];
+        m_urlIdx++;
+        return url;
+    }
+
+    void QueueRequest(BenchConnection &connection, const uint64_t startTime)
+    {
+        connection.sendBuff += "GET ";
+        connection.sendBuff += NextUrl();
+        connection.sendBuff += " HTTP/1.1\r\nHost: ";
+        // IPv6地址在Host头部中需要加方括号
+        connection.sendBuff += m_options.ipAddr.find(':') == std::string::npos ? m_options.ipAddr :
+            "[" + m_options.ipAddr + "]";
+        connection.sendBuff += m_options.keepAlive ? "\r\nConnection: keep-alive\r\n\r\n" : "\r\nConnection: close\r\n\r\n";
+        connection.inflight.push_back(startTime);
+    }
+
+    unsigned int PipelineDepth() const
+    {
+        return m_options.keepAlive ? m_options.pipeline : 1;
+    }
+
+    void FillClosedLoop(BenchConnection &connection)
+    {
+        uint64_t now = NowNs();
+        while (connection.inflight.size() < PipelineDepth()) {
+            QueueRequest(connection, now);
+        }
+        Flush(connection);
+    }
+
+    // 开环模式：按固定速率生成计划发送时刻，连接繁忙时请求在积压队列中等待，
+    // 时延从计划时刻开始计算，以修正协调遗漏(coordinated omission)
+    void ScheduleOpenLoop(const uint64_t now)
+    {
+        while (m_nextSendTime <= now && m_nextSendTime < m_arg->endTime) {
+            m_backlog.push_back(m_nextSendTime);
+            m_nextSendTime += m_sendInterval;
+        }
+        DispatchBacklog();
+    }
+
+    // 服务端越慢，结束时积压和在途的请求越多，丢弃它们会让时延偏低，按等待到结束时刻计入
+    void RecordUnfinished()
+    {
+        uint64_t endTime = m_arg->endTime;
+        while (m_nextSendTime < endTime) {
+            m_backlog.push_back(m_nextSendTime);
+            m_nextSendTime += m_sendInterval;
+        }
+        BenchStats &stats = m_arg->stats;
+        for (uint64_t startTime : m_backlog) {
+            stats.unfinished++;
+            stats.histogram.Record(endTime > startTime ? endTime - startTime : 0);
+        }
+        m_backlog.clear();
+        for (auto &connection : m_connections) {
+            for (uint64_t startTime : connection.inflight) {
+                stats.unfinished++;
+                stats.histogram.Record(endTime > startTime ? endTime - startTime : 0);
+            }
+            connection.inflight.clear();
+        }
+    }
+
+    void DispatchBacklog()
+    {
+        unsigned int connectionNum = m_connections.size();
+        unsigned int idleRounds = 0;
+        while (!m_backlog.empty() && idleRounds < connectionNum) {
+            BenchConnection &connection = m_connections[m_dispatchIdx % connectionNum];
+            m_dispatchIdx++;
+            if (connection.state != CONNECTION_STATE_CONNECTED || connection.inflight.size() >= PipelineDepth()) {
+                idleRounds++;
+                continue;
+            }
+            idleRounds = 0;
+            if (m_backlog.front() + m_sendInterval < NowNs()) {
+                m_arg->stats.missedSends++;
+            }
+            QueueRequest(connection, m_backlog.front());
+            m_backlog.pop_front();
+            Flush(connection);
+        }
+    }
+
+    void Flush(BenchConnection &connection)
+    {
+        if (connection.state != CONNECTION_STATE_CONNECTED) {
+            return;
+        }
+        while (connection.sendOffset < connection.sendBuff.size()) {
+            ssize_t ret = send(connection.fd, connection.sendBuff.data() + connection.sendOffset,
+                connection.sendBuff.size() - connection.sendOffset, MSG_NOSIGNAL);
+            if (ret == -1) {
+                if (errno == EAGAIN) {
+                    SetWantWrite(connection, true);
+                    return;
+                }
+                m_arg->stats.ioErrors++;
+                Reconnect(connection);
+                return;
+            }
+            connection.sendOffset += static_cast<size_t>(ret);
+        }
+        connection.sendBuff.clear();
+        connection.sendOffset = 0;
+        SetWantWrite(connection, false);
+    }
+
+    void SetWantWrite(BenchConnection &connection, const bool wantWrite)
+    {
+        if (connection.wantWrite == wantWrite) {
+            return;
+        }
+        struct epoll_event event = { 0 };
+        event.events = wantWrite ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+        event.data.u32 = static_cast<uint32_t>(&connection - &m_connections[0]);
+        if (epoll_ctl(m_efd, EPOLL_CTL_MOD, connection.fd, &event) == 0) {
+            connection.wantWrite = wantWrite;
+        }
+    }
+
+    // 返回false表示连接已被关闭
+    bool HandleRead(BenchConnection &connection)
+    {
+        char buff[RECV_BUFF_LEN];
+        bool peerClosed = false;
+        while (true) {
+            ssize_t ret = recv(connection.fd, buff, sizeof(buff), 0);
+            if (ret == -1) {
+                if (errno == EAGAIN) {
+                    break;
+                }
+                m_arg->stats.ioErrors++;
+                Reconnect(connection);
+                return false;
+            }
+            if (ret == 0) {
+                peerClosed = true;
+                break;
+            }
+            connection.lastActive = NowNs();
+            connection.recvBuff.append(buff, ret);
+        }
+        bool closeAfter = false;
+        while (ParseResponse(connection, closeAfter)) {
+            if (closeAfter) {
+                break;
+            }
+        }
+        if (closeAfter || peerClosed) {
+            // 对端关闭时仍有未完成的请求视为出错
+            if (!closeAfter && !connection.inflight.empty()) {
+                m_arg->stats.ioErrors++;
+            }
+            Reconnect(connection);
+            return false;
+        }
+        if (m_arg->rate > 0) {
+            DispatchBacklog();
+        } else {
+            FillClosedLoop(connection);
+        }
+        return true;
+    }
+
+    // 解析出一个完整回复返回true
+    bool ParseResponse(BenchConnection &connection, bool &closeAfter)
+    {
+        std::string &recvBuff = connection.recvBuff;
+        // 服务端错误回复会在消息体后多发送一个结束符，这里跳过
+        size_t start = recvBuff.find_first_not_of('\0');
+        if (start == std::string::npos) {
+            recvBuff.clear();
+            return false;
+        }
+        size_t headEnd = recvBuff.find(HEAD_END_STR, start);
+        if (headEnd == std::string::npos) {
+            return false;
+        }
+        size_t headLen = headEnd + strlen(HEAD_END_STR);
+        unsigned long contentLen = 0;
+        const char *head = recvBuff.c_str() + start;
+        const char *contentLenPos = strcasestr(head, CONTENT_LENGTH_STR);
+        if (contentLenPos != nullptr && contentLenPos < recvBuff.c_str() + headEnd) {
+            contentLen = strtoul(contentLenPos + strlen(CONTENT_LENGTH_STR), nullptr, 10);
+        }
+        if (recvBuff.size() < headLen + contentLen) {
+            return false;
+        }
+        const char *statusPos = strchr(head, ' ');
+        int status = statusPos != nullptr ? atoi(statusPos + 1) : 0;
+        const char *closePos = strcasestr(head, CONNECTION_CLOSE_STR);
+        closeAfter = (closePos != nullptr && closePos < recvBuff.c_str() + headEnd) || !m_options.keepAlive;
+
+        uint64_t now = NowNs();
+        if (!connection.inflight.empty()) {
+            uint64_t startTime = connection.inflight.front();
+            connection.inflight.pop_front();
+            if (now < m_arg->endTime) {
+                BenchStats &stats = m_arg->stats;
+                stats.completed++;
+                if (status >= 200 && status < 300) {
+                    stats.success++;
+                } else {
+                    stats.nonSuccess++;
+                }
+                stats.bytes += headLen + contentLen - start;
+                stats.histogram.Record(now > startTime ? now - startTime : 0);
+            }
+        }
+        recvBuff.erase(0, headLen + contentLen);
+        return true;
+    }
+
+    void CheckTimeout(const uint64_t now)
+    {
+        uint64_t timeout = static_cast<uint64_t>(m_options.timeoutMs) * NSEC_PER_MSEC;
+        for (auto &connection : m_connections) {
+            if (connection.state == CONNECTION_STATE_CLOSED) {
+                Connect(connection);
+                continue;
+            }
+            bool waiting = connection.state == CONNECTION_STATE_CONNECTING || !connection.inflight.empty();
+            if (waiting && now > connection.lastActive + timeout) {
+                m_arg->stats.timeouts++;
+                Reconnect(connection);
+            }
+        }
+    }
+private:
+    BenchThreadArg *m_arg;
+    const BenchOptions &m_options;
+    int m_efd { -1 };
+    std::vector<BenchConnection> m_connections;
+    std::deque<uint64_t> m_backlog; // 开环模式下等待空闲连接的计划发送时刻
+    uint64_t m_sendInterval { 0 };
+    uint64_t m_nextSendTime { 0 };
+    unsigned int m_dispatchIdx { 0 };
+    unsigned int m_urlIdx { 0 };
+};
+
+static void *BenchThreadFunction(void *arg)
+{
+    BenchWorker worker(reinterpret_cast<BenchThreadArg *>(arg));
+    worker.Run();
+    return nullptr;
+}
+
+// 场景文件每行格式为"[权重] URL"，#开头为注释
+static bool LoadScenario(const char *path, std::vector<std::string> &urls)
+{
+    FILE *file = fopen(path, "r");
+    if (file == nullptr) {
+        printf("ERROR  open scenario fail: %s.\n", path);
+        return false;
+    }
+    char line[1024];
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        char *pos = line + strspn(line, " \t");
+        if (*pos == '#' || *pos == '\n' || *pos == '\0') {
+            continue;
+        }
+        pos[strcspn(pos, "\r\n")] = '\0';
+        unsigned long weight = 1;
+        if (*pos != '/') {
+            char *end = nullptr;
+            weight = strtoul(pos, &end, 10);
+            pos = end + strspn(end, " \t");
+        }
+        for (unsigned long i = 0; i < weight; ++i) {
+            urls.push_back(pos);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+static void Usage(const char *name)
+{
+    printf("Usage: %s [options]\n"
+        "  -a <ip>         server ipv4 or ipv6 address (default 127.0.0.1)\n"
+        "  -p <port>       server port (default 443)\n"
+        "  -t <threads>    load generator threads (default %u)\n"
+        "  -c <conns>      total connections (default %u)\n"
+        "  -d <seconds>    test duration (default %u)\n"
+        "  -R <rate>       open-loop mode, total requests per second (default closed loop)\n"
+        "  -P <depth>      pipelined requests per connection (default 1), checked before the run\n"
+        "  -C              close connection after every request (no keep-alive)\n"
+        "  -F              connect with TCP Fast Open\n"
+        "  -U <path>       connect to a unix domain socket instead of ip and port\n"
+        "  -T <ms>         request timeout (default %u)\n"
+        "  -u <url>        request url, may be repeated\n"
+        "  -s <file>       scenario file with weighted urls\n"
+        "  -j              print result as json\n",
+        name, DEFAULT_THREAD_NUM, DEFAULT_CONNECTION_NUM, DEFAULT_DURATION, DEFAULT_TIMEOUT_MS);
+}
+
+static bool ParseOptions(int argc, char *argv[], BenchOptions &options)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "a:p:t:c:d:R:P:CFU:T:u:s:jh")) != -1) {
+        switch (opt) {
+            case 'a': options.ipAddr = optarg; break;
+            case 'p': options.port = static_cast<unsigned short int>(atoi(optarg)); break;
+            case 't': options.threadNum = strtoul(optarg, nullptr, 10); break;
+            case 'c': options.connectionNum = strtoul(optarg, nullptr, 10); break;
+            case 'd': options.duration = strtoul(optarg, nullptr, 10); break;
+            case 'R': options.rate = atof(optarg); break;
+            case 'P': options.pipeline = strtoul(optarg, nullptr, 10); break;
+            case 'C': options.keepAlive = false; break;
+            case 'F': options.fastOpen = true; break;
+            case 'U': options.unixPath = optarg; break;
+            case 'T': options.timeoutMs = strtoul(optarg, nullptr, 10); break;
+            case 'u': options.urls.push_back(optarg); break;
+            case 's': {
+                if (!LoadScenario(optarg, options.urls)) {
+                    return false;
+                }
+                break;
+            }
+            case 'j': options.jsonOutput = true; break;
+            default: {
+                Usage(argv[0]);
+                return false;
+            }
+        }
+    }
+    if (options.urls.empty()) {
+        options.urls.push_back("/hello.html");
+    }
+    if (options.threadNum == 0 || options.connectionNum < options.threadNum || options.pipeline == 0 ||
+        options.duration == 0) {
+        printf("ERROR  invalid options, threads = %u, conns = %u, pipeline = %u, duration = %u.\n",
+            options.threadNum, options.connectionNum, options.pipeline, options.duration);
+        return false;
+    }
+    return true;
+}
+
+static void PrintResult(const BenchOptions &options, const BenchStats &total)
+{
+    double seconds = options.duration;
+    double throughput = total.completed / seconds;
+    double mbps = total.bytes / seconds / (1024 * 1024);
+    const LatencyHistogram &histogram = total.histogram;
+    if (options.jsonOutput) {
+        printf("{\"mode\":\"%s\",\"threads\":%u,\"connections\":%u,\"pipeline\":%u,\"keep_alive\":%s,"
+            "\"duration\":%u,\"target_rate\":%.1f,\"requests\":%lu,\"throughput\":%.1f,\"mb_per_sec\":%.2f,"
+            "\"non_2xx\":%lu,\"connect_errors\":%lu,\"io_errors\":%lu,\"timeouts\":%lu,\"reconnects\":%lu,"
+            "\"missed_sends\":%lu,\"unfinished\":%lu,\"latency_us\":{\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f,\"p999\":%.1f,\"max\":%.1f}}\n",
+            options.rate > 0 ? "open" : "closed", options.threadNum, options.connectionNum, options.pipeline,
+            options.keepAlive ? "true" : "false", options.duration, options.rate, total.completed, throughput, mbps,
+            total.nonSuccess, total.connectErrors, total.ioErrors, total.timeouts, total.reconnects,
+            total.missedSends, total.unfinished, histogram.Percentile(50) / 1000.0, histogram.Percentile(90) / 1000.0, histogram.Percentile(99) / 1000.0,
+            histogram.Percentile(99.9) / 1000.0, histogram.Max() / 1000.0);
+        return;
+    }
+    printf("%s loop, %u threads, %u connections, pipeline %u, %s, %us\n",
+        options.rate > 0 ? "open" : "closed", options.threadNum, options.connectionNum, options.pipeline,
+        options.keepAlive ? "keep-alive" : "close", options.duration);
+    if (options.rate > 0) {
+        printf("  target rate:  %.1f req/s, missed sends: %lu, unfinished: %lu\n", options.rate, total.missedSends,
+            total.unfinished);
+    }
+    printf("  requests:     %lu (non-2xx %lu)\n", total.completed, total.nonSuccess);
+    printf("  throughput:   %.1f req/s, %.2f MB/s\n", throughput, mbps);
+    printf("  errors:       connect %lu, io %lu, timeout %lu, reconnects %lu\n",
+        total.connectErrors, total.ioErrors, total.timeouts, total.reconnects);
+    printf("  latency(us):  p50 %.1f  p90 %.1f  p99 %.1f  p999 %.1f  max %.1f\n",
+        histogram.Percentile(50) / 1000.0, histogram.Percentile(90) / 1000.0, histogram.Percentile(99) / 1000.0,
+        histogram.Percentile(99.9) / 1000.0, histogram.Max() / 1000.0);
+}
+
+static bool GetServerAddr(const BenchOptions &options, struct sockaddr_storage &addr, socklen_t &addrLen)
+{
+    memset(&addr, 0, sizeof(addr));
+    if (!options.unixPath.empty()) {
+        struct sockaddr_un *unixAddr = reinterpret_cast<struct sockaddr_un *>(&addr);
+        if (options.unixPath.size() >= sizeof(unixAddr->sun_path)) {
+            printf("ERROR  Unix socket path too long: %s.\n", options.unixPath.c_str());
+            return false;
+        }
+        unixAddr->sun_family = AF_UNIX;
+        strncpy(unixAddr->sun_path, options.unixPath.c_str(), sizeof(unixAddr->sun_path) - 1);
+        addrLen = sizeof(struct sockaddr_un);
+        return true;
+    }
+    struct sockaddr_in *ipv4Addr = reinterpret_cast<struct sockaddr_in *>(&addr);
+    if (inet_pton(AF_INET, options.ipAddr.c_str(), &ipv4Addr->sin_addr) == 1) {
+        ipv4Addr->sin_family = AF_INET;
+        ipv4Addr->sin_port = htons(options.port);
+        addrLen = sizeof(struct sockaddr_in);
+        return true;
+    }
+    struct sockaddr_in6 *ipv6Addr = reinterpret_cast<struct sockaddr_in6 *>(&addr);
+    if (inet_pton(AF_INET6, options.ipAddr.c_str(), &ipv6Addr->sin6_addr) == 1) {
+        ipv6Addr->sin6_family = AF_INET6;
+        ipv6Addr->sin6_port = htons(options.port);
+        addrLen = sizeof(struct sockaddr_in6);
+        return true;
+    }
+    printf("ERROR  Invalid ip address: %s.\n", options.ipAddr.c_str());
+    return false;
+}
+
+// 回复按顺序与在途请求对应，服务端丢弃同一批数据中后面的请求时，每个回复都会算到更早的请求上，吞吐量和时延都失真
+// 管线化压测前在一个连接上一次发送两个请求，收不齐两个回复时拒绝压测
+static bool CheckPipelining(const BenchOptions &options, const struct sockaddr_storage &addr, const socklen_t addrLen)
+{
+    int fd = socket(addr.ss_family, SOCK_STREAM, 0);
+    if (fd == -1) {
+        printf("ERROR  Create socket fail, errno = %d.\n", errno);
+        return false;
+    }
+    struct timeval timeout = { .tv_sec = static_cast<time_t>(options.timeoutMs / 1000),
+        .tv_usec = static_cast<suseconds_t>(options.timeoutMs % 1000 * 1000) };
+    (void)setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (connect(fd, reinterpret_cast<const struct sockaddr *>(&addr), addrLen) == -1) {
+        printf("ERROR  Connect fail, errno = %d.\n", errno);
+        close(fd);
+        return false;
+    }
+    std::string host = options.ipAddr.find(':') == std::string::npos ? options.ipAddr : "[" + options.ipAddr + "]";
+    std::string request;
+    for (unsigned int i = 0; i < PIPELINE_CHECK_REQUEST_NUM; ++i) {
+        request += "GET " + options.urls[i % options.urls.size()] + " HTTP/1.1\r\nHost: " + host +
+            "\r\nConnection: keep-alive\r\n\r\n";
+    }
+    unsigned int responseNum = 0;
+    if (send(fd, request.data(), request.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(request.size())) {
+        std::string recvBuff;
+        char buff[RECV_BUFF_LEN];
+        while (responseNum < PIPELINE_CHECK_REQUEST_NUM) {
+            size_t start = recvBuff.find_first_not_of('\0');
+            size_t headEnd = start == std::string::npos ? std::string::npos : recvBuff.find(HEAD_END_STR, start);
+            if (headEnd != std::string::npos) {
+                size_t headLen = headEnd + strlen(HEAD_END_STR);
+                unsigned long contentLen = 0;
+                const char *contentLenPos = strcasestr(recvBuff.c_str() + start, CONTENT_LENGTH_STR);
+                if (contentLenPos != nullptr && contentLenPos < recvBuff.c_str() + headEnd) {
+                    contentLen = strtoul(contentLenPos + strlen(CONTENT_LENGTH_STR), nullptr, 10);
+                }
+                if (recvBuff.size() >= headLen + contentLen) {
+                    recvBuff.erase(0, headLen + contentLen);
+                    responseNum++;
+                    continue;
+                }
+            }
+            ssize_t ret = recv(fd, buff, sizeof(buff), 0);
+            if (ret <= 0) {
+                break; // 超时或连接关闭
+            }
+            recvBuff.append(buff, ret);
+        }
+    }
+    close(fd);
+    if (responseNum != PIPELINE_CHECK_REQUEST_NUM) {
+        printf("ERROR  Server answered %u of %u pipelined requests, run with -P 1.\n", responseNum,
+            PIPELINE_CHECK_REQUEST_NUM);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    BenchOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        return 1;
+    }
+    struct sockaddr_storage serverAddr;
+    socklen_t serverAddrLen = 0;
+    if (!GetServerAddr(options, serverAddr, serverAddrLen)) {
+        return 1;
+    }
+    if (options.keepAlive && options.pipeline > 1 && !CheckPipelining(options, serverAddr, serverAddrLen)) {
+        return 1;
+    }
+
+    std::vector<BenchThreadArg> args(options.threadNum);
+    std::vector<pthread_t> threads(options.threadNum);
+    uint64_t startTime = NowNs();
+    uint64_t endTime = startTime + static_cast<uint64_t>(options.duration) * NSEC_PER_SEC;
+    for (unsigned int i = 0; i < options.threadNum; ++i) {
+        BenchThreadArg &arg = args[i];
+        arg.options = &options;
+        arg.serverAddr = serverAddr;
+        arg.serverAddrLen = serverAddrLen;
+        arg.threadIdx = i;
+        // 连接数和请求速率平均分配到各线程，余数分给前面的线程
+        arg.connectionNum = options.connectionNum / options.threadNum + (i < options.connectionNum % options.threadNum);
+        arg.rate = options.rate / options.threadNum;
+        arg.startTime = startTime;
+        arg.endTime = endTime;
+        if (pthread_create(&threads[i], nullptr, BenchThreadFunction, &arg) != 0) {
+            printf("ERROR  pthread_create fail.\n");
+            return 1;
+        }
+    }
+    BenchStats total;
+    for (unsigned int i = 0; i < options.threadNum; ++i) {
+        pthread_join(threads[i], nullptr);
+        const BenchStats &stats = args[i].stats;
+        total.completed += stats.completed;
+        total.success += stats.success;
+        total.nonSuccess += stats.nonSuccess;
+        total.bytes += stats.bytes;
+        total.connectErrors += stats.connectErrors;
+        total.ioErrors += stats.ioErrors;
+        total.timeouts += stats.timeouts;
+        total.reconnects += stats.reconnects;
+        total.missedSends += stats.missedSends;
+        total.unfinished += stats.unfinished;
+        total.histogram.Merge(stats.histogram);
+    }
+    PrintResult(options, total);
+    return 0;
+}
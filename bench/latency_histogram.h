@@ -0,0 +1,88 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stdint.h>
+
+const unsigned int HISTOGRAM_SUB_BUCKET_BITS = 6; // 每个2的幂区间划分为32个子桶，相对误差约3%
+const unsigned int HISTOGRAM_SUB_BUCKET_COUNT = 1 << HISTOGRAM_SUB_BUCKET_BITS;
+const unsigned int HISTOGRAM_HALF_SUB_BUCKET_COUNT = HISTOGRAM_SUB_BUCKET_COUNT / 2;
+const unsigned int HISTOGRAM_BUCKET_COUNT = 2048;
+
+// 对数线性直方图，记录纳秒级时延，可跨线程合并
+class LatencyHistogram {
+public:
+    void Record(const uint64_t value)
+    {
+        m_counts[Index(value)]++;
+        m_totalCount++;
+        if (value > m_max) {
+            m_max = value;
+        }
+    }
+    void Merge(const LatencyHistogram &other)
+    {
+        for (unsigned int i = 0; i < HISTOGRAM_BUCKET_COUNT; ++i) {
+            m_counts[i] += other.m_counts[i];
+        }
+        m_totalCount += other.m_totalCount;
+        if (other.m_max > m_max) {
+            m_max = other.m_max;
+        }
+    }
+    uint64_t Percentile(const double percentile) const
+    {
+        if (m_totalCount == 0) {
+            return 0;
+        }
+        uint64_t target = static_cast<uint64_t>(percentile / 100.0 * m_totalCount + 0.5);
+        if (target == 0) {
+            target = 1;
+        }
+        uint64_t count = 0;
+        for (unsigned int i = 0; i < HISTOGRAM_BUCKET_COUNT; ++i) {
+            count += m_counts[i];
+            if (count >= target) {
+                uint64_t value = Value(i);
+                return value < m_max ? value : m_max;
+            }
+        }
+        return m_max;
+    }
+    uint64_t TotalCount() const
+    {
+        return m_totalCount;
+    }
+    uint64_t Max() const
+    {
+        return m_max;
+    }
+private:
+    static unsigned int Index(const uint64_t value)
+    {
+        if (value < HISTOGRAM_SUB_BUCKET_COUNT) {
+            return static_cast<unsigned int>(value);
+        }
+        unsigned int msb = 63 - __builtin_clzll(value);
+        unsigned int shift = msb - (HISTOGRAM_SUB_BUCKET_BITS - 1);
+        unsigned int index = HISTOGRAM_SUB_BUCKET_COUNT + (shift - 1) * HISTOGRAM_HALF_SUB_BUCKET_COUNT +
+            static_cast<unsigned int>((value >> shift) - HISTOGRAM_HALF_SUB_BUCKET_COUNT);
+        return index < HISTOGRAM_BUCKET_COUNT ? index : HISTOGRAM_BUCKET_COUNT - 1;
+    }
+    // 返回桶的上界
+    static uint64_t Value(const unsigned int index)
+    {
+        if (index < HISTOGRAM_SUB_BUCKET_COUNT) {
+            return index;
+        }
+        unsigned int offset = index - HISTOGRAM_SUB_BUCKET_COUNT;
+        unsigned int shift = offset / HISTOGRAM_HALF_SUB_BUCKET_COUNT + 1;
+        uint64_t subBucket = offset % HISTOGRAM_HALF_SUB_BUCKET_COUNT + HISTOGRAM_HALF_SUB_BUCKET_COUNT;
+        return ((subBucket + 1) << shift) - 1;
+    }
+private:
+    uint64_t m_counts[HISTOGRAM_BUCKET_COUNT] { 0 };
+    uint64_t m_totalCount { 0 };
+    uint64_t m_max { 0 };
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,596 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <stdint.h>
+#include <semaphore.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include "http_processor.h"
+#include "client_expire_min_heap.h"
+#include "thread_pool.h"
+#include "http_config.h"
+#include "cpu_affinity.h"
+
+const unsigned int DEFAULT_REPEAT = 5; // 每项测试重复5次取中位数
+const double DEFAULT_THRESHOLD = 10.0; // 比基线慢10%以上视为性能回退
+const unsigned int PARSE_ITERATIONS = 20000;
+const unsigned int THREAD_POOL_ITERATIONS = 20000;
+const unsigned int AFFINITY_ITERATIONS = 20000;
+const unsigned int UNMASK_ITERATIONS = 20000;
+const unsigned int UNMASK_SIZE_LIST[] = { 16, 1024, 65536 };
+const unsigned int SSE_FANOUT_ROUNDS = 20;
+const unsigned int SSE_SUBSCRIBER_NUM_LIST[] = { 100, 1000 };
+const unsigned int SSE_EVENT_DATA_LEN = 200;
+const unsigned int HEAP_SIZE_LIST[] = { 10000, 100000, 1000000 };
+const unsigned int THREAD_NUM_LIST[] = { 1, 2, 4, 8 };
+const uint64_t NSEC_PER_SEC = 1000000000ULL;
+
+// 解析器语料，覆盖常见客户端的请求形态
+const struct {
+    const char *name;
+    const char *request;
+} PARSE_CORPUS[] = {
+    { "curl", "GET /hello.html HTTP/1.1\r\nHost: 127.0.0.1\r\nUser-Agent: curl/7.88.1\r\nAccept: */*\r\n\r\n" },
+    { "keep_alive", "GET /hello.html HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: keep-alive\r\n\r\n" },
+    { "browser", "GET /static/js/app.3f2a9c.js HTTP/1.1\r\nHost: www.example.com\r\nConnection: keep-alive\r\n"
+        "sec-ch-ua: \"Chromium\";v=\"118\", \"Google Chrome\";v=\"118\", \"Not=A?Brand\";v=\"99\"\r\n"
+        "sec-ch-ua-mobile: ?0\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) "
+        "Chrome/118.0.0.0 Safari/537.36\r\n"
+        "sec-ch-ua-platform: \"Linux\"\r\nAccept: */*\r\nSec-Fetch-Site: same-origin\r\nSec-Fetch-Mode: no-cors\r\n"
+        "Sec-Fetch-Dest: script\r\nReferer: https://www.example.com/index.html\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\nAccept-Language: en-US,en;q=0.9,zh-CN;q=0.8\r\n"
+        "Cookie: session=4f1b2c3d4e5f60718293a4b5c6d7e8f9; theme=dark; _ga=GA1.1.123456789.1697000000\r\n\r\n" },
+    { "absolute_url", "GET http://127.0.0.1/hello.html HTTP/1.1\r\nHost: 127.0.0.1\r\nAccept: text/html\r\n\r\n" },
+    { "with_body", "GET /hello.html HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Type: application/json\r\n"
+        "Content-Length: 27\r\nConnection: keep-alive\r\n\r\n{\"query\":\"hello\",\"page\":1}\n" },
+    { "websocket_upgrade", "GET /ws/echo HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: keep-alive, Upgrade\r\n"
+        "Upgrade: websocket\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n" },
+};
+
+struct BenchResult {
+    std::string name;
+    uint64_t iterations;
+    double nsPerOp; // 多次重复的中位数
+    double minNsPerOp;
+};
+
+struct MicroBenchOptions {
+    unsigned int repeat { DEFAULT_REPEAT };
+    double threshold { DEFAULT_THRESHOLD };
+    const char *filter { nullptr };
+    const char *outputPath { nullptr };
+    const char *comparePath { nullptr };
+};
+
+// HttpProcessor的友元，直接在内存中解析请求，不经过套接字
+class HttpProcessorBench {
+public:
+    static ParseRequestReturnCode Parse(HttpProcessor &processor, const char *request, const unsigned int len)
+    {
+        processor.Init();
+        if (!processor.AttachBuffer()) {
+            return PARSE_REQUEST_RETURN_CODE_ERROR;
+        }
+        memcpy(processor.m_request, request, len);
+        processor.m_request[len] = '\0';
+        processor.m_currentRequestSize = len;
+        return processor.ParseRequest();
+    }
+};
+
+struct PoolTaskArg {
+    sem_t *done;
+    char *buffer; // 主线程分配的缓冲区，模拟事件循环线程分配的处理对象
+    unsigned int bufferLen;
+};
+
+static uint64_t NowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void PostDone(void *arg)
+{
+    PoolTaskArg *taskArg = reinterpret_cast<PoolTaskArg *>(arg);
+    sem_post(taskArg->done);
+}
+
+// 读写整个缓冲区后通知主线程，缓冲区所在节点与当前线程不同时每次都要跨节点访问
+static void TouchAndPostDone(void *arg)
+{
+    PoolTaskArg *taskArg = reinterpret_cast<PoolTaskArg *>(arg);
+    for (unsigned int i = 0; i < taskArg->bufferLen; i += 64) {
+        taskArg->buffer[i]++;
+    }
+    sem_post(taskArg->done);
+}
+
+// 逐字节异或，作为SIMD实现的对照
+static void UnmaskByByte(char *data, const size_t len, const unsigned char *mask)
+{
+    for (size_t i = 0; i < len; ++i) {
+        data[i] ^= mask[i % WEBSOCKET_MASK_LEN];
+    }
+}
+
+static void BindPoolThread(const unsigned int threadIdx, void *arg)
+{
+    (void)threadIdx;
+    const int *cpu = reinterpret_cast<const int *>(arg);
+    CpuAffinity::BindCurrentThread(std::vector<int> { *cpu });
+}
+
+class MicroBench {
+public:
+    explicit MicroBench(const MicroBenchOptions &options) : m_options(options) {}
+    void RunAll()
+    {
+        RunParseBench();
+        RunHeapBench();
+        RunThreadPoolBench();
+        RunAffinityBench();
+        RunUnmaskBench();
+        RunSseFanoutBench();
+    }
+    const std::vector<BenchResult> &Results() const
+    {
+        return m_results;
+    }
+private:
+    bool Selected(const std::string &name) const
+    {
+        return m_options.filter == nullptr || name.find(m_options.filter) != std::string::npos;
+    }
+
+    // 每轮返回总耗时，按操作数折算为单次耗时后取中位数
+    template <class F>
+    void Measure(const std::string &name, const uint64_t iterations, F round)
+    {
+        std::vector<double> samples;
+        for (unsigned int i = 0; i < m_options.repeat; ++i) {
+            uint64_t elapsed = round();
+            samples.push_back(static_cast<double>(elapsed) / iterations);
+        }
+        std::sort(samples.begin(), samples.end());
+        BenchResult result = { name, iterations, samples[samples.size() / 2], samples[0] };
+        m_results.push_back(result);
+        fprintf(stderr, "%-32s %12.1f ns/op (min %.1f)\n", name.c_str(), result.nsPerOp, result.minNsPerOp);
+    }
+
+    void RunParseBench()
+    {
+        BufferPool bufferPool;
+        bufferPool.Init(HttpProcessor::GetBufferSize(DEFAULT_MAX_READ_BUFF_LEN), 1);
+        std::shared_ptr<const HttpProcessorContext> context = std::make_shared<const HttpProcessorContext>(
+            HttpProcessorContext { "", DEFAULT_MAX_READ_BUFF_LEN, &bufferPool, nullptr });
+        HttpProcessor *processor = new HttpProcessor(-1, context);
+        for (const auto &corpus : PARSE_CORPUS) {
+            std::string name = std::string("parser/") + corpus.name;
+            if (!Selected(name)) {
+                continue;
+            }
+            unsigned int len = strlen(corpus.request);
+            if (HttpProcessorBench::Parse(*processor, corpus.request, len) != PARSE_REQUEST_RETURN_CODE_FINISH) {
+                fprintf(stderr, "ERROR corpus %s parse fail.\n", corpus.name);
+                continue;
+            }
+            Measure(name, PARSE_ITERATIONS, [&]() {
+                uint64_t start = NowNs();
+                for (unsigned int i = 0; i < PARSE_ITERATIONS; ++i) {
+                    HttpProcessorBench::Parse(*processor, corpus.request, len);
+                }
+                return NowNs() - start;
+            });
+        }
+        delete processor;
+    }
+
+    void RunHeapBench()
+    {
+        for (unsigned int size : HEAP_SIZE_LIST) {
+            std::vector<ClientExpire> nodes(size);
+            std::vector<ClientExpire> modifies(size);
+            std::vector<int> deletes(size);
+            unsigned int seed = size; // 固定种子保证每次运行的操作序列一致
+            for (unsigned int i = 0; i < size; ++i) {
+                nodes[i].clientFd = static_cast<int>(i);
+                nodes[i].expire = rand_r(&seed) % 100000;
+                modifies[i].clientFd = rand_r(&seed) % size;
+                modifies[i].expire = rand_r(&seed) % 100000;
+                deletes[i] = static_cast<int>(i);
+            }
+            for (unsigned int i = size - 1; i > 0; --i) {
+                std::swap(deletes[i], deletes[rand_r(&seed) % (i + 1)]);
+            }
+            std::string suffix = "/";
+            suffix += std::to_string(size);
+            if (Selected("heap/push" + suffix)) {
+                Measure("heap/push" + suffix, size, [&]() {
+                    ClientExpireMinHeap heap;
+                    heap.Init(size);
+                    uint64_t start = NowNs();
+                    for (unsigned int i = 0; i < size; ++i) {
+                        heap.Push(nodes[i]);
+                    }
+                    return NowNs() - start;
+                });
+            }
+            if (Selected("heap/modify" + suffix)) {
+                Measure("heap/modify" + suffix, size, [&]() {
+                    ClientExpireMinHeap heap;
+                    heap.Init(size);
+                    for (unsigned int i = 0; i < size; ++i) {
+                        heap.Push(nodes[i]);
+                    }
+                    uint64_t start = NowNs();
+                    for (unsigned int i = 0; i < size; ++i) {
+                        heap.Modify(modifies[i]);
+                    }
+                    return NowNs() - start;
+                });
+            }
+            if (Selected("heap/delete" + suffix)) {
+                Measure("heap/delete" + suffix, size, [&]() {
+                    ClientExpireMinHeap heap;
+                    heap.Init(size);
+                    for (unsigned int i = 0; i < size; ++i) {
+                        heap.Push(nodes[i]);
+                    }
+                    uint64_t start = NowNs();
+                    for (unsigned int i = 0; i < size; ++i) {
+                        heap.Delete(deletes[i]);
+                    }
+                    return NowNs() - start;
+                });
+            }
+        }
+    }
+
+    // 测量AddTask到任务在工作线程中执行完毕的往返时延
+    void RunThreadPoolBench()
+    {
+        for (unsigned int threadNum : THREAD_NUM_LIST) {
+            std::string name = "thread_pool/round_trip/" + std::to_string(threadNum);
+            if (!Selected(name)) {
+                continue;
+            }
+            ThreadPool<PoolTaskArg> *pool = new ThreadPool<PoolTaskArg>(threadNum);
+            if (!pool->Init()) {
+                fprintf(stderr, "ERROR thread pool init fail.\n");
+                delete pool;
+                continue;
+            }
+            sem_t done;
+            sem_init(&done, 0, 0);
+            Task<PoolTaskArg> task = { .function = PostDone, .arg = { .done = &done } };
+            Measure(name, THREAD_POOL_ITERATIONS, [&]() {
+                uint64_t start = NowNs();
+                for (unsigned int i = 0; i < THREAD_POOL_ITERATIONS; ++i) {
+                    pool->AddTask(task);
+                    while (sem_wait(&done) != 0) {}
+                }
+                return NowNs() - start;
+            });
+            delete pool; // 等待线程退出
+            sem_destroy(&done);
+        }
+    }
+
+    // 主线程绑定在节点0上并分配缓冲区，处理线程分别绑定在同一节点和其他节点，对比跨节点访问的代价
+    void RunAffinityBench()
+    {
+        std::vector<int> localCpus = CpuAffinity::GetNodeCpus(0);
+        if (localCpus.empty()) {
+            fprintf(stderr, "WARN  no numa node info, skip affinity bench.\n");
+            return;
+        }
+        std::vector<int> remoteCpus;
+        if (CpuAffinity::GetNodeNum() > 1) {
+            remoteCpus = CpuAffinity::GetNodeCpus(1);
+        }
+        const struct {
+            const char *name;
+            int cpu; // -1表示没有可用的CPU
+        } caseList[] = {
+            { "affinity/round_trip/same_node", localCpus.size() > 1 ? localCpus[1] : localCpus[0] },
+            { "affinity/round_trip/cross_node", remoteCpus.empty() ? -1 : remoteCpus[0] },
+        };
+        cpu_set_t oldCpuSet;
+        sched_getaffinity(0, sizeof(oldCpuSet), &oldCpuSet);
+        CpuAffinity::BindCurrentThread(std::vector<int> { localCpus[0] });
+        // 在主线程中清零，按首次写入原则内存分配在节点0上
+        std::vector<char> buffer(DEFAULT_MAX_READ_BUFF_LEN * 4, 0);
+        std::vector<double> nsPerOp;
+        for (const auto &affinityCase : caseList) {
+            if (!Selected(affinityCase.name)) {
+                continue;
+            }
+            if (affinityCase.cpu == -1) {
+                fprintf(stderr, "%-32s skipped, single numa node\n", affinityCase.name);
+                continue;
+            }
+            int cpu = affinityCase.cpu;
+            ThreadPool<PoolTaskArg> *pool = new ThreadPool<PoolTaskArg>(1);
+            pool->SetThreadInitFunction(BindPoolThread, &cpu);
+            if (!pool->Init()) {
+                fprintf(stderr, "ERROR thread pool init fail.\n");
+                delete pool;
+                continue;
+            }
+            sem_t done;
+            sem_init(&done, 0, 0);
+            Task<PoolTaskArg> task = { .function = TouchAndPostDone,
+                .arg = { .done = &done, .buffer = buffer.data(), .bufferLen = static_cast<unsigned int>(buffer.size()) } };
+            Measure(affinityCase.name, AFFINITY_ITERATIONS, [&]() {
+                uint64_t start = NowNs();
+                for (unsigned int i = 0; i < AFFINITY_ITERATIONS; ++i) {
+                    pool->AddTask(task);
+                    while (sem_wait(&done) != 0) {}
+                }
+                return NowNs() - start;
+            });
+            delete pool;
+            sem_destroy(&done);
+            nsPerOp.push_back(m_results.back().nsPerOp);
+        }
+        if (nsPerOp.size() == 2) {
+            fprintf(stderr, "%-32s %+12.1f ns/op (%+.1f%%)\n", "affinity/cross_node_penalty", nsPerOp[1] - nsPerOp[0],
+                (nsPerOp[1] - nsPerOp[0]) * 100.0 / nsPerOp[0]);
+        }
+        sched_setaffinity(0, sizeof(oldCpuSet), &oldCpuSet);
+    }
+
+    // 对照逐字节实现，打印SIMD实现的加速比
+    void RunUnmaskBench()
+    {
+        const unsigned char mask[WEBSOCKET_MASK_LEN] = { 0x37, 0xfa, 0x21, 0x3d };
+        for (unsigned int size : UNMASK_SIZE_LIST) {
+            std::vector<char> data(size + 1, 'a');
+            char *payload = data.data() + 1; // 帧头之后的消息体一般不对齐
+            std::string suffix = "/";
+            suffix += std::to_string(size);
+            std::vector<double> nsPerOp;
+            if (Selected("websocket/unmask_byte" + suffix)) {
+                Measure("websocket/unmask_byte" + suffix, UNMASK_ITERATIONS, [&]() {
+                    uint64_t start = NowNs();
+                    for (unsigned int i = 0; i < UNMASK_ITERATIONS; ++i) {
+                        UnmaskByByte(payload, size, mask);
+                        __asm__ __volatile__("" : : "r"(payload) : "memory"); // 防止循环被合并
+                    }
+                    return NowNs() - start;
+                });
+                nsPerOp.push_back(m_results.back().nsPerOp);
+            }
+            if (Selected("websocket/unmask" + suffix)) {
+                Measure("websocket/unmask" + suffix, UNMASK_ITERATIONS, [&]() {
+                    uint64_t start = NowNs();
+                    for (unsigned int i = 0; i < UNMASK_ITERATIONS; ++i) {
+                        WebSocketCodec::Unmask(payload, size, mask);
+                        __asm__ __volatile__("" : : "r"(payload) : "memory");
+                    }
+                    return NowNs() - start;
+                });
+                nsPerOp.push_back(m_results.back().nsPerOp);
+            }
+            if (nsPerOp.size() == 2 && nsPerOp[1] > 0) {
+                fprintf(stderr, "%-32s %12.1fx\n", ("websocket/unmask_speedup" + suffix).c_str(),
+                    nsPerOp[0] / nsPerOp[1]);
+            }
+        }
+    }
+
+    // 订阅者为socketpair的一端，每轮推送一个事件后在计时之外读空另一端；对照每个订阅者直接send一次
+    void RunSseFanoutBench()
+    {
+        std::string data(SSE_EVENT_DATA_LEN, 'x');
+        SseEvent *event = SseEvent::Create(1, "tick", data.data(), data.size());
+        for (unsigned int num : SSE_SUBSCRIBER_NUM_LIST) {
+            std::string suffix = "/";
+            suffix += std::to_string(num);
+            if (!Selected("sse/fanout" + suffix) && !Selected("sse/fanout_send" + suffix)) {
+                continue;
+            }
+            std::vector<int> senders;
+            std::vector<int> receivers;
+            for (unsigned int i = 0; i < num; ++i) {
+                int fds[2];
+                if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) == -1) {
+                    fprintf(stderr, "ERROR socketpair fail, %u subscribers created.\n", i);
+                    break;
+                }
+                senders.push_back(fds[0]);
+                receivers.push_back(fds[1]);
+            }
+            std::vector<SseSubscriber *> subscribers;
+            for (int fd : senders) {
+                subscribers.push_back(new SseSubscriber(fd, 0, DEFAULT_SSE_MAX_QUEUE, true));
+            }
+            char buff[4096];
+            auto drain = [&]() {
+                for (int fd : receivers) {
+                    while (read(fd, buff, sizeof(buff)) > 0) {}
+                }
+            };
+            uint64_t iterations = static_cast<uint64_t>(subscribers.size()) * SSE_FANOUT_ROUNDS;
+            if (Selected("sse/fanout" + suffix) && !subscribers.empty()) {
+                Measure("sse/fanout" + suffix, iterations, [&]() {
+                    uint64_t elapsed = 0;
+                    for (unsigned int round = 0; round < SSE_FANOUT_ROUNDS; ++round) {
+                        uint64_t start = NowNs();
+                        for (SseSubscriber *subscriber : subscribers) {
+                            (void)subscriber->Push(event);
+                        }
+                        elapsed += NowNs() - start;
+                        drain();
+                    }
+                    return elapsed;
+                });
+            }
+            if (Selected("sse/fanout_send" + suffix) && !senders.empty()) {
+                Measure("sse/fanout_send" + suffix, iterations, [&]() {
+                    uint64_t elapsed = 0;
+                    for (unsigned int round = 0; round < SSE_FANOUT_ROUNDS; ++round) {
+                        uint64_t start = NowNs();
+                        for (int fd : senders) {
+                            (void)send(fd, event->GetData(), event->GetSize(), MSG_NOSIGNAL | MSG_DONTWAIT);
+                        }
+                        elapsed += NowNs() - start;
+                        drain();
+                    }
+                    return elapsed;
+                });
+            }
+            for (SseSubscriber *subscriber : subscribers) {
+                delete subscriber;
+            }
+            for (size_t i = 0; i < senders.size(); ++i) {
+                close(senders[i]);
+                close(receivers[i]);
+            }
+        }
+        event->Unref();
+    }
+private:
+    const MicroBenchOptions &m_options;
+    std::vector<BenchResult> m_results;
+};
+
+static void WriteJson(FILE *file, const std::vector<BenchResult> &results)
+{
+    fprintf(file, "{\n  \"build_type\": \"%s\",\n  \"results\": [\n", BUILD_TYPE);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult &result = results[i];
+        fprintf(file, "    {\"name\": \"%s\", \"iterations\": %lu, \"ns_per_op\": %.2f, \"min_ns_per_op\": %.2f}%s\n",
+            result.name.c_str(), result.iterations, result.nsPerOp, result.minNsPerOp,
+            i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+}
+
+// 只解析WriteJson输出的格式，每行一个结果
+static bool LoadBaseline(const char *path, std::vector<BenchResult> &results)
+{
+    FILE *file = fopen(path, "r");
+    if (file == nullptr) {
+        fprintf(stderr, "ERROR open baseline fail: %s.\n", path);
+        return false;
+    }
+    char line[1024];
+    char name[256];
+    BenchResult result;
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        if (sscanf(line, " {\"name\": \"%255[^\"]\", \"iterations\": %lu, \"ns_per_op\": %lf, \"min_ns_per_op\": %lf",
+            name, &result.iterations, &result.nsPerOp, &result.minNsPerOp) == 4) {
+            result.name = name;
+            results.push_back(result);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+// 返回回退的测试项数量
+static unsigned int Compare(const std::vector<BenchResult> &baseline, const std::vector<BenchResult> &results,
+    const double threshold)
+{
+    unsigned int regressions = 0;
+    fprintf(stderr, "\n%-32s %12s %12s %9s\n", "name", "baseline", "current", "change");
+    for (const BenchResult &result : results) {
+        auto iter = std::find_if(baseline.begin(), baseline.end(),
+            [&result](const BenchResult &base) { return base.name == result.name; });
+        if (iter == baseline.end() || iter->nsPerOp <= 0) {
+            fprintf(stderr, "%-32s %12s %12.1f %9s\n", result.name.c_str(), "-", result.nsPerOp, "new");
+            continue;
+        }
+        double change = (result.nsPerOp - iter->nsPerOp) / iter->nsPerOp * 100.0;
+        bool regressed = change > threshold;
+        if (regressed) {
+            regressions++;
+        }
+        fprintf(stderr, "%-32s %12.1f %12.1f %+8.1f%%%s\n", result.name.c_str(), iter->nsPerOp, result.nsPerOp,
+            change, regressed ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+static void Usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [options]\n"
+        "  -r <repeat>     repeat each benchmark and report the median (default %u)\n"
+        "  -f <filter>     only run benchmarks whose name contains filter\n"
+        "  -o <file>       write json result to file (default stdout)\n"
+        "  -b <file>       compare against a saved baseline json\n"
+        "  -t <percent>    regression threshold for compare mode (default %.0f)\n",
+        name, DEFAULT_REPEAT, DEFAULT_THRESHOLD);
+}
+
+int main(int argc, char *argv[])
+{
+    MicroBenchOptions options;
+    int opt;
+    while ((opt = getopt(argc, argv, "r:f:o:b:t:h")) != -1) {
+        switch (opt) {
+            case 'r': options.repeat = strtoul(optarg, nullptr, 10); break;
+            case 'f': options.filter = optarg; break;
+            case 'o': options.outputPath = optarg; break;
+            case 'b': options.comparePath = optarg; break;
+            case 't': options.threshold = atof(optarg); break;
+            default: {
+                Usage(argv[0]);
+                return 1;
+            }
+        }
+    }
+    if (options.repeat == 0) {
+        options.repeat = 1;
+    }
+    std::vector<BenchResult> baseline;
+    if (options.comparePath != nullptr && !LoadBaseline(options.comparePath, baseline)) {
+        return 1;
+    }
+
+    // 被测代码在热路径上有大量printf，测试期间将标准输出重定向到/dev/null，结果另行输出
+    fflush(stdout);
+    int stdoutFd = dup(STDOUT_FILENO);
+    int nullFd = open("/dev/null", O_WRONLY);
+    if (stdoutFd == -1 || nullFd == -1) {
+        fprintf(stderr, "ERROR redirect stdout fail.\n");
+        return 1;
+    }
+    dup2(nullFd, STDOUT_FILENO);
+    close(nullFd);
+    MicroBench bench(options);
+    bench.RunAll();
+    fflush(stdout);
+    dup2(stdoutFd, STDOUT_FILENO);
+    close(stdoutFd);
+
+    FILE *output = stdout;
+    if (options.outputPath != nullptr) {
+        output = fopen(options.outputPath, "w");
+        if (output == nullptr) {
+            fprintf(stderr, "ERROR open output fail: %s.\n", options.outputPath);
+            return 1;
+        }
+    }
+    WriteJson(output, bench.Results());
+    if (output != stdout) {
+        fclose(output);
+    }
+    if (options.comparePath != nullptr) {
+        unsigned int regressions = Compare(baseline, bench.Results(), options.threshold);
+        fprintf(stderr, "%u regression(s) over %.1f%%\n", regressions, options.threshold);
+        return regressions == 0 ? 0 : 2;
+    }
+    return 0;
+}
@@ -0,0 +1,29 @@
+#!/bin/bash
+# 在回环地址上对webpages目录执行一组固定场景的压测
+# 用法: ./bench/run_scenarios.sh [ip] [port] [duration]
+# 需要先启动http_server，并以webpages目录作为资源目录，例如:
+#   ./output/http_server --port=8080 --source_dir=./webpages
+
+ip=${1:-"127.0.0.1"}
+port=${2:-443}
+duration=${3:-10}
+script_path=$(cd "$(dirname "$0")"; pwd)
+bench="${script_path}/../output/http_bench"
+scenario_path="${script_path}/scenarios"
+
+if [ ! -x "$bench" ]; then
+    echo "http_bench not found, run build.sh first"
+    exit 1
+fi
+
+run() {
+    echo "==== $1"
+    shift
+    "$bench" -a "$ip" -p "$port" -d "$duration" "$@"
+}
+
+run "closed loop, keep-alive" -t 2 -c 16 -s "${scenario_path}/hello.txt"
+run "closed loop, short connection" -t 2 -c 16 -C -s "${scenario_path}/hello.txt"
+run "closed loop, mixed hit/miss" -t 2 -c 16 -s "${scenario_path}/mixed.txt"
+run "open loop, 5000 req/s" -t 2 -c 32 -R 5000 -s "${scenario_path}/hello.txt"
+run "open loop, 20000 req/s" -t 2 -c 64 -R 20000 -s "${scenario_path}/hello.txt"
@@ -0,0 +1,45 @@
+#!/bin/bash
+# 在回环地址上对比各个套接字选项的效果，每组选项启动一次http_server并执行短连接和长连接压测
+# 用法: ./bench/run_socket_options.sh [port] [duration]
+# TCP Fast Open需要服务端和客户端都开启: sysctl -w net.ipv4.tcp_fastopen=3
+# 忙轮询超过net.core.busy_read的值需要root权限
+
+port=${1:-8080}
+duration=${2:-5}
+script_path=$(cd "$(dirname "$0")"; pwd)
+output_path="${script_path}/../output"
+server="${output_path}/http_server"
+bench="${output_path}/http_bench"
+source_dir="${script_path}/../webpages"
+
+if [ ! -x "$server" ] || [ ! -x "$bench" ]; then
+    echo "http_server or http_bench not found, run build.sh first"
+    exit 1
+fi
+
+# 短连接压测在回环地址上留下大量TIME_WAIT连接，等它们超时再开始下一组，避免本地端口耗尽
+wait_time_wait() {
+    while [ "$(ss -tan state time-wait "( sport = :$port or dport = :$port )" | wc -l)" -gt 1 ]; do
+        sleep 1
+    done
+}
+
+# $1为场景名，$2为服务端选项，$3为压测客户端选项
+run() {
+    wait_time_wait
+    "$server" --ip_addr=127.0.0.1 --port="$port" --source_dir="$source_dir" $2 > /dev/null &
+    server_pid=$!
+    sleep 0.5
+    echo "==== $1, short connection"
+    "$bench" -p "$port" -d "$duration" -t 2 -c 16 -C $3
+    echo "==== $1, keep-alive"
+    "$bench" -p "$port" -d "$duration" -t 2 -c 16 $3
+    kill "$server_pid"
+    wait "$server_pid" 2>/dev/null
+}
+
+run "baseline" "--tcp_nodelay=0"
+run "tcp_nodelay" "--tcp_nodelay=1"
+run "defer_accept" "--tcp_nodelay=1 --defer_accept=5"
+run "fast_open" "--tcp_nodelay=1 --fast_open=256" "-F"
+run "busy_poll" "--tcp_nodelay=1 --busy_poll=50"
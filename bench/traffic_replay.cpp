@@ -0,0 +1,760 @@
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include "latency_histogram.h"
+#include "traffic_capture.h"
+
+const unsigned int DEFAULT_CONCURRENCY = 256; // 最快速度回放时同时打开的连接数
+const unsigned int DEFAULT_TIMEOUT_MS = 2000;
+const unsigned int MAX_EVENTS = 256;
+const unsigned int RECV_BUFF_LEN = 16384;
+const uint64_t NSEC_PER_SEC = 1000000000ULL;
+const uint64_t NSEC_PER_MSEC = 1000000ULL;
+const uint64_t LAG_THRESHOLD_NS = NSEC_PER_MSEC; // 晚于计划时刻超过1毫秒发出的数据计为滞后
+const uint64_t TIMEOUT_CHECK_INTERVAL_NS = 10 * NSEC_PER_MSEC; // 连接数可能很多，超时检查不在每轮循环中进行
+const char *HEAD_END_STR = "\r\n\r\n";
+const char *CONTENT_LENGTH_STR = "Content-Length:";
+const char *CONNECTION_CLOSE_STR = "Connection: close";
+
+struct ReplayOptions {
+    std::string ipAddr { "127.0.0.1" };
+    std::string unixPath; // 非空时通过Unix域套接字连接，忽略地址和端口
+    unsigned short int port { 443 };
+    std::string file;
+    double speed { 1 }; // 回放倍速，0表示不按时间间隔、每个连接收到回复后立即发送下一批数据
+    unsigned int concurrency { DEFAULT_CONCURRENCY };
+    unsigned int timeoutMs { DEFAULT_TIMEOUT_MS };
+    bool jsonOutput { false };
+};
+
+// 抓包中一次read收到的数据，offset为在文件内容中的偏移
+struct ReplayChunk {
+    uint64_t time;
+    size_t offset;
+    uint32_t length;
+};
+
+// 按时间顺序排列的回放动作，只在按倍速回放时使用
+struct ReplayAction {
+    uint64_t time;
+    uint32_t connection; // 在m_connections中的下标
+    uint16_t type;
+};
+
+enum ConnectionState : unsigned char {
+    CONNECTION_STATE_CLOSED = 0,
+    CONNECTION_STATE_CONNECTING = 1,
+    CONNECTION_STATE_CONNECTED = 2,
+};
+
+struct ReplayConnection {
+    std::vector<ReplayChunk> chunks;
+    size_t nextChunk { 0 }; // 下一批待发送的数据
+    size_t dueChunk { 0 }; // 已到计划时刻的数据批数
+    bool captureClosed { false }; // 已回放到抓包中的关闭，回复全部收到后关闭
+    bool finished { false };
+    int fd { -1 };
+    ConnectionState state { CONNECTION_STATE_CLOSED };
+    std::string sendBuff;
+    size_t sendOffset { 0 };
+    std::string recvBuff;
+    std::deque<uint64_t> inflight; // 在途请求的计时起点，按倍速回放时为计划发送时刻
+    std::string requestHead; // 还没有收完头部的请求
+    unsigned long requestBodyLeft { 0 }; // 当前请求还没有收完的消息体长度
+    uint64_t lastActive { 0 };
+    bool wantWrite { false };
+};
+
+struct ReplayStats {
+    uint64_t completed { 0 };
+    uint64_t nonSuccess { 0 };
+    uint64_t bytes { 0 };
+    uint64_t connectErrors { 0 };
+    uint64_t ioErrors { 0 }; // 连接出错或被关闭时丢失回复的请求数
+    uint64_t timeouts { 0 };
+    uint64_t reconnects { 0 }; // 连接被关闭后同一抓包连接还有数据，重新连接
+    uint64_t laggedSends { 0 };
+    uint64_t elapsed { 0 };
+    LatencyHistogram histogram;
+};
+
+static uint64_t NowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+// 单线程回放：按倍速回放时每批数据在抓包中的相对时刻发出，不等待之前的回复，服务端变慢时请求在连接上排队，
+// 时延从计划时刻开始计算；最快速度回放时每个连接收齐回复后才发送下一批，同时打开的连接数受concurrency限制
+class Replayer {
+public:
+    Replayer(const ReplayOptions &options, const struct sockaddr_storage &serverAddr, const socklen_t serverAddrLen)
+        : m_options(options), m_serverAddr(serverAddr), m_serverAddrLen(serverAddrLen)
+    {}
+    ~Replayer()
+    {
+        for (auto &connection : m_connections) {
+            CloseConnection(connection);
+        }
+        if (m_efd != -1) {
+            close(m_efd);
+        }
+    }
+    bool Load(const char *path);
+    void Run();
+    void PrintResult() const;
+private:
+    bool IsTimed() const
+    {
+        return m_options.speed > 0;
+    }
+    uint64_t ScheduleTime(const uint64_t captureTime) const
+    {
+        return m_startTime + static_cast<uint64_t>((captureTime - m_firstTime) / m_options.speed);
+    }
+    uint32_t Index(const ReplayConnection &connection) const
+    {
+        return static_cast<uint32_t>(&connection - &m_connections[0]);
+    }
+    int WaitTimeout(const uint64_t now) const;
+    void RunActions(const uint64_t now);
+    void StartConnections();
+    void SendChunk(ReplayConnection &connection, const uint64_t startTime);
+    void Advance(ReplayConnection &connection);
+    void Finish(ReplayConnection &connection);
+    void Connect(ReplayConnection &connection);
+    void CloseConnection(ReplayConnection &connection);
+    void LoseInflight(ReplayConnection &connection);
+    void HandleEvent(ReplayConnection &connection, const uint32_t events);
+    void Flush(ReplayConnection &connection);
+    void SetWantWrite(ReplayConnection &connection, const bool wantWrite);
+    void HandleRead(ReplayConnection &connection);
+    bool ParseResponse(ReplayConnection &connection, bool &closeAfter);
+    void ScanRequests(ReplayConnection &connection, const char *data, size_t len, const uint64_t startTime);
+    void CheckTimeout(const uint64_t now);
+private:
+    const ReplayOptions &m_options;
+    struct sockaddr_storage m_serverAddr;
+    socklen_t m_serverAddrLen;
+    std::string m_content; // 抓包文件的全部内容
+    std::vector<ReplayConnection> m_connections; // 按抓包中的建立顺序排列
+    std::vector<ReplayAction> m_actions;
+    size_t m_nextAction { 0 };
+    size_t m_nextConnection { 0 }; // 最快速度回放时下一个要开始的连接
+    unsigned int m_activeNum { 0 }; // 已开始还没有结束的连接数
+    size_t m_finishedNum { 0 };
+    uint64_t m_firstTime { 0 }; // 抓包中第一条记录的时刻
+    uint64_t m_lastTime { 0 };
+    uint64_t m_startTime { 0 };
+    uint64_t m_nextTimeoutCheck { 0 };
+    uint64_t m_requestNum { 0 }; // 抓包中的完整请求数，回放时统计
+    uint64_t m_chunkNum { 0 };
+    uint64_t m_captureBytes { 0 };
+    int m_efd { -1 };
+    ReplayStats m_stats;
+};
+
+// 文件全部读入内存，DATA记录只保存偏移；抓包停止时没有关闭记录的连接在文件结束时关闭
+bool Replayer::Load(const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        printf("ERROR  open capture file fail: %s.\n", path);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return false;
+    }
+    m_content.resize(st.st_size);
+    size_t offset = 0;
+    while (offset < m_content.size()) {
+        ssize_t ret = read(fd, &m_content[offset], m_content.size() - offset);
+        if (ret <= 0) {
+            break;
+        }
+        offset += static_cast<size_t>(ret);
+    }
+    close(fd);
+    const TrafficCaptureFileHeader *header = reinterpret_cast<const TrafficCaptureFileHeader *>(m_content.data());
+    if (offset != m_content.size() || m_content.size() < sizeof(TrafficCaptureFileHeader) ||
+        memcmp(header->magic, TRAFFIC_CAPTURE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != TRAFFIC_CAPTURE_VERSION) {
+        printf("ERROR  invalid capture file: %s.\n", path);
+        return false;
+    }
+    std::unordered_map<uint32_t, uint32_t> indexes; // 抓包中的连接编号到下标
+    offset = header->headerSize;
+    bool first = true;
+    while (offset + sizeof(TrafficCaptureRecord) <= m_content.size()) {
+        TrafficCaptureRecord record;
+        memcpy(&record, m_content.data() + offset, sizeof(record));
+        offset += sizeof(record);
+        if (offset + record.length > m_content.size()) {
+            break; // 进程异常退出时最后一条记录可能不完整
+        }
+        if (first) {
+            m_firstTime = record.time;
+            first = false;
+        }
+        m_lastTime = record.time;
+        auto iter = indexes.find(record.connection);
+        if (iter == indexes.end()) {
+            if (record.type == TRAFFIC_CAPTURE_RECORD_CLOSE) {
+                continue;
+            }
+            iter = indexes.emplace(record.connection, static_cast<uint32_t>(m_connections.size())).first;
+            m_connections.emplace_back();
+            m_actions.push_back({ record.time, iter->second, TRAFFIC_CAPTURE_RECORD_OPEN });
+        }
+        ReplayConnection &connection = m_connections[iter->second];
+        if (record.type == TRAFFIC_CAPTURE_RECORD_DATA && record.length > 0) {
+            connection.chunks.push_back({ record.time, offset, record.length });
+            m_actions.push_back({ record.time, iter->second, TRAFFIC_CAPTURE_RECORD_DATA });
+            m_chunkNum++;
+            m_captureBytes += record.length;
+        } else if (record.type == TRAFFIC_CAPTURE_RECORD_CLOSE) {
+            m_actions.push_back({ record.time, iter->second, TRAFFIC_CAPTURE_RECORD_CLOSE });
+            indexes.erase(iter);
+        }
+        offset += record.length;
+    }
+    for (auto &item : indexes) {
+        m_actions.push_back({ m_lastTime, item.second, TRAFFIC_CAPTURE_RECORD_CLOSE });
+    }
+    return true;
+}
+
+void Replayer::Run()
+{
+    m_efd = epoll_create(MAX_EVENTS);
+    if (m_efd == -1) {
+        printf("ERROR  epoll_create fail.\n");
+        return;
+    }
+    m_startTime = NowNs();
+    struct epoll_event events[MAX_EVENTS];
+    while (m_finishedNum < m_connections.size()) {
+        uint64_t now = NowNs();
+        if (IsTimed()) {
+            RunActions(now);
+        } else {
+            StartConnections();
+        }
+        int ret = epoll_wait(m_efd, events, MAX_EVENTS, WaitTimeout(now));
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            printf("ERROR  epoll_wait fail, errno = %d.\n", errno);
+            break;
+        }
+        for (int i = 0; i < ret; ++i) {
+            HandleEvent(m_connections[events[i].data.u32], events[i].events);
+        }
+        now = NowNs();
+        if (now >= m_nextTimeoutCheck) {
+            CheckTimeout(now);
+            m_nextTimeoutCheck = now + TIMEOUT_CHECK_INTERVAL_NS;
+        }
+    }
+    m_stats.elapsed = NowNs() - m_startTime;
+}
+
+int Replayer::WaitTimeout(const uint64_t now) const
+{
+    uint64_t timeout = 100; // 最多等待100毫秒，保证超时检查及时
+    if (IsTimed() && m_nextAction < m_actions.size()) {
+        uint64_t deadline = ScheduleTime(m_actions[m_nextAction].time);
+        timeout = deadline <= now ? 0 : (deadline - now + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC;
+    }
+    return timeout > 100 ? 100 : static_cast<int>(timeout);
+}
+
+void Replayer::RunActions(const uint64_t now)
+{
+    while (m_nextAction < m_actions.size()) {
+        const ReplayAction &action = m_actions[m_nextAction];
+        if (ScheduleTime(action.time) > now) {
+            break;
+        }
+        m_nextAction++;
+        ReplayConnection &connection = m_connections[action.connection];
+        if (connection.finished) {
+            continue;
+        }
+        if (action.type == TRAFFIC_CAPTURE_RECORD_OPEN) {
+            m_activeNum++;
+            Connect(connection);
+        } else if (action.type == TRAFFIC_CAPTURE_RECORD_DATA) {
+            connection.dueChunk++;
+        } else {
+            connection.captureClosed = true;
+        }
+        Advance(connection);
+    }
+}
+
+void Replayer::StartConnections()
+{
+    while (m_nextConnection < m_connections.size() && m_activeNum < m_options.concurrency) {
+        ReplayConnection &connection = m_connections[m_nextConnection];
+        m_nextConnection++;
+        m_activeNum++;
+        // 最快速度回放时所有数据都已到期，发送完后关闭
+        connection.dueChunk = connection.chunks.size();
+        connection.captureClosed = true;
+        Connect(connection);
+        Advance(connection);
+    }
+}
+
+void Replayer::SendChunk(ReplayConnection &connection, const uint64_t startTime)
+{
+    const ReplayChunk &chunk = connection.chunks[connection.nextChunk];
+    connection.nextChunk++;
+    const char *data = m_content.data() + chunk.offset;
+    if (connection.inflight.empty()) {
+        connection.lastActive = NowNs(); // 空闲之后的请求从发送时开始计算超时
+    }
+    connection.sendBuff.append(data, chunk.length);
+    ScanRequests(connection, data, chunk.length, startTime);
+    Flush(connection);
+}
+
+// 服务端不处理管线化的请求，原客户端在收到回复后才会发送下一个请求，所以开始新请求的数据要等之前的回复收齐；
+// 接着发送未完成请求的数据不等待。按倍速回放时计时起点仍为计划时刻，等待回复的时间计入时延
+void Replayer::Advance(ReplayConnection &connection)
+{
+    while (!connection.finished && connection.nextChunk < connection.dueChunk) {
+        bool partial = !connection.requestHead.empty() || connection.requestBodyLeft > 0;
+        if (!connection.inflight.empty() && !partial) {
+            return;
+        }
+        if (connection.state == CONNECTION_STATE_CLOSED) {
+            m_stats.reconnects++;
+            Connect(connection);
+            if (connection.state == CONNECTION_STATE_CLOSED) {
+                connection.nextChunk = connection.dueChunk; // 连接失败，放弃已到期的数据
+                break;
+            }
+        }
+        if (connection.state != CONNECTION_STATE_CONNECTED) {
+            return;
+        }
+        uint64_t startTime = NowNs();
+        if (IsTimed()) {
+            uint64_t scheduleTime = ScheduleTime(connection.chunks[connection.nextChunk].time);
+            if (startTime > scheduleTime + LAG_THRESHOLD_NS) {
+                m_stats.laggedSends++;
+            }
+            startTime = scheduleTime;
+        }
+        SendChunk(connection, startTime);
+    }
+    bool allSent = connection.nextChunk == connection.chunks.size() && connection.sendBuff.empty();
+    if (!connection.finished && connection.captureClosed && allSent && connection.inflight.empty()) {
+        Finish(connection);
+    }
+}
+
+void Replayer::Finish(ReplayConnection &connection)
+{
+    connection.finished = true;
+    connection.inflight.clear();
+    CloseConnection(connection);
+    m_activeNum--;
+    m_finishedNum++;
+}
+
+void Replayer::Connect(ReplayConnection &connection)
+{
+    connection.fd = socket(m_serverAddr.ss_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (connection.fd == -1) {
+        m_stats.connectErrors++;
+        return;
+    }
+    connection.state = CONNECTION_STATE_CONNECTING;
+    connection.lastActive = NowNs();
+    int ret = connect(connection.fd, reinterpret_cast<const struct sockaddr *>(&m_serverAddr), m_serverAddrLen);
+    if (ret == -1 && errno != EINPROGRESS) {
+        m_stats.connectErrors++;
+        close(connection.fd);
+        connection.fd = -1;
+        connection.state = CONNECTION_STATE_CLOSED;
+        return;
+    }
+    struct epoll_event event = { 0 };
+    event.events = EPOLLIN | EPOLLOUT;
+    event.data.u32 = Index(connection);
+    connection.wantWrite = true;
+    if (epoll_ctl(m_efd, EPOLL_CTL_ADD, connection.fd, &event) == -1) {
+        m_stats.connectErrors++;
+        close(connection.fd);
+        connection.fd = -1;
+        connection.state = CONNECTION_STATE_CLOSED;
+    }
+}
+
+void Replayer::CloseConnection(ReplayConnection &connection)
+{
+    if (connection.fd != -1) {
+        epoll_ctl(m_efd, EPOLL_CTL_DEL, connection.fd, NULL);
+        close(connection.fd);
+        connection.fd = -1;
+    }
+    connection.state = CONNECTION_STATE_CLOSED;
+    connection.sendBuff.clear();
+    connection.sendOffset = 0;
+    connection.recvBuff.clear();
+    connection.requestHead.clear();
+    connection.requestBodyLeft = 0;
+    connection.wantWrite = false;
+}
+
+// 连接出错或被服务端关闭，在途请求计为出错，之后的数据由Advance在新连接上发送
+void Replayer::LoseInflight(ReplayConnection &connection)
+{
+    m_stats.ioErrors += connection.inflight.size();
+    connection.inflight.clear();
+    CloseConnection(connection);
+}
+
+void Replayer::HandleEvent(ReplayConnection &connection, const uint32_t events)
+{
+    if (connection.fd == -1) {
+        return;
+    }
+    if (connection.state == CONNECTION_STATE_CONNECTING) {
+        int error = 0;
+        socklen_t errorLen = sizeof(error);
+        if (getsockopt(connection.fd, SOL_SOCKET, SO_ERROR, &error, &errorLen) == -1 || error != 0) {
+            m_stats.connectErrors++;
+            CloseConnection(connection);
+            connection.nextChunk = connection.dueChunk; // 放弃已到期的数据，之后到期的数据重新连接
+            Advance(connection);
+            return;
+        }
+        connection.state = CONNECTION_STATE_CONNECTED;
+        connection.lastActive = NowNs();
+    }
+    if (events & EPOLLIN) {
+        HandleRead(connection);
+    } else if (events & (EPOLLERR | EPOLLHUP)) {
+        LoseInflight(connection);
+    }
+    if ((events & EPOLLOUT) && connection.wantWrite) {
+        Flush(connection);
+    }
+    Advance(connection);
+}
+
+void Replayer::Flush(ReplayConnection &connection)
+{
+    if (connection.state != CONNECTION_STATE_CONNECTED) {
+        return;
+    }
+    while (connection.sendOffset < connection.sendBuff.size()) {
+        ssize_t ret = send(connection.fd, connection.sendBuff.data() + connection.sendOffset,
+            connection.sendBuff.size() - connection.sendOffset, MSG_NOSIGNAL);
+        if (ret == -1) {
+            if (errno == EAGAIN) {
+                SetWantWrite(connection, true);
+                return;
+            }
+            LoseInflight(connection);
+            return;
+        }
+        connection.sendOffset += static_cast<size_t>(ret);
+    }
+    connection.sendBuff.clear();
+    connection.sendOffset = 0;
+    SetWantWrite(connection, false);
+}
+
+void Replayer::SetWantWrite(ReplayConnection &connection, const bool wantWrite)
+{
+    if (connection.wantWrite == wantWrite) {
+        return;
+    }
+    struct epoll_event event = { 0 };
+    event.events = wantWrite ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    event.data.u32 = Index(connection);
+    if (epoll_ctl(m_efd, EPOLL_CTL_MOD, connection.fd, &event) == 0) {
+        connection.wantWrite = wantWrite;
+    }
+}
+
+void Replayer::HandleRead(ReplayConnection &connection)
+{
+    char buff[RECV_BUFF_LEN];
+    bool peerClosed = false;
+    while (true) {
+        ssize_t ret = recv(connection.fd, buff, sizeof(buff), 0);
+        if (ret == -1) {
+            if (errno == EAGAIN) {
+                break;
+            }
+            LoseInflight(connection);
+            return;
+        }
+        if (ret == 0) {
+            peerClosed = true;
+            break;
+        }
+        connection.lastActive = NowNs();
+        connection.recvBuff.append(buff, ret);
+    }
+    bool closeAfter = false;
+    while (ParseResponse(connection, closeAfter)) {
+        if (closeAfter) {
+            break;
+        }
+    }
+    if (closeAfter || peerClosed) {
+        LoseInflight(connection);
+    }
+}
+
+// 解析出一个完整回复返回true，与http_bench相同
+bool Replayer::ParseResponse(ReplayConnection &connection, bool &closeAfter)
+{
+    std::string &recvBuff = connection.recvBuff;
+    // 服务端错误回复会在消息体后多发送一个结束符，这里跳过
+    size_t start = recvBuff.find_first_not_of('\0');
+    if (start == std::string::npos) {
+        recvBuff.clear();
+        return false;
+    }
+    size_t headEnd = recvBuff.find(HEAD_END_STR, start);
+    if (headEnd == std::string::npos) {
+        return false;
+    }
+    size_t headLen = headEnd + strlen(HEAD_END_STR);
+    unsigned long contentLen = 0;
+    const char *head = recvBuff.c_str() + start;
+    const char *contentLenPos = strcasestr(head, CONTENT_LENGTH_STR);
+    if (contentLenPos != nullptr && contentLenPos < recvBuff.c_str() + headEnd) {
+        contentLen = strtoul(contentLenPos + strlen(CONTENT_LENGTH_STR), nullptr, 10);
+    }
+    if (recvBuff.size() < headLen + contentLen) {
+        return false;
+    }
+    const char *statusPos = strchr(head, ' ');
+    int status = statusPos != nullptr ? atoi(statusPos + 1) : 0;
+    const char *closePos = strcasestr(head, CONNECTION_CLOSE_STR);
+    closeAfter = closePos != nullptr && closePos < recvBuff.c_str() + headEnd;
+    if (!connection.inflight.empty()) {
+        uint64_t now = NowNs();
+        uint64_t startTime = connection.inflight.front();
+        connection.inflight.pop_front();
+        m_stats.completed++;
+        if (status < 200 || status >= 300) {
+            m_stats.nonSuccess++;
+        }
+        m_stats.bytes += headLen + contentLen - start;
+        m_stats.histogram.Record(now > startTime ? now - startTime : 0);
+    }
+    recvBuff.erase(0, headLen + contentLen);
+    return true;
+}
+
+// 请求可能跨多批数据，也可能一批中有多个管线化的请求；收完头部和Content-Length指定的消息体才算一个请求
+void Replayer::ScanRequests(ReplayConnection &connection, const char *data, size_t len, const uint64_t startTime)
+{
+    while (len > 0) {
+        if (connection.requestBodyLeft > 0) {
+            size_t bodyLen = len < connection.requestBodyLeft ? len : connection.requestBodyLeft;
+            connection.requestBodyLeft -= bodyLen;
+            data += bodyLen;
+            len -= bodyLen;
+            if (connection.requestBodyLeft == 0) {
+                connection.inflight.push_back(startTime);
+                m_requestNum++;
+            }
+            continue;
+        }
+        std::string &head = connection.requestHead;
+        size_t searchStart = head.size() < strlen(HEAD_END_STR) ? 0 : head.size() - strlen(HEAD_END_STR) + 1;
+        size_t oldLen = head.size();
+        head.append(data, len);
+        size_t headEnd = head.find(HEAD_END_STR, searchStart);
+        if (headEnd == std::string::npos) {
+            return;
+        }
+        size_t used = headEnd + strlen(HEAD_END_STR) - oldLen;
+        head.resize(headEnd);
+        const char *contentLenPos = strcasestr(head.c_str(), CONTENT_LENGTH_STR);
+        connection.requestBodyLeft = contentLenPos == nullptr ? 0 :
+            strtoul(contentLenPos + strlen(CONTENT_LENGTH_STR), nullptr, 10);
+        head.clear();
+        data += used;
+        len -= used;
+        if (connection.requestBodyLeft == 0) {
+            connection.inflight.push_back(startTime);
+            m_requestNum++;
+        }
+    }
+}
+
+void Replayer::CheckTimeout(const uint64_t now)
+{
+    uint64_t timeout = static_cast<uint64_t>(m_options.timeoutMs) * NSEC_PER_MSEC;
+    for (auto &connection : m_connections) {
+        if (connection.fd == -1) {
+            continue;
+        }
+        bool waiting = connection.state == CONNECTION_STATE_CONNECTING || !connection.inflight.empty();
+        if (waiting && now > connection.lastActive + timeout) {
+            m_stats.timeouts += connection.inflight.empty() ? 1 : connection.inflight.size();
+            connection.inflight.clear();
+            CloseConnection(connection);
+            Advance(connection);
+        }
+    }
+}
+
+void Replayer::PrintResult() const
+{
+    double captureSeconds = static_cast<double>(m_lastTime - m_firstTime) / NSEC_PER_SEC;
+    double seconds = static_cast<double>(m_stats.elapsed) / NSEC_PER_SEC;
+    double throughput = seconds > 0 ? m_stats.completed / seconds : 0;
+    const LatencyHistogram &histogram = m_stats.histogram;
+    if (m_options.jsonOutput) {
+        printf("{\"speed\":%.2f,\"capture_seconds\":%.3f,\"connections\":%zu,\"chunks\":%lu,\"capture_bytes\":%lu,"
+            "\"requests\":%lu,\"elapsed\":%.3f,\"completed\":%lu,\"throughput\":%.1f,\"non_2xx\":%lu,"
+            "\"connect_errors\":%lu,\"io_errors\":%lu,\"timeouts\":%lu,\"reconnects\":%lu,\"lagged_sends\":%lu,"
+            "\"latency_us\":{\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f,\"p999\":%.1f,\"max\":%.1f}}\n",
+            m_options.speed, captureSeconds, m_connections.size(), m_chunkNum, m_captureBytes, m_requestNum, seconds,
+            m_stats.completed, throughput, m_stats.nonSuccess, m_stats.connectErrors, m_stats.ioErrors,
+            m_stats.timeouts, m_stats.reconnects, m_stats.laggedSends, histogram.Percentile(50) / 1000.0,
+            histogram.Percentile(90) / 1000.0, histogram.Percentile(99) / 1000.0,
+            histogram.Percentile(99.9) / 1000.0, histogram.Max() / 1000.0);
+        return;
+    }
+    printf("capture: %.3fs, %zu connections, %lu reads, %lu bytes, %lu requests\n", captureSeconds,
+        m_connections.size(), m_chunkNum, m_captureBytes, m_requestNum);
+    if (IsTimed()) {
+        printf("replay at %.2fx in %.3fs, lagged sends %lu\n", m_options.speed, seconds, m_stats.laggedSends);
+    } else {
+        printf("replay at max speed in %.3fs, concurrency %u\n", seconds, m_options.concurrency);
+    }
+    printf("  requests:     %lu (non-2xx %lu)\n", m_stats.completed, m_stats.nonSuccess);
+    printf("  throughput:   %.1f req/s, %.2f MB/s\n", throughput,
+        seconds > 0 ? m_stats.bytes / seconds / (1024 * 1024) : 0);
+    printf("  errors:       connect %lu, io %lu, timeout %lu, reconnects %lu\n",
+        m_stats.connectErrors, m_stats.ioErrors, m_stats.timeouts, m_stats.reconnects);
+    printf("  latency(us):  p50 %.1f  p90 %.1f  p99 %.1f  p999 %.1f  max %.1f\n",
+        histogram.Percentile(50) / 1000.0, histogram.Percentile(90) / 1000.0, histogram.Percentile(99) / 1000.0,
+        histogram.Percentile(99.9) / 1000.0, histogram.Max() / 1000.0);
+}
+
+static void Usage(const char *name)
+{
+    printf("Usage: %s [options] -f <capture file>\n"
+        "  -a <ip>         server ipv4 or ipv6 address (default 127.0.0.1)\n"
+        "  -p <port>       server port (default 443)\n"
+        "  -U <path>       connect to a unix domain socket instead of ip and port\n"
+        "  -f <file>       capture file written by http_server with capture_file\n"
+        "  -x <speed>      replay speed, 2 replays twice as fast, 0 replays at max speed (default 1)\n"
+        "  -c <conns>      open connections at max speed (default %u)\n"
+        "  -T <ms>         request timeout (default %u)\n"
+        "  -j              print result as json\n",
+        name, DEFAULT_CONCURRENCY, DEFAULT_TIMEOUT_MS);
+}
+
+static bool ParseOptions(int argc, char *argv[], ReplayOptions &options)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "a:p:U:f:x:c:T:jh")) != -1) {
+        switch (opt) {
+            case 'a': options.ipAddr = optarg; break;
+            case 'p': options.port = static_cast<unsigned short int>(atoi(optarg)); break;
+            case 'U': options.unixPath = optarg; break;
+            case 'f': options.file = optarg; break;
+            case 'x': options.speed = atof(optarg); break;
+            case 'c': options.concurrency = strtoul(optarg, nullptr, 10); break;
+            case 'T': options.timeoutMs = strtoul(optarg, nullptr, 10); break;
+            case 'j': options.jsonOutput = true; break;
+            default: {
+                Usage(argv[0]);
+                return false;
+            }
+        }
+    }
+    if (options.file.empty() || options.speed < 0 || options.concurrency == 0) {
+        Usage(argv[0]);
+        return false;
+    }
+    return true;
+}
+
+static bool GetServerAddr(const ReplayOptions &options, struct sockaddr_storage &addr, socklen_t &addrLen)
+{
+    memset(&addr, 0, sizeof(addr));
+    if (!options.unixPath.empty()) {
+        struct sockaddr_un *unixAddr = reinterpret_cast<struct sockaddr_un *>(&addr);
+        if (options.unixPath.size() >= sizeof(unixAddr->sun_path)) {
+            printf("ERROR  Unix socket path too long: %s.\n", options.unixPath.c_str());
+            return false;
+        }
+        unixAddr->sun_family = AF_UNIX;
+        strncpy(unixAddr->sun_path, options.unixPath.c_str(), sizeof(unixAddr->sun_path) - 1);
+        addrLen = sizeof(struct sockaddr_un);
+        return true;
+    }
+    struct sockaddr_in *ipv4Addr = reinterpret_cast<struct sockaddr_in *>(&addr);
+    if (inet_pton(AF_INET, options.ipAddr.c_str(), &ipv4Addr->sin_addr) == 1) {
+        ipv4Addr->sin_family = AF_INET;
+        ipv4Addr->sin_port = htons(options.port);
+        addrLen = sizeof(struct sockaddr_in);
+        return true;
+    }
+    struct sockaddr_in6 *ipv6Addr = reinterpret_cast<struct sockaddr_in6 *>(&addr);
+    if (inet_pton(AF_INET6, options.ipAddr.c_str(), &ipv6Addr->sin6_addr) == 1) {
+        ipv6Addr->sin6_family = AF_INET6;
+        ipv6Addr->sin6_port = htons(options.port);
+        addrLen = sizeof(struct sockaddr_in6);
+        return true;
+    }
+    printf("ERROR  Invalid ip address: %s.\n", options.ipAddr.c_str());
+    return false;
+}
+
+int main(int argc, char *argv[])
+{
+    ReplayOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        return 1;
+    }
+    struct sockaddr_storage serverAddr;
+    socklen_t serverAddrLen = 0;
+    if (!GetServerAddr(options, serverAddr, serverAddrLen)) {
+        return 1;
+    }
+    Replayer replayer(options, serverAddr, serverAddrLen);
+    if (!replayer.Load(options.file.c_str())) {
+        return 1;
+    }
+    replayer.Run();
+    replayer.PrintResult();
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+#!/bin/bash
+# 构建开启LTO的发布版本和PGO版本，并在回环地址上对比两者的吞吐量
+# 用法: ./build_pgo.sh [port] [train_seconds] [bench_seconds] [rounds]
+# 结果: output/http_server_pgo和output/pgo_report.txt，发布版本在build_release/output中
+
+port=${1:-8080}
+train_seconds=${2:-5}
+bench_seconds=${3:-5}
+rounds=${4:-3}
+root_path=$(cd "$(dirname "$0")"; pwd)
+release_path="${root_path}/build_release"
+pgo_path="${root_path}/build_pgo"
+profile_path="${pgo_path}/profile"
+output_path="${root_path}/output"
+source_dir="${root_path}/webpages"
+train_file="${root_path}/bench/scenarios/pgo_train.txt"
+bench_file="${root_path}/bench/scenarios/hello.txt"
+report="${output_path}/pgo_report.txt"
+jobs=$(nproc)
+
+# $1为构建目录，其余为cmake选项
+build() {
+    local build_path=$1
+    shift
+    cmake -S "$root_path" -B "$build_path" -Wno-dev -DCMAKE_BUILD_TYPE=Release -DENABLE_LTO=ON \
+        -DOUTPUT_PATH="${build_path}/output" "$@" > /dev/null || exit 1
+    cmake --build "$build_path" -j"$jobs" --target http_server http_bench > /dev/null || exit 1
+}
+
+# $1为服务端可执行文件，在后台启动并等待端口可用
+start_server() {
+    "$1" -c "${root_path}/conf/http_server.conf" --ip_addr=127.0.0.1 --port="$port" --source_dir="$source_dir" \
+        --backlog=1024 > /dev/null &
+    server_pid=$!
+    sleep 0.5
+}
+
+# SIGTERM让服务端处理完连接后正常退出，插桩版本在退出时写profile
+stop_server() {
+    kill -TERM "$server_pid"
+    wait "$server_pid" 2>/dev/null
+}
+
+# 短连接压测在回环地址上留下大量TIME_WAIT连接，等它们超时再开始下一组，避免本地端口耗尽
+wait_time_wait() {
+    while [ "$(ss -tan state time-wait "( sport = :$port or dport = :$port )" | wc -l)" -gt 1 ]; do
+        sleep 1
+    done
+}
+
+rm -rf "$release_path" "$pgo_path"
+mkdir -p "$output_path"
+bench="${release_path}/output/http_bench"
+
+echo "==== build release with LTO"
+build "$release_path"
+
+echo "==== build instrumented server"
+build "$pgo_path" -DPGO=generate -DPGO_PROFILE_DIR="$profile_path"
+
+echo "==== train with ${train_file}"
+start_server "${pgo_path}/output/http_server"
+"$bench" -p "$port" -d "$train_seconds" -t 2 -c 16 -s "$train_file" > /dev/null
+"$bench" -p "$port" -d "$train_seconds" -t 2 -c 64 -s "$train_file" > /dev/null
+"$bench" -p "$port" -d "$train_seconds" -t 2 -c 16 -C -s "$train_file" > /dev/null
+stop_server
+if [ -z "$(find "$profile_path" -name '*.gcda' 2>/dev/null)" ]; then
+    echo "no profile written to ${profile_path}"
+    exit 1
+fi
+
+echo "==== build server with profile"
+build "$pgo_path" -DPGO=use -DPGO_PROFILE_DIR="$profile_path"
+cp "${pgo_path}/output/http_server" "${output_path}/http_server_pgo"
+
+# $1为场景名，$2为压测选项；两个版本交替执行，每个版本取各轮吞吐量的中位数
+compare() {
+    local release_list=""
+    local pgo_list=""
+    for ((i = 0; i < rounds; i++)); do
+        for binary in "${release_path}/output/http_server" "${output_path}/http_server_pgo"; do
+            wait_time_wait
+            start_server "$binary"
+            local result=$("$bench" -p "$port" -d "$bench_seconds" -t 2 -c 16 $2 -s "$bench_file" -j)
+            stop_server
+            local throughput=$(echo "$result" | sed -n 's/.*"throughput":\([0-9.]*\).*/\1/p')
+            if [ "$binary" = "${output_path}/http_server_pgo" ]; then
+                pgo_list="${pgo_list} ${throughput}"
+            else
+                release_list="${release_list} ${throughput}"
+            fi
+        done
+    done
+    local release_median=$(echo $release_list | tr ' ' '\n' | sort -n | awk '{v[NR]=$1} END {print v[int((NR+1)/2)]}')
+    local pgo_median=$(echo $pgo_list | tr ' ' '\n' | sort -n | awk '{v[NR]=$1} END {print v[int((NR+1)/2)]}')
+    printf "%-14s release %10.1f req/s  pgo %10.1f req/s  speedup %.3fx\n" "$1" "$release_median" "$pgo_median" \
+        "$(awk -v a="$pgo_median" -v b="$release_median" 'BEGIN {print (b > 0 ? a / b : 0)}')" | tee -a "$report"
+}
+
+echo "==== compare release and pgo, ${rounds} rounds of ${bench_seconds}s"
+{
+    echo "# $(date '+%Y-%m-%d %H:%M:%S') $(${CXX:-c++} --version | head -1)"
+    echo "# train ${train_file}, bench ${bench_file}"
+} > "$report"
+compare "keep-alive" ""
+compare "keep-alive c64" "-c 64"
+compare "short conn" "-C"
+echo "report written to ${report}"
\ No newline at end of file
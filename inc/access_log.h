@@ -0,0 +1,118 @@
+#ifndef ACCESS_LOG_H
+#define ACCESS_LOG_H
+
+#include <stdint.h>
+#include <string>
+#include <atomic>
+#include "request_trace.h"
+
+// 访问日志文件格式：文件头之后依次追加8字节对齐的条目，每个条目以类型和长度开头
+// 字符串条目在同一文件中只写一次，记录条目通过文件内偏移引用URL和对端地址，access_log_dump离线解码
+extern const char ACCESS_LOG_MAGIC[8];
+const uint32_t ACCESS_LOG_VERSION = 1;
+const uint32_t ACCESS_LOG_ENTRY_ALIGN = 8;
+
+enum AccessLogEntryType : uint16_t {
+    ACCESS_LOG_ENTRY_STRING = 1,
+    ACCESS_LOG_ENTRY_RECORD = 2,
+};
+
+enum AccessLogMethod : uint8_t {
+    ACCESS_LOG_METHOD_OTHER = 0,
+    ACCESS_LOG_METHOD_GET = 1,
+    ACCESS_LOG_METHOD_HEAD = 2,
+    ACCESS_LOG_METHOD_POST = 3,
+    ACCESS_LOG_METHOD_PUT = 4,
+    ACCESS_LOG_METHOD_DELETE = 5,
+    ACCESS_LOG_METHOD_NUM,
+};
+
+enum AccessLogFlag : uint8_t {
+    ACCESS_LOG_FLAG_KEEP_ALIVE = 1,
+    ACCESS_LOG_FLAG_BUNDLE = 2, // 从资源包回复
+    ACCESS_LOG_FLAG_POOLED = 4, // 经过线程池
+};
+
+struct AccessLogFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t pid;
+    uint32_t writer; // 写入该文件的写入者编号，线程退出后其写入者由新线程继续使用
+    uint64_t seq; // 该写入者的第几个文件
+    uint64_t baseRealtime; // 创建文件时的CLOCK_REALTIME，与baseMonotonic一起把记录中的时间换算为日历时间
+    uint64_t baseMonotonic;
+    uint64_t fileSize;
+    uint64_t dataEnd; // 已完整写入的条目的结束偏移，每写完一个条目后更新
+};
+
+struct AccessLogEntryHead {
+    uint16_t type;
+    uint16_t size; // 包括条目头，不包括对齐填充
+};
+
+struct AccessLogString {
+    AccessLogEntryHead head;
+    uint32_t hash;
+    char data[0]; // 长度为head.size - sizeof(AccessLogString)，不带结束符
+};
+
+// 时间单位为微秒，没有经过的阶段为0
+struct AccessLogRecord {
+    AccessLogEntryHead head;
+    uint16_t status;
+    uint8_t method;
+    uint8_t flags;
+    uint64_t startTime; // 收到请求第一批数据的CLOCK_MONOTONIC时间，单位纳秒
+    uint32_t urlHash;
+    uint32_t urlOffset; // URL字符串条目在文件中的偏移
+    uint32_t peerOffset; // 对端地址字符串条目在文件中的偏移
+    uint32_t bytes; // 回复的字节数
+    uint32_t totalUs; // 收到第一批数据到最后一批回复数据交给内核
+    uint32_t queueUs; // 在线程池任务队列中等待
+    uint32_t handleUs; // 解析完成到查找资源包或stat、open、mmap完成
+    uint32_t sendUs; // 第一批到最后一批回复数据交给内核
+};
+
+// 请求处理期间的时间点和回复状态，放在连接的请求缓冲区中，空闲连接不占用内存
+struct RequestLogInfo {
+    unsigned long long time[TRACE_POINT_NUM]; // CLOCK_MONOTONIC，单位纳秒，0表示没有经过
+    unsigned int status;
+};
+
+struct AccessLogEntry {
+    const char *method;
+    const char *url; // 以结束符结尾，可以为空
+    const char *peer;
+    unsigned int status;
+    unsigned int bytes;
+    unsigned char flags;
+    const RequestLogInfo *info;
+};
+
+// 每个线程通过自己的写入者追加记录，追加时不加锁；文件以MAP_SHARED映射，进程崩溃时已写入的记录仍在页缓存中
+// 文件写满后换新文件，每个写入者最多保留fileNum个文件，超过时删除最早的
+class AccessLog {
+public:
+    // dir为空时关闭访问日志，只在启动时调用一次
+    static bool Init(const std::string &dir, const unsigned long long fileSize, const unsigned int fileNum);
+    static bool IsEnabled()
+    {
+        return m_enabled.load(std::memory_order_relaxed);
+    }
+    static unsigned long long Now();
+    static void Append(const AccessLogEntry &entry);
+    static AccessLogMethod GetMethod(const char *method);
+    static const char *GetMethodName(const uint8_t method);
+    static uint32_t HashString(const char *data, const size_t len);
+private:
+    class Writer;
+    static Writer *GetWriter();
+private:
+    static std::atomic<bool> m_enabled;
+    static std::string m_dir;
+    static unsigned long long m_fileSize;
+    static unsigned int m_fileNum;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,81 @@
+#ifndef ASSET_BUNDLE_H
+#define ASSET_BUNDLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+// 资源包文件布局，所有整数为小端：
+// [文件头][哈希槽数组][条目数组][路径字符串][按页对齐的数据区]
+// 数据区中每个变体是预先构造的头部(Content-Length、Content-Type、ETag等，以空行结束)紧跟消息体，
+// 回复时状态行和Connection头部之后直接发送变体所在的内存
+extern const char ASSET_BUNDLE_MAGIC[8];
+const uint32_t ASSET_BUNDLE_VERSION = 1;
+const unsigned int ASSET_BUNDLE_ETAG_LEN = 24; // 带引号的16位十六进制内容哈希，以结束符填充
+const uint32_t ASSET_BUNDLE_EMPTY_SLOT = 0;
+
+enum AssetVariantIndex : unsigned char {
+    ASSET_VARIANT_INDEX_IDENTITY = 0, // 原始内容
+    ASSET_VARIANT_INDEX_GZIP = 1, // 预先压缩的内容，压缩后没有变小时不生成
+    ASSET_VARIANT_NUM,
+};
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t entryNum;
+    uint32_t slotNum; // 2的幂
+    uint32_t reserved;
+    uint64_t slotOffset;
+    uint64_t entryOffset;
+    uint64_t pathOffset;
+    uint64_t dataOffset; // 按页对齐
+    uint64_t fileSize;
+} AssetBundleHeader;
+
+typedef struct {
+    uint32_t entryIdx; // 条目下标加1，0表示空槽
+    uint32_t hashTag; // 路径哈希的高32位，比较路径前先比较
+} AssetBundleSlot;
+
+typedef struct {
+    uint64_t offset; // 相对文件起始，长度为0表示没有该变体
+    uint32_t length; // 头部加消息体
+    uint32_t bodyLength;
+} AssetBundleVariant;
+
+typedef struct {
+    uint64_t pathHash;
+    uint32_t pathOffset; // 相对路径字符串区
+    uint32_t pathLen;
+    AssetBundleVariant variants[ASSET_VARIANT_NUM];
+    char etag[ASSET_BUNDLE_ETAG_LEN];
+} AssetBundleEntry;
+
+// 启动时只读映射整个资源包，查找只做哈希和一次路径比较，不产生文件系统调用
+// 映射后只读，多个线程可以同时查找
+class AssetBundle {
+public:
+    AssetBundle();
+    ~AssetBundle();
+    bool Open(const std::string &path);
+    void Close();
+    bool IsOpen() const;
+    const AssetBundleEntry *Find(const char *path, const size_t pathLen) const;
+    // 客户端接受gzip且有压缩变体时返回压缩变体
+    const AssetBundleVariant &GetVariant(const AssetBundleEntry *entry, const bool acceptGzip) const;
+    const char *GetData(const AssetBundleVariant &variant) const;
+    uint32_t GetEntryNum() const;
+    static uint64_t HashPath(const char *path, const size_t pathLen);
+private:
+    bool Check() const;
+private:
+    const char *m_base { nullptr };
+    size_t m_size { 0 };
+    const AssetBundleHeader *m_header { nullptr };
+    const AssetBundleSlot *m_slots { nullptr };
+    const AssetBundleEntry *m_entries { nullptr };
+    const char *m_paths { nullptr };
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,33 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+// 连接的读写缓冲区池，连接只在处理请求期间持有缓冲区，空闲的长连接不占用缓冲区
+// 事件循环线程取出、处理线程可能归还，用互斥锁保护空闲链表
+// 缓冲区大小随max_read_buff_len变化，归还大小不一致的缓冲区直接释放
+class BufferPool {
+public:
+    BufferPool();
+    ~BufferPool();
+    void Init(const size_t bufferSize, const unsigned int maxFreeNum);
+    // 修改缓冲区大小并释放空闲链表上的旧缓冲区，已被取出的旧缓冲区归还时释放
+    void SetBufferSize(const size_t bufferSize);
+    char *Acquire(const size_t bufferSize);
+    void Release(char *buffer, const size_t bufferSize);
+    unsigned int GetFreeNum() const;
+private:
+    struct FreeBuffer {
+        FreeBuffer *next;
+    };
+    void ClearFreeList();
+private:
+    mutable pthread_mutex_t m_mutex;
+    size_t m_bufferSize { 0 };
+    unsigned int m_maxFreeNum { 0 };
+    unsigned int m_freeNum { 0 };
+    FreeBuffer *m_freeList { nullptr };
+};
+
+#endif
\ No newline at end of file
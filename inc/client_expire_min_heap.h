@@ -2,7 +2,7 @@
 #define CLIENT_EXPIRE_MIN_HEAP_H
 
 #include <time.h>
-#include <map>
+#include <vector>
 
 typedef struct {
     int clientFd;
@@ -20,15 +20,19 @@ public:
     bool Top(ClientExpire &node);
     bool Modify(const ClientExpire &node);
     bool Delete(const int clientFd);
+    bool Contains(const int clientFd) const;
 private:
     void SiftDown(const unsigned int startIdx);
     void SiftUp(const unsigned int startIdx);
     bool Resize();
+    void SetHeapIdx(const int clientFd, const unsigned int heapIdx);
+    bool GetHeapIdx(const int clientFd, unsigned int &heapIdx) const;
 private:
     unsigned int m_capacity { 0 };
     unsigned int m_currentSize { 0 };
     ClientExpire *m_heap { nullptr };
-    std::map<int, unsigned int> m_socketAndHeapIdxMap; // 套接字id和客户端超时对应在最小堆位置的映射
+    // 下标为套接字id，值为客户端超时在最小堆中的位置，套接字id由内核从小到大复用，数组不会稀疏
+    std::vector<unsigned int> m_socketHeapIdx;
 
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef COMPLETION_QUEUE_H
+#define COMPLETION_QUEUE_H
+
+#include <atomic>
+#include <vector>
+
+// 完成通知的节点由提交方持有，不需要分配内存；同一节点被取出前不能再次提交
+struct CompletionNode {
+    CompletionNode *next;
+    int client;
+    void *owner;
+    unsigned char result; // 处理结果，含义由提交方定义
+};
+
+typedef struct {
+    int client;
+    void *owner;
+    unsigned char result;
+} Completion;
+
+// 处理线程交回事件循环线程的完成队列，多个生产者以CAS压栈，不加锁
+// 只有队列原本为空时才写eventfd，事件循环线程取出前的多次提交只唤醒一次，负载高时唤醒自然合并
+class CompletionQueue {
+public:
+    CompletionQueue();
+    ~CompletionQueue();
+    bool Init();
+    int GetEventFd() const; // 有完成通知时可读
+    // 可以在任意线程调用
+    void Push(CompletionNode *node, const int client, void *owner, const unsigned char result);
+    // 按提交顺序取出全部完成通知，取出后节点可以再次提交，在事件循环线程中调用
+    void PollCompletions(std::vector<Completion> &completions);
+private:
+    int m_eventFd { -1 };
+    std::atomic<CompletionNode *> m_head { nullptr };
+};
+
+#endif
\ No newline at end of file
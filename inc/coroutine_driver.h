@@ -0,0 +1,117 @@
+#ifndef COROUTINE_DRIVER_H
+#define COROUTINE_DRIVER_H
+
+#include <coroutine>
+#include <stddef.h>
+#include <vector>
+#include "client_expire_min_heap.h"
+
+enum IoWaitResult : unsigned char {
+    IO_WAIT_RESULT_READY = 0, // 套接字可读或可写
+    IO_WAIT_RESULT_TIMEOUT = 1, // 等待超时
+    IO_WAIT_RESULT_CLOSED = 2, // 事件循环要求连接退出，如平滑升级或服务端退出
+};
+
+// 协程帧的空闲链表，固定大小的块复用，超过块大小的帧直接从堆上分配
+class FramePool {
+public:
+    FramePool();
+    ~FramePool();
+    void Init(const size_t blockSize, const unsigned int maxFreeNum);
+    void *Allocate(const size_t size);
+    void Deallocate(void *frame, const size_t size);
+    // 当前线程的帧池，由事件循环线程设置，协程在哪个线程创建就使用哪个线程的帧池
+    static FramePool *&Current();
+private:
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+    size_t m_blockSize { 0 };
+    unsigned int m_maxFreeNum { 0 };
+    unsigned int m_freeNum { 0 };
+    FreeBlock *m_freeList { nullptr };
+};
+
+// 连接协程的返回类型，创建后立即运行到第一个co_await，结束后自动销毁协程帧
+struct ConnectionTask {
+    struct promise_type {
+        ConnectionTask get_return_object()
+        {
+            return ConnectionTask {};
+        }
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() {}
+        static void *operator new(size_t size);
+        static void operator delete(void *frame, size_t size);
+    };
+};
+
+class CoroutineDriver;
+
+// co_await等待套接字事件，超时时间单位为秒
+struct IoAwaitable {
+    CoroutineDriver *driver;
+    int fd;
+    unsigned int events;
+    unsigned int timeout;
+    IoWaitResult result;
+    const void *owner; // Sleep等待的操作所属的对象，Wake时核对，其他等待为空
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+    bool await_suspend(std::coroutine_handle<> handle); // 返回false时不挂起，协程立即继续执行
+    IoWaitResult await_resume() const noexcept
+    {
+        return result;
+    }
+};
+
+// 在事件循环线程中驱动连接协程：协程等待套接字事件时挂起，事件到达、超时或被取消时恢复
+// 每个连接在过期时间最小堆中只占一个节点，每次等待只修改过期时间，不在堆上分配内存
+class CoroutineDriver {
+public:
+    CoroutineDriver();
+    ~CoroutineDriver();
+    bool Init(const int efd);
+    // 接管套接字，注册到epoll和过期时间最小堆，之后由协程调用Readable/Writable等待事件
+    bool Attach(const int fd);
+    void Detach(const int fd);
+    bool Owns(const int fd) const;
+    unsigned int Size() const;
+    IoAwaitable Readable(const int fd, const unsigned int timeout);
+    IoAwaitable Writable(const int fd, const unsigned int timeout);
+    IoAwaitable Sleep(const int fd, const unsigned int timeout, const void *owner); // 只等待超时或Wake
+    void HandleEvent(const int fd, const unsigned int events);
+    void HandleTimer(const time_t now);
+    // 恢复通过Sleep等待的协程，用于等待其他线程完成的操作；owner与Sleep时不同说明是已经超时放弃的旧操作，不恢复
+    void Wake(const int fd, const void *owner);
+    void CancelReadWaiters(); // 让等待读事件的协程退出，用于平滑升级时关闭空闲连接
+    void CancelAll();
+private:
+    friend struct IoAwaitable;
+    struct Waiter {
+        std::coroutine_handle<> handle;
+        IoAwaitable *awaitable { nullptr };
+        unsigned int registerEvents { 0 }; // 当前注册到epoll的事件
+        bool attached { false };
+    };
+    bool Suspend(IoAwaitable *awaitable, std::coroutine_handle<> handle);
+    void Resume(const int fd, const IoWaitResult result);
+private:
+    int m_efd { -1 };
+    unsigned int m_size { 0 };
+    std::vector<Waiter> m_waiters; // 下标为套接字
+    ClientExpireMinHeap m_expireMinHeap;
+    FramePool m_framePool;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,22 @@
+#ifndef CPU_AFFINITY_H
+#define CPU_AFFINITY_H
+
+#include <string>
+#include <vector>
+
+// 线程绑核和NUMA节点查询，节点信息从/sys/devices/system/node读取，不依赖libnuma
+class CpuAffinity {
+public:
+    // 解析"0-3,8"格式的CPU列表，空字符串得到空列表，表示不绑定
+    static bool ParseCpuList(const std::string &value, std::vector<int> &cpus);
+    // 将当前线程绑定到cpus中的任意CPU上
+    static bool BindCurrentThread(const std::vector<int> &cpus);
+    static int GetNodeOfCpu(const int cpu); // 非NUMA系统或查询失败时返回0
+    static int GetCurrentNode();
+    static int GetNodeNum();
+    static std::vector<int> GetNodeCpus(const int node);
+private:
+    static const std::vector<int> &GetCpuNodeTable(); // 下标为CPU编号，值为所在节点
+};
+
+#endif
\ No newline at end of file
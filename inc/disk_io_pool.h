@@ -0,0 +1,49 @@
+#ifndef DISK_IO_POOL_H
+#define DISK_IO_POOL_H
+
+#include <pthread.h>
+#include <sys/types.h>
+#include <string>
+#include <vector>
+#include "thread_pool.h"
+
+class DiskIoPool;
+
+struct DiskIoArg {
+    DiskIoPool *diskIoPool;
+    int client;
+    void *owner; // 提交请求的处理对象，磁盘线程不访问，完成时原样交回
+    std::string path; // 磁盘线程重新打开文件读取，不依赖处理对象中的映射
+    off_t length;
+};
+
+typedef struct {
+    int client;
+    void *owner;
+} DiskIoCompletion;
+
+// 把不在页缓存中的文件交给专门的磁盘线程读入页缓存，事件循环线程和处理线程发送时不会因缺页阻塞
+// 完成的请求放入完成列表并写eventfd，由事件循环线程取出后继续发送回复
+class DiskIoPool {
+public:
+    DiskIoPool();
+    ~DiskIoPool();
+    bool Init(const unsigned int threadNum);
+    bool IsEnabled() const;
+    int GetEventFd() const; // 有完成的请求时可读
+    bool Submit(const int client, void *owner, const char *path, const off_t length);
+    // 取出全部完成的请求，在事件循环线程中调用
+    void PollCompletions(std::vector<DiskIoCompletion> &completions);
+    // 映射的内存是否全部在页缓存中
+    static bool IsResident(const void *addr, const size_t length);
+private:
+    static void Warm(void *arg);
+    void Complete(const int client, void *owner);
+private:
+    ThreadPool<DiskIoArg> m_threadPool;
+    int m_eventFd { -1 };
+    pthread_mutex_t m_mutex;
+    std::vector<DiskIoCompletion> m_completions;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,66 @@
+#ifndef DISPATCH_POLICY_H
+#define DISPATCH_POLICY_H
+
+#include <string>
+#include <vector>
+
+enum DispatchMode : unsigned char {
+    DISPATCH_MODE_POOLED = 0, // 交给线程池处理
+    DISPATCH_MODE_INLINE = 1, // 在事件循环线程中直接解析、处理并发送
+};
+
+typedef struct {
+    std::string prefix; // URL前缀
+    DispatchMode mode;
+} DispatchRoute;
+
+// 线程池的任务队列，值为ThreadPool中的lane
+enum TaskLane : unsigned char {
+    TASK_LANE_SMALL = 0, // 回复较小或已缓存的请求
+    TASK_LANE_LARGE = 1, // 回复较大的请求
+    TASK_LANE_NUM = 2,
+};
+
+typedef struct {
+    std::string prefix; // URL前缀
+    TaskLane lane;
+} LaneRoute;
+
+extern const char *DISPATCH_MODE_POOLED_NAME;
+extern const char *DISPATCH_MODE_INLINE_NAME;
+extern const char *TASK_LANE_SMALL_NAME;
+extern const char *TASK_LANE_LARGE_NAME;
+
+// 按URL前缀决定请求的分发方式，没有匹配的前缀时使用默认方式，只在事件循环线程中访问
+class DispatchPolicy {
+public:
+    DispatchPolicy();
+    ~DispatchPolicy();
+    bool Init(const std::string &defaultMode, const std::string &routes);
+    DispatchMode GetMode(const char *url, const unsigned int urlLen) const;
+    bool HasInline() const; // 是否有请求可能在事件循环线程中处理
+    static bool ParseMode(const std::string &value, DispatchMode &mode);
+    // 解析"前缀:方式"的列表，以逗号分隔，例如"/static:inline,/api:pooled"
+    static bool ParseRoutes(const std::string &value, std::vector<DispatchRoute> &routes);
+private:
+    DispatchMode m_defaultMode { DISPATCH_MODE_POOLED };
+    std::vector<DispatchRoute> m_routes;
+};
+
+// 按URL前缀决定请求进入的任务队列，没有匹配的前缀时由调用方按回复大小决定，只在事件循环线程中访问
+class LanePolicy {
+public:
+    LanePolicy();
+    ~LanePolicy();
+    bool Init(const std::string &routes);
+    bool GetLane(const char *url, const unsigned int urlLen, TaskLane &lane) const; // 没有匹配的前缀时返回false
+    bool HasRoutes() const;
+    static const char *GetLaneName(const TaskLane lane);
+    static bool ParseLane(const std::string &value, TaskLane &lane);
+    // 解析"前缀:队列"的列表，以逗号分隔，例如"/download:large,/api:small"
+    static bool ParseRoutes(const std::string &value, std::vector<LaneRoute> &routes);
+private:
+    std::vector<LaneRoute> m_routes;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,136 @@
+#ifndef HTTP_CONFIG_H
+#define HTTP_CONFIG_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include "listener.h"
+#include "sse.h"
+
+const char * const DEFAULT_IP_ADDR = "127.0.0.1";
+const unsigned int DEFAULT_PORT = 443;
+const unsigned int DEFAULT_BACKLOG = 5;
+const unsigned int DEFAULT_EPOLL_SIZE = 5;
+const char * const DEFAULT_SOURCE_DIR = "./webpages";
+const unsigned int DEFAULT_THREAD_NUM = 5; // 处理请求线程数量为5
+const unsigned int DEFAULT_TIMER_INTERVAL = 5; // 定时器间隔设置为5秒
+const unsigned int DEFAULT_CLIENT_EXPIRE_INTERVAL = DEFAULT_TIMER_INTERVAL * 3; // 客户端过期时间间隔设置为3个定时器间隔
+const unsigned int DEFAULT_MAX_READ_BUFF_LEN = 2048;
+const unsigned int DEFAULT_DRAIN_TIMEOUT = 30; // 平滑升级时旧进程最多等待30秒处理完已有连接
+const unsigned int DEFAULT_RETRY_AFTER = 1; // 过载回复中建议客户端1秒后重试
+const unsigned int DEFAULT_RATE_LIMIT_IDLE = 60; // 客户端60秒没有请求后淘汰其令牌桶
+const unsigned int DEFAULT_RATE_LIMIT_TABLE_SIZE = 65536;
+const unsigned int DEFAULT_INLINE_MAX_REQUEST_LEN = 4096;
+const unsigned int DEFAULT_INLINE_MAX_FILE_SIZE = 64 * 1024; // 超过64KB的文件交给线程池发送
+const unsigned int DEFAULT_BUSY_POLL_BUDGET = 8; // 与内核NAPI的默认值相同
+const unsigned int DEFAULT_DISK_IO_THREADS = 2;
+const unsigned int DEFAULT_TARGET_QUEUE_WAIT_US = 2000; // 排队超过2毫秒时增加处理线程
+const unsigned int DEFAULT_THREAD_IDLE_TIMEOUT = 30; // 处理线程空闲30秒后退出
+const unsigned int DEFAULT_TRACE_RING_SIZE = 16384; // 每个线程保留最近16384个追踪事件，约512KB
+const char * const DEFAULT_TRACE_FILE = "http_trace.json";
+const unsigned int DEFAULT_ACCESS_LOG_FILE_SIZE = 64; // 单位MB
+const unsigned int DEFAULT_ACCESS_LOG_FILES = 8;
+const unsigned int DEFAULT_CAPTURE_MAX_SIZE = 1024; // 单位MB
+const unsigned int DEFAULT_WEBSOCKET_PING_INTERVAL = 30; // WebSocket连接空闲30秒后发送ping
+const unsigned int DEFAULT_WEBSOCKET_MAX_MESSAGE = 1024 * 1024;
+const unsigned int DEFAULT_SSE_MAX_QUEUE = 1024;
+const unsigned int DEFAULT_SSE_KEEPALIVE_INTERVAL = 15; // 事件流空闲15秒后发送保活注释
+const unsigned int DEFAULT_SMALL_LANE_WEIGHT = 4; // 两个队列都有任务时，每出队4个小请求出队1个大请求
+const unsigned int DEFAULT_LARGE_LANE_WEIGHT = 1;
+extern const char *OVERLOAD_ACTION_REJECT; // 超过连接数上限时回复503并关闭连接
+extern const char *OVERLOAD_ACTION_REFUSE; // 超过连接数上限时暂停接收新连接
+extern const char *CONNECTION_DRIVER_CALLBACK; // 由事件回调和处理对象中的状态字段驱动连接
+extern const char *CONNECTION_DRIVER_COROUTINE; // 每个连接一个协程，在事件循环线程中处理请求
+
+struct HttpServerConfig {
+    std::string ipAddr { DEFAULT_IP_ADDR };
+    unsigned int port { DEFAULT_PORT };
+    unsigned int backlog { DEFAULT_BACKLOG };
+    unsigned int epollSize { DEFAULT_EPOLL_SIZE }; // 每次epoll_wait最多返回的事件数
+    std::string sourceDir { DEFAULT_SOURCE_DIR };
+    unsigned int threadNum { DEFAULT_THREAD_NUM }; // 启动时的处理线程数量
+    unsigned int minThreads { 0 }; // 处理线程数量下限，0表示与threadNum相同
+    unsigned int maxThreads { 0 }; // 处理线程数量上限，0表示与threadNum相同，上下限相同时线程数量固定
+    unsigned int targetQueueWaitUs { DEFAULT_TARGET_QUEUE_WAIT_US };
+    unsigned int threadIdleTimeout { DEFAULT_THREAD_IDLE_TIMEOUT }; // 单位秒
+    unsigned int timerInterval { DEFAULT_TIMER_INTERVAL };
+    unsigned int clientExpireInterval { DEFAULT_CLIENT_EXPIRE_INTERVAL };
+    unsigned int maxReadBuffLen { DEFAULT_MAX_READ_BUFF_LEN }; // 只对新建连接生效
+    unsigned int drainTimeout { DEFAULT_DRAIN_TIMEOUT };
+    unsigned int maxConnections { 0 }; // 连接数上限，0表示不限制
+    std::string overloadAction { OVERLOAD_ACTION_REJECT };
+    unsigned int maxQueuePerThread { 0 }; // 每个处理线程对应的任务队列长度上限，0表示不限制
+    unsigned int maxQueueWaitMs { 0 }; // 请求排队时间上限，0表示不限制
+    unsigned int retryAfter { DEFAULT_RETRY_AFTER };
+    unsigned int rateLimit { 0 }; // 每个客户端地址每秒允许的请求数，0表示不限流
+    unsigned int rateLimitBurst { 0 }; // 令牌桶容量，0表示与rateLimit相同
+    std::string rateLimitRoutes; // 按URL前缀限流，格式为"前缀:速率:容量"，以逗号分隔
+    unsigned int rateLimitIdle { DEFAULT_RATE_LIMIT_IDLE };
+    unsigned int rateLimitTableSize { DEFAULT_RATE_LIMIT_TABLE_SIZE };
+    std::string reactorCpus; // 事件循环线程绑定的CPU列表，格式为"0-3,8"，空表示不绑定
+    std::string workerCpus; // 处理线程依次绑定到列表中的一个CPU上，空表示不绑定
+    std::string dispatchMode { "pooled" }; // pooled或inline
+    std::string dispatchRoutes; // 按URL前缀指定分发方式，格式为"前缀:方式"，以逗号分隔
+    unsigned int inlineMaxRequestLen { DEFAULT_INLINE_MAX_REQUEST_LEN };
+    unsigned int inlineMaxFileSize { DEFAULT_INLINE_MAX_FILE_SIZE };
+    unsigned int largeResponseSize { 0 }; // 回复超过该大小的请求进入大请求队列，0表示不按大小区分
+    std::string laneRoutes; // 按URL前缀指定任务队列，格式为"前缀:队列"，以逗号分隔
+    unsigned int smallLaneWeight { DEFAULT_SMALL_LANE_WEIGHT };
+    unsigned int largeLaneWeight { DEFAULT_LARGE_LANE_WEIGHT };
+    std::string connectionDriver { CONNECTION_DRIVER_CALLBACK }; // 只对新建连接生效
+    unsigned int reuseAddr { 1 };
+    unsigned int deferAccept { 0 }; // 单位秒，0表示不启用
+    unsigned int fastOpen { 0 }; // TCP Fast Open队列长度，0表示不启用
+    unsigned int tcpNoDelay { 1 }; // 只对新建连接生效
+    unsigned int busyPoll { 0 }; // 单位微秒，0表示不启用
+    unsigned int busyPollBudget { DEFAULT_BUSY_POLL_BUDGET };
+    std::string listeners; // 监听地址列表，空表示只监听ip_addr:port
+    std::string assetBundle; // asset_pack生成的资源包路径，空表示不使用
+    unsigned int diskIoThreads { DEFAULT_DISK_IO_THREADS }; // 0表示不检查文件是否在页缓存中
+    unsigned int traceSample { 0 }; // 每多少个请求追踪一个，0表示不追踪
+    unsigned int traceRingSize { DEFAULT_TRACE_RING_SIZE };
+    std::string traceFile { DEFAULT_TRACE_FILE };
+    std::string accessLogDir; // 二进制访问日志目录，空表示不记录
+    unsigned int accessLogFileSize { DEFAULT_ACCESS_LOG_FILE_SIZE }; // 单位MB
+    unsigned int accessLogFiles { DEFAULT_ACCESS_LOG_FILES }; // 每个写入者保留的文件数
+    std::string captureFile; // 抓包文件路径，空表示不抓包
+    unsigned int captureMaxSize { DEFAULT_CAPTURE_MAX_SIZE }; // 单位MB
+    std::string webSocketRoutes; // 可升级为WebSocket的URL前缀，格式为"前缀:处理接口"，以逗号分隔
+    unsigned int webSocketPingInterval { DEFAULT_WEBSOCKET_PING_INTERVAL };
+    unsigned int webSocketMaxMessage { DEFAULT_WEBSOCKET_MAX_MESSAGE };
+    std::string sseRoutes; // 回复事件流的URL前缀，格式为"前缀:频道"，以逗号分隔
+    unsigned int sseMaxQueue { DEFAULT_SSE_MAX_QUEUE };
+    std::string sseSlowPolicy { SSE_SLOW_POLICY_DROP };
+    unsigned int sseKeepaliveInterval { DEFAULT_SSE_KEEPALIVE_INTERVAL };
+};
+
+// 配置来源优先级：命令行 > 配置文件 > 默认值
+// 配置文件每行格式为"key = value"，#开头为注释；命令行格式为"--key=value"或"--key value"
+class HttpConfig {
+public:
+    HttpConfig();
+    ~HttpConfig();
+    bool Init(int argc, char *argv[]);
+    // 重新读取配置文件并叠加命令行参数，失败时保持当前配置不变
+    bool Reload();
+    const HttpServerConfig &Get() const;
+    // 启动时的命令行参数，平滑升级时用于启动新进程
+    const std::vector<std::string> &GetArgs() const;
+    // 判断新旧配置中是否有不能在运行时生效的配置项发生变化，并打印这些配置项
+    static bool HasRestartOnlyChange(const HttpServerConfig &oldConfig, const HttpServerConfig &newConfig);
+    // 得到全部监听地址，ip_addr、port、backlog和监听选项作为各监听地址未指定时的默认值
+    static bool GetListeners(const HttpServerConfig &config, std::vector<ListenerConfig> &listeners);
+    static void Usage(const char *name);
+private:
+    bool Load(HttpServerConfig &config);
+    bool LoadFile(const char *path, HttpServerConfig &config);
+    static bool SetItem(HttpServerConfig &config, const char *key, const char *value);
+    static bool Check(const HttpServerConfig &config);
+private:
+    std::vector<std::string> m_args;
+    std::string m_configPath;
+    std::vector<std::pair<std::string, std::string>> m_cmdItems; // 命令行指定的配置项，重新加载时再次叠加
+    HttpServerConfig m_config;
+};
+
+#endif
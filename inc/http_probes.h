@@ -0,0 +1,31 @@
+#ifndef HTTP_PROBES_H
+#define HTTP_PROBES_H
+
+// 请求生命周期上的USDT静态探针，提供者为http_server，可以用bpftrace或perf挂载，示例脚本见tools/bpftrace
+// 有sys/sdt.h时每个探针编译为一条nop指令，参数只在ELF注记中描述位置，未挂载时不产生任何计算和分支；
+// 没有sys/sdt.h时探针为空，参数不求值
+// 连接以HttpProcessor对象地址标识，请求以连接上已完成的请求数标识，两者组合在连接存活期间唯一
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define HTTP_PROBES_ENABLED
+#endif
+#endif
+
+#ifdef HTTP_PROBES_ENABLED
+#include <sys/sdt.h>
+#define HTTP_PROBE1(name, a1) DTRACE_PROBE1(http_server, name, a1)
+#define HTTP_PROBE2(name, a1, a2) DTRACE_PROBE2(http_server, name, a1, a2)
+#define HTTP_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(http_server, name, a1, a2, a3)
+#define HTTP_PROBE4(name, a1, a2, a3, a4) DTRACE_PROBE4(http_server, name, a1, a2, a3, a4)
+#define HTTP_PROBE5(name, a1, a2, a3, a4, a5) DTRACE_PROBE5(http_server, name, a1, a2, a3, a4, a5)
+#define HTTP_PROBE6(name, a1, a2, a3, a4, a5, a6) DTRACE_PROBE6(http_server, name, a1, a2, a3, a4, a5, a6)
+#else
+#define HTTP_PROBE1(name, a1) do {} while (0)
+#define HTTP_PROBE2(name, a1, a2) do {} while (0)
+#define HTTP_PROBE3(name, a1, a2, a3) do {} while (0)
+#define HTTP_PROBE4(name, a1, a2, a3, a4) do {} while (0)
+#define HTTP_PROBE5(name, a1, a2, a3, a4, a5) do {} while (0)
+#define HTTP_PROBE6(name, a1, a2, a3, a4, a5, a6) do {} while (0)
+#endif
+
+#endif
\ No newline at end of file
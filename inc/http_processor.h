@@ -2,11 +2,23 @@
 #define HTTP_PROCESSOR_H
 
 #include <sys/uio.h>
+#include <sys/stat.h>
 #include <string>
-#include <map>
+#include <memory>
+#include <atomic>
+#include "listener.h"
+#include "asset_bundle.h"
+#include "buffer_pool.h"
+#include "request_trace.h"
+#include "access_log.h"
+#include "traffic_capture.h"
+#include "http_probes.h"
+#include "completion_queue.h"
+#include "websocket.h"
+#include "sse.h"
 
-const unsigned int MAX_READ_BUFF_LEN = 2048;
 const unsigned int MAX_WRITE_BUFF_LEN = 1024;
+const unsigned int MAX_FILE_NAME_LEN = 200;
 
 enum RecvRequestReturnCode : unsigned char {
     RECV_REQUEST_RETURN_CODE_SUCCESS = 0, // 读消息成功
@@ -14,6 +26,12 @@ enum RecvRequestReturnCode : unsigned char {
     RECV_REQUEST_RETURN_CODE_AGAIN = 2, // 再试一次
 };
 
+enum ProcessorDispatchState : unsigned char {
+    PROCESSOR_DISPATCH_STATE_IDLE = 0, // 由事件循环线程处理
+    PROCESSOR_DISPATCH_STATE_BUSY = 1, // 处理线程正在处理
+    PROCESSOR_DISPATCH_STATE_EVENTS_PAUSED = 2, // 处理线程正在处理，事件循环线程已把连接从epoll中移除，取出完成通知后重新加入
+};
+
 enum GetSingleLineState : unsigned char {
     GET_SINGLE_LINE_OK = 0,
     GET_SINGLE_LINE_CONTINUE = 1,
@@ -34,11 +52,15 @@ enum ParseRequestReturnCode: unsigned int {
 };
 
 enum ResponseStatusCode : unsigned int {
+    RESPONSE_STATUS_CODE_SWITCHING_PROTOCOLS = 101, // 升级为WebSocket
     RESPONSE_STATUS_CODE_OK = 200, // 请求成功
+    RESPONSE_STATUS_CODE_NOT_MODIFIED = 304, // 客户端缓存的资源没有变化
     RESPONSE_STATUS_CODE_BAD_REQUEST = 400, // 通用客户请求错误
     RESPONSE_STATUS_CODE_FORBIDDEN = 403, // 访问被服务器禁止
     RESPONSE_STATUS_CODE_NOT_FOUND = 404, // 资源没找到
+    RESPONSE_STATUS_CODE_TOO_MANY_REQUESTS = 429, // 请求过于频繁
     RESPONSE_STATUS_CODE_INTERNAL_SERVER_ERROR = 500, // 通用服务器错误
+    RESPONSE_STATUS_CODE_SERVICE_UNAVAILABLE = 503, // 服务器过载
 };
 
 enum SendResponseReturnCode : unsigned char {
@@ -46,6 +68,8 @@ enum SendResponseReturnCode : unsigned char {
     SEND_RESPONSE_RETURN_CODE_ERROR = 1, // 发送回复消息出错
     SEND_RESPONSE_RETURN_CODE_AGAIN = 2, // 再试一次
     SEND_RESPONSE_RETURN_CODE_NEXT = 3, // 进入下一次处理消息流程
+    SEND_RESPONSE_RETURN_CODE_UPGRADE = 4, // 握手回复发送完成，连接已升级为WebSocket
+    SEND_RESPONSE_RETURN_CODE_STREAM = 5, // 事件流回复头部发送完成，连接已成为SSE订阅者
 };
 
 enum VectorIndex {
@@ -56,6 +80,11 @@ enum VectorIndex {
 
 extern const char *CONTENT_LENGTH_KEY_NAME;
 extern const char *CONNECTION_KEY_NAME;
+extern const char *IF_NONE_MATCH_KEY_NAME;
+extern const char *ACCEPT_ENCODING_KEY_NAME;
+extern const char *UPGRADE_KEY_NAME;
+extern const char *WEBSOCKET_KEY_KEY_NAME;
+extern const char *WEBSOCKET_VERSION_KEY_NAME;
 
 typedef struct {
     ResponseStatusCode statusCode;
@@ -63,15 +92,84 @@ typedef struct {
     const char *statusContent;
 } StatusInfo;
 
+// 预先构造的完整回复，过载等场景下不经过请求解析直接发送并关闭连接
+class PrebuiltResponse {
+public:
+    bool Init(const ResponseStatusCode statusCode, const unsigned int retryAfter);
+    // 非阻塞发送，发送不完整时直接放弃
+    bool Send(const int socketId) const;
+private:
+    std::string m_response;
+};
+
+// 同一份配置下所有连接共享的只读状态，重新加载配置后新建连接使用新的上下文，已有连接继续使用旧的
+struct HttpProcessorContext {
+    std::string sourceDir;
+    unsigned int readBuffLen; // 读缓冲区大小，不含结束符
+    BufferPool *bufferPool; // 由服务端持有，缓冲区大小为GetBufferSize(readBuffLen)
+    const AssetBundle *assetBundle; // 资源包中的文件优先于source_dir
+    std::string webSocketRoutes; // 构造webSocketRouter的配置，变化时重新构造上下文
+    WebSocketRouter webSocketRouter; // 匹配的URL可以升级为WebSocket
+    unsigned int webSocketMaxMessage { 0 }; // 单条消息的长度上限，单位字节
+    std::string sseRoutes; // 构造sseRouter的配置，变化时重新构造上下文
+    SseRouter sseRouter; // 匹配的URL回复事件流并订阅频道
+    unsigned int sseMaxQueue { 0 }; // 每个订阅者积压的事件数上限
+    bool sseDropSlow { true }; // 积压超过上限时丢弃事件，否则关闭连接
+};
+
 class HttpProcessor {
+    friend class HttpProcessorBench; // 微基准测试直接驱动解析流程
 public:
-    HttpProcessor(const int socketId, const std::string &sourceDir);
+    HttpProcessor(const int socketId, const std::shared_ptr<const HttpProcessorContext> &context);
     ~HttpProcessor();
     RecvRequestReturnCode Read();
     SendResponseReturnCode Write();
     bool ProcessReadEvent();
+    // ProcessReadEvent拆成解析和回复两步，事件循环线程先解析，再决定是否交给线程池回复
+    ParseRequestReturnCode ParseReadEvent();
+    bool RespondReadEvent();
+    // 请求是否可能阻塞事件循环线程：请求报文或请求的文件过大，解析完成后调用
+    bool IsHeavyRequest(const unsigned int maxRequestLen, const unsigned int maxFileSize);
+    bool IsIdle() const; // 没有正在处理的请求
+    // 交给处理线程或磁盘线程后置为忙，事件循环线程取出完成通知后清除，忙时事件循环线程不读取新数据
+    // 状态只由事件循环线程修改，处理线程只读取
+    void SetBusy();
+    bool IsBusy() const;
+    // 忙时读到事件，暂停监听前调用，返回false表示已经暂停
+    bool PauseEvents();
+    // 返回true表示监听已暂停，需要恢复
+    bool ClearBusy();
+    // 处理线程完成后提交到完成队列的节点，处理对象忙时只有一个未取出的完成通知
+    CompletionNode *GetCompletionNode();
+    void SetClientKey(const unsigned long long clientKey);
+    unsigned long long GetClientKey() const;
+    // 对端地址在accept时记录，日志中不再调用getpeername
+    void SetPeerName(const char *peerName);
+    // 在解析前从已收到的报文中取出URL，用于分发前的限流等检查，请求行不完整时返回false
+    bool PeekUrl(const char *&url, unsigned int &urlLen) const;
+    // 升级为WebSocket后不为空，连接之后只由事件循环线程通过它处理
+    WebSocketConnection *GetWebSocket() const;
+    // 事件流回复头部发送完成后不为空，只由事件循环线程通过它推送事件
+    SseSubscriber *GetSseSubscriber() const;
+    // 回复构造完成后调用，要发送的文件不全在页缓存中时返回true和文件路径，发送前需要先读入页缓存
+    bool GetColdFile(const char *&path, off_t &length) const;
+    // 一个连接的缓冲区包含访问日志时间点、回复头部、文件路径和请求报文四部分
+    static size_t GetBufferSize(const unsigned int readBuffLen);
+    // 当前请求被抽中时记录时间点，开启访问日志时记录每个时间点第一次经过的时间，都未开启时只有两次判断
+    void Trace(const TracePoint point) const
+    {
+        if (m_logInfo != nullptr && m_logInfo->time[point] == 0) {
+            m_logInfo->time[point] = AccessLog::Now();
+        }
+        if (m_traceId != 0) {
+            RequestTrace::Record(m_traceId, m_socketId, point);
+        }
+    }
 private:
     void Init();
+    // 开始读取请求时从缓冲区池取出缓冲区，回复发送完成后归还
+    bool AttachBuffer();
+    void DetachBuffer();
     ParseRequestReturnCode ParseRequest();
     ParseRequestReturnCode ParseRequestLine();
     GetSingleLineState GetSingleLine();
@@ -79,21 +177,49 @@ private:
     ParseRequestReturnCode ParseHeadFields();
     void ParseContentLength();
     void ParseConnection();
+    void ParseIfNoneMatch();
+    void ParseAcceptEncoding();
+    void ParseUpgrade();
+    void ParseWebSocketKey();
+    void ParseWebSocketVersion();
     ParseRequestReturnCode ParseContent();
     bool Response(const ParseRequestReturnCode returnCode);
+    bool GetFilePath(char *filePath, const unsigned int filePathLen) const;
+    const AssetBundleEntry *FindAsset();
+    ResponseStatusCode HandleAssetRequest();
     ResponseStatusCode HandleRequest();
+    // 请求升级为WebSocket且URL匹配时检查握手字段，返回false表示按普通请求处理
+    bool HandleWebSocketUpgrade(ResponseStatusCode &statusCode);
+    void ReleaseFile();
+    // 回复发送完成时调用，在归还缓冲区之前
+    void WriteAccessLog() const;
     bool FillResp(const ResponseStatusCode statusCode);
     bool FillRespInNormalCase();
     bool FillRespInErrorCase(const StatusInfo statusInfo);
+    bool FillRespNotModified();
+    bool FillRespSwitchingProtocols();
+    bool FillRespEventStream();
     bool AddStatusLine(const int status, const char *title);
     bool AddHeadField(const unsigned int contentLen);
+    bool AddConnectionField();
     bool AddContent(const char *content);
 private:
     typedef void (HttpProcessor::*ParseHeadFieldValueStr)();
+    typedef struct {
+        const char *keyName;
+        unsigned int keyNameLen;
+        ParseHeadFieldValueStr parseFunc;
+    } HeadFieldParser;
+    static const HeadFieldParser m_headFieldParserList[]; // 所有连接共用的头部解析函数表
+    static const unsigned int m_headFieldParserListSize;
 private:
-    char m_request[MAX_READ_BUFF_LEN + 1]{ 0 }; // 记录请求报文
+    std::shared_ptr<const HttpProcessorContext> m_context;
+    unsigned int m_readBuffLen; // 读缓冲区大小，不含结束符
+    char *m_buffer{ nullptr }; // 从缓冲区池取出的缓冲区，空闲时为空
+    RequestLogInfo *m_logInfo{ nullptr }; // 指向m_buffer，未开启访问日志时为空
+    char *m_request{ nullptr }; // 记录请求报文，指向m_buffer
     int m_socketId; // 对应的套接字id
-    std::string m_sourceDir;
+    char m_peerName[PEER_NAME_MAX_LEN] { 0 };
     unsigned int m_currentRequestSize{ 0 }; // 记录当前收到的请求报文长度
     char *m_parseStartPos{ m_request }; // 解析报文字段的起始位置
     unsigned int m_currentIndex{ 0 }; // 解析报文是否有换行符的当前位置
@@ -103,17 +229,38 @@ private:
     char *m_httpVersion{ nullptr };
     unsigned int m_contentLen{ 0 };
     bool m_keepAlive{ false };
-    char m_writeBuff[MAX_WRITE_BUFF_LEN]{ 0 }; // 记录请求报文
+    const char *m_ifNoneMatch{ nullptr }; // If-None-Match头部的值，指向请求报文
+    bool m_acceptGzip{ false };
+    bool m_connectionUpgrade{ false }; // Connection头部包含upgrade
+    bool m_upgradeWebSocket{ false }; // Upgrade头部为websocket
+    const char *m_webSocketKey{ nullptr }; // Sec-WebSocket-Key头部的值，指向请求报文
+    unsigned int m_webSocketVersion{ 0 };
+    WebSocketHandler *m_webSocketHandler{ nullptr }; // 握手成功时匹配的处理接口，握手回复发送完成后创建连接
+    WebSocketConnection *m_webSocket{ nullptr };
+    bool m_sseMatched{ false }; // URL匹配SSE路由，回复头部发送完成后创建订阅者
+    unsigned int m_sseChannel{ 0 };
+    SseSubscriber *m_sseSubscriber{ nullptr };
+    char *m_writeBuff{ nullptr }; // 记录回复的状态行和头部，指向m_buffer，长度为MAX_WRITE_BUFF_LEN
     unsigned int m_writeSize{ 0 };
     char *m_fileAddr{ nullptr };
     unsigned int m_fileSize{ 0 };
+    ParseRequestReturnCode m_parseReturnCode{ PARSE_REQUEST_RETURN_CODE_CONTINUE }; // ParseReadEvent的结果
+    bool m_fileStatValid{ false }; // IsHeavyRequest已经获取过文件状态，HandleRequest直接使用
+    struct stat m_fileStat{ 0 };
+    char *m_filePath{ nullptr }; // 指向m_buffer，长度为MAX_FILE_NAME_LEN
+    const AssetBundleEntry *m_assetEntry{ nullptr }; // 当前请求命中的资源，IsHeavyRequest查找后HandleRequest直接使用
+    bool m_assetLookedUp{ false };
+    bool m_fileFromBundle{ false }; // m_fileAddr指向资源包中的预置头部和消息体，不需要释放
     struct iovec m_iov[VECTOR_COUNT]{ 0 };
     int m_cnt{ 0 };
     unsigned int m_leftRespSize{ 0 }; // 剩余回复字节数
-    std::map<const char *, ParseHeadFieldValueStr> m_keyNameAndParseFuncMap {
-        { CONTENT_LENGTH_KEY_NAME, &HttpProcessor::ParseContentLength },
-        { CONNECTION_KEY_NAME, &HttpProcessor::ParseConnection },        
-    };
+    unsigned long long m_clientKey{ 0 }; // 客户端地址对应的键，用于按客户端限流
+    std::atomic<unsigned char> m_dispatchState{ PROCESSOR_DISPATCH_STATE_IDLE };
+    CompletionNode m_completionNode{ 0 };
+    unsigned long long m_traceId{ 0 }; // 当前请求的追踪编号，0表示未被抽中
+    uint32_t m_captureId{ 0 }; // 抓包中的连接编号，0表示没有抓包
+    bool m_traceFirstByte{ false }; // 已记录回复的第一批数据
+    unsigned int m_requestSeq{ 0 }; // 连接上已完成的请求数，探针中与对象地址一起标识请求
 };
 
 
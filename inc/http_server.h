@@ -1,10 +1,29 @@
 #ifndef HTTP_SERVER_H
 #define HTTP_SERVER
+#include <sys/epoll.h>
+#include <sys/types.h>
+#include <time.h>
+#include <limits.h>
 #include <string>
-#include <map>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include "http_config.h"
 #include "http_processor.h"
 #include "client_expire_min_heap.h"
 #include "thread_pool.h"
+#include "server_stats.h"
+#include "rate_limiter.h"
+#include "dispatch_policy.h"
+#include "coroutine_driver.h"
+#include "socket_options.h"
+#include "listener.h"
+#include "asset_bundle.h"
+#include "buffer_pool.h"
+#include "slab_pool.h"
+#include "disk_io_pool.h"
+#include "completion_queue.h"
+#include "traffic_capture.h"
 
 class HttpServer;
 
@@ -12,6 +31,8 @@ struct HttpReqProcessArg {
     HttpServer *httpServer;
     HttpProcessor *httpProcessor;
     int client;
+    bool parsed; // 事件循环线程已经解析完请求，处理线程只需要回复
+    unsigned int largeResponseSize; // 不为0时处理线程解析后按回复大小把大请求转到大请求队列
 };
 
 const unsigned int PIPE_FD_NUM = 2; // 一对能互相通信的scoket，数量为2
@@ -19,37 +40,138 @@ const unsigned int PIPE_FD_NUM = 2; // 一对能互相通信的scoket，数量
 class HttpServer {
 public:
     static HttpServer &GetInstance();
-    void Run(const char *ipAddr, const unsigned short int portId,  const unsigned int backlog, const int epollSize,
-        const char *sourceDir);
+    void Run(HttpConfig &config);
 private:
     HttpServer();
     ~HttpServer();
-    bool InitServer(const char *ipAddr, const unsigned short int portId,  const unsigned int backlog);
-    bool InitEpollFd(const int epollSize);
+    bool InitServer(const std::vector<ListenerConfig> &listeners);
+    bool InheritServer(const int channel, const std::vector<ListenerConfig> &listeners);
+    bool InitEpollFd();
     static bool InitPipeFd();
     bool RegisterServerReadEvent();
     bool RegisterPipeReadEvent();
+    bool RegisterDiskIoEvent();
+    bool RegisterCompletionEvent();
+    bool RegisterSseEvent();
     bool RegisterHandleSignal(const int signalId);
     static void WriteSignalToPipeFd(int signalId);
-    void EventLoop(const int epollSize);
-    void HandleServerReadEvent();
-    void HandleClientReadEvent(const int client);
+    void EventLoop();
+    void ApplyConfig(const HttpServerConfig &config);
+    void ApplyRateLimitConfig(const HttpServerConfig &config);
+    void ApplySocketConfig(const HttpServerConfig &config);
+    void ReloadConfig();
+    void HandleServerReadEvent(const Listener &listener);
+    bool CheckConnectionLimit(const int client);
+    bool AddClient(const int client, HttpProcessor *httpProcessor);
+    void PauseAccept();
+    void ResumeAccept();
+    void HandleClientReadEvent(const int client, const unsigned int events);
+    void HandleWebSocketEvent(const int client, HttpProcessor *httpProcessor, const unsigned int events);
+    void ApplyWebSocketResult(const int client, WebSocketConnection *webSocket, const WebSocketEventResult result);
+    void HandleSseEvent(const int client, HttpProcessor *httpProcessor, const unsigned int events);
+    void ApplySseResult(const int client, SseSubscriber *subscriber, const SseEventResult result);
+    void HandleSsePublishEvent();
+    void PublishStats();
+    unsigned int GetConnectionNum() const;
+    HttpProcessor *GetProcessor(const int client) const;
+    void StartCoroutineClient(const int client, const unsigned long long clientKey, const char *peerName);
+    ConnectionTask ServeConnection(const int client, HttpProcessor *httpProcessor);
+    bool CheckRateLimit(const HttpProcessor *httpProcessor);
+    DispatchMode GetDispatchMode(const HttpProcessor *httpProcessor) const;
+    void DispatchToPool(const int client, HttpProcessor *httpProcessor, const bool parsed);
+    TaskLane GetTaskLane(const HttpProcessor *httpProcessor, unsigned int &largeResponseSize) const;
+    bool RequeueLargeReq(HttpReqProcessArg &arg);
+    void DumpPoolStats();
+    void HandleInlineRequest(const int client, HttpProcessor *httpProcessor);
+    void FlushPendingWrites();
+    void SendResponse(const int client, HttpProcessor *httpProcessor, const bool paused);
+    void ApplySendResult(const int client, HttpProcessor *httpProcessor, const SendResponseReturnCode ret,
+        const bool paused);
+    bool ModifyClientEvents(const int client, const unsigned int events);
+    bool ResumeClientEvents(const int client, const unsigned int events);
+    bool ProcessReqInThread(HttpProcessor *httpProcessor, const bool parsed);
+    void HandleCompletionEvent();
+    bool SubmitDiskIo(const int client, HttpProcessor *httpProcessor);
+    void HandleDiskIoEvent();
     void DelClient(const int client);
     void HandlePipeReadEvent();
     void HandleWriteEvent(const int client);
     void HandleClientExpire();
+    void StartUpgrade();
+    void HandleUpgradeReadEvent();
+    void AbortUpgrade();
+    void StartDrain();
     void clear();
     static void ClosePipefd();
     static void ProcessReq(void *arg);
+    static void DropReq(void *arg);
+    static void InitWorkerThread(const unsigned int threadIdx, void *arg);
+    bool BindThreads(const HttpServerConfig &config);
 private:
-    int m_server { -1 }; // 记录socket服务器套接字，初始化为-1是无效值
+    ListenerSet m_listenerSet; // 全部监听套接字
     int m_efd { -1 };
     bool m_checkClientExpire { false };
+    bool m_reloadConfig { false };
+    bool m_dumpStats { false };
+    bool m_upgrade { false }; // 收到平滑升级信号
+    bool m_shutdown { false }; // 收到退出信号
+    int m_upgradeChannel { -1 }; // 与升级启动的新进程之间的通道
+    pid_t m_upgradePid { -1 };
+    time_t m_upgradeDeadline { 0 }; // 超过该时间新进程仍未回复确认字节时终止升级
+    bool m_draining { false }; // 已将监听套接字交给新进程，正在处理剩余连接
+    time_t m_drainDeadline { 0 };
+    unsigned int m_drainTimeout { DEFAULT_DRAIN_TIMEOUT };
     static int m_pipefd[PIPE_FD_NUM];
-    std::string m_sourceDir;
-    std::map<int, HttpProcessor*> m_fdAndProcessorMap; // 客户端套接字和处理对象的映射
+    HttpConfig *m_config { nullptr };
+    AssetBundle m_assetBundle; // 启动时映射，运行期间只读
+    BufferPool m_bufferPool; // 连接处理请求期间使用的缓冲区
+    std::shared_ptr<const HttpProcessorContext> m_processorContext; // 新建连接使用的共享状态
+    unsigned int m_timerInterval { DEFAULT_TIMER_INTERVAL };
+    std::atomic<unsigned int> m_clientExpireInterval { DEFAULT_CLIENT_EXPIRE_INTERVAL }; // 工作线程会读取
+    std::vector<struct epoll_event> m_events; // epoll_wait返回的事件，大小为epoll_size
+    unsigned int m_maxConnections { 0 }; // 连接数上限，0表示不限制
+    bool m_refuseOnOverload { false }; // 达到连接数上限时暂停接收新连接，否则回复503
+    bool m_acceptPaused { false };
+    unsigned int m_retryAfter { UINT_MAX }; // 初始为无效值，保证首次应用配置时构造预置回复
+    PrebuiltResponse m_overloadResponse; // 预先构造的503回复，只在retry_after变化时重新构造
+    PrebuiltResponse m_rateLimitResponse; // 预先构造的429回复
+    RateLimiter m_ipRateLimiter; // 按客户端地址限流
+    std::vector<RouteLimit> m_routeLimits;
+    std::vector<RateLimiter> m_routeRateLimiters; // 与m_routeLimits一一对应，按客户端地址和URL前缀限流
+    bool m_rateLimitApplied { false };
+    HttpServerConfig m_rateLimitConfig; // 当前限流表对应的配置，配置不变时重新加载不清空限流表
+    unsigned long long m_rateLimitIdleNs { 0 };
+    ServerStats m_stats;
+    DispatchPolicy m_dispatchPolicy;
+    unsigned int m_inlineMaxRequestLen { DEFAULT_INLINE_MAX_REQUEST_LEN };
+    unsigned int m_inlineMaxFileSize { DEFAULT_INLINE_MAX_FILE_SIZE };
+    unsigned int m_threadNum { 0 }; // 当前生效的thread_num配置
+    LanePolicy m_lanePolicy;
+    unsigned int m_largeResponseSize { 0 };
+    std::string m_traceFile; // 收到SIGUSR1时导出请求追踪的文件
+    std::vector<std::pair<int, HttpProcessor *>> m_pendingWrites; // 本轮事件循环中inline处理完、待发送回复的连接
+    bool m_useCoroutine { false }; // 新建连接使用协程驱动
+    unsigned int m_webSocketPingInterval { DEFAULT_WEBSOCKET_PING_INTERVAL };
+    std::vector<char> m_webSocketReadBuff; // 所有WebSocket连接共用，只在事件循环线程中使用
+    unsigned int m_sseKeepaliveInterval { DEFAULT_SSE_KEEPALIVE_INTERVAL };
+    SseEvent *m_sseKeepaliveComment { nullptr }; // 所有订阅者共享的保活注释
+    std::vector<SsePublished> m_ssePublished;
+    std::vector<std::pair<int, SseEventResult>> m_sseChanged; // 推送一个事件后需要修改监听事件或关闭的订阅者
+    ConnectionOptions m_connectionOptions;
+    unsigned int m_epollBusyPoll { 0 }; // 当前设置到epoll实例的忙轮询参数
+    unsigned int m_epollBusyPollBudget { 0 };
+    CoroutineDriver m_coroutineDriver;
+    std::vector<int> m_workerCpus;
+    int m_reactorNode { 0 }; // 事件循环线程所在的NUMA节点，连接的处理对象由该线程分配和首次写入，内存也在该节点上
+    SlabPool<HttpProcessor> m_processorPool; // 处理对象只在事件循环线程中创建和销毁
+    std::vector<HttpProcessor *> m_processors; // 下标为客户端套接字，不使用协程驱动的连接的处理对象
+    unsigned int m_processorNum { 0 };
     ClientExpireMinHeap m_clientExpireMinHeap;
+    CompletionQueue m_completionQueue; // 处理线程不修改连接表、监听事件和过期堆，完成后交回事件循环线程
+    std::vector<Completion> m_completions;
     ThreadPool<HttpReqProcessArg> m_threadPool;
+    DiskIoPool m_diskIoPool; // 读取不在页缓存中的文件
+    std::vector<DiskIoCompletion> m_diskIoCompletions;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,65 @@
+#ifndef LISTENER_H
+#define LISTENER_H
+
+#include <sys/socket.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "socket_options.h"
+
+const unsigned int PEER_NAME_MAX_LEN = 64; // 足够容纳"[IPv6地址]:端口"
+
+enum ListenerFamily : unsigned char {
+    LISTENER_FAMILY_IPV4 = 0,
+    LISTENER_FAMILY_IPV6 = 1, // 默认同时接收IPv4连接
+    LISTENER_FAMILY_UNIX = 2, // Unix域流套接字，不设置TCP相关的选项
+};
+
+struct ListenerConfig {
+    ListenerFamily family { LISTENER_FAMILY_IPV4 };
+    std::string host; // IP地址，Unix域套接字为文件路径
+    unsigned short int port { 0 };
+    unsigned int backlog { 0 };
+    ListenerOptions options;
+    bool v6Only { false }; // IPv6监听套接字只接收IPv6连接
+    unsigned int fileMode { 0 }; // Unix域套接字文件的权限，0表示不修改
+};
+
+struct Listener {
+    int fd { -1 };
+    ListenerFamily family { LISTENER_FAMILY_IPV4 };
+    std::string name; // 用于日志，如127.0.0.1:80、[::]:80、unix:/run/http.sock
+};
+
+// 服务端的全部监听套接字，都注册到同一个事件循环
+class ListenerSet {
+public:
+    ListenerSet();
+    ~ListenerSet();
+    // 解析"地址[;选项=值...]"的列表，以逗号分隔，地址为"IPv4:端口"、"[IPv6]:端口"或"unix:路径"，
+    // 选项有backlog、defer_accept、fast_open、reuse_addr、v6only和mode，未指定的选项取defaults中的值
+    static bool ParseList(const std::string &value, const ListenerConfig &defaults,
+        std::vector<ListenerConfig> &configs);
+    static std::string GetName(const ListenerConfig &config);
+    // 任意一个监听套接字创建失败时关闭已创建的，返回false
+    bool Open(const std::vector<ListenerConfig> &configs);
+    // 平滑升级时接管旧进程的监听套接字，按名字匹配configs中的选项重新设置
+    bool Inherit(const std::vector<int> &fds, const std::vector<ListenerConfig> &configs);
+    const std::vector<Listener> &Get() const;
+    const Listener *Find(const int fd) const;
+    std::vector<int> GetFds() const;
+    bool Empty() const;
+    void Close();
+    // 在accept时记录一次对端地址，之后的日志不再调用getpeername；返回限流使用的客户端标识，不会为0
+    static unsigned long long IdentifyPeer(const int client, const struct sockaddr_storage &addr, char *peerName,
+        const size_t peerNameLen);
+private:
+    static bool ParseAddress(const std::string &address, ListenerConfig &config);
+    static bool ParseOption(const std::string &option, ListenerConfig &config);
+    static bool OpenOne(const ListenerConfig &config, Listener &listener);
+    static bool Identify(const int fd, Listener &listener);
+private:
+    std::vector<Listener> m_listeners;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef LISTENER_HANDOFF_H
+#define LISTENER_HANDOFF_H
+
+#include <sys/types.h>
+#include <string>
+#include <vector>
+
+extern const char *UPGRADE_CHANNEL_ENV_NAME;
+const char UPGRADE_READY_FLAG = 'R'; // 新进程初始化完成后回复的确认字节
+
+// 平滑升级时在新旧进程之间传递监听套接字
+// 旧进程通过socketpair与新启动的进程建立通道，新进程的通道套接字编号通过环境变量传递，
+// 监听套接字以SCM_RIGHTS的方式发送，新进程初始化完成后回复确认字节
+class ListenerHandoff {
+public:
+    // 启动时记录可执行文件的绝对路径，命令行中的程序名可能是相对路径或依赖PATH查找
+    static void ResolveExecutable();
+    // 启动新进程，返回旧进程一端的通道套接字，失败返回-1
+    static int Spawn(const std::vector<std::string> &args, pid_t &childPid);
+    // 新进程读取环境变量获取通道套接字，不是由升级启动时返回-1
+    static int GetInheritedChannel();
+    static bool SendFds(const int channel, const std::vector<int> &fds);
+    static bool RecvFds(const int channel, std::vector<int> &fds);
+    static bool SendReady(const int channel);
+private:
+    static std::string m_executable;
+};
+
+#endif
\ No newline at end of file
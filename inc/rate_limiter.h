@@ -0,0 +1,54 @@
+#ifndef RATE_LIMITER_H
+#define RATE_LIMITER_H
+
+#include <string>
+#include <vector>
+
+typedef struct {
+    unsigned long long key; // 0表示空槽位
+    double tokens;
+    unsigned long long lastTime; // 上次访问时刻，单位纳秒，同时用于补充令牌和淘汰空闲桶
+} TokenBucket;
+
+typedef struct {
+    std::string prefix; // URL前缀
+    double rate; // 每秒补充的令牌数
+    double burst; // 桶容量
+} RouteLimit;
+
+// 令牌桶限流表，按键的哈希值分片，分片内使用线性探测的开放地址法
+// 只在事件循环线程中访问，不加锁；访问时按流逝时间补充令牌，定时淘汰长时间未访问的桶
+// 分片满时替换新键探测位置附近最久未访问的桶，插入的代价有上限，也不会因表满而放行
+class RateLimiter {
+public:
+    RateLimiter();
+    ~RateLimiter();
+    bool Init(const unsigned int tableSize, const double rate, const double burst);
+    bool IsEnabled() const;
+    // 消耗一个令牌，令牌不足返回false
+    bool Allow(const unsigned long long key, const unsigned long long now);
+    void EvictIdle(const unsigned long long now, const unsigned long long idleTime);
+    unsigned int Size() const;
+    // 解析"前缀:速率:容量"的列表，以逗号分隔
+    static bool ParseRouteLimits(const std::string &value, std::vector<RouteLimit> &routeLimits);
+    static unsigned long long HashKey(const unsigned long long value);
+private:
+    struct Shard {
+        std::vector<TokenBucket> buckets;
+        unsigned int size { 0 };
+    };
+    TokenBucket *Find(Shard &shard, const unsigned long long key, const unsigned long long hash);
+    TokenBucket *Insert(Shard &shard, const unsigned long long key, const unsigned long long hash,
+        const unsigned long long now);
+    void EvictShard(Shard &shard, const unsigned long long now, const unsigned long long idleTime);
+    void Erase(Shard &shard, unsigned int idx);
+private:
+    std::vector<Shard> m_shards;
+    unsigned int m_shardMask { 0 };
+    unsigned int m_slotMask { 0 };
+    unsigned int m_maxShardSize { 0 }; // 分片最多使用的槽位数，控制负载因子
+    double m_rate { 0 };
+    double m_burst { 0 };
+};
+
+#endif
\ No newline at end of file
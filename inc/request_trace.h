@@ -0,0 +1,72 @@
+#ifndef REQUEST_TRACE_H
+#define REQUEST_TRACE_H
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include <atomic>
+
+// 请求处理过程中的时间点，相邻两个时间点之间的区间以后一个时间点命名
+enum TracePoint : unsigned char {
+    TRACE_POINT_ACCEPT = 0, // 接收连接，只记录连接上的第一个请求
+    TRACE_POINT_READ = 1, // 每次读到数据
+    TRACE_POINT_ENQUEUE = 2, // 放入线程池的任务队列
+    TRACE_POINT_WORKER_START = 3, // 处理线程开始处理
+    TRACE_POINT_PARSE_END = 4, // 解析请求完成
+    TRACE_POINT_HANDLE_END = 5, // 查找资源包或stat、open、mmap完成
+    TRACE_POINT_FIRST_BYTE = 6, // 回复的第一批数据交给内核
+    TRACE_POINT_LAST_BYTE = 7, // 回复的最后一批数据交给内核
+    TRACE_POINT_NUM,
+};
+
+struct TraceEvent {
+    unsigned long long traceId;
+    unsigned long long time; // CLOCK_MONOTONIC，单位纳秒
+    int tid; // 记录事件的线程
+    int socketId;
+    TracePoint point;
+};
+
+// 按配置的间隔抽样请求，被抽中的请求在各个时间点把事件写入当前线程的环形缓冲区，写满后覆盖最早的事件
+// 未被抽中的请求traceId为0，各时间点只多一次判断；导出时按traceId汇总为Chrome/Perfetto的JSON格式
+class RequestTrace {
+public:
+    // sampleInterval为每多少个请求抽样一个，0表示关闭；ringSize为每个线程缓冲区的事件数，只在第一次调用时生效
+    static void Init(const unsigned int sampleInterval, const unsigned int ringSize);
+    static bool IsEnabled()
+    {
+        return m_sampleInterval.load(std::memory_order_relaxed) != 0;
+    }
+    // 新请求开始时调用，返回0表示不追踪
+    static unsigned long long Sample()
+    {
+        if (!IsEnabled()) {
+            return 0;
+        }
+        return SampleSlow();
+    }
+    static void Record(const unsigned long long traceId, const int socketId, const TracePoint point);
+    // 汇总所有线程的事件写入文件，先写临时文件再重命名
+    static bool Export(const std::string &path);
+private:
+    struct Ring {
+        std::vector<TraceEvent> events;
+        std::atomic<unsigned long long> head { 0 }; // 已写入的事件总数，写入位置为head % events.size()
+        bool owned { false }; // 有线程正在使用，线程退出后可以被新线程复用
+    };
+    struct RingHolder {
+        Ring *ring { nullptr };
+        ~RingHolder();
+    };
+    static unsigned long long SampleSlow();
+    static Ring *GetRing();
+    static void CollectEvents(std::vector<TraceEvent> &events);
+private:
+    static std::atomic<unsigned int> m_sampleInterval;
+    static std::atomic<unsigned long long> m_nextTraceId;
+    static unsigned int m_ringSize;
+    static pthread_mutex_t m_mutex; // 保护m_rings
+    static std::vector<Ring *> m_rings; // 进程退出前不释放，导出时也能读到已退出线程的事件
+};
+
+#endif
\ No newline at end of file
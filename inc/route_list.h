@@ -0,0 +1,21 @@
+#ifndef ROUTE_LIST_H
+#define ROUTE_LIST_H
+
+#include <string>
+#include <vector>
+
+typedef struct {
+    std::string prefix; // URL前缀
+    std::string value; // 前缀之后的部分，有多个字段时仍以冒号分隔
+} RouteItem;
+
+// 按URL前缀配置的列表，格式为"前缀:值"，以逗号分隔，分发方式、任务队列、限流、WebSocket和事件流的路由共用
+class RouteList {
+public:
+    // 值由fieldNum个冒号分隔的字段组成，从右侧拆分，前缀中可以包含冒号；前缀必须以/开头，值不能为空
+    // name用于错误信息，例如"dispatch route"
+    static bool Parse(const std::string &list, const unsigned int fieldNum, const char *name,
+        std::vector<RouteItem> &items);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef SERVER_STATS_H
+#define SERVER_STATS_H
+
+#include <stddef.h>
+#include <atomic>
+
+// 服务端运行统计，工作线程也会更新，计数器都使用原子变量；收到SIGUSR1时打印
+struct ServerStats {
+    std::atomic<unsigned long> acceptCount { 0 }; // 接收的连接数
+    std::atomic<unsigned long> rejectConnCount { 0 }; // 超过连接数上限被拒绝的连接数
+    std::atomic<unsigned long> pauseAcceptCount { 0 }; // 达到连接数上限暂停接收新连接的次数
+    std::atomic<unsigned long> shedQueueFullCount { 0 }; // 任务队列已满被拒绝的请求数
+    std::atomic<unsigned long> shedQueueWaitCount { 0 }; // 排队超时被拒绝的请求数
+    std::atomic<unsigned long> rateLimitedCount { 0 }; // 超过限流被拒绝的请求数
+    std::atomic<unsigned long> processReqCount { 0 }; // 处理线程处理的请求数
+    std::atomic<unsigned long> inlineReqCount { 0 }; // 在事件循环线程中处理的请求数
+    std::atomic<unsigned long> offloadReqCount { 0 }; // 按inline分发但可能阻塞而交给线程池的请求数
+    std::atomic<unsigned long> coroutineReqCount { 0 }; // 由连接协程处理的请求数
+    std::atomic<unsigned long> crossNodeReqCount { 0 }; // 处理线程与事件循环线程不在同一NUMA节点上的请求数
+    std::atomic<unsigned long> diskIoReqCount { 0 }; // 文件不在页缓存中，先交给磁盘线程读取的请求数
+    std::atomic<unsigned long> webSocketUpgradeCount { 0 }; // 握手完成的WebSocket连接数
+    std::atomic<unsigned long> webSocketTimeoutCount { 0 }; // ping超时没有回应被关闭的WebSocket连接数
+    std::atomic<unsigned long> sseSubscribeCount { 0 }; // 开始接收事件流的订阅者数
+    std::atomic<unsigned long> ssePublishCount { 0 }; // 推送的事件数
+    std::atomic<unsigned long> ssePushCount { 0 }; // 事件放入订阅者队列的次数
+    std::atomic<unsigned long> sseDropCount { 0 }; // 订阅者积压过多被丢弃的事件数
+    std::atomic<unsigned long> completionWakeCount { 0 }; // 事件循环线程被完成队列唤醒的次数，与process_req之比为合并程度
+
+    void Dump() const;
+    // 以JSON格式写入buff，返回长度，发布到SSE的stats频道
+    int Format(char *buff, const size_t buffLen) const;
+};
+
+#endif
\ No newline at end of file
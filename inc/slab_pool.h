@@ -0,0 +1,82 @@
+#ifndef SLAB_POOL_H
+#define SLAB_POOL_H
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <new>
+#include <utility>
+#include <vector>
+
+// 固定类型对象的板式分配器：每次向堆申请一块能容纳多个对象的内存，释放的对象挂到空闲链表上复用
+// 板在对象池析构时才归还，稳定运行时创建和销毁对象都不调用malloc/free
+// 不加锁，创建和销毁必须在同一个线程中进行
+template <class T>
+class SlabPool {
+public:
+    explicit SlabPool(const unsigned int objectsPerSlab) : m_objectsPerSlab(objectsPerSlab == 0 ? 1 : objectsPerSlab) {}
+    ~SlabPool()
+    {
+        for (Block *slab : m_slabs) {
+            free(slab);
+        }
+        m_slabs.clear();
+        m_freeList = nullptr;
+    }
+    SlabPool(const SlabPool &) = delete;
+    SlabPool &operator=(const SlabPool &) = delete;
+    template <class... Args>
+    T *Create(Args &&...args)
+    {
+        if (m_freeList == nullptr && !Grow()) {
+            return nullptr;
+        }
+        Block *block = m_freeList;
+        m_freeList = block->next;
+        m_usedNum++;
+        return new (block->storage) T(std::forward<Args>(args)...);
+    }
+    void Destroy(T *object)
+    {
+        if (object == nullptr) {
+            return;
+        }
+        object->~T();
+        Block *block = reinterpret_cast<Block *>(object);
+        block->next = m_freeList;
+        m_freeList = block;
+        m_usedNum--;
+    }
+    unsigned int GetUsedNum() const
+    {
+        return m_usedNum;
+    }
+    size_t GetSlabBytes() const
+    {
+        return m_slabs.size() * m_objectsPerSlab * sizeof(Block);
+    }
+private:
+    union Block {
+        Block *next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+    bool Grow()
+    {
+        Block *slab = reinterpret_cast<Block *>(malloc(sizeof(Block) * m_objectsPerSlab));
+        if (slab == nullptr) {
+            return false;
+        }
+        m_slabs.push_back(slab);
+        for (unsigned int i = 0; i < m_objectsPerSlab; ++i) {
+            slab[i].next = m_freeList;
+            m_freeList = &slab[i];
+        }
+        return true;
+    }
+private:
+    unsigned int m_objectsPerSlab;
+    unsigned int m_usedNum { 0 };
+    Block *m_freeList { nullptr };
+    std::vector<Block *> m_slabs;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,26 @@
+#ifndef SOCKET_OPTIONS_H
+#define SOCKET_OPTIONS_H
+
+// 监听套接字的选项，在bind之前设置
+struct ListenerOptions {
+    bool reuseAddr { true }; // 重启时不必等待TIME_WAIT状态的连接超时
+    unsigned int deferAccept { 0 }; // 连接收到数据后才交给accept，最多等待的秒数，0表示不启用
+    unsigned int fastOpenQueue { 0 }; // TCP Fast Open等待accept的连接数上限，0表示不启用
+};
+
+// accept得到的客户端套接字的选项
+struct ConnectionOptions {
+    bool noDelay { true }; // 关闭Nagle算法，回复不等待上一段数据的确认
+    unsigned int busyPoll { 0 }; // 读取时忙轮询网卡队列的微秒数，0表示不启用
+};
+
+class SocketOptions {
+public:
+    static bool ApplyListener(const int fd, const ListenerOptions &options);
+    // 设置失败只打印告警，不影响连接的处理
+    static void ApplyConnection(const int fd, const ConnectionOptions &options);
+    // 设置epoll实例的忙轮询参数，需要内核6.9及以上，不支持时返回false
+    static bool ApplyEpollBusyPoll(const int efd, const unsigned int busyPoll, const unsigned int budget);
+};
+
+#endif
\ No newline at end of file
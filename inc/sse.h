@@ -0,0 +1,139 @@
+#ifndef SSE_H
+#define SSE_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+
+const unsigned int SSE_WRITEV_MAX_NUM = 64; // 每次writev最多发送的事件数
+const char * const SSE_CHANNEL_STATS = "stats"; // 内置频道，每个定时器间隔发布一次运行统计
+extern const char *SSE_SLOW_POLICY_DROP; // 队列满时丢弃最早还没开始发送的事件
+extern const char *SSE_SLOW_POLICY_CLOSE; // 队列满时关闭连接，客户端重连后从最新的事件开始接收
+
+// 处理一次事件后订阅者接下来的状态，由事件循环线程转换为需要监听的事件
+enum SseEventResult : unsigned char {
+    SSE_EVENT_RESULT_READ = 0, // 只需要监听读事件，用于发现客户端断开
+    SSE_EVENT_RESULT_WRITE = 1, // 有未发送完的事件，同时监听写事件
+    SSE_EVENT_RESULT_CLOSE = 2, // 关闭连接
+};
+
+// 发布时序列化一次，所有订阅者的发送队列共享同一份，引用计数只在事件循环线程中修改
+class SseEvent {
+public:
+    // data中的每一行生成一个"data:"字段
+    static SseEvent *Create(const unsigned long long id, const char *event, const char *data, const size_t len);
+    static SseEvent *CreateComment(const char *comment); // 注释行，客户端忽略，用于保活
+    void Ref();
+    void Unref(); // 计数归零时释放
+    const char *GetData() const;
+    size_t GetSize() const;
+private:
+    static SseEvent *Allocate(const size_t size);
+    SseEvent() {}
+    ~SseEvent() {}
+private:
+    unsigned int m_refCount { 1 };
+    size_t m_size { 0 };
+};
+
+typedef struct {
+    std::string prefix; // URL前缀
+    unsigned int channel; // SseHub中的频道下标
+} SseRoute;
+
+// 按URL前缀选择订阅的频道
+class SseRouter {
+public:
+    SseRouter();
+    ~SseRouter();
+    bool Init(const std::string &routes);
+    bool Match(const char *url, const size_t urlLen, unsigned int &channel) const;
+    bool HasRoutes() const;
+    // 解析"前缀:频道"的列表，以逗号分隔，例如"/events/stats:stats,/events/news:news"
+    static bool ParseRoutes(const std::string &value, std::vector<SseRoute> &routes);
+private:
+    std::vector<SseRoute> m_routes;
+};
+
+// 订阅者的发送队列只保存事件指针，连接间不复制事件内容；有积压时一次writev发送多个事件
+class SseSubscriber {
+public:
+    SseSubscriber(const int socketId, const unsigned int channel, const unsigned int maxQueue, const bool dropSlow);
+    ~SseSubscriber();
+    void Open(); // 在事件循环线程中加入频道
+    bool IsOpened() const;
+    // 队列原本为空时立即发送，积压时按丢弃策略处理
+    SseEventResult Push(SseEvent *event);
+    SseEventResult OnWritable();
+    // 客户端不会发送数据，读到连接结束或出错时关闭，其余数据丢弃
+    SseEventResult OnReadable(char *buffer, const size_t bufferLen);
+    // 距上次发送超过间隔时发送保活注释；有积压且一个间隔内没有任何进展时关闭
+    SseEventResult KeepAlive(SseEvent *comment, const time_t now, const unsigned int interval, time_t &nextTime);
+    int GetSocketId() const;
+    unsigned int GetChannel() const;
+    unsigned long long GetDropNum() const;
+    void SetIndex(const size_t index); // 在频道订阅者列表中的下标，由SseHub维护
+    size_t GetIndex() const;
+    void SetEvents(const unsigned int events);
+    unsigned int GetEvents() const;
+private:
+    SseEventResult Flush();
+    SseEventResult GetResult() const;
+private:
+    int m_socketId;
+    unsigned int m_channel;
+    unsigned int m_maxQueue;
+    bool m_dropSlow; // true时丢弃积压的事件，false时关闭连接
+    bool m_opened { false };
+    bool m_broken { false };
+    std::deque<SseEvent *> m_queue;
+    size_t m_frontOffset { 0 }; // 队首事件已发送的长度
+    time_t m_lastSendTime { 0 }; // 最近一次发送出数据的时间
+    unsigned long long m_dropNum { 0 };
+    size_t m_index { 0 };
+    unsigned int m_events { 0 };
+};
+
+typedef struct {
+    unsigned int channel;
+    SseEvent *event;
+} SsePublished;
+
+// 频道和发布队列；Publish可以在任意线程调用，序列化后放入发布队列并写eventfd，
+// 由事件循环线程取出后推送给频道的全部订阅者，订阅者列表只在事件循环线程中访问
+class SseHub {
+public:
+    static SseHub &GetInstance();
+    bool Init();
+    int GetEventFd() const; // 有待推送的事件时可读
+    // 频道不存在时创建，下标在进程内不变
+    unsigned int GetChannel(const std::string &name);
+    bool Publish(const std::string &channel, const char *event, const char *data, const size_t len);
+    // 以下只在事件循环线程中调用
+    bool HasSubscribers(const std::string &channel);
+    void PollPublished(std::vector<SsePublished> &published);
+    const std::vector<SseSubscriber *> &GetSubscribers(const unsigned int channel);
+    void Subscribe(SseSubscriber *subscriber);
+    void Unsubscribe(SseSubscriber *subscriber);
+private:
+    SseHub();
+    ~SseHub();
+    unsigned int GetChannelLocked(const std::string &name);
+private:
+    struct Channel {
+        std::string name;
+        unsigned long long lastId { 0 }; // 发布时分配，受m_mutex保护
+        std::vector<SseSubscriber *> subscribers;
+    };
+    int m_eventFd { -1 };
+    pthread_mutex_t m_mutex;
+    std::deque<Channel> m_channels; // 扩容时不移动已有频道，订阅者列表的引用保持有效
+    std::unordered_map<std::string, unsigned int> m_channelIndex;
+    std::vector<SsePublished> m_published;
+};
+
+#endif
\ No newline at end of file
@@ -3,25 +3,101 @@
 
 #include <pthread.h>
 #include <semaphore.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <atomic>
 #include <queue>
+#include <vector>
 #include <stdio.h>
+#include "http_probes.h"
 
 typedef void (*TaskFunction)(void *);
+typedef void (*ThreadInitFunction)(const unsigned int threadIdx, void *); // 线程启动后、处理任务前调用
+
+enum AddTaskReturnCode : unsigned char {
+    ADD_TASK_RETURN_CODE_SUCCESS = 0, // 添加任务成功
+    ADD_TASK_RETURN_CODE_ERROR = 1, // 添加任务出错
+    ADD_TASK_RETURN_CODE_FULL = 2, // 任务队列已满
+};
 
 template <class T>
 struct Task {
     TaskFunction function;
     T arg;
+    TaskFunction dropFunction; // 任务排队超时时代替function执行，为空时不丢弃
+    unsigned char lane; // 任务进入的队列，超出队列数量时进入最后一个队列
+    unsigned long long enqueueTime; // 入队时刻，单位纳秒，由AddTask填写
+    unsigned long long probeId; // 探针中标识任务所属的对象，由调用方填写，不需要时为0
+};
+
+// 单个队列的排队统计，排队时间在任务出队时计算
+struct ThreadPoolLaneStats {
+    unsigned int weight;
+    unsigned int queueSize; // 当前排队的任务数
+    unsigned long long dequeueCount; // 已出队的任务数，包括排队超时被丢弃的任务
+    unsigned long long waitTotalNs; // 已出队任务的排队时间总和
+    unsigned long long waitMaxNs; // 已出队任务的最长排队时间
+};
+
+// 线程数量的调整情况，排队时间和阻塞比例为最近一个调整周期的测量值
+struct ThreadPoolSizingStats {
+    unsigned int threadNum; // 目标线程数量
+    unsigned int liveThreadNum;
+    unsigned int minThreadNum;
+    unsigned int maxThreadNum;
+    unsigned long long growCount; // 因排队时间过长增加线程的次数
+    unsigned long long retireCount; // 空闲超时或调小线程数量后退出的线程数
+    unsigned long long queueWaitNs;
+    unsigned int blockedPercent; // 处理任务期间阻塞在磁盘、锁或网络上的时间占比，不包括等待CPU的时间
 };
 
+const unsigned long long THREAD_POOL_ADJUST_INTERVAL = 100000000ULL; // 每100毫秒最多调整一次线程数量
+const unsigned int THREAD_POOL_GROW_BLOCKED_PERCENT = 20; // 线程数不少于CPU数时，阻塞比例低于20%不再增加线程
+const unsigned int THREAD_POOL_FAST_GROW_BLOCKED_PERCENT = 50; // 阻塞比例超过50%时按当前线程数的一半增加
+const unsigned int THREAD_POOL_MEASURE_SAMPLE = 8; // 每个线程每8个任务测量一次阻塞时间
+
+// 任务按lane进入多个队列，处理线程按权重平滑轮询非空的队列，小任务不会排在大任务后面等待
+// 默认只有一个队列，与先进先出相同
+// 设置线程数量范围后，排队时间超过目标时增加线程，空闲超时的线程退出；线程可以join，析构时等待所有线程退出
 template <class T>
 class ThreadPool {
 public:
-    ThreadPool(const unsigned int threadNum) : m_threadNum(threadNum) {}
+    ThreadPool(const unsigned int threadNum) : m_threadNum(threadNum), m_lanes(1)
+    {
+        long cpuNum = sysconf(_SC_NPROCESSORS_ONLN);
+        m_cpuNum = cpuNum > 0 ? static_cast<unsigned int>(cpuNum) : 1;
+    }
     ~ThreadPool()
     {
+        Stop();
         Clear();
-        m_stop = true; // 停止子线程的任务
+    }
+    // 唤醒所有线程并等待退出，正在执行的任务会执行完，队列中剩余的任务不再执行
+    void Stop()
+    {
+        if (!m_initMutex) {
+            return;
+        }
+        (void)pthread_mutex_lock(&m_mutex);
+        if (m_stop) {
+            (void)pthread_mutex_unlock(&m_mutex);
+            return;
+        }
+        m_stop = true;
+        std::vector<pthread_t> threads;
+        threads.swap(m_threads);
+        threads.insert(threads.end(), m_exitedThreads.begin(), m_exitedThreads.end());
+        m_exitedThreads.clear();
+        unsigned int liveThreadNum = m_liveThreadNum;
+        (void)pthread_mutex_unlock(&m_mutex);
+        for (unsigned int i = 0; m_initSem && i < liveThreadNum; ++i) {
+            (void)sem_post(&m_sem);
+        }
+        for (pthread_t thread : threads) {
+            (void)pthread_join(thread, nullptr);
+        }
     }
     bool Init()
     {
@@ -43,39 +119,220 @@ public:
         }
         m_initSem = true;
         // 初始化线程池
-        m_threadPool = new pthread_t[m_threadNum];
-        if (m_threadPool == nullptr) {
+        if (IsElastic() && (m_threadNum < m_minThreadNum || m_threadNum > m_maxThreadNum)) {
+            m_threadNum = m_threadNum < m_minThreadNum ? m_minThreadNum : m_maxThreadNum;
+        }
+        if (!CreateThreads(m_threadNum)) {
+            Stop();
             Clear();
             return false;
         }
-        for (unsigned int i = 0; i < m_threadNum; ++i) {
-            if(pthread_create(&m_threadPool[i], nullptr, ThreadPool::ThreadFunction, this) != 0) {
-                Clear();
-                return false;
-            }
-            if (pthread_detach(m_threadPool[i]) != 0) {
-                Clear();
-                return false;
-            }
-        }
 
         return true;
     }
-    bool AddTask(const Task<T> &task)
+    // 调整线程数量，增加时立即创建线程，减少时多余的线程在取到下一个信号量后退出
+    bool SetThreadNum(const unsigned int threadNum)
     {
+        if (threadNum == 0) {
+            return false;
+        }
+        if (!m_initMutex || !m_initSem) { // 未初始化时只记录线程数量
+            m_threadNum = threadNum;
+            return true;
+        }
         if (pthread_mutex_lock(&m_mutex) != 0) {
             return false;
         }
-        m_queue.push(task);
+        unsigned int oldThreadNum = m_threadNum;
+        m_threadNum = threadNum;
+        unsigned int createNum = threadNum > m_liveThreadNum ? threadNum - m_liveThreadNum : 0;
+        (void)pthread_mutex_unlock(&m_mutex);
+
+        if (threadNum < oldThreadNum) {
+            // 唤醒需要退出的线程
+            for (unsigned int i = threadNum; i < oldThreadNum; ++i) {
+                (void)sem_post(&m_sem);
+            }
+        }
+        return CreateThreads(createNum);
+    }
+    AddTaskReturnCode AddTask(const Task<T> &task)
+    {
+        if (pthread_mutex_lock(&m_mutex) != 0) {
+            return ADD_TASK_RETURN_CODE_ERROR;
+        }
+        // 线程数量会自动调整，队列长度上限按入队时的线程数量计算
+        if (m_maxQueuePerThread != 0 && m_queueSize >= m_maxQueuePerThread * m_threadNum) {
+            (void)pthread_mutex_unlock(&m_mutex);
+            return ADD_TASK_RETURN_CODE_FULL;
+        }
+        std::queue<Task<T>> &queue = m_lanes[task.lane < m_lanes.size() ? task.lane : m_lanes.size() - 1].queue;
+        unsigned long long now = NowNs();
+        queue.push(task);
+        queue.back().enqueueTime = now;
+        m_queueSize++;
+        HTTP_PROBE3(task_enqueue, task.probeId, task.lane, m_queueSize);
+        // 所有线程都阻塞时没有任务出队，入队时也检查一次，根据队首任务的排队时间增加线程
+        unsigned int createNum = CheckGrow(now);
         (void)pthread_mutex_unlock(&m_mutex);
 
         if (sem_post(&m_sem) != 0) {
-            return false;
+            return ADD_TASK_RETURN_CODE_ERROR;
         }
+        (void)CreateThreads(createNum);
 
+        return ADD_TASK_RETURN_CODE_SUCCESS;
+    }
+    // 设置线程数量范围、目标排队时间和空闲线程的退出时间，单位纳秒；minThreadNum不小于maxThreadNum时线程数量固定
+    // 当前线程数量不在范围内时调整到范围内
+    bool SetElasticLimits(const unsigned int minThreadNum, const unsigned int maxThreadNum,
+        const unsigned long long targetQueueWait, const unsigned long long idleTimeout)
+    {
+        if (minThreadNum == 0 || maxThreadNum == 0) {
+            return false;
+        }
+        if (!m_initMutex) {
+            m_minThreadNum = minThreadNum;
+            m_maxThreadNum = maxThreadNum;
+            m_targetQueueWait = targetQueueWait;
+            m_idleTimeout = idleTimeout;
+            return true;
+        }
+        (void)pthread_mutex_lock(&m_mutex);
+        m_minThreadNum = minThreadNum;
+        m_maxThreadNum = maxThreadNum;
+        m_targetQueueWait = targetQueueWait;
+        m_idleTimeout = idleTimeout;
+        unsigned int threadNum = m_threadNum;
+        (void)pthread_mutex_unlock(&m_mutex);
+        if (IsElastic() && (threadNum < minThreadNum || threadNum > maxThreadNum)) {
+            return SetThreadNum(threadNum < minThreadNum ? minThreadNum : maxThreadNum);
+        }
+        return true;
+    }
+    bool GetSizingStats(ThreadPoolSizingStats &stats)
+    {
+        if (!m_initMutex || pthread_mutex_lock(&m_mutex) != 0) {
+            return false;
+        }
+        stats.threadNum = m_threadNum;
+        stats.liveThreadNum = m_liveThreadNum;
+        stats.minThreadNum = IsElastic() ? m_minThreadNum : m_threadNum;
+        stats.maxThreadNum = IsElastic() ? m_maxThreadNum : m_threadNum;
+        stats.growCount = m_growCount;
+        stats.retireCount = m_retireCount;
+        stats.queueWaitNs = m_lastQueueWait;
+        stats.blockedPercent = m_lastBlockedPercent;
+        (void)pthread_mutex_unlock(&m_mutex);
+        return true;
+    }
+    // 需要在Init之前设置，之后新建的线程也会调用，threadIdx按线程创建顺序递增
+    void SetThreadInitFunction(ThreadInitFunction function, void *arg)
+    {
+        m_threadInitFunction = function;
+        m_threadInitArg = arg;
+    }
+    // 设置每个线程对应的队列长度上限和排队时间上限，0表示不限制
+    void SetQueueLimit(const unsigned int maxQueuePerThread, const unsigned long long maxQueueWait)
+    {
+        if (!m_initMutex) {
+            m_maxQueuePerThread = maxQueuePerThread;
+            m_maxQueueWait = maxQueueWait;
+            return;
+        }
+        (void)pthread_mutex_lock(&m_mutex);
+        m_maxQueuePerThread = maxQueuePerThread;
+        m_maxQueueWait = maxQueueWait;
+        (void)pthread_mutex_unlock(&m_mutex);
+    }
+    // 设置各队列的权重，队列数量等于权重个数，权重为0的队列按1处理
+    // 队列数量减少时，被移除队列中的任务移到新的最后一个队列，排队统计保留
+    bool SetLaneWeights(const std::vector<unsigned int> &weights)
+    {
+        if (weights.empty() || weights.size() > MAX_LANE_NUM) {
+            return false;
+        }
+        if (m_initMutex) {
+            (void)pthread_mutex_lock(&m_mutex);
+        }
+        while (m_lanes.size() > weights.size()) {
+            std::queue<Task<T>> &removed = m_lanes.back().queue;
+            std::queue<Task<T>> &last = m_lanes[m_lanes.size() - 2].queue;
+            for (; !removed.empty(); removed.pop()) {
+                last.push(removed.front());
+            }
+            m_lanes.pop_back();
+        }
+        m_lanes.resize(weights.size());
+        for (size_t i = 0; i < weights.size(); ++i) {
+            m_lanes[i].weight = weights[i] == 0 ? 1 : weights[i];
+            m_lanes[i].credit = 0;
+        }
+        if (m_initMutex) {
+            (void)pthread_mutex_unlock(&m_mutex);
+        }
+        return true;
+    }
+    unsigned int GetLaneNum()
+    {
+        if (!m_initMutex) {
+            return static_cast<unsigned int>(m_lanes.size());
+        }
+        (void)pthread_mutex_lock(&m_mutex);
+        unsigned int laneNum = static_cast<unsigned int>(m_lanes.size());
+        (void)pthread_mutex_unlock(&m_mutex);
+        return laneNum;
+    }
+    bool GetLaneStats(const unsigned int lane, ThreadPoolLaneStats &stats)
+    {
+        if (!m_initMutex || pthread_mutex_lock(&m_mutex) != 0) {
+            return false;
+        }
+        if (lane >= m_lanes.size()) {
+            (void)pthread_mutex_unlock(&m_mutex);
+            return false;
+        }
+        const Lane &laneInfo = m_lanes[lane];
+        stats.weight = laneInfo.weight;
+        stats.queueSize = static_cast<unsigned int>(laneInfo.queue.size());
+        stats.dequeueCount = laneInfo.dequeueCount;
+        stats.waitTotalNs = laneInfo.waitTotalNs;
+        stats.waitMaxNs = laneInfo.waitMaxNs;
+        (void)pthread_mutex_unlock(&m_mutex);
         return true;
     }
 private:
+    struct Lane {
+        std::queue<Task<T>> queue;
+        unsigned int weight { 1 };
+        long long credit { 0 }; // 平滑加权轮询的当前权重
+        unsigned long long dequeueCount { 0 };
+        unsigned long long waitTotalNs { 0 };
+        unsigned long long waitMaxNs { 0 };
+    };
+    static const size_t MAX_LANE_NUM = 255;
+
+    // 平滑加权轮询：非空队列的当前权重加上各自权重，取最大的出队并减去非空队列的权重之和
+    // 权重为4:1时出队顺序为AAABA AAABA...，权重小的队列不会饿死，只有一个非空队列时直接出队
+    // 调用时持有m_mutex且队列不全为空
+    Lane &SelectLane()
+    {
+        Lane *selected = nullptr;
+        long long totalWeight = 0;
+        for (Lane &lane : m_lanes) {
+            if (lane.queue.empty()) {
+                continue;
+            }
+            lane.credit += lane.weight;
+            totalWeight += lane.weight;
+            if (selected == nullptr || lane.credit > selected->credit) {
+                selected = &lane;
+            }
+        }
+        selected->credit -= totalWeight;
+        return *selected;
+    }
+
     void Clear()
     {
         // 销毁互斥锁
@@ -88,13 +345,147 @@ private:
             (void)sem_destroy(&m_sem);
             m_initSem = false;
         }
-        // 销毁线程池
-        if (m_threadPool != nullptr) {
-            delete []m_threadPool;
-            m_threadPool = nullptr;
+    }
+
+    // 在锁内创建线程并记录，Stop取到的线程列表是完整的
+    bool CreateThreads(const unsigned int createNum)
+    {
+        ReapThreads();
+        for (unsigned int i = 0; i < createNum; ++i) {
+            pthread_t thread;
+            (void)pthread_mutex_lock(&m_mutex);
+            if (m_stop) {
+                (void)pthread_mutex_unlock(&m_mutex);
+                return false;
+            }
+            if (pthread_create(&thread, nullptr, ThreadPool::ThreadFunction, this) != 0) {
+                (void)pthread_mutex_unlock(&m_mutex);
+                printf("ERROR pthread_create fail.\n");
+                return false;
+            }
+            m_liveThreadNum++;
+            m_threads.push_back(thread);
+            (void)pthread_mutex_unlock(&m_mutex);
+        }
+        return true;
+    }
+
+    // 回收已退出的线程
+    void ReapThreads()
+    {
+        std::vector<pthread_t> threads;
+        (void)pthread_mutex_lock(&m_mutex);
+        threads.swap(m_exitedThreads);
+        (void)pthread_mutex_unlock(&m_mutex);
+        for (pthread_t thread : threads) {
+            (void)pthread_join(thread, nullptr);
         }
     }
 
+    // 当前线程退出，调用时持有m_mutex；Stop之后由Stop负责join
+    void Retire()
+    {
+        m_liveThreadNum--;
+        if (m_stop) {
+            return;
+        }
+        pthread_t self = pthread_self();
+        for (size_t i = 0; i < m_threads.size(); ++i) {
+            if (pthread_equal(m_threads[i], self)) {
+                m_threads[i] = m_threads.back();
+                m_threads.pop_back();
+                break;
+            }
+        }
+        m_exitedThreads.push_back(self);
+        m_retireCount++;
+    }
+
+    bool IsElastic() const
+    {
+        return m_minThreadNum < m_maxThreadNum;
+    }
+
+    // 每个调整周期计算一次排队时间：周期内出队任务的平均排队时间与队首任务已排队时间中的较大值
+    // 超过目标时增加线程；处理线程主要在占用CPU且线程数已不少于CPU数时，增加线程只会加剧竞争，不再增加
+    // 调用时持有m_mutex，返回需要创建的线程数
+    unsigned int CheckGrow(const unsigned long long now)
+    {
+        if (!IsElastic() || m_stop || now - m_lastAdjustTime < THREAD_POOL_ADJUST_INTERVAL) {
+            return 0;
+        }
+        m_lastAdjustTime = now;
+        unsigned long long queueWait = m_windowDequeueCount == 0 ? 0 : m_windowQueueWait / m_windowDequeueCount;
+        for (const Lane &lane : m_lanes) {
+            if (!lane.queue.empty() && now - lane.queue.front().enqueueTime > queueWait) {
+                queueWait = now - lane.queue.front().enqueueTime;
+            }
+        }
+        unsigned long long taskWall = m_windowTaskWall.exchange(0);
+        unsigned long long taskCpu = m_windowTaskCpu.exchange(0);
+        m_windowQueueWait = 0;
+        m_windowDequeueCount = 0;
+        m_lastQueueWait = queueWait;
+        m_lastBlockedPercent = taskWall == 0 || taskCpu >= taskWall ? 0 :
+            static_cast<unsigned int>((taskWall - taskCpu) * 100 / taskWall);
+        if (m_targetQueueWait == 0 || queueWait <= m_targetQueueWait || m_threadNum >= m_maxThreadNum) {
+            return 0;
+        }
+        if (m_threadNum >= m_cpuNum && m_lastBlockedPercent < THREAD_POOL_GROW_BLOCKED_PERCENT) {
+            return 0;
+        }
+        unsigned int step = m_lastBlockedPercent >= THREAD_POOL_FAST_GROW_BLOCKED_PERCENT && m_threadNum > 2 ?
+            m_threadNum / 2 : 1;
+        m_threadNum = m_threadNum + step > m_maxThreadNum ? m_maxThreadNum : m_threadNum + step;
+        m_growCount++;
+        printf("EVENT  Thread pool grows to %u threads, queue wait = %llu us, blocked = %u%%.\n", m_threadNum,
+            queueWait / 1000, m_lastBlockedPercent);
+        return m_threadNum > m_liveThreadNum ? m_threadNum - m_liveThreadNum : 0;
+    }
+
+    // 空闲线程等待信号量时带超时，返回false表示超时
+    bool WaitTask(const unsigned long long idleTimeout)
+    {
+        if (idleTimeout == 0) {
+            return sem_wait(&m_sem) == 0;
+        }
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        unsigned long long nsec = deadline.tv_nsec + idleTimeout;
+        deadline.tv_sec += nsec / 1000000000ULL;
+        deadline.tv_nsec = nsec % 1000000000ULL;
+        while (sem_timedwait(&m_sem, &deadline) != 0) {
+            if (errno == ETIMEDOUT) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // 读取当前线程的CPU时间和在运行队列中等待的时间，读取失败时只返回CPU时间
+    static void ReadSchedStat(const int fd, unsigned long long &cpuNs, unsigned long long &runDelayNs)
+    {
+        char buff[128];
+        ssize_t len = fd == -1 ? -1 : pread(fd, buff, sizeof(buff) - 1, 0);
+        if (len > 0) {
+            buff[len] = '\0';
+            if (sscanf(buff, "%llu %llu", &cpuNs, &runDelayNs) == 2) {
+                return;
+            }
+        }
+        struct timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        cpuNs = static_cast<unsigned long long>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+        runDelayNs = 0;
+    }
+
+    static unsigned long long NowNs()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<unsigned long long>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+    }
+
     static void *ThreadFunction(void *arg)
     {
         ThreadPool *pool = reinterpret_cast<ThreadPool *>(arg);
@@ -103,32 +494,122 @@ private:
     }
     void Run()
     {
-        while (m_stop == false) {
-            if (sem_wait(&m_sem) != 0) {
+        if (m_threadInitFunction != nullptr) {
+            unsigned int threadIdx = 0;
+            (void)pthread_mutex_lock(&m_mutex);
+            threadIdx = m_threadSeq++;
+            (void)pthread_mutex_unlock(&m_mutex);
+            m_threadInitFunction(threadIdx, m_threadInitArg);
+        }
+        (void)pthread_mutex_lock(&m_mutex);
+        unsigned long long idleTimeout = IsElastic() ? m_idleTimeout : 0;
+        (void)pthread_mutex_unlock(&m_mutex);
+        // 运行时间减去CPU时间包括等待CPU的时间，CPU满载时不能算作阻塞，因此从schedstat中扣除运行队列等待时间
+        int schedStatFd = open("/proc/thread-self/schedstat", O_RDONLY | O_CLOEXEC);
+        unsigned int taskSeq = 0;
+        while (true) {
+            bool woken = WaitTask(idleTimeout);
+            if (pthread_mutex_lock(&m_mutex) != 0) {
                 continue;
             }
-            if (pthread_mutex_lock(&m_mutex) != 0) {
+            idleTimeout = IsElastic() ? m_idleTimeout : 0;
+            // 停止或线程数量被调小，当前线程退出
+            if (m_stop || m_liveThreadNum > m_threadNum) {
+                Retire();
+                (void)pthread_mutex_unlock(&m_mutex);
+                break;
+            }
+            if (!woken) {
+                // 空闲超时，线程数量多于下限时退出
+                if (IsElastic() && m_liveThreadNum > m_minThreadNum && m_queueSize == 0) {
+                    m_threadNum = m_liveThreadNum - 1;
+                    Retire();
+                    (void)pthread_mutex_unlock(&m_mutex);
+                    break;
+                }
+                (void)pthread_mutex_unlock(&m_mutex);
                 continue;
             }
 
-            if (m_queue.empty()) {
+            if (m_queueSize == 0) {
                 (void)pthread_mutex_unlock(&m_mutex);
                 continue;
             }
 
-            Task<T> task = m_queue.front();
-            m_queue.pop();
+            Lane &lane = SelectLane();
+            Task<T> task = lane.queue.front();
+            lane.queue.pop();
+            m_queueSize--;
+            unsigned long long now = NowNs();
+            unsigned long long queueWait = now - task.enqueueTime;
+            lane.dequeueCount++;
+            lane.waitTotalNs += queueWait;
+            if (queueWait > lane.waitMaxNs) {
+                lane.waitMaxNs = queueWait;
+            }
+            m_windowQueueWait += queueWait;
+            m_windowDequeueCount++;
+            HTTP_PROBE3(task_dequeue, task.probeId, task.lane, queueWait);
+            unsigned int createNum = CheckGrow(now);
+            bool measure = IsElastic() && ++taskSeq % THREAD_POOL_MEASURE_SAMPLE == 0;
+            unsigned long long maxQueueWait = m_maxQueueWait;
             (void)pthread_mutex_unlock(&m_mutex);
+            (void)CreateThreads(createNum);
+            // 排队时间过长的任务直接丢弃，避免过载时时延无限增长
+            if (maxQueueWait != 0 && task.dropFunction != nullptr && queueWait > maxQueueWait) {
+                task.dropFunction(&task.arg);
+                continue;
+            }
+            if (!measure) {
+                task.function(&task.arg);
+                continue;
+            }
+            // 抽样记录任务的运行时间和占用CPU或等待CPU的时间，差值为阻塞在磁盘、锁或网络上的时间
+            unsigned long long cpuStart = 0;
+            unsigned long long runDelayStart = 0;
+            ReadSchedStat(schedStatFd, cpuStart, runDelayStart);
+            unsigned long long wallStart = NowNs();
             task.function(&task.arg);
+            unsigned long long wallEnd = NowNs();
+            unsigned long long cpuEnd = 0;
+            unsigned long long runDelayEnd = 0;
+            ReadSchedStat(schedStatFd, cpuEnd, runDelayEnd);
+            m_windowTaskCpu += (cpuEnd - cpuStart) + (runDelayEnd - runDelayStart);
+            m_windowTaskWall += wallEnd - wallStart;
+        }
+        if (schedStatFd != -1) {
+            close(schedStatFd);
         }
     }
 private:
-    unsigned int m_threadNum;
-    pthread_t *m_threadPool { nullptr };
+    unsigned int m_threadNum; // 目标线程数量
+    unsigned int m_liveThreadNum { 0 }; // 当前存活的线程数量
+    unsigned int m_minThreadNum { 0 }; // 线程数量范围，下限不小于上限时线程数量固定
+    unsigned int m_maxThreadNum { 0 };
+    unsigned long long m_targetQueueWait { 0 }; // 目标排队时间，单位纳秒，0表示不增加线程
+    unsigned long long m_idleTimeout { 0 }; // 线程空闲超过该时间后退出，单位纳秒，0表示不退出
+    unsigned int m_cpuNum { 1 };
+    unsigned long long m_lastAdjustTime { 0 };
+    unsigned long long m_windowQueueWait { 0 }; // 本调整周期内出队任务的排队时间总和
+    unsigned long long m_windowDequeueCount { 0 };
+    std::atomic<unsigned long long> m_windowTaskWall { 0 }; // 本调整周期内任务的运行时间总和，任务执行时不持有锁
+    std::atomic<unsigned long long> m_windowTaskCpu { 0 }; // 包括在运行队列中等待CPU的时间
+    unsigned long long m_lastQueueWait { 0 };
+    unsigned int m_lastBlockedPercent { 0 };
+    unsigned long long m_growCount { 0 };
+    unsigned long long m_retireCount { 0 };
+    std::vector<pthread_t> m_threads; // 存活的线程
+    std::vector<pthread_t> m_exitedThreads; // 已退出、等待join的线程
     bool m_stop { false };
     bool m_initMutex { false };
     bool m_initSem { false };
-    std::queue<Task<T>> m_queue;
+    unsigned int m_maxQueuePerThread { 0 }; // 每个线程对应的队列长度上限，0表示不限制
+    unsigned long long m_maxQueueWait { 0 }; // 排队时间上限，单位纳秒，0表示不限制
+    ThreadInitFunction m_threadInitFunction { nullptr };
+    void *m_threadInitArg { nullptr };
+    unsigned int m_threadSeq { 0 }; // 已启动的线程数，用于分配threadIdx
+    std::vector<Lane> m_lanes;
+    unsigned int m_queueSize { 0 }; // 所有队列中的任务数
     pthread_mutex_t m_mutex;
     sem_t m_sem;
 };
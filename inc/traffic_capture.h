@@ -0,0 +1,71 @@
+#ifndef TRAFFIC_CAPTURE_H
+#define TRAFFIC_CAPTURE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <string>
+#include <atomic>
+
+// 抓包文件格式：文件头之后依次追加记录，每条记录为固定长度的记录头，DATA记录之后紧跟read收到的原始数据
+// 连接编号保留连接复用关系，一次read收到的多个请求保留为一条记录，traffic_replay按此回放
+extern const char TRAFFIC_CAPTURE_MAGIC[8];
+const uint32_t TRAFFIC_CAPTURE_VERSION = 1;
+
+enum TrafficCaptureRecordType : uint16_t {
+    TRAFFIC_CAPTURE_RECORD_OPEN = 1, // 接受连接
+    TRAFFIC_CAPTURE_RECORD_DATA = 2, // 一次read收到的数据
+    TRAFFIC_CAPTURE_RECORD_CLOSE = 3, // 连接关闭
+};
+
+struct TrafficCaptureFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t baseRealtime; // 开始抓包时的CLOCK_REALTIME，单位纳秒
+};
+
+struct TrafficCaptureRecord {
+    uint16_t type;
+    uint16_t reserved;
+    uint32_t connection; // 从1开始编号，套接字复用时编号不同
+    uint64_t time; // 距开始抓包的纳秒数，CLOCK_MONOTONIC
+    uint32_t length; // 记录头之后的数据长度
+    uint32_t reserved2;
+};
+
+// 所有线程共用一个缓冲区，加锁后追加；缓冲区满或定时器触发时由后台线程换出缓冲区，在锁外写入文件，
+// 读数据的线程不等待磁盘；文件达到最大长度或写入跟不上时停止抓包
+class TrafficCapture {
+public:
+    // path为空时不抓包，只在启动时调用一次
+    static bool Init(const std::string &path, const unsigned long long maxSize);
+    static bool IsEnabled()
+    {
+        return m_enabled.load(std::memory_order_relaxed);
+    }
+    static uint32_t Open(); // 返回连接编号，没有抓包时返回0
+    static void Data(const uint32_t connection, const char *data, const size_t len);
+    static void Close(const uint32_t connection);
+    static void Flush(); // 通知后台线程写入已有的记录，不等待写完
+    // 停止抓包，等后台线程把剩余的记录写入文件后关闭文件，退出时调用
+    static void Stop();
+private:
+    static void Append(const uint16_t type, const uint32_t connection, const char *data, const size_t len);
+    static void *WriterThread(void *arg);
+    static bool Write(const char *data, const size_t len);
+private:
+    static std::atomic<bool> m_enabled;
+    static std::atomic<uint32_t> m_nextConnection;
+    static int m_fd;
+    static unsigned long long m_maxSize;
+    static unsigned long long m_fileSize; // 已写入文件和缓冲区中的总长度
+    static unsigned long long m_baseTime;
+    static std::string m_buffer; // 等待写入文件的记录
+    static bool m_flushRequested; // 以下受锁保护
+    static bool m_stop;
+    static bool m_writerStarted;
+    static pthread_t m_writer;
+};
+
+#endif
\ No newline at end of file
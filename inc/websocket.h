@@ -0,0 +1,146 @@
+#ifndef WEBSOCKET_H
+#define WEBSOCKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <utility>
+
+const unsigned int WEBSOCKET_VERSION = 13;
+const unsigned int WEBSOCKET_ACCEPT_LEN = 28; // SHA-1摘要的base64编码长度
+const unsigned int WEBSOCKET_MASK_LEN = 4;
+const unsigned int WEBSOCKET_MAX_HEADER_LEN = 14; // 2字节基本头部 + 8字节扩展长度 + 4字节掩码
+const unsigned int WEBSOCKET_MAX_CONTROL_PAYLOAD_LEN = 125;
+const unsigned int WEBSOCKET_READ_BUFF_LEN = 64 * 1024; // 事件循环线程共用的读缓冲区大小
+
+enum WebSocketOpcode : unsigned char {
+    WEBSOCKET_OPCODE_CONTINUATION = 0x0,
+    WEBSOCKET_OPCODE_TEXT = 0x1,
+    WEBSOCKET_OPCODE_BINARY = 0x2,
+    WEBSOCKET_OPCODE_CLOSE = 0x8,
+    WEBSOCKET_OPCODE_PING = 0x9,
+    WEBSOCKET_OPCODE_PONG = 0xA,
+};
+
+enum WebSocketCloseCode : unsigned short {
+    WEBSOCKET_CLOSE_CODE_NORMAL = 1000,
+    WEBSOCKET_CLOSE_CODE_GOING_AWAY = 1001, // 服务端平滑升级或退出
+    WEBSOCKET_CLOSE_CODE_PROTOCOL_ERROR = 1002,
+    WEBSOCKET_CLOSE_CODE_POLICY_VIOLATION = 1008, // 客户端接收过慢，待发送数据超过上限
+    WEBSOCKET_CLOSE_CODE_MESSAGE_TOO_BIG = 1009,
+};
+
+// 处理一次事件后连接接下来的状态，由事件循环线程转换为需要监听的事件
+enum WebSocketEventResult : unsigned char {
+    WEBSOCKET_EVENT_RESULT_READ = 0, // 只需要监听读事件
+    WEBSOCKET_EVENT_RESULT_WRITE = 1, // 有未发送完的数据，同时监听写事件
+    WEBSOCKET_EVENT_RESULT_CLOSE = 2, // 关闭连接
+};
+
+// 握手、帧头编解码和掩码处理，与连接状态无关
+class WebSocketCodec {
+public:
+    // accept的长度至少为WEBSOCKET_ACCEPT_LEN + 1，结果以结束符结尾
+    static void ComputeAccept(const char *key, char *accept);
+    // 客户端发来的数据带有4字节掩码，原地异或；长度是4的倍数的分段使用SIMD，掩码相位不变
+    static void Unmask(char *data, const size_t len, const unsigned char *mask);
+    // 返回帧头长度，服务端发出的帧不带掩码
+    static unsigned int EncodeHeader(const WebSocketOpcode opcode, const bool fin, const uint64_t payloadLen,
+        unsigned char *header);
+};
+
+class WebSocketConnection;
+
+// 消息处理接口，所有回调都在事件循环线程中执行，不能阻塞；只能在回调中调用连接的Send
+class WebSocketHandler {
+public:
+    virtual ~WebSocketHandler() {}
+    virtual void OnOpen(WebSocketConnection &connection)
+    {
+        (void)connection;
+    }
+    // 分片的消息合并后回调一次，opcode为TEXT或BINARY，文本消息不校验UTF-8
+    virtual void OnMessage(WebSocketConnection &connection, const WebSocketOpcode opcode, const char *data,
+        const size_t len) = 0;
+    // 连接释放前回调，此时已不能发送
+    virtual void OnClose(WebSocketConnection &connection)
+    {
+        (void)connection;
+    }
+};
+
+typedef struct {
+    std::string prefix; // URL前缀
+    WebSocketHandler *handler;
+} WebSocketRoute;
+
+extern const char *WEBSOCKET_HANDLER_ECHO_NAME;
+
+// 按URL前缀选择处理接口，处理接口按名称注册，内置echo
+class WebSocketRouter {
+public:
+    WebSocketRouter();
+    ~WebSocketRouter();
+    bool Init(const std::string &routes);
+    WebSocketHandler *Match(const char *url, const size_t urlLen) const; // 没有匹配的前缀时返回空
+    bool HasRoutes() const;
+    // 在加载配置之前调用，处理接口由调用方持有，进程退出前不能释放
+    static bool RegisterHandler(const std::string &name, WebSocketHandler *handler);
+    // 解析"前缀:处理接口名称"的列表，以逗号分隔，例如"/ws/echo:echo,/ws/metrics:metrics"
+    static bool ParseRoutes(const std::string &value, std::vector<WebSocketRoute> &routes);
+private:
+    static std::vector<std::pair<std::string, WebSocketHandler *>> &GetHandlers();
+private:
+    std::vector<WebSocketRoute> m_routes;
+};
+
+// 升级后的连接状态，只在事件循环线程中访问
+// 读取时使用调用方提供的共用缓冲区，只有不完整的帧才复制到连接自己的缓冲区，空闲连接不占用读写缓冲区
+// 发送时帧头和消息体通过一次sendmsg直接交给内核，只有发送不完的部分才复制到待发送缓冲区
+class WebSocketConnection {
+public:
+    WebSocketConnection(const int socketId, WebSocketHandler *handler, const size_t maxMessageLen);
+    ~WebSocketConnection();
+    WebSocketEventResult Open();
+    bool IsOpened() const;
+    // buffer为事件循环线程的共用读缓冲区
+    WebSocketEventResult OnReadable(char *buffer, const size_t bufferLen);
+    WebSocketEventResult OnWritable();
+    // 空闲超过ping间隔时调用：没有未回应的ping时发送ping，已发送的ping仍无回应时返回CLOSE
+    WebSocketEventResult KeepAlive();
+    // 发送关闭帧，发送完成后关闭连接
+    WebSocketEventResult Close(const WebSocketCloseCode code);
+    // 发送一条完整的消息，连接正在关闭或待发送数据超过上限时返回false
+    bool Send(const WebSocketOpcode opcode, const char *data, const size_t len);
+    int GetSocketId() const;
+    void SetUserData(void *userData);
+    void *GetUserData() const;
+    // 当前注册到epoll的事件，由事件循环线程维护，避免每次事件都调用epoll_ctl
+    void SetEvents(const unsigned int events);
+    unsigned int GetEvents() const;
+private:
+    bool ProcessFrames(char *data, const size_t len, size_t &consumed);
+    bool HandleFrame(const WebSocketOpcode opcode, const bool fin, char *payload, const size_t payloadLen);
+    bool SendFrame(const WebSocketOpcode opcode, const char *data, const size_t len);
+    void Fail(const WebSocketCloseCode code);
+    WebSocketEventResult GetResult() const;
+private:
+    int m_socketId;
+    WebSocketHandler *m_handler;
+    size_t m_maxMessageLen;
+    size_t m_maxPendingLen; // 待发送数据上限，超过时认为客户端接收过慢并关闭连接
+    bool m_opened { false };
+    bool m_closing { false }; // 已发送关闭帧，待发送数据发送完后关闭连接
+    bool m_broken { false }; // 套接字出错，直接关闭连接
+    bool m_pingPending { false }; // 已发送ping，还没有收到任何数据
+    WebSocketOpcode m_messageOpcode { WEBSOCKET_OPCODE_CONTINUATION }; // 正在接收的分片消息类型
+    std::string m_message; // 已收到的分片
+    std::string m_partial; // 不完整的帧
+    std::string m_pending; // 未发送完的数据
+    size_t m_pendingOffset { 0 }; // m_pending中已发送的长度
+    unsigned int m_events { 0 };
+    void *m_userData { nullptr }; // 供处理接口保存连接相关的状态
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,327 @@
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <vector>
+#include "access_log.h"
+
+const char ACCESS_LOG_MAGIC[8] = { 'H', 'T', 'T', 'P', 'A', 'L', 'O', 'G' };
+const unsigned int ACCESS_LOG_STRING_TABLE_SIZE = 4096; // 必须是2的幂
+const unsigned int ACCESS_LOG_MAX_STRING_LEN = 2048; // 超过部分截断
+const char * const ACCESS_LOG_EMPTY_STRING = "-";
+
+const char *ACCESS_LOG_METHOD_NAME_LIST[ACCESS_LOG_METHOD_NUM] = {
+    "-", "GET", "HEAD", "POST", "PUT", "DELETE",
+};
+
+std::atomic<bool> AccessLog::m_enabled { false };
+std::string AccessLog::m_dir;
+unsigned long long AccessLog::m_fileSize { 0 };
+unsigned int AccessLog::m_fileNum { 0 };
+
+static inline uint64_t AlignEntry(const uint64_t size)
+{
+    return (size + ACCESS_LOG_ENTRY_ALIGN - 1) & ~static_cast<uint64_t>(ACCESS_LOG_ENTRY_ALIGN - 1);
+}
+
+static inline uint32_t SpanUs(const unsigned long long from, const unsigned long long to)
+{
+    if (from == 0 || to < from) {
+        return 0;
+    }
+    unsigned long long us = (to - from) / 1000;
+    return us > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(us);
+}
+
+// 一个写入者同时只属于一个线程，持有当前文件的映射和已写入字符串的索引
+// 字符串索引按哈希直接映射，冲突时覆盖旧的，最多导致同一字符串在文件中多写一次
+class AccessLog::Writer {
+public:
+    Writer(const unsigned int index) : m_index(index) {}
+    void Append(const AccessLogEntry &entry);
+    bool owned { false }; // 有线程正在使用，线程退出后可以被新线程复用
+private:
+    struct StringSlot {
+        uint32_t hash;
+        uint32_t offset; // 0表示空
+    };
+    bool OpenFile();
+    void CloseFile();
+    void GetPath(const unsigned long long seq, char *path, const size_t pathLen) const;
+    uint32_t FindString(const char *data, const size_t len, const uint32_t hash) const;
+    uint32_t AddString(const char *data, const size_t len, const uint32_t hash);
+    void Publish();
+private:
+    unsigned int m_index;
+    unsigned long long m_seq { 0 }; // 下一个文件的序号
+    bool m_failed { false }; // 创建文件失败后不再写入，避免每个请求都打印错误
+    int m_fd { -1 };
+    char *m_base { nullptr };
+    uint64_t m_offset { 0 }; // 下一个条目的写入位置
+    StringSlot m_strings[ACCESS_LOG_STRING_TABLE_SIZE] { };
+};
+
+void AccessLog::Writer::GetPath(const unsigned long long seq, char *path, const size_t pathLen) const
+{
+    (void)snprintf(path, pathLen, "%s/access.%d.%u.%06llu.alog", m_dir.c_str(), static_cast<int>(getpid()),
+        m_index, seq);
+}
+
+// 新文件按配置大小创建为稀疏文件，只有写入的页占用磁盘；超过保留数量时删除该写入者最早的文件
+bool AccessLog::Writer::OpenFile()
+{
+    char path[PATH_MAX];
+    GetPath(m_seq, path, sizeof(path));
+    m_fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (m_fd == -1) {
+        printf("ERROR Open access log fail: %s, errno = %d.\n", path, errno);
+        return false;
+    }
+    if (ftruncate(m_fd, m_fileSize) == -1) {
+        printf("ERROR Resize access log fail: %s, errno = %d.\n", path, errno);
+        CloseFile();
+        return false;
+    }
+    void *addr = mmap(nullptr, m_fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (addr == MAP_FAILED) {
+        printf("ERROR Map access log fail: %s, errno = %d.\n", path, errno);
+        CloseFile();
+        return false;
+    }
+    m_base = reinterpret_cast<char *>(addr);
+    AccessLogFileHeader *header = reinterpret_cast<AccessLogFileHeader *>(m_base);
+    memcpy(header->magic, ACCESS_LOG_MAGIC, sizeof(header->magic));
+    header->version = ACCESS_LOG_VERSION;
+    header->headerSize = sizeof(AccessLogFileHeader);
+    header->pid = static_cast<uint32_t>(getpid());
+    header->writer = m_index;
+    header->seq = m_seq;
+    struct timespec realtime;
+    clock_gettime(CLOCK_REALTIME, &realtime);
+    header->baseRealtime = static_cast<uint64_t>(realtime.tv_sec) * 1000000000ULL + realtime.tv_nsec;
+    header->baseMonotonic = Now();
+    header->fileSize = m_fileSize;
+    m_offset = AlignEntry(sizeof(AccessLogFileHeader));
+    memset(m_strings, 0, sizeof(m_strings));
+    Publish();
+    if (m_seq >= m_fileNum) {
+        GetPath(m_seq - m_fileNum, path, sizeof(path));
+        (void)unlink(path);
+    }
+    m_seq++;
+    return true;
+}
+
+// 换文件时把旧文件截断到实际写入的长度
+void AccessLog::Writer::CloseFile()
+{
+    if (m_base != nullptr) {
+        (void)munmap(m_base, m_fileSize);
+        m_base = nullptr;
+        (void)ftruncate(m_fd, m_offset);
+    }
+    if (m_fd != -1) {
+        (void)close(m_fd);
+        m_fd = -1;
+    }
+}
+
+// 条目内容写完后才更新dataEnd，读取正在写入的文件时不会读到不完整的条目
+void AccessLog::Writer::Publish()
+{
+    AccessLogFileHeader *header = reinterpret_cast<AccessLogFileHeader *>(m_base);
+    __atomic_store_n(&header->dataEnd, m_offset, __ATOMIC_RELEASE);
+}
+
+uint32_t AccessLog::Writer::FindString(const char *data, const size_t len, const uint32_t hash) const
+{
+    const StringSlot &slot = m_strings[hash & (ACCESS_LOG_STRING_TABLE_SIZE - 1)];
+    if (slot.offset == 0 || slot.hash != hash) {
+        return 0;
+    }
+    const AccessLogString *str = reinterpret_cast<const AccessLogString *>(m_base + slot.offset);
+    if (str->head.size - sizeof(AccessLogString) != len || memcmp(str->data, data, len) != 0) {
+        return 0;
+    }
+    return slot.offset;
+}
+
+// 调用前已确认剩余空间足够
+uint32_t AccessLog::Writer::AddString(const char *data, const size_t len, const uint32_t hash)
+{
+    uint32_t offset = static_cast<uint32_t>(m_offset);
+    AccessLogString *str = reinterpret_cast<AccessLogString *>(m_base + m_offset);
+    str->head.type = ACCESS_LOG_ENTRY_STRING;
+    str->head.size = static_cast<uint16_t>(sizeof(AccessLogString) + len);
+    str->hash = hash;
+    memcpy(str->data, data, len);
+    m_offset += AlignEntry(sizeof(AccessLogString) + len);
+    StringSlot &slot = m_strings[hash & (ACCESS_LOG_STRING_TABLE_SIZE - 1)];
+    slot.hash = hash;
+    slot.offset = offset;
+    return offset;
+}
+
+void AccessLog::Writer::Append(const AccessLogEntry &entry)
+{
+    if (m_failed) {
+        return;
+    }
+    const char *url = entry.url != nullptr && entry.url[0] != '\0' ? entry.url : ACCESS_LOG_EMPTY_STRING;
+    const char *peer = entry.peer != nullptr && entry.peer[0] != '\0' ? entry.peer : ACCESS_LOG_EMPTY_STRING;
+    size_t urlLen = strnlen(url, ACCESS_LOG_MAX_STRING_LEN);
+    size_t peerLen = strnlen(peer, ACCESS_LOG_MAX_STRING_LEN);
+    uint32_t urlHash = HashString(url, urlLen);
+    uint32_t peerHash = HashString(peer, peerLen);
+    uint32_t urlOffset = 0;
+    uint32_t peerOffset = 0;
+    // 当前文件放不下时换新文件，新文件的字符串索引为空，两个字符串都要重新写入
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        if (m_base == nullptr && !OpenFile()) {
+            m_failed = true;
+            return;
+        }
+        urlOffset = FindString(url, urlLen, urlHash);
+        peerOffset = FindString(peer, peerLen, peerHash);
+        uint64_t need = AlignEntry(sizeof(AccessLogRecord));
+        need += urlOffset == 0 ? AlignEntry(sizeof(AccessLogString) + urlLen) : 0;
+        need += peerOffset == 0 ? AlignEntry(sizeof(AccessLogString) + peerLen) : 0;
+        if (m_offset + need <= m_fileSize) {
+            break;
+        }
+        CloseFile();
+        if (attempt == 1) {
+            printf("ERROR access_log_file_size is too small for one record.\n");
+            m_failed = true;
+            return;
+        }
+    }
+    if (urlOffset == 0) {
+        urlOffset = AddString(url, urlLen, urlHash);
+    }
+    if (peerOffset == 0) {
+        peerOffset = AddString(peer, peerLen, peerHash);
+    }
+    const unsigned long long *time = entry.info->time;
+    AccessLogRecord *record = reinterpret_cast<AccessLogRecord *>(m_base + m_offset);
+    record->head.type = ACCESS_LOG_ENTRY_RECORD;
+    record->head.size = sizeof(AccessLogRecord);
+    record->status = static_cast<uint16_t>(entry.status);
+    record->method = GetMethod(entry.method);
+    record->flags = entry.flags;
+    record->startTime = time[TRACE_POINT_READ];
+    record->urlHash = urlHash;
+    record->urlOffset = urlOffset;
+    record->peerOffset = peerOffset;
+    record->bytes = entry.bytes;
+    record->totalUs = SpanUs(time[TRACE_POINT_READ], time[TRACE_POINT_LAST_BYTE]);
+    record->queueUs = SpanUs(time[TRACE_POINT_ENQUEUE], time[TRACE_POINT_WORKER_START]);
+    record->handleUs = SpanUs(time[TRACE_POINT_PARSE_END], time[TRACE_POINT_HANDLE_END]);
+    record->sendUs = SpanUs(time[TRACE_POINT_FIRST_BYTE], time[TRACE_POINT_LAST_BYTE]);
+    m_offset += AlignEntry(sizeof(AccessLogRecord));
+    Publish();
+}
+
+bool AccessLog::Init(const std::string &dir, const unsigned long long fileSize, const unsigned int fileNum)
+{
+    if (dir.empty()) {
+        return true;
+    }
+    if (access(dir.c_str(), W_OK) == -1) {
+        printf("ERROR access_log_dir is not writable: %s.\n", dir.c_str());
+        return false;
+    }
+    m_dir = dir;
+    m_fileSize = fileSize;
+    m_fileNum = fileNum;
+    m_enabled.store(true, std::memory_order_relaxed);
+    printf("EVENT  Access log enabled, dir = %s, file size = %llu, files per writer = %u.\n", dir.c_str(), fileSize,
+        fileNum);
+    return true;
+}
+
+unsigned long long AccessLog::Now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<unsigned long long>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+// 写入者和请求追踪的缓冲区一样在进程退出前不释放，线程退出后交给新线程继续写同一个文件
+AccessLog::Writer *AccessLog::GetWriter()
+{
+    static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    static std::vector<Writer *> writers;
+    struct WriterHolder {
+        Writer *writer { nullptr };
+        ~WriterHolder()
+        {
+            if (writer != nullptr) {
+                (void)pthread_mutex_lock(&mutex);
+                writer->owned = false;
+                (void)pthread_mutex_unlock(&mutex);
+            }
+        }
+    };
+    static thread_local WriterHolder holder;
+    if (holder.writer != nullptr) {
+        return holder.writer;
+    }
+    (void)pthread_mutex_lock(&mutex);
+    for (Writer *writer : writers) {
+        if (!writer->owned) {
+            holder.writer = writer;
+            break;
+        }
+    }
+    if (holder.writer == nullptr) {
+        holder.writer = new Writer(static_cast<unsigned int>(writers.size()));
+        writers.push_back(holder.writer);
+    }
+    holder.writer->owned = true;
+    (void)pthread_mutex_unlock(&mutex);
+    return holder.writer;
+}
+
+void AccessLog::Append(const AccessLogEntry &entry)
+{
+    if (!IsEnabled()) {
+        return;
+    }
+    GetWriter()->Append(entry);
+}
+
+AccessLogMethod AccessLog::GetMethod(const char *method)
+{
+    if (method == nullptr) {
+        return ACCESS_LOG_METHOD_OTHER;
+    }
+    for (unsigned int i = ACCESS_LOG_METHOD_GET; i < ACCESS_LOG_METHOD_NUM; ++i) {
+        if (strcmp(method, ACCESS_LOG_METHOD_NAME_LIST[i]) == 0) {
+            return static_cast<AccessLogMethod>(i);
+        }
+    }
+    return ACCESS_LOG_METHOD_OTHER;
+}
+
+const char *AccessLog::GetMethodName(const uint8_t method)
+{
+    return ACCESS_LOG_METHOD_NAME_LIST[method < ACCESS_LOG_METHOD_NUM ? method : ACCESS_LOG_METHOD_OTHER];
+}
+
+// FNV-1a
+uint32_t AccessLog::HashString(const char *data, const size_t len)
+{
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 16777619U;
+    }
+    return hash;
+}
\ No newline at end of file
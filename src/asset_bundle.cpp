@@ -0,0 +1,165 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include "asset_bundle.h"
+
+const char ASSET_BUNDLE_MAGIC[8] = { 'H', 'T', 'T', 'P', 'B', 'N', 'D', 'L' };
+const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+const uint64_t FNV_PRIME = 0x100000001b3ULL;
+const unsigned int HASH_TAG_SHIFT = 32;
+
+AssetBundle::AssetBundle()
+{}
+
+AssetBundle::~AssetBundle()
+{
+    Close();
+}
+
+bool AssetBundle::Open(const std::string &path)
+{
+    Close();
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        printf("ERROR Open asset bundle fail: %s.\n", path.c_str());
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) == -1 || fileStat.st_size < static_cast<off_t>(sizeof(AssetBundleHeader))) {
+        printf("ERROR Invalid asset bundle: %s.\n", path.c_str());
+        close(fd);
+        return false;
+    }
+    void *addr = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        printf("ERROR mmap asset bundle fail: %s.\n", path.c_str());
+        return false;
+    }
+    m_base = reinterpret_cast<const char *>(addr);
+    m_size = fileStat.st_size;
+    m_header = reinterpret_cast<const AssetBundleHeader *>(m_base);
+    if (!Check()) {
+        printf("ERROR Invalid asset bundle: %s.\n", path.c_str());
+        Close();
+        return false;
+    }
+    m_slots = reinterpret_cast<const AssetBundleSlot *>(m_base + m_header->slotOffset);
+    m_entries = reinterpret_cast<const AssetBundleEntry *>(m_base + m_header->entryOffset);
+    m_paths = m_base + m_header->pathOffset;
+    // 资源包会被频繁随机访问，提示内核预读整个文件
+    (void)madvise(addr, m_size, MADV_WILLNEED);
+    return true;
+}
+
+// 只校验各区域的边界，变体的偏移在查找命中后使用，打包工具保证其合法
+bool AssetBundle::Check() const
+{
+    const AssetBundleHeader *header = m_header;
+    if (memcmp(header->magic, ASSET_BUNDLE_MAGIC, sizeof(ASSET_BUNDLE_MAGIC)) != 0 ||
+        header->version != ASSET_BUNDLE_VERSION || header->fileSize != m_size) {
+        return false;
+    }
+    if (header->slotNum == 0 || (header->slotNum & (header->slotNum - 1)) != 0 ||
+        header->entryNum >= header->slotNum) {
+        return false;
+    }
+    if (header->slotOffset + static_cast<uint64_t>(header->slotNum) * sizeof(AssetBundleSlot) > m_size ||
+        header->entryOffset + static_cast<uint64_t>(header->entryNum) * sizeof(AssetBundleEntry) > m_size ||
+        header->pathOffset > m_size || header->dataOffset > m_size) {
+        return false;
+    }
+    const AssetBundleEntry *entries = reinterpret_cast<const AssetBundleEntry *>(m_base + header->entryOffset);
+    for (uint32_t i = 0; i < header->entryNum; ++i) {
+        if (header->pathOffset + entries[i].pathOffset + entries[i].pathLen > m_size ||
+            entries[i].etag[ASSET_BUNDLE_ETAG_LEN - 1] != '\0') {
+            return false;
+        }
+        for (unsigned int j = 0; j < ASSET_VARIANT_NUM; ++j) {
+            const AssetBundleVariant &variant = entries[i].variants[j];
+            if (variant.length != 0 && (variant.offset < header->dataOffset || variant.offset + variant.length > m_size ||
+                variant.bodyLength > variant.length)) {
+                return false;
+            }
+        }
+        if (entries[i].variants[ASSET_VARIANT_INDEX_IDENTITY].length == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void AssetBundle::Close()
+{
+    if (m_base != nullptr) {
+        munmap(const_cast<char *>(m_base), m_size);
+    }
+    m_base = nullptr;
+    m_size = 0;
+    m_header = nullptr;
+    m_slots = nullptr;
+    m_entries = nullptr;
+    m_paths = nullptr;
+}
+
+bool AssetBundle::IsOpen() const
+{
+    return m_base != nullptr;
+}
+
+const AssetBundleEntry *AssetBundle::Find(const char *path, const size_t pathLen) const
+{
+    if (m_base == nullptr) {
+        return nullptr;
+    }
+    uint64_t hash = HashPath(path, pathLen);
+    uint32_t hashTag = static_cast<uint32_t>(hash >> HASH_TAG_SHIFT);
+    uint32_t mask = m_header->slotNum - 1;
+    // 打包时保证至少有一个空槽，线性探测一定会结束
+    for (uint32_t slotIdx = static_cast<uint32_t>(hash) & mask; ; slotIdx = (slotIdx + 1) & mask) {
+        const AssetBundleSlot &slot = m_slots[slotIdx];
+        if (slot.entryIdx == ASSET_BUNDLE_EMPTY_SLOT) {
+            return nullptr;
+        }
+        if (slot.hashTag != hashTag || slot.entryIdx > m_header->entryNum) {
+            continue;
+        }
+        const AssetBundleEntry *entry = &m_entries[slot.entryIdx - 1];
+        if (entry->pathHash == hash && entry->pathLen == pathLen &&
+            memcmp(m_paths + entry->pathOffset, path, pathLen) == 0) {
+            return entry;
+        }
+    }
+}
+
+const AssetBundleVariant &AssetBundle::GetVariant(const AssetBundleEntry *entry, const bool acceptGzip) const
+{
+    if (acceptGzip && entry->variants[ASSET_VARIANT_INDEX_GZIP].length != 0) {
+        return entry->variants[ASSET_VARIANT_INDEX_GZIP];
+    }
+    return entry->variants[ASSET_VARIANT_INDEX_IDENTITY];
+}
+
+const char *AssetBundle::GetData(const AssetBundleVariant &variant) const
+{
+    return m_base + variant.offset;
+}
+
+uint32_t AssetBundle::GetEntryNum() const
+{
+    return m_header == nullptr ? 0 : m_header->entryNum;
+}
+
+// FNV-1a，打包工具和服务端使用同一个实现
+uint64_t AssetBundle::HashPath(const char *path, const size_t pathLen)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < pathLen; ++i) {
+        hash ^= static_cast<unsigned char>(path[i]);
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include <stdlib.h>
+#include "buffer_pool.h"
+
+BufferPool::BufferPool()
+{
+    pthread_mutex_init(&m_mutex, nullptr);
+}
+
+BufferPool::~BufferPool()
+{
+    ClearFreeList();
+    pthread_mutex_destroy(&m_mutex);
+}
+
+void BufferPool::Init(const size_t bufferSize, const unsigned int maxFreeNum)
+{
+    pthread_mutex_lock(&m_mutex);
+    m_maxFreeNum = maxFreeNum;
+    pthread_mutex_unlock(&m_mutex);
+    SetBufferSize(bufferSize);
+}
+
+void BufferPool::SetBufferSize(const size_t bufferSize)
+{
+    size_t size = bufferSize < sizeof(FreeBuffer) ? sizeof(FreeBuffer) : bufferSize;
+    pthread_mutex_lock(&m_mutex);
+    bool changed = size != m_bufferSize;
+    m_bufferSize = size;
+    pthread_mutex_unlock(&m_mutex);
+    if (changed) {
+        ClearFreeList();
+    }
+}
+
+char *BufferPool::Acquire(const size_t bufferSize)
+{
+    pthread_mutex_lock(&m_mutex);
+    if (bufferSize == m_bufferSize && m_freeList != nullptr) {
+        FreeBuffer *buffer = m_freeList;
+        m_freeList = buffer->next;
+        m_freeNum--;
+        pthread_mutex_unlock(&m_mutex);
+        return reinterpret_cast<char *>(buffer);
+    }
+    pthread_mutex_unlock(&m_mutex);
+    return reinterpret_cast<char *>(malloc(bufferSize < sizeof(FreeBuffer) ? sizeof(FreeBuffer) : bufferSize));
+}
+
+void BufferPool::Release(char *buffer, const size_t bufferSize)
+{
+    if (buffer == nullptr) {
+        return;
+    }
+    pthread_mutex_lock(&m_mutex);
+    if (bufferSize == m_bufferSize && m_freeNum < m_maxFreeNum) {
+        FreeBuffer *freeBuffer = reinterpret_cast<FreeBuffer *>(buffer);
+        freeBuffer->next = m_freeList;
+        m_freeList = freeBuffer;
+        m_freeNum++;
+        pthread_mutex_unlock(&m_mutex);
+        return;
+    }
+    pthread_mutex_unlock(&m_mutex);
+    free(buffer);
+}
+
+unsigned int BufferPool::GetFreeNum() const
+{
+    pthread_mutex_lock(&m_mutex);
+    unsigned int freeNum = m_freeNum;
+    pthread_mutex_unlock(&m_mutex);
+    return freeNum;
+}
+
+void BufferPool::ClearFreeList()
+{
+    pthread_mutex_lock(&m_mutex);
+    FreeBuffer *freeList = m_freeList;
+    m_freeList = nullptr;
+    m_freeNum = 0;
+    pthread_mutex_unlock(&m_mutex);
+    while (freeList != nullptr) {
+        FreeBuffer *buffer = freeList;
+        freeList = buffer->next;
+        free(buffer);
+    }
+}
\ No newline at end of file
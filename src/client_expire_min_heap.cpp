@@ -3,6 +3,7 @@
 
 const unsigned int MAX_U32 = 0xFFFFFFFF;
 const unsigned int ROOT_NODE_INDEX = 0; // 根节点下标为0
+const unsigned int INVALID_HEAP_INDEX = MAX_U32; // 套接字不在堆中
 
 ClientExpireMinHeap::ClientExpireMinHeap()
 {}
@@ -19,6 +20,7 @@ bool ClientExpireMinHeap::Init(unsigned int capacity)
 {
     m_currentSize = 0;
     m_capacity = 0;
+    m_socketHeapIdx.clear();
     if (m_heap != nullptr) {
         delete []m_heap;
         m_heap = nullptr;
@@ -62,7 +64,7 @@ void ClientExpireMinHeap::SiftDown(const unsigned int startIdx)
 
     unsigned int currentIdx = startIdx; // 记录目标节点当前位置下标
     unsigned int childIdx = currentIdx * 2 + 1; // 记录目标节点的较小子节点位置下标，一开始先指向左节点
-    const ClientExpire &value = m_heap[startIdx];
+    ClientExpire value = m_heap[startIdx]; // 下沉过程中startIdx位置会被覆盖，需要拷贝
 
     while (childIdx < m_currentSize) {
         if (childIdx < m_currentSize - 1) {
@@ -70,16 +72,16 @@ void ClientExpireMinHeap::SiftDown(const unsigned int startIdx)
                 childIdx++;
             }
         }
-        if (m_heap[childIdx].expire >= m_heap[currentIdx].expire) {
+        if (m_heap[childIdx].expire >= value.expire) {
             break;
         }
         m_heap[currentIdx] = m_heap[childIdx];
-        m_socketAndHeapIdxMap[m_heap[childIdx].clientFd] = currentIdx;
+        SetHeapIdx(m_heap[childIdx].clientFd, currentIdx);
         currentIdx = childIdx;
         childIdx = currentIdx * 2 + 1; // 记录目标节点的较小子节点位置下标，一开始先指向左节点
     }
     m_heap[currentIdx] = value;
-    m_socketAndHeapIdxMap[value.clientFd] = currentIdx;
+    SetHeapIdx(value.clientFd, currentIdx);
 }
 
 void ClientExpireMinHeap::SiftUp(const unsigned int startIdx)
@@ -97,11 +99,11 @@ void ClientExpireMinHeap::SiftUp(const unsigned int startIdx)
             break;
         }
         m_heap[currentIdx] = m_heap[parentIdx];
-        m_socketAndHeapIdxMap[m_heap[parentIdx].clientFd] = currentIdx;
+        SetHeapIdx(m_heap[parentIdx].clientFd, currentIdx);
         currentIdx = parentIdx;
     }
     m_heap[currentIdx] = value;
-    m_socketAndHeapIdxMap[value.clientFd] = currentIdx;
+    SetHeapIdx(value.clientFd, currentIdx);
 }
 
 bool ClientExpireMinHeap::Resize()
@@ -141,12 +143,12 @@ bool ClientExpireMinHeap::Push(const ClientExpire &node)
         }
     }
 
-    std::pair<int, unsigned int> socketAndHeapIdxPair(node.clientFd, m_currentSize);
-    auto ret = m_socketAndHeapIdxMap.insert(socketAndHeapIdxPair);
-    if (!ret.second) {
+    unsigned int heapIdx;
+    if (node.clientFd < 0 || GetHeapIdx(node.clientFd, heapIdx)) {
         printf("ERROR  socket id already exits.\n");
         return false;
     }
+    SetHeapIdx(node.clientFd, m_currentSize);
     m_heap[m_currentSize] = node;
     SiftUp(m_currentSize);
     ++m_currentSize;
@@ -160,9 +162,9 @@ bool ClientExpireMinHeap::Pop(ClientExpire &node)
     }
 
     node = m_heap[ROOT_NODE_INDEX];
-    m_socketAndHeapIdxMap.erase(node.clientFd);
     m_heap[ROOT_NODE_INDEX] = m_heap[m_currentSize - 1]; // 将最后一个元素移到根节点
-    m_socketAndHeapIdxMap[m_heap[ROOT_NODE_INDEX].clientFd] = ROOT_NODE_INDEX;
+    SetHeapIdx(m_heap[ROOT_NODE_INDEX].clientFd, ROOT_NODE_INDEX);
+    SetHeapIdx(node.clientFd, INVALID_HEAP_INDEX);
     m_currentSize--;
     SiftDown(ROOT_NODE_INDEX);
     return true;
@@ -181,12 +183,11 @@ bool ClientExpireMinHeap::Top(ClientExpire &node)
 bool ClientExpireMinHeap::Modify(const ClientExpire &node)
 {
     int clientFd = node.clientFd;
-    auto iter = m_socketAndHeapIdxMap.find(clientFd);
-    if (iter == m_socketAndHeapIdxMap.end()) {
+    unsigned int heapIdx;
+    if (!GetHeapIdx(clientFd, heapIdx)) {
         printf("ERROR client[%d] not find.\n", clientFd);
         return false;
     }
-    unsigned int heapIdx = iter->second;
     time_t oldExpire = m_heap[heapIdx].expire;
     m_heap[heapIdx].expire = node.expire;
     // 调整位置
@@ -200,16 +201,15 @@ bool ClientExpireMinHeap::Modify(const ClientExpire &node)
 
 bool ClientExpireMinHeap::Delete(const int clientFd)
 {
-    auto iter = m_socketAndHeapIdxMap.find(clientFd);
-    if (iter == m_socketAndHeapIdxMap.end()) {
+    unsigned int heapIdx;
+    if (!GetHeapIdx(clientFd, heapIdx)) {
         printf("ERROR client[%d] not find.\n", clientFd);
         return false;
     }
-    unsigned int heapIdx = iter->second;
     time_t oldExpire = m_heap[heapIdx].expire; 
     m_heap[heapIdx] = m_heap[m_currentSize - 1];
-    m_socketAndHeapIdxMap[m_heap[heapIdx].clientFd] = heapIdx;
-    m_socketAndHeapIdxMap.erase(clientFd);
+    SetHeapIdx(m_heap[heapIdx].clientFd, heapIdx);
+    SetHeapIdx(clientFd, INVALID_HEAP_INDEX);
     m_currentSize--;
     // 调整位置
     if (m_heap[heapIdx].expire < oldExpire) {
@@ -218,4 +218,28 @@ bool ClientExpireMinHeap::Delete(const int clientFd)
         SiftDown(heapIdx);
     }
     return true;
+}
+
+bool ClientExpireMinHeap::Contains(const int clientFd) const
+{
+    unsigned int heapIdx;
+    return GetHeapIdx(clientFd, heapIdx);
+}
+
+void ClientExpireMinHeap::SetHeapIdx(const int clientFd, const unsigned int heapIdx)
+{
+    if (static_cast<size_t>(clientFd) >= m_socketHeapIdx.size()) {
+        m_socketHeapIdx.resize(clientFd + 1, INVALID_HEAP_INDEX);
+    }
+    m_socketHeapIdx[clientFd] = heapIdx;
+}
+
+bool ClientExpireMinHeap::GetHeapIdx(const int clientFd, unsigned int &heapIdx) const
+{
+    if (clientFd < 0 || static_cast<size_t>(clientFd) >= m_socketHeapIdx.size() ||
+        m_socketHeapIdx[clientFd] == INVALID_HEAP_INDEX) {
+        return false;
+    }
+    heapIdx = m_socketHeapIdx[clientFd];
+    return true;
 }
\ No newline at end of file
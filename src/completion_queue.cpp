@@ -0,0 +1,64 @@
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include "completion_queue.h"
+
+CompletionQueue::CompletionQueue()
+{
+}
+
+CompletionQueue::~CompletionQueue()
+{
+    if (m_eventFd != -1) {
+        close(m_eventFd);
+        m_eventFd = -1;
+    }
+}
+
+bool CompletionQueue::Init()
+{
+    m_eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_eventFd == -1) {
+        printf("ERROR  Create completion eventfd fail.\n");
+        return false;
+    }
+    return true;
+}
+
+int CompletionQueue::GetEventFd() const
+{
+    return m_eventFd;
+}
+
+void CompletionQueue::Push(CompletionNode *node, const int client, void *owner, const unsigned char result)
+{
+    node->client = client;
+    node->owner = owner;
+    node->result = result;
+    CompletionNode *head = m_head.load(std::memory_order_relaxed);
+    do {
+        node->next = head;
+    } while (!m_head.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+    if (head == nullptr) {
+        uint64_t one = 1;
+        (void)write(m_eventFd, &one, sizeof(one));
+    }
+}
+
+// 先读eventfd再取出整个链表：取出之后的提交看到空队列会重新写eventfd，不会丢失唤醒
+void CompletionQueue::PollCompletions(std::vector<Completion> &completions)
+{
+    uint64_t count = 0;
+    (void)read(m_eventFd, &count, sizeof(count));
+    CompletionNode *node = m_head.exchange(nullptr, std::memory_order_acquire);
+    size_t start = completions.size();
+    while (node != nullptr) {
+        CompletionNode *next = node->next;
+        Completion completion = { .client = node->client, .owner = node->owner, .result = node->result };
+        completions.push_back(completion);
+        node = next;
+    }
+    std::reverse(completions.begin() + start, completions.end());
+}
\ No newline at end of file
@@ -0,0 +1,274 @@
+#include <sys/epoll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "coroutine_driver.h"
+
+const size_t FRAME_POOL_BLOCK_SIZE = 1024; // 连接协程的帧一般不超过1KB
+const unsigned int FRAME_POOL_MAX_FREE_NUM = 4096;
+const unsigned int COROUTINE_EXPIRE_MIN_HEAP_DEFAULT_SIZE = 10;
+const unsigned int COROUTINE_WAIT_EVENTS_NONE = 0;
+
+FramePool::FramePool()
+{}
+
+FramePool::~FramePool()
+{
+    while (m_freeList != nullptr) {
+        FreeBlock *block = m_freeList;
+        m_freeList = block->next;
+        free(block);
+    }
+    m_freeNum = 0;
+}
+
+void FramePool::Init(const size_t blockSize, const unsigned int maxFreeNum)
+{
+    m_blockSize = blockSize < sizeof(FreeBlock) ? sizeof(FreeBlock) : blockSize;
+    m_maxFreeNum = maxFreeNum;
+}
+
+void *FramePool::Allocate(const size_t size)
+{
+    if (size > m_blockSize) {
+        return malloc(size);
+    }
+    if (m_freeList != nullptr) {
+        FreeBlock *block = m_freeList;
+        m_freeList = block->next;
+        m_freeNum--;
+        return block;
+    }
+    return malloc(m_blockSize);
+}
+
+void FramePool::Deallocate(void *frame, const size_t size)
+{
+    if (size > m_blockSize || m_freeNum >= m_maxFreeNum) {
+        free(frame);
+        return;
+    }
+    FreeBlock *block = reinterpret_cast<FreeBlock *>(frame);
+    block->next = m_freeList;
+    m_freeList = block;
+    m_freeNum++;
+}
+
+FramePool *&FramePool::Current()
+{
+    static thread_local FramePool *framePool = nullptr;
+    return framePool;
+}
+
+// 帧的大小在编译期确定，释放时编译器会传入与分配时相同的大小
+void *ConnectionTask::promise_type::operator new(size_t size)
+{
+    FramePool *framePool = FramePool::Current();
+    void *frame = framePool != nullptr ? framePool->Allocate(size) : malloc(size);
+    if (frame == nullptr) {
+        printf("ERROR Allocate coroutine frame fail, size = %zu.\n", size);
+        abort();
+    }
+    return frame;
+}
+
+void ConnectionTask::promise_type::operator delete(void *frame, size_t size)
+{
+    FramePool *framePool = FramePool::Current();
+    if (framePool != nullptr) {
+        framePool->Deallocate(frame, size);
+        return;
+    }
+    free(frame);
+}
+
+bool IoAwaitable::await_suspend(std::coroutine_handle<> handle)
+{
+    return driver->Suspend(this, handle);
+}
+
+CoroutineDriver::CoroutineDriver()
+{}
+
+CoroutineDriver::~CoroutineDriver()
+{
+    if (FramePool::Current() == &m_framePool) {
+        FramePool::Current() = nullptr;
+    }
+}
+
+bool CoroutineDriver::Init(const int efd)
+{
+    m_efd = efd;
+    if (m_expireMinHeap.Init(COROUTINE_EXPIRE_MIN_HEAP_DEFAULT_SIZE) == false) {
+        return false;
+    }
+    m_framePool.Init(FRAME_POOL_BLOCK_SIZE, FRAME_POOL_MAX_FREE_NUM);
+    FramePool::Current() = &m_framePool;
+    return true;
+}
+
+bool CoroutineDriver::Attach(const int fd)
+{
+    if (fd < 0) {
+        return false;
+    }
+    if (static_cast<size_t>(fd) >= m_waiters.size()) {
+        m_waiters.resize(fd + 1);
+    }
+    Waiter &waiter = m_waiters[fd];
+    if (waiter.attached) {
+        printf("ERROR fd %d already attached to coroutine driver.\n", fd);
+        return false;
+    }
+    struct epoll_event event = { 0 };
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(m_efd, EPOLL_CTL_ADD, fd, &event) == -1) {
+        printf("ERROR epoll_ctl add fail, fd = %d.\n", fd);
+        return false;
+    }
+    ClientExpire clientExpire = { .clientFd = fd, .expire = time(NULL) };
+    if (m_expireMinHeap.Push(clientExpire) == false) {
+        epoll_ctl(m_efd, EPOLL_CTL_DEL, fd, NULL);
+        return false;
+    }
+    waiter.handle = nullptr;
+    waiter.awaitable = nullptr;
+    waiter.registerEvents = EPOLLIN;
+    waiter.attached = true;
+    m_size++;
+    return true;
+}
+
+void CoroutineDriver::Detach(const int fd)
+{
+    if (!Owns(fd)) {
+        return;
+    }
+    epoll_ctl(m_efd, EPOLL_CTL_DEL, fd, NULL);
+    m_expireMinHeap.Delete(fd);
+    m_waiters[fd] = Waiter {};
+    m_size--;
+}
+
+bool CoroutineDriver::Owns(const int fd) const
+{
+    return fd >= 0 && static_cast<size_t>(fd) < m_waiters.size() && m_waiters[fd].attached;
+}
+
+unsigned int CoroutineDriver::Size() const
+{
+    return m_size;
+}
+
+IoAwaitable CoroutineDriver::Readable(const int fd, const unsigned int timeout)
+{
+    return IoAwaitable { this, fd, EPOLLIN, timeout, IO_WAIT_RESULT_CLOSED, nullptr };
+}
+
+IoAwaitable CoroutineDriver::Writable(const int fd, const unsigned int timeout)
+{
+    return IoAwaitable { this, fd, EPOLLOUT, timeout, IO_WAIT_RESULT_CLOSED, nullptr };
+}
+
+IoAwaitable CoroutineDriver::Sleep(const int fd, const unsigned int timeout, const void *owner)
+{
+    return IoAwaitable { this, fd, COROUTINE_WAIT_EVENTS_NONE, timeout, IO_WAIT_RESULT_CLOSED, owner };
+}
+
+// 只有等待的事件变化时才修改epoll注册，长连接反复等待读事件时不产生系统调用
+bool CoroutineDriver::Suspend(IoAwaitable *awaitable, std::coroutine_handle<> handle)
+{
+    int fd = awaitable->fd;
+    if (!Owns(fd)) {
+        awaitable->result = IO_WAIT_RESULT_CLOSED;
+        return false;
+    }
+    Waiter &waiter = m_waiters[fd];
+    if (waiter.registerEvents != awaitable->events) {
+        struct epoll_event event = { 0 };
+        event.events = awaitable->events;
+        event.data.fd = fd;
+        if (epoll_ctl(m_efd, EPOLL_CTL_MOD, fd, &event) == -1) {
+            printf("ERROR epoll_ctl mod fail, fd = %d.\n", fd);
+            awaitable->result = IO_WAIT_RESULT_CLOSED;
+            return false;
+        }
+        waiter.registerEvents = awaitable->events;
+    }
+    ClientExpire clientExpire = { .clientFd = fd, .expire = time(NULL) + awaitable->timeout };
+    m_expireMinHeap.Modify(clientExpire);
+    waiter.handle = handle;
+    waiter.awaitable = awaitable;
+    return true;
+}
+
+// 先清空等待信息再恢复协程，协程可能在恢复后结束并调用Detach
+void CoroutineDriver::Resume(const int fd, const IoWaitResult result)
+{
+    Waiter &waiter = m_waiters[fd];
+    std::coroutine_handle<> handle = waiter.handle;
+    if (!handle) {
+        return;
+    }
+    waiter.awaitable->result = result;
+    waiter.handle = nullptr;
+    waiter.awaitable = nullptr;
+    handle.resume();
+}
+
+void CoroutineDriver::HandleEvent(const int fd, const unsigned int events)
+{
+    if (!Owns(fd) || m_waiters[fd].awaitable == nullptr) {
+        return;
+    }
+    // 出错或对端关闭时也恢复协程，由读写的返回值判断连接状态
+    if ((events & (m_waiters[fd].awaitable->events | EPOLLERR | EPOLLHUP)) == 0) {
+        return;
+    }
+    Resume(fd, IO_WAIT_RESULT_READY);
+}
+
+void CoroutineDriver::Wake(const int fd, const void *owner)
+{
+    if (!Owns(fd) || m_waiters[fd].awaitable == nullptr ||
+        m_waiters[fd].awaitable->events != COROUTINE_WAIT_EVENTS_NONE || m_waiters[fd].awaitable->owner != owner) {
+        return;
+    }
+    Resume(fd, IO_WAIT_RESULT_READY);
+}
+
+void CoroutineDriver::HandleTimer(const time_t now)
+{
+    ClientExpire clientExpire = { 0 };
+    while (m_expireMinHeap.Top(clientExpire) && clientExpire.expire <= now) {
+        int fd = clientExpire.clientFd;
+        if (!Owns(fd) || !m_waiters[fd].handle) {
+            // 不在等待中的连接没有协程可以恢复，移出堆避免反复检查
+            (void)m_expireMinHeap.Pop(clientExpire);
+            continue;
+        }
+        // 恢复后协程可能继续等待并更新过期时间，也可能退出并移出堆
+        Resume(fd, IO_WAIT_RESULT_TIMEOUT);
+    }
+}
+
+void CoroutineDriver::CancelReadWaiters()
+{
+    std::vector<int> fds;
+    for (size_t fd = 0; fd < m_waiters.size(); ++fd) {
+        if (m_waiters[fd].handle && m_waiters[fd].awaitable->events == EPOLLIN) {
+            fds.push_back(static_cast<int>(fd));
+        }
+    }
+    for (int fd : fds) {
+        Resume(fd, IO_WAIT_RESULT_CLOSED);
+    }
+}
+
+void CoroutineDriver::CancelAll()
+{
+    for (size_t fd = 0; fd < m_waiters.size(); ++fd) {
+        Resume(static_cast<int>(fd), IO_WAIT_RESULT_CLOSED);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include <sched.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include "cpu_affinity.h"
+
+const char *NUMA_NODE_DIR = "/sys/devices/system/node";
+const char *NUMA_NODE_DIR_PREFIX = "node";
+const unsigned int MAX_CPU_LIST_LEN = 4096;
+
+bool CpuAffinity::ParseCpuList(const std::string &value, std::vector<int> &cpus)
+{
+    cpus.clear();
+    const char *pos = value.c_str();
+    while (*pos != '\0') {
+        char *end = nullptr;
+        long first = strtol(pos, &end, 10);
+        long last = first;
+        if (end == pos) {
+            printf("ERROR Invalid cpu list: %s.\n", value.c_str());
+            return false;
+        }
+        pos = end;
+        if (*pos == '-') {
+            ++pos;
+            last = strtol(pos, &end, 10);
+            if (end == pos) {
+                printf("ERROR Invalid cpu list: %s.\n", value.c_str());
+                return false;
+            }
+            pos = end;
+        }
+        if (first < 0 || last < first || last >= CPU_SETSIZE) {
+            printf("ERROR Invalid cpu range in cpu list: %s.\n", value.c_str());
+            return false;
+        }
+        for (long cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+        if (*pos == ',') {
+            ++pos;
+        } else if (*pos != '\0') {
+            printf("ERROR Invalid cpu list: %s.\n", value.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CpuAffinity::BindCurrentThread(const std::vector<int> &cpus)
+{
+    if (cpus.empty()) {
+        return true;
+    }
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (int cpu : cpus) {
+        CPU_SET(cpu, &cpuSet);
+    }
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+    if (ret != 0) {
+        printf("ERROR pthread_setaffinity_np fail, ret = %d.\n", ret);
+        return false;
+    }
+    return true;
+}
+
+// 只在第一次调用时扫描sysfs，C++11保证局部静态变量初始化是线程安全的
+const std::vector<int> &CpuAffinity::GetCpuNodeTable()
+{
+    static const std::vector<int> cpuNodeTable = []() {
+        std::vector<int> table;
+        DIR *dir = opendir(NUMA_NODE_DIR);
+        if (dir == nullptr) {
+            return table;
+        }
+        struct dirent *entry = nullptr;
+        while ((entry = readdir(dir)) != nullptr) {
+            size_t prefixLen = strlen(NUMA_NODE_DIR_PREFIX);
+            if (strncmp(entry->d_name, NUMA_NODE_DIR_PREFIX, prefixLen) != 0 ||
+                entry->d_name[prefixLen] < '0' || entry->d_name[prefixLen] > '9') {
+                continue;
+            }
+            int node = atoi(entry->d_name + prefixLen);
+            std::string path = std::string(NUMA_NODE_DIR) + "/" + entry->d_name + "/cpulist";
+            FILE *file = fopen(path.c_str(), "r");
+            if (file == nullptr) {
+                continue;
+            }
+            char line[MAX_CPU_LIST_LEN] = { 0 };
+            if (fgets(line, sizeof(line), file) != nullptr) {
+                line[strcspn(line, "\n")] = '\0';
+                std::vector<int> cpus;
+                if (ParseCpuList(line, cpus)) {
+                    for (int cpu : cpus) {
+                        if (static_cast<size_t>(cpu) >= table.size()) {
+                            table.resize(cpu + 1, 0);
+                        }
+                        table[cpu] = node;
+                    }
+                }
+            }
+            fclose(file);
+        }
+        closedir(dir);
+        return table;
+    }();
+    return cpuNodeTable;
+}
+
+int CpuAffinity::GetNodeOfCpu(const int cpu)
+{
+    const std::vector<int> &table = GetCpuNodeTable();
+    if (cpu < 0 || static_cast<size_t>(cpu) >= table.size()) {
+        return 0;
+    }
+    return table[cpu];
+}
+
+int CpuAffinity::GetCurrentNode()
+{
+    return GetNodeOfCpu(sched_getcpu());
+}
+
+int CpuAffinity::GetNodeNum()
+{
+    int nodeNum = 1;
+    for (int node : GetCpuNodeTable()) {
+        if (node + 1 > nodeNum) {
+            nodeNum = node + 1;
+        }
+    }
+    return nodeNum;
+}
+
+std::vector<int> CpuAffinity::GetNodeCpus(const int node)
+{
+    std::vector<int> cpus;
+    const std::vector<int> &table = GetCpuNodeTable();
+    for (size_t cpu = 0; cpu < table.size(); ++cpu) {
+        if (table[cpu] == node) {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+    }
+    return cpus;
+}
\ No newline at end of file
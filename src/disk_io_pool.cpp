@@ -0,0 +1,130 @@
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "disk_io_pool.h"
+
+const unsigned int MINCORE_VEC_LEN = 4096; // 每次mincore检查4096页
+const size_t WARM_READ_LEN = 256 * 1024; // 磁盘线程每次读取256KB
+
+DiskIoPool::DiskIoPool() : m_threadPool(1)
+{
+    pthread_mutex_init(&m_mutex, nullptr);
+}
+
+DiskIoPool::~DiskIoPool()
+{
+    m_threadPool.Stop(); // 等磁盘线程退出后再关闭eventfd，避免完成通知写到复用的描述符上
+    if (m_eventFd != -1) {
+        close(m_eventFd);
+        m_eventFd = -1;
+    }
+    pthread_mutex_destroy(&m_mutex);
+}
+
+bool DiskIoPool::Init(const unsigned int threadNum)
+{
+    m_eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_eventFd == -1) {
+        printf("ERROR  Create disk io eventfd fail.\n");
+        return false;
+    }
+    if (m_threadPool.SetThreadNum(threadNum) == false || m_threadPool.Init() == false) {
+        printf("ERROR  Init disk io threads fail.\n");
+        close(m_eventFd);
+        m_eventFd = -1;
+        return false;
+    }
+    return true;
+}
+
+bool DiskIoPool::IsEnabled() const
+{
+    return m_eventFd != -1;
+}
+
+int DiskIoPool::GetEventFd() const
+{
+    return m_eventFd;
+}
+
+bool DiskIoPool::Submit(const int client, void *owner, const char *path, const off_t length)
+{
+    if (m_eventFd == -1) {
+        return false;
+    }
+    DiskIoArg arg = { .diskIoPool = this, .client = client, .owner = owner, .path = path, .length = length };
+    Task<DiskIoArg> task = { .function = DiskIoPool::Warm, .arg = arg, .dropFunction = nullptr };
+    return m_threadPool.AddTask(task) == ADD_TASK_RETURN_CODE_SUCCESS;
+}
+
+void DiskIoPool::PollCompletions(std::vector<DiskIoCompletion> &completions)
+{
+    uint64_t count = 0;
+    (void)read(m_eventFd, &count, sizeof(count));
+    pthread_mutex_lock(&m_mutex);
+    completions.swap(m_completions);
+    pthread_mutex_unlock(&m_mutex);
+}
+
+bool DiskIoPool::IsResident(const void *addr, const size_t length)
+{
+    if (addr == nullptr || addr == MAP_FAILED || length == 0) {
+        return true;
+    }
+    static const size_t pageSize = sysconf(_SC_PAGESIZE);
+    uintptr_t start = reinterpret_cast<uintptr_t>(addr) & ~(pageSize - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t>(addr) + length;
+    unsigned char vec[MINCORE_VEC_LEN];
+    while (start < end) {
+        size_t pageNum = (end - start + pageSize - 1) / pageSize;
+        if (pageNum > MINCORE_VEC_LEN) {
+            pageNum = MINCORE_VEC_LEN;
+        }
+        if (mincore(reinterpret_cast<void *>(start), pageNum * pageSize, vec) == -1) {
+            return true; // 无法判断时按在页缓存中处理，保持原来的发送方式
+        }
+        for (size_t i = 0; i < pageNum; ++i) {
+            if ((vec[i] & 1) == 0) {
+                return false;
+            }
+        }
+        start += pageNum * pageSize;
+    }
+    return true;
+}
+
+// 先提示内核预读整个文件，再顺序读一遍等待数据进入页缓存，读取失败时也交回，由发送流程处理
+void DiskIoPool::Warm(void *arg)
+{
+    DiskIoArg *diskIoArg = reinterpret_cast<DiskIoArg *>(arg);
+    static thread_local char buff[WARM_READ_LEN];
+    int fd = open(diskIoArg->path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd != -1) {
+        (void)posix_fadvise(fd, 0, diskIoArg->length, POSIX_FADV_WILLNEED);
+        off_t offset = 0;
+        while (offset < diskIoArg->length) {
+            ssize_t ret = pread(fd, buff, sizeof(buff), offset);
+            if (ret <= 0) {
+                break;
+            }
+            offset += ret;
+        }
+        close(fd);
+    } else {
+        printf("ERROR  Disk io open file fail: %s.\n", diskIoArg->path.c_str());
+    }
+    diskIoArg->diskIoPool->Complete(diskIoArg->client, diskIoArg->owner);
+}
+
+void DiskIoPool::Complete(const int client, void *owner)
+{
+    DiskIoCompletion completion = { .client = client, .owner = owner };
+    pthread_mutex_lock(&m_mutex);
+    m_completions.push_back(completion);
+    pthread_mutex_unlock(&m_mutex);
+    uint64_t one = 1;
+    (void)write(m_eventFd, &one, sizeof(one));
+}
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <string.h>
+#include "route_list.h"
+#include "dispatch_policy.h"
+
+const char *DISPATCH_MODE_POOLED_NAME = "pooled";
+const char *DISPATCH_MODE_INLINE_NAME = "inline";
+const char *TASK_LANE_SMALL_NAME = "small";
+const char *TASK_LANE_LARGE_NAME = "large";
+
+DispatchPolicy::DispatchPolicy()
+{}
+
+DispatchPolicy::~DispatchPolicy()
+{}
+
+bool DispatchPolicy::Init(const std::string &defaultMode, const std::string &routes)
+{
+    DispatchMode mode = DISPATCH_MODE_POOLED;
+    std::vector<DispatchRoute> routeList;
+    if (!ParseMode(defaultMode, mode) || !ParseRoutes(routes, routeList)) {
+        return false;
+    }
+    m_defaultMode = mode;
+    m_routes.swap(routeList);
+    return true;
+}
+
+DispatchMode DispatchPolicy::GetMode(const char *url, const unsigned int urlLen) const
+{
+    for (const DispatchRoute &route : m_routes) {
+        if (urlLen >= route.prefix.size() && memcmp(url, route.prefix.data(), route.prefix.size()) == 0) {
+            return route.mode;
+        }
+    }
+    return m_defaultMode;
+}
+
+bool DispatchPolicy::HasInline() const
+{
+    if (m_defaultMode == DISPATCH_MODE_INLINE) {
+        return true;
+    }
+    for (const DispatchRoute &route : m_routes) {
+        if (route.mode == DISPATCH_MODE_INLINE) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool DispatchPolicy::ParseMode(const std::string &value, DispatchMode &mode)
+{
+    if (value == DISPATCH_MODE_POOLED_NAME) {
+        mode = DISPATCH_MODE_POOLED;
+        return true;
+    }
+    if (value == DISPATCH_MODE_INLINE_NAME) {
+        mode = DISPATCH_MODE_INLINE;
+        return true;
+    }
+    printf("ERROR Invalid dispatch mode: %s, must be %s or %s.\n", value.c_str(), DISPATCH_MODE_POOLED_NAME,
+        DISPATCH_MODE_INLINE_NAME);
+    return false;
+}
+
+bool DispatchPolicy::ParseRoutes(const std::string &value, std::vector<DispatchRoute> &routes)
+{
+    std::vector<RouteItem> items;
+    if (!RouteList::Parse(value, 1, "dispatch route", items)) {
+        return false;
+    }
+    routes.clear();
+    for (const RouteItem &item : items) {
+        DispatchRoute route;
+        route.prefix = item.prefix;
+        if (!ParseMode(item.value, route.mode)) {
+            return false;
+        }
+        routes.push_back(route);
+    }
+    return true;
+}
+
+LanePolicy::LanePolicy()
+{}
+
+LanePolicy::~LanePolicy()
+{}
+
+bool LanePolicy::Init(const std::string &routes)
+{
+    std::vector<LaneRoute> routeList;
+    if (!ParseRoutes(routes, routeList)) {
+        return false;
+    }
+    m_routes.swap(routeList);
+    return true;
+}
+
+bool LanePolicy::GetLane(const char *url, const unsigned int urlLen, TaskLane &lane) const
+{
+    for (const LaneRoute &route : m_routes) {
+        if (urlLen >= route.prefix.size() && memcmp(url, route.prefix.data(), route.prefix.size()) == 0) {
+            lane = route.lane;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LanePolicy::HasRoutes() const
+{
+    return !m_routes.empty();
+}
+
+const char *LanePolicy::GetLaneName(const TaskLane lane)
+{
+    return lane == TASK_LANE_LARGE ? TASK_LANE_LARGE_NAME : TASK_LANE_SMALL_NAME;
+}
+
+bool LanePolicy::ParseLane(const std::string &value, TaskLane &lane)
+{
+    if (value == TASK_LANE_SMALL_NAME) {
+        lane = TASK_LANE_SMALL;
+        return true;
+    }
+    if (value == TASK_LANE_LARGE_NAME) {
+        lane = TASK_LANE_LARGE;
+        return true;
+    }
+    printf("ERROR Invalid task lane: %s, must be %s or %s.\n", value.c_str(), TASK_LANE_SMALL_NAME,
+        TASK_LANE_LARGE_NAME);
+    return false;
+}
+
+bool LanePolicy::ParseRoutes(const std::string &value, std::vector<LaneRoute> &routes)
+{
+    std::vector<RouteItem> items;
+    if (!RouteList::Parse(value, 1, "lane route", items)) {
+        return false;
+    }
+    routes.clear();
+    for (const RouteItem &item : items) {
+        LaneRoute route;
+        route.prefix = item.prefix;
+        if (!ParseLane(item.value, route.lane)) {
+            return false;
+        }
+        routes.push_back(route);
+    }
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,417 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "rate_limiter.h"
+#include "cpu_affinity.h"
+#include "dispatch_policy.h"
+#include "websocket.h"
+#include "sse.h"
+#include "http_config.h"
+
+const unsigned int MAX_CONFIG_LINE_LEN = 1024;
+const unsigned int MAX_PORT = 65535;
+const unsigned int MAX_THREAD_NUM = 1024;
+const unsigned int MAX_READ_BUFF_LEN_LIMIT = 1024 * 1024; // 读缓冲区最大1MB
+const char *CONFIG_FILE_OPTION = "-c";
+const char *HELP_OPTION = "-h";
+const char *CMD_ITEM_PREFIX = "--";
+const char *CONFIG_WHITE_SPACE_CHARS = " \t\r\n";
+const char *OVERLOAD_ACTION_REJECT = "reject";
+const char *OVERLOAD_ACTION_REFUSE = "refuse";
+const char *CONNECTION_DRIVER_CALLBACK = "callback";
+const char *CONNECTION_DRIVER_COROUTINE = "coroutine";
+
+enum ConfigValueType : unsigned char {
+    CONFIG_VALUE_TYPE_UINT = 0,
+    CONFIG_VALUE_TYPE_STRING = 1,
+};
+
+typedef struct {
+    const char *key;
+    ConfigValueType type;
+    unsigned int HttpServerConfig::*uintField;
+    std::string HttpServerConfig::*stringField;
+    unsigned int minValue;
+    unsigned int maxValue;
+    bool reloadable; // 是否可以通过SIGHUP在运行时生效
+    const char *description;
+} ConfigItem;
+
+const ConfigItem CONFIG_ITEM_LIST[] = {
+    { "ip_addr", CONFIG_VALUE_TYPE_STRING, nullptr, &HttpServerConfig::ipAddr, 0, 0, false,
+        "listen ip address" },
+    { "port", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::port, nullptr, 1, MAX_PORT, false,
+        "listen port" },
+    { "backlog", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::backlog, nullptr, 1, 65535, false,
+        "listen backlog" },
+    { "epoll_size", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::epollSize, nullptr, 1, 65535, true,
+        "max events returned by one epoll_wait" },
+    { "source_dir", CONFIG_VALUE_TYPE_STRING, nullptr, &HttpServerConfig::sourceDir, 0, 0, true,
+        "document root, applies to new connections" },
+    { "thread_num", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::threadNum, nullptr, 1, MAX_THREAD_NUM, true,
+        "request handling threads at startup" },
+    { "min_threads", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::minThreads, nullptr, 0, MAX_THREAD_NUM, true,
+        "fewest handling threads kept when idle, 0 means thread_num" },
+    { "max_threads", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::maxThreads, nullptr, 0, MAX_THREAD_NUM, true,
+        "most handling threads when requests queue up, 0 means thread_num" },
+    { "target_queue_wait_us", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::targetQueueWaitUs, nullptr, 0, 60000000,
+        true, "queue wait microseconds above which handling threads are added, 0 means never add" },
+    { "thread_idle_timeout", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::threadIdleTimeout, nullptr, 0, 86400, true,
+        "idle seconds before a handling thread above min_threads exits, 0 means never exit" },
+    { "timer_interval", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::timerInterval, nullptr, 1, 3600, true,
+        "seconds between client expire checks" },
+    { "client_expire_interval", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::clientExpireInterval, nullptr, 1, 86400,
+        true, "idle seconds before a client is closed" },
+    { "max_read_buff_len", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::maxReadBuffLen, nullptr, 256,
+        MAX_READ_BUFF_LEN_LIMIT, true, "request buffer size, applies to new connections" },
+    { "drain_timeout", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::drainTimeout, nullptr, 0, 3600, true,
+        "seconds to drain connections before the old process exits on upgrade" },
+    { "max_connections", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::maxConnections, nullptr, 0, 10000000, true,
+        "max open connections, 0 means unlimited" },
+    { "overload_action", CONFIG_VALUE_TYPE_STRING, nullptr, &HttpServerConfig::overloadAction, 0, 0, true,
+        "reject (answer 503) or refuse (stop accepting) when max_connections is reached" },
+    { "max_queue_per_thread", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::maxQueuePerThread, nullptr, 0, 1000000,
+        true, "queued requests per handling thread before answering 503, 0 means unlimited" },
+    { "max_queue_wait_ms", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::maxQueueWaitMs, nullptr, 0, 3600000, true,
+        "queued milliseconds before a request is answered with 503, 0 means unlimited" },
+    { "retry_after", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::retryAfter, nullptr, 0, 86400, true,
+        "Retry-After seconds in overload responses" },
+    { "rate_limit", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::rateLimit, nullptr, 0, 100000000, true,
+        "requests per second allowed for each client address, 0 means unlimited" },
+    { "rate_limit_burst", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::rateLimitBurst, nullptr, 0, 100000000, true,
+        "token bucket size for each client address, 0 means same as rate_limit" },
+    { "rate_limit_routes", CONFIG_VALUE_TYPE_STRING, nullptr, &HttpServerConfig::rateLimitRoutes, 0, 0, true,
+        "per client limits for url prefixes, e.g. /api:100:200,/login:5:10" },
+    { "rate_limit_idle", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::rateLimitIdle, nullptr, 1, 86400, true,
+        "idle seconds before a client token bucket is evicted" },
+    { "rate_limit_table_size", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::rateLimitTableSize, nullptr, 1024,
+        100000000, true, "token buckets kept for each limit" },
+    { "reactor_cpus", CONFIG_VALUE_TYPE_STRING, nullptr, &HttpServerConfig::reactorCpus, 0, 0, false,
+        "cpus the event loop thread is bound to, e.g. 0-3,8" },
+    { "worker_cpus", CONFIG_VALUE_TYPE_STRING, nullptr, &HttpServerConfig::workerCpus, 0, 0, false,
+        "cpus the handling threads are bound to, one cpu per thread in turn" },
+    { "dispatch_mode", CONFIG_VALUE_TYPE_STRING, nullptr, &HttpServerConfig::dispatchMode, 0, 0, true,
+        "pooled (handling threads) or inline (event loop thread) request handling" },
+    { "dispatch_routes", CONFIG_VALUE_TYPE_STRING, nullptr, &HttpServerConfig::dispatchRoutes, 0, 0, true,
+        "dispatch mode for url prefixes, e.g. /static:inline,/api:pooled" },
+    { "inline_max_request_len", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::inlineMaxRequestLen, nullptr, 0,
+        MAX_READ_BUFF_LEN_LIMIT, true, "larger inline requests are handed to the handling threads" },
+    { "inline_max_file_size", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::inlineMaxFileSize, nullptr, 0,
+        0xffffffff, true, "inline requests for larger files are handed to the handling threads" },
+    { "large_response_size", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::largeResponseSize, nullptr, 0, 0xffffffff,
+        true, "requests with larger responses are queued in the large lane, 0 means queue by route only" },
+    { "lane_routes", CONFIG_VALUE_TYPE_STRING, nullptr, &HttpServerConfig::laneRoutes, 0, 0, true,
+        "task lane for url prefixes, e.g. /download:large,/api:small" },
+    { "small_lane_weight", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::smallLaneWeight, nullptr, 1, 1000, true,
+        "share of handling thread dequeues given to the small lane" },
+    { "large_lane_weight", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::largeLaneWeight, nullptr, 1, 1000, true,
+        "share of handling thread dequeues given to the large lane" },
+    { "connection_driver", CONFIG_VALUE_TYPE_STRING, nullptr, &HttpServerConfig::connectionDriver, 0, 0, true,
+        "callback or coroutine connection handling, applies to new connections" },
+    { "reuse_addr", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::reuseAddr, nullptr, 0, 1, false,
+        "set SO_REUSEADDR on the listener" },
+    { "defer_accept", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::deferAccept, nullptr, 0, 3600, false,
+        "seconds to wait for request data before accept (TCP_DEFER_ACCEPT), 0 means disabled" },
+    { "fast_open", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::fastOpen, nullptr, 0, 65535, false,
+        "TCP Fast Open queue length on the listener, 0 means disabled" },
+    { "tcp_nodelay", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::tcpNoDelay, nullptr, 0, 1, true,
+        "set TCP_NODELAY on accepted sockets, applies to new connections" },
+    { "busy_poll", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::busyPoll, nullptr, 0, 1000000, true,
+        "busy poll microseconds for accepted sockets and epoll, 0 means disabled" },
+    { "busy_poll_budget", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::busyPollBudget, nullptr, 1, 65535, true,
+        "packets processed by one epoll busy poll" },
+    { "listeners", CONFIG_VALUE_TYPE_STRING, nullptr, &HttpServerConfig::listeners, 0, 0, false,
+        "listen addresses, e.g. 0.0.0.0:80,[::]:8080;v6only=1,unix:/run/http.sock;mode=660" },
+    { "asset_bundle", CONFIG_VALUE_TYPE_STRING, nullptr, &HttpServerConfig::assetBundle, 0, 0, false,
+        "asset bundle packed by asset_pack, served before source_dir" },
+    { "disk_io_threads", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::diskIoThreads, nullptr, 0, 64, false,
+        "threads reading files not in page cache before sending, 0 disables the check" },
+    { "trace_sample", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::traceSample, nullptr, 0, 1000000000, true,
+        "trace one of every N requests, exported on SIGUSR1, 0 disables tracing" },
+    { "trace_ring_size", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::traceRingSize, nullptr, 1024, 16777216, false,
+        "trace events kept for each thread" },
+    { "trace_file", CONFIG_VALUE_TYPE_STRING, nullptr, &HttpServerConfig::traceFile, 0, 0, true,
+        "Chrome/Perfetto trace file written on SIGUSR1" },
+    { "access_log_dir", CONFIG_VALUE_TYPE_STRING, nullptr, &HttpServerConfig::accessLogDir, 0, 0, false,
+        "directory of binary access log files decoded by access_log_dump, empty disables access log" },
+    { "access_log_file_size", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::accessLogFileSize, nullptr, 1, 4095, false,
+        "access log file size in MB, a full file is rotated" },
+    { "access_log_files", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::accessLogFiles, nullptr, 1, 100000, false,
+        "access log files kept for each writer thread" },
+    { "capture_file", CONFIG_VALUE_TYPE_STRING, nullptr, &HttpServerConfig::captureFile, 0, 0, false,
+        "file recording received request bytes for traffic_replay, empty disables capture" },
+    { "capture_max_size", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::captureMaxSize, nullptr, 1, 1048576, false,
+        "capture file size in MB, capture stops when reached" },
+    { "websocket_routes", CONFIG_VALUE_TYPE_STRING, nullptr, &HttpServerConfig::webSocketRoutes, 0, 0, true,
+        "url prefixes upgraded to websocket, prefix:handler separated by comma, built-in handler is echo" },
+    { "websocket_ping_interval", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::webSocketPingInterval, nullptr, 1, 86400,
+        true, "seconds a websocket connection stays idle before ping, closed if still idle after another interval" },
+    { "websocket_max_message", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::webSocketMaxMessage, nullptr, 125,
+        1073741824, true, "max bytes of a websocket message, larger messages close the connection with 1009" },
+    { "sse_routes", CONFIG_VALUE_TYPE_STRING, nullptr, &HttpServerConfig::sseRoutes, 0, 0, true,
+        "url prefixes answered with an event stream, prefix:channel separated by comma, built-in channel is stats" },
+    { "sse_max_queue", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::sseMaxQueue, nullptr, 1, 1048576, true,
+        "events queued for one sse subscriber before sse_slow_policy applies" },
+    { "sse_slow_policy", CONFIG_VALUE_TYPE_STRING, nullptr, &HttpServerConfig::sseSlowPolicy, 0, 0, true,
+        "drop: drop the oldest queued events, close: close the subscriber" },
+    { "sse_keepalive_interval", CONFIG_VALUE_TYPE_UINT, &HttpServerConfig::sseKeepaliveInterval, nullptr, 1, 86400,
+        true, "seconds an event stream stays idle before a comment is sent, stalled subscribers are closed" },
+};
+const unsigned int CONFIG_ITEM_LIST_SIZE = sizeof(CONFIG_ITEM_LIST) / sizeof(CONFIG_ITEM_LIST[0]);
+
+HttpConfig::HttpConfig()
+{}
+
+HttpConfig::~HttpConfig()
+{}
+
+bool HttpConfig::Init(int argc, char *argv[])
+{
+    m_args.assign(argv, argv + argc);
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], HELP_OPTION) == 0) {
+            Usage(argv[0]);
+            return false;
+        }
+        if (strcmp(argv[i], CONFIG_FILE_OPTION) == 0) {
+            if (i + 1 >= argc) {
+                printf("ERROR Option -c need a file path.\n");
+                return false;
+            }
+            m_configPath = argv[++i];
+            continue;
+        }
+        if (strncmp(argv[i], CMD_ITEM_PREFIX, strlen(CMD_ITEM_PREFIX)) != 0) {
+            printf("ERROR Unknown option: %s.\n", argv[i]);
+            return false;
+        }
+        std::string key = argv[i] + strlen(CMD_ITEM_PREFIX);
+        std::string value;
+        size_t splitPos = key.find('=');
+        if (splitPos != std::string::npos) {
+            value = key.substr(splitPos + 1);
+            key = key.substr(0, splitPos);
+        } else if (i + 1 < argc) {
+            value = argv[++i];
+        } else {
+            printf("ERROR Option --%s need a value.\n", key.c_str());
+            return false;
+        }
+        m_cmdItems.push_back(std::make_pair(key, value));
+    }
+
+    HttpServerConfig config;
+    if (!Load(config)) {
+        return false;
+    }
+    m_config = config;
+    return true;
+}
+
+bool HttpConfig::Reload()
+{
+    HttpServerConfig config;
+    if (!Load(config)) {
+        printf("ERROR Reload config fail, keep current config.\n");
+        return false;
+    }
+    m_config = config;
+    return true;
+}
+
+const HttpServerConfig &HttpConfig::Get() const
+{
+    return m_config;
+}
+
+const std::vector<std::string> &HttpConfig::GetArgs() const
+{
+    return m_args;
+}
+
+bool HttpConfig::HasRestartOnlyChange(const HttpServerConfig &oldConfig, const HttpServerConfig &newConfig)
+{
+    bool changed = false;
+    for (unsigned int i = 0; i < CONFIG_ITEM_LIST_SIZE; ++i) {
+        const ConfigItem &item = CONFIG_ITEM_LIST[i];
+        if (item.reloadable) {
+            continue;
+        }
+        bool itemChanged = item.type == CONFIG_VALUE_TYPE_UINT ?
+            oldConfig.*item.uintField != newConfig.*item.uintField :
+            oldConfig.*item.stringField != newConfig.*item.stringField;
+        if (itemChanged) {
+            printf("WARN  Config %s changed, take effect after restart.\n", item.key);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+bool HttpConfig::GetListeners(const HttpServerConfig &config, std::vector<ListenerConfig> &listeners)
+{
+    ListenerConfig defaults;
+    defaults.backlog = config.backlog;
+    defaults.options.reuseAddr = config.reuseAddr != 0;
+    defaults.options.deferAccept = config.deferAccept;
+    defaults.options.fastOpenQueue = config.fastOpen;
+    if (!config.listeners.empty()) {
+        return ListenerSet::ParseList(config.listeners, defaults, listeners);
+    }
+    bool ipv6 = config.ipAddr.find(':') != std::string::npos;
+    std::string address = ipv6 ? "[" + config.ipAddr + "]" : config.ipAddr;
+    return ListenerSet::ParseList(address + ":" + std::to_string(config.port), defaults, listeners);
+}
+
+void HttpConfig::Usage(const char *name)
+{
+    printf("Usage: %s [-c config_file] [--key=value ...]\n", name);
+    for (unsigned int i = 0; i < CONFIG_ITEM_LIST_SIZE; ++i) {
+        const ConfigItem &item = CONFIG_ITEM_LIST[i];
+        printf("  --%-24s %s%s\n", item.key, item.description, item.reloadable ? " (reloadable)" : "");
+    }
+}
+
+bool HttpConfig::Load(HttpServerConfig &config)
+{
+    if (!m_configPath.empty() && !LoadFile(m_configPath.c_str(), config)) {
+        return false;
+    }
+    for (auto iter = m_cmdItems.begin(); iter != m_cmdItems.end(); ++iter) {
+        if (!SetItem(config, iter->first.c_str(), iter->second.c_str())) {
+            return false;
+        }
+    }
+    return Check(config);
+}
+
+bool HttpConfig::LoadFile(const char *path, HttpServerConfig &config)
+{
+    FILE *file = fopen(path, "r");
+    if (file == nullptr) {
+        printf("ERROR Open config file fail: %s.\n", path);
+        return false;
+    }
+    char line[MAX_CONFIG_LINE_LEN];
+    unsigned int lineNum = 0;
+    bool ret = true;
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        lineNum++;
+        char *key = line + strspn(line, CONFIG_WHITE_SPACE_CHARS);
+        if (*key == '#' || *key == '\0') {
+            continue;
+        }
+        char *value = strchr(key, '=');
+        if (value == nullptr) {
+            printf("ERROR Invalid config line %u: %s", lineNum, line);
+            ret = false;
+            break;
+        }
+        *value++ = '\0';
+        value += strspn(value, CONFIG_WHITE_SPACE_CHARS);
+        // 去掉键和值尾部的空白字符
+        for (char *end = value + strlen(value); end > value && strchr(CONFIG_WHITE_SPACE_CHARS, end[-1]); --end) {
+            end[-1] = '\0';
+        }
+        for (char *end = key + strlen(key); end > key && strchr(CONFIG_WHITE_SPACE_CHARS, end[-1]); --end) {
+            end[-1] = '\0';
+        }
+        if (!SetItem(config, key, value)) {
+            printf("ERROR Invalid config line %u.\n", lineNum);
+            ret = false;
+            break;
+        }
+    }
+    fclose(file);
+    return ret;
+}
+
+bool HttpConfig::SetItem(HttpServerConfig &config, const char *key, const char *value)
+{
+    for (unsigned int i = 0; i < CONFIG_ITEM_LIST_SIZE; ++i) {
+        const ConfigItem &item = CONFIG_ITEM_LIST[i];
+        if (strcmp(item.key, key) != 0) {
+            continue;
+        }
+        if (item.type == CONFIG_VALUE_TYPE_STRING) {
+            config.*item.stringField = value;
+            return true;
+        }
+        char *end = nullptr;
+        unsigned long num = strtoul(value, &end, 10);
+        if (*value == '\0' || *end != '\0' || num < item.minValue || num > item.maxValue) {
+            printf("ERROR Config %s = %s out of range [%u, %u].\n", key, value, item.minValue, item.maxValue);
+            return false;
+        }
+        config.*item.uintField = static_cast<unsigned int>(num);
+        return true;
+    }
+    printf("ERROR Unknown config: %s.\n", key);
+    return false;
+}
+
+bool HttpConfig::Check(const HttpServerConfig &config)
+{
+    struct stat dirStat{ 0 };
+    if (stat(config.sourceDir.c_str(), &dirStat) == -1 || !S_ISDIR(dirStat.st_mode)) {
+        printf("ERROR source_dir is not a directory: %s.\n", config.sourceDir.c_str());
+        return false;
+    }
+    if (config.overloadAction != OVERLOAD_ACTION_REJECT && config.overloadAction != OVERLOAD_ACTION_REFUSE) {
+        printf("ERROR overload_action must be %s or %s.\n", OVERLOAD_ACTION_REJECT, OVERLOAD_ACTION_REFUSE);
+        return false;
+    }
+    if (config.traceSample != 0 && config.traceFile.empty()) {
+        printf("ERROR trace_file can't be empty when trace_sample is set.\n");
+        return false;
+    }
+    unsigned int minThreads = config.minThreads == 0 ? config.threadNum : config.minThreads;
+    unsigned int maxThreads = config.maxThreads == 0 ? config.threadNum : config.maxThreads;
+    if (minThreads > maxThreads) {
+        printf("ERROR min_threads %u is larger than max_threads %u.\n", minThreads, maxThreads);
+        return false;
+    }
+    std::vector<RouteLimit> routeLimits;
+    if (!RateLimiter::ParseRouteLimits(config.rateLimitRoutes, routeLimits)) {
+        return false;
+    }
+    if (config.connectionDriver != CONNECTION_DRIVER_CALLBACK && config.connectionDriver != CONNECTION_DRIVER_COROUTINE) {
+        printf("ERROR connection_driver must be %s or %s.\n", CONNECTION_DRIVER_CALLBACK, CONNECTION_DRIVER_COROUTINE);
+        return false;
+    }
+    DispatchPolicy dispatchPolicy;
+    if (!dispatchPolicy.Init(config.dispatchMode, config.dispatchRoutes)) {
+        return false;
+    }
+    std::vector<LaneRoute> laneRoutes;
+    if (!LanePolicy::ParseRoutes(config.laneRoutes, laneRoutes)) {
+        return false;
+    }
+    std::vector<WebSocketRoute> webSocketRoutes;
+    if (!WebSocketRouter::ParseRoutes(config.webSocketRoutes, webSocketRoutes)) {
+        return false;
+    }
+    if (config.sseSlowPolicy != SSE_SLOW_POLICY_DROP && config.sseSlowPolicy != SSE_SLOW_POLICY_CLOSE) {
+        printf("ERROR sse_slow_policy must be %s or %s.\n", SSE_SLOW_POLICY_DROP, SSE_SLOW_POLICY_CLOSE);
+        return false;
+    }
+    std::vector<SseRoute> sseRoutes;
+    if (!SseRouter::ParseRoutes(config.sseRoutes, sseRoutes)) {
+        return false;
+    }
+    std::vector<int> cpus;
+    if (!CpuAffinity::ParseCpuList(config.reactorCpus, cpus) || !CpuAffinity::ParseCpuList(config.workerCpus, cpus)) {
+        return false;
+    }
+    std::vector<ListenerConfig> listeners;
+    if (!GetListeners(config, listeners)) {
+        return false;
+    }
+    if (!config.assetBundle.empty() && access(config.assetBundle.c_str(), R_OK) == -1) {
+        printf("ERROR Can't read asset_bundle: %s.\n", config.assetBundle.c_str());
+        return false;
+    }
+    return true;
+}
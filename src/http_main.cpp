@@ -1,11 +1,14 @@
 #include <stdio.h>
+#include "http_config.h"
 #include "http_server.h"
 
-const char *SOURCE_DIR = "/home/enspire/code/HttpServer/webpages";
-
-int main()
+int main(int argc, char *argv[])
 {
+    HttpConfig config;
+    if (config.Init(argc, argv) == false) {
+        return 1;
+    }
     HttpServer &server = HttpServer::GetInstance();
-    server.Run("127.0.0.1", 443, 5, 5, SOURCE_DIR);
+    server.Run(config);
     return 0;
 }
\ No newline at end of file
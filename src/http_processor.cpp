@@ -6,9 +6,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <fcntl.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
+#include <sys/socket.h>
 #include "http_processor.h"
+#include "disk_io_pool.h"
 
 const char *WHITE_SPACE_CHARS = " \t";
 const char *GET_METHOD_STR = "GET";
@@ -18,8 +18,22 @@ const char HEAD_FIELD_SPLIT_CHAR = ':';
 const char END_CHAR = '\0'; // 结束符
 const char *CONTENT_LENGTH_KEY_NAME = "Content-Length";
 const char *CONNECTION_KEY_NAME = "Connection";
+const char *IF_NONE_MATCH_KEY_NAME = "If-None-Match";
+const char *ACCEPT_ENCODING_KEY_NAME = "Accept-Encoding";
+const char *UPGRADE_KEY_NAME = "Upgrade";
+const char *WEBSOCKET_KEY_KEY_NAME = "Sec-WebSocket-Key";
+const char *WEBSOCKET_VERSION_KEY_NAME = "Sec-WebSocket-Version";
+const char *GZIP_ENCODING_VALUE = "gzip";
+const char *ANY_ETAG_VALUE = "*";
+const char *URL_QUERY_CHARS = "?";
 const char *KEEP_ALIVE_VALUE = "keep-alive";
 const char *CLOSE_ALIVE_VALUE = "close";
+const char *UPGRADE_VALUE = "upgrade";
+const char *WEBSOCKET_VALUE = "websocket";
+const char *CONNECTION_TOKEN_SPLIT_CHARS = ", \t";
+const unsigned int WEBSOCKET_KEY_LEN = 24; // 16字节随机数的base64编码
+const char *NOT_MODIFIED_TITLE = "Not Modified";
+const char *SWITCHING_PROTOCOLS_TITLE = "Switching Protocols";
 const char *OK_TITLE = "OK";
 const char *BAD_REQUEST_TITLE = "Bad Request";
 const char *BAD_REQUEST_CONTENT = "Your request has bad syntax or is inherently impossible to satisfy.\n";
@@ -27,51 +41,302 @@ const char *FORBIDDEN_TITLE = "Forbidden";
 const char *FORBIDDEN_CONTENT = "You don't have permission to get file from this server.\n";
 const char *NOT_FOUND_TITLE = "Not Found";
 const char *NOT_FOUND_CONTENT = "The request file was not found on this server.\n";
+const char *TOO_MANY_REQUESTS_TITLE = "Too Many Requests";
+const char *TOO_MANY_REQUESTS_CONTENT = "You have sent too many requests, please retry later.\n";
 const char *INTERNAL_SERVER_ERROR_TITLE = "Internal Server Error";
 const char *INTERNAL_SERVER_ERROR_CONTENT = "There was an unusual problem serving the requested file.\n";
-const unsigned int MAX_FILE_NAME_LEN = 200;
+const char *SERVICE_UNAVAILABLE_TITLE = "Service Unavailable";
+const char *SERVICE_UNAVAILABLE_CONTENT = "The server is overloaded, please retry later.\n";
+const char *DEFAULT_HTTP_VERSION = "HTTP/1.1";
 
 const StatusInfo ERROR_STATUS_INFO_LIST[] = {
     { RESPONSE_STATUS_CODE_BAD_REQUEST, BAD_REQUEST_TITLE, BAD_REQUEST_CONTENT },
     { RESPONSE_STATUS_CODE_FORBIDDEN, FORBIDDEN_TITLE, FORBIDDEN_CONTENT },
     { RESPONSE_STATUS_CODE_NOT_FOUND, NOT_FOUND_TITLE, NOT_FOUND_CONTENT },
+    { RESPONSE_STATUS_CODE_TOO_MANY_REQUESTS, TOO_MANY_REQUESTS_TITLE, TOO_MANY_REQUESTS_CONTENT },
     { RESPONSE_STATUS_CODE_INTERNAL_SERVER_ERROR, INTERNAL_SERVER_ERROR_TITLE, INTERNAL_SERVER_ERROR_CONTENT },
+    { RESPONSE_STATUS_CODE_SERVICE_UNAVAILABLE, SERVICE_UNAVAILABLE_TITLE, SERVICE_UNAVAILABLE_CONTENT },
 };
 const unsigned int ERROR_STATUS_INFO_LIST_SIZE = sizeof(ERROR_STATUS_INFO_LIST) / sizeof(ERROR_STATUS_INFO_LIST[0]);
 
-HttpProcessor::HttpProcessor(const int socketId, const std::string &sourceDir) : m_socketId(socketId), m_sourceDir(sourceDir)
-{}
+const HttpProcessor::HeadFieldParser HttpProcessor::m_headFieldParserList[] = {
+    { CONTENT_LENGTH_KEY_NAME, static_cast<unsigned int>(strlen(CONTENT_LENGTH_KEY_NAME)), &HttpProcessor::ParseContentLength },
+    { CONNECTION_KEY_NAME, static_cast<unsigned int>(strlen(CONNECTION_KEY_NAME)), &HttpProcessor::ParseConnection },
+    { IF_NONE_MATCH_KEY_NAME, static_cast<unsigned int>(strlen(IF_NONE_MATCH_KEY_NAME)), &HttpProcessor::ParseIfNoneMatch },
+    { ACCEPT_ENCODING_KEY_NAME, static_cast<unsigned int>(strlen(ACCEPT_ENCODING_KEY_NAME)),
+        &HttpProcessor::ParseAcceptEncoding },
+    { UPGRADE_KEY_NAME, static_cast<unsigned int>(strlen(UPGRADE_KEY_NAME)), &HttpProcessor::ParseUpgrade },
+    { WEBSOCKET_KEY_KEY_NAME, static_cast<unsigned int>(strlen(WEBSOCKET_KEY_KEY_NAME)),
+        &HttpProcessor::ParseWebSocketKey },
+    { WEBSOCKET_VERSION_KEY_NAME, static_cast<unsigned int>(strlen(WEBSOCKET_VERSION_KEY_NAME)),
+        &HttpProcessor::ParseWebSocketVersion },
+};
+const unsigned int HttpProcessor::m_headFieldParserListSize = sizeof(m_headFieldParserList) /
+    sizeof(m_headFieldParserList[0]);
+
+bool PrebuiltResponse::Init(const ResponseStatusCode statusCode, const unsigned int retryAfter)
+{
+    for (unsigned int i = 0; i < ERROR_STATUS_INFO_LIST_SIZE; ++i) {
+        const StatusInfo &statusInfo = ERROR_STATUS_INFO_LIST[i];
+        if (statusInfo.statusCode != statusCode) {
+            continue;
+        }
+        char head[MAX_WRITE_BUFF_LEN] = { 0 };
+        int ret = snprintf(head, sizeof(head), "%s %d %s\r\nContent-Length: %zu\r\nConnection: %s\r\n"
+            "Retry-After: %u\r\n\r\n", DEFAULT_HTTP_VERSION, statusInfo.statusCode, statusInfo.statusTitle,
+            strlen(statusInfo.statusContent), CLOSE_ALIVE_VALUE, retryAfter);
+        if (ret < 0 || static_cast<unsigned int>(ret) >= sizeof(head)) {
+            printf("ERROR Build response fail, statusCode = %u.\n", statusCode);
+            return false;
+        }
+        m_response = head;
+        m_response += statusInfo.statusContent;
+        return true;
+    }
+    printf("ERROR Invalid statusCode: %u.\n", statusCode);
+    return false;
+}
+
+bool PrebuiltResponse::Send(const int socketId) const
+{
+    ssize_t ret = send(socketId, m_response.data(), m_response.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+    return ret == static_cast<ssize_t>(m_response.size());
+}
+
+HttpProcessor::HttpProcessor(const int socketId, const std::shared_ptr<const HttpProcessorContext> &context)
+    : m_context(context), m_readBuffLen(context->readBuffLen), m_socketId(socketId),
+      m_traceId(RequestTrace::Sample()), m_captureId(TrafficCapture::Open())
+{
+    Trace(TRACE_POINT_ACCEPT);
+}
 
 HttpProcessor::~HttpProcessor()
-{}
+{
+    delete m_webSocket;
+    delete m_sseSubscriber;
+    ReleaseFile();
+    DetachBuffer();
+    if (m_captureId != 0) {
+        TrafficCapture::Close(m_captureId);
+    }
+}
+
+size_t HttpProcessor::GetBufferSize(const unsigned int readBuffLen)
+{
+    return sizeof(RequestLogInfo) + MAX_WRITE_BUFF_LEN + MAX_FILE_NAME_LEN + readBuffLen + 1; // 1表示请求报文的结束符
+}
+
+bool HttpProcessor::AttachBuffer()
+{
+    if (m_buffer != nullptr) {
+        return true;
+    }
+    m_buffer = m_context->bufferPool->Acquire(GetBufferSize(m_readBuffLen));
+    if (m_buffer == nullptr) {
+        printf("ERROR Acquire buffer fail, socket id = %d\n", m_socketId);
+        return false;
+    }
+    // 缓冲区可能是其他连接用过的，只需要清空各部分的开头，之后的写入都会带结束符
+    if (AccessLog::IsEnabled()) {
+        m_logInfo = reinterpret_cast<RequestLogInfo *>(m_buffer);
+        memset(m_logInfo, 0, sizeof(RequestLogInfo));
+    }
+    m_writeBuff = m_buffer + sizeof(RequestLogInfo);
+    m_filePath = m_writeBuff + MAX_WRITE_BUFF_LEN;
+    m_request = m_filePath + MAX_FILE_NAME_LEN;
+    m_writeBuff[0] = END_CHAR;
+    m_filePath[0] = END_CHAR;
+    m_request[0] = END_CHAR;
+    m_parseStartPos = m_request;
+    return true;
+}
+
+void HttpProcessor::DetachBuffer()
+{
+    if (m_buffer == nullptr) {
+        return;
+    }
+    m_context->bufferPool->Release(m_buffer, GetBufferSize(m_readBuffLen));
+    m_buffer = nullptr;
+    m_logInfo = nullptr;
+    m_writeBuff = nullptr;
+    m_filePath = nullptr;
+    m_request = nullptr;
+    m_parseStartPos = nullptr;
+}
 
 bool HttpProcessor::ProcessReadEvent()
 {
-    ParseRequestReturnCode ret = ParseRequest();
-    printf("EVENT ParseRequest ret = %u\n", ret);
-    return Response(ret);
+    (void)ParseReadEvent();
+    return RespondReadEvent();
+}
+
+ParseRequestReturnCode HttpProcessor::ParseReadEvent()
+{
+    m_parseReturnCode = ParseRequest();
+    HTTP_PROBE4(parse, this, m_socketId, m_requestSeq, m_parseReturnCode);
+    printf("EVENT ParseRequest ret = %u\n", m_parseReturnCode);
+    if (m_parseReturnCode == PARSE_REQUEST_RETURN_CODE_FINISH || m_parseReturnCode == PARSE_REQUEST_RETURN_CODE_ERROR) {
+        Trace(TRACE_POINT_PARSE_END);
+    }
+    return m_parseReturnCode;
+}
+
+bool HttpProcessor::RespondReadEvent()
+{
+    return Response(m_parseReturnCode);
+}
+
+bool HttpProcessor::IsHeavyRequest(const unsigned int maxRequestLen, const unsigned int maxFileSize)
+{
+    if (m_parseReturnCode != PARSE_REQUEST_RETURN_CODE_FINISH) {
+        return false; // 错误请求只需要回复错误信息
+    }
+    if (m_currentRequestSize > maxRequestLen) {
+        return true;
+    }
+    const AssetBundleEntry *entry = FindAsset();
+    if (entry != nullptr) {
+        return m_context->assetBundle->GetVariant(entry, m_acceptGzip).bodyLength > maxFileSize;
+    }
+    if (m_fileStatValid) {
+        return S_ISREG(m_fileStat.st_mode) && m_fileStat.st_size > maxFileSize;
+    }
+    if (!GetFilePath(m_filePath, MAX_FILE_NAME_LEN)) {
+        return false;
+    }
+    m_fileStatValid = stat(m_filePath, &m_fileStat) == 0;
+    return m_fileStatValid && S_ISREG(m_fileStat.st_mode) && m_fileStat.st_size > maxFileSize;
+}
+
+bool HttpProcessor::GetFilePath(char *filePath, const unsigned int filePathLen) const
+{
+    int ret = snprintf(filePath, filePathLen, "%s%s", m_context->sourceDir.c_str(), m_url);
+    if (ret < 0 || static_cast<unsigned int>(ret) >= filePathLen) {
+       printf("ERROR Get file path fail, dir:%s, url:%s.\n", m_context->sourceDir.c_str(), m_url);
+       return false;
+    }
+    return true;
+}
+
+void HttpProcessor::SetBusy()
+{
+    m_dispatchState.store(PROCESSOR_DISPATCH_STATE_BUSY, std::memory_order_release);
+}
+
+bool HttpProcessor::IsBusy() const
+{
+    return m_dispatchState.load(std::memory_order_acquire) != PROCESSOR_DISPATCH_STATE_IDLE;
+}
+
+bool HttpProcessor::PauseEvents()
+{
+    unsigned char expected = PROCESSOR_DISPATCH_STATE_BUSY;
+    return m_dispatchState.compare_exchange_strong(expected, PROCESSOR_DISPATCH_STATE_EVENTS_PAUSED,
+        std::memory_order_acq_rel);
+}
+
+bool HttpProcessor::ClearBusy()
+{
+    return m_dispatchState.exchange(PROCESSOR_DISPATCH_STATE_IDLE, std::memory_order_acq_rel) ==
+        PROCESSOR_DISPATCH_STATE_EVENTS_PAUSED;
+}
+
+CompletionNode *HttpProcessor::GetCompletionNode()
+{
+    return &m_completionNode;
+}
+
+bool HttpProcessor::IsIdle() const
+{
+    return m_currentRequestSize == 0 && m_leftRespSize == 0;
+}
+
+WebSocketConnection *HttpProcessor::GetWebSocket() const
+{
+    return m_webSocket;
+}
+
+SseSubscriber *HttpProcessor::GetSseSubscriber() const
+{
+    return m_sseSubscriber;
+}
+
+void HttpProcessor::SetClientKey(const unsigned long long clientKey)
+{
+    m_clientKey = clientKey;
+}
+
+unsigned long long HttpProcessor::GetClientKey() const
+{
+    return m_clientKey;
+}
+
+void HttpProcessor::SetPeerName(const char *peerName)
+{
+    snprintf(m_peerName, sizeof(m_peerName), "%s", peerName);
+}
+
+bool HttpProcessor::PeekUrl(const char *&url, unsigned int &urlLen) const
+{
+    if (m_request == nullptr) {
+        return false;
+    }
+    const char *end = m_request + m_currentRequestSize;
+    const char *methodEnd = reinterpret_cast<const char *>(memchr(m_request, ' ', m_currentRequestSize));
+    if (methodEnd == nullptr) {
+        return false;
+    }
+    url = methodEnd + 1;
+    const char *urlEnd = reinterpret_cast<const char *>(memchr(url, ' ', end - url));
+    if (urlEnd == nullptr) {
+        return false;
+    }
+    urlLen = static_cast<unsigned int>(urlEnd - url);
+    return true;
+}
+
+// 资源包在启动时已提示内核预读，只检查source_dir中的文件
+bool HttpProcessor::GetColdFile(const char *&path, off_t &length) const
+{
+    if (m_fileAddr == nullptr || m_fileFromBundle || m_filePath == nullptr ||
+        DiskIoPool::IsResident(m_fileAddr, m_fileSize)) {
+        return false;
+    }
+    path = m_filePath;
+    length = m_fileSize;
+    return true;
 }
 
 RecvRequestReturnCode HttpProcessor::Read()
 {
-    ssize_t readSize = read(m_socketId, m_request + m_currentRequestSize, MAX_READ_BUFF_LEN - m_currentRequestSize);
-    if (readSize <= 0) {
-        if (errno == EAGAIN) {
+    if (!AttachBuffer()) {
+        return RECV_REQUEST_RETURN_CODE_ERROR;
+    }
+    ssize_t readSize = read(m_socketId, m_request + m_currentRequestSize, m_readBuffLen - m_currentRequestSize);
+    if (readSize == 0) {
+        printf("EVENT client closed, socket id = %d\n", m_socketId);
+        return RECV_REQUEST_RETURN_CODE_ERROR;
+    }
+    if (readSize < 0) {
+        if (errno == EAGAIN || errno == EINTR) {
+            if (m_currentRequestSize == 0) {
+                DetachBuffer(); // 没有收到任何数据，连接仍然空闲
+            }
             return RECV_REQUEST_RETURN_CODE_AGAIN;
         }
         printf("ERROR read fail, socket id = %d\n", m_socketId);
         return RECV_REQUEST_RETURN_CODE_ERROR;
     }
+    if (m_captureId != 0) {
+        TrafficCapture::Data(m_captureId, m_request + m_currentRequestSize, readSize);
+    }
     m_currentRequestSize += readSize;
+    m_request[m_currentRequestSize] = END_CHAR;
+    Trace(TRACE_POINT_READ);
+    HTTP_PROBE4(read, this, m_socketId, m_requestSeq, readSize);
 
-    struct sockaddr_in clientAddr = { 0 };
-    socklen_t clientAddrLen = sizeof(clientAddr);
-    if (getpeername(m_socketId, reinterpret_cast<struct sockaddr *>(&clientAddr), &clientAddrLen) == -1) {
-        printf("\nDEBUG  client[%u] recv msg:\n%s\n", m_socketId, m_request);
-    } else {
-    printf("\nDEBUG  client[%u] %s:%hu recv msg:\n%s\n", m_socketId, inet_ntoa(clientAddr.sin_addr),
-        ntohs(clientAddr.sin_port), m_request);
-    }
+    printf("\nDEBUG  client[%u] %s recv msg:\n%s\n", m_socketId, m_peerName, m_request);
 
     return RECV_REQUEST_RETURN_CODE_SUCCESS;
 }
@@ -82,42 +347,63 @@ SendResponseReturnCode HttpProcessor::Write()
         printf("ERROR No content need to send.\n");
         return SEND_RESPONSE_RETURN_CODE_ERROR;
     }
-    struct sockaddr_in clientAddr = { 0 };
-    socklen_t clientAddrLen = sizeof(clientAddr);
-    if (getpeername(m_socketId, reinterpret_cast<struct sockaddr *>(&clientAddr), &clientAddrLen) == -1) {
-        printf("DEBUG client[%u] msg to send:\n", m_socketId);
-    } else {
-    printf("DEBUG client[%u] %s:%hu msg to send:\n", m_socketId, inet_ntoa(clientAddr.sin_addr),
-        ntohs(clientAddr.sin_port));
-    }
+    printf("DEBUG client[%u] %s msg to send:\n", m_socketId, m_peerName);
     printf("%s", m_writeBuff);
     if (m_cnt == VECTOR_COUNT) {
-        printf("%s", m_fileAddr);
+        printf("%.*s", static_cast<int>(m_fileSize), m_fileAddr);
     }
     printf("\n");
     ssize_t ret;
+    struct msghdr msg = { 0 };
     while (true) {
-        ret = writev(m_socketId, m_iov, m_cnt);
+        // 状态行、头部和消息体在一次系统调用中交给内核，小回复在同一个报文段中发出
+        // 对端已关闭时返回EPIPE，不产生SIGPIPE
+        msg.msg_iov = m_iov;
+        msg.msg_iovlen = m_cnt;
+        ret = sendmsg(m_socketId, &msg, MSG_NOSIGNAL);
         // 发送回复消息异常
         if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
             if (errno == EAGAIN) {
                 return SEND_RESPONSE_RETURN_CODE_AGAIN;
             }
-            munmap(m_fileAddr, m_fileSize);
-            m_fileAddr = nullptr;
-            m_fileSize = 0;
+            ReleaseFile();
             return SEND_RESPONSE_RETURN_CODE_ERROR;
         }
         unsigned int writeSize = static_cast<unsigned int >(ret);
         if (writeSize > m_leftRespSize) {
             return SEND_RESPONSE_RETURN_CODE_ERROR;
         }
+        if (!m_traceFirstByte) {
+            m_traceFirstByte = true;
+            Trace(TRACE_POINT_FIRST_BYTE);
+        }
         m_leftRespSize -= writeSize;
         // 发送回复消息完成
         if (m_leftRespSize == 0) {
-            munmap(m_fileAddr, m_fileSize);
-            m_fileAddr = nullptr;
-            m_fileSize = 0;
+            Trace(TRACE_POINT_LAST_BYTE);
+            HTTP_PROBE4(write, this, m_socketId, m_requestSeq,
+                m_writeSize + (m_cnt == VECTOR_COUNT ? m_fileSize : 0));
+            if (m_logInfo != nullptr) {
+                WriteAccessLog();
+            }
+            ReleaseFile();
+            // 握手完成，请求缓冲区归还，之后的帧由WebSocket连接处理
+            if (m_webSocketHandler != nullptr) {
+                WebSocketHandler *handler = m_webSocketHandler;
+                Init();
+                m_webSocket = new WebSocketConnection(m_socketId, handler, m_context->webSocketMaxMessage);
+                return SEND_RESPONSE_RETURN_CODE_UPGRADE;
+            }
+            if (m_sseMatched) {
+                unsigned int channel = m_sseChannel;
+                Init();
+                m_sseSubscriber = new SseSubscriber(m_socketId, channel, m_context->sseMaxQueue,
+                    m_context->sseDropSlow);
+                return SEND_RESPONSE_RETURN_CODE_STREAM;
+            }
             if (m_keepAlive) {
                 Init();
                 return SEND_RESPONSE_RETURN_CODE_NEXT;
@@ -132,19 +418,52 @@ SendResponseReturnCode HttpProcessor::Write()
                 reinterpret_cast<void *>(reinterpret_cast<char *>(m_iov[CONTENT_VECTOR_INDEX].iov_base) + contentVectorOffset);
             m_iov[CONTENT_VECTOR_INDEX].iov_len -= contentVectorOffset;
         } else {
-            m_iov[STATUS_LINE_AND_HEAD_FIELD_VECTOR_INDEX].iov_base =
-                reinterpret_cast<void *>(reinterpret_cast<char *>(m_iov[CONTENT_VECTOR_INDEX].iov_base) + writeSize);
+            m_iov[STATUS_LINE_AND_HEAD_FIELD_VECTOR_INDEX].iov_base = reinterpret_cast<void *>(
+                reinterpret_cast<char *>(m_iov[STATUS_LINE_AND_HEAD_FIELD_VECTOR_INDEX].iov_base) + writeSize);
             m_iov[STATUS_LINE_AND_HEAD_FIELD_VECTOR_INDEX].iov_len -= writeSize;                
         }
     }
     return SEND_RESPONSE_RETURN_CODE_ERROR;
 }
 
+void HttpProcessor::ReleaseFile()
+{
+    if (m_fileAddr != nullptr && !m_fileFromBundle) {
+        munmap(m_fileAddr, m_fileSize);
+    }
+    m_fileAddr = nullptr;
+    m_fileSize = 0;
+    m_fileFromBundle = false;
+}
+
+// 回复字节数按构造回复时的长度计算，连接中途断开的请求不记录
+void HttpProcessor::WriteAccessLog() const
+{
+    AccessLogEntry entry;
+    entry.method = m_method;
+    entry.url = m_url;
+    entry.peer = m_peerName;
+    entry.status = m_logInfo->status;
+    entry.bytes = m_writeSize + (m_cnt == VECTOR_COUNT ? m_fileSize : 0);
+    entry.flags = 0;
+    if (m_keepAlive) {
+        entry.flags |= ACCESS_LOG_FLAG_KEEP_ALIVE;
+    }
+    if (m_fileFromBundle) {
+        entry.flags |= ACCESS_LOG_FLAG_BUNDLE;
+    }
+    if (m_logInfo->time[TRACE_POINT_ENQUEUE] != 0) {
+        entry.flags |= ACCESS_LOG_FLAG_POOLED;
+    }
+    entry.info = m_logInfo;
+    AccessLog::Append(entry);
+}
+
+// 请求处理完成，连接回到空闲状态并归还缓冲区
 void HttpProcessor::Init()
 {
-    memset(m_request, 0, sizeof(m_request));
+    DetachBuffer();
     m_currentRequestSize = 0;
-    m_parseStartPos = m_request;
     m_currentIndex = 0;
     m_processState = HTTP_PROCESS_STATE_PARSE_REQUEST_LINE;
     m_method = nullptr;
@@ -152,13 +471,29 @@ void HttpProcessor::Init()
     m_httpVersion = nullptr;
     m_contentLen = 0;
     m_keepAlive = false;
-    memset(m_writeBuff, 0, sizeof(m_writeBuff));
+    m_ifNoneMatch = nullptr;
+    m_acceptGzip = false;
+    m_connectionUpgrade = false;
+    m_upgradeWebSocket = false;
+    m_webSocketKey = nullptr;
+    m_webSocketVersion = 0;
+    m_webSocketHandler = nullptr;
+    m_sseMatched = false;
+    m_sseChannel = 0;
     m_writeSize = 0;
     m_fileAddr = nullptr;
     m_fileSize = 0;
     memset(m_iov, 0, sizeof(m_iov));
     m_cnt = 0;
     m_leftRespSize = 0; // 剩余回复字节数
+    m_parseReturnCode = PARSE_REQUEST_RETURN_CODE_CONTINUE;
+    m_fileStatValid = false;
+    m_assetEntry = nullptr;
+    m_assetLookedUp = false;
+    m_fileFromBundle = false;
+    m_traceId = RequestTrace::Sample(); // 长连接上的下一个请求重新抽样
+    m_traceFirstByte = false;
+    m_requestSeq++;
 }
 
 ParseRequestReturnCode HttpProcessor::ParseRequest()
@@ -294,18 +629,16 @@ ParseRequestReturnCode HttpProcessor::ParseHeadFields()
         return PARSE_REQUEST_RETURN_CODE_FINISH;
     }
 
-    for (auto iter = m_keyNameAndParseFuncMap.begin(); iter != m_keyNameAndParseFuncMap.end(); ++iter) {
-        if (strncasecmp(m_parseStartPos, iter->first, strlen(iter->first)) != 0) {
+    for (unsigned int i = 0; i < m_headFieldParserListSize; ++i) {
+        const HeadFieldParser &parser = m_headFieldParserList[i];
+        // 名称只是前缀相同的头部(如Upgrade-Insecure-Requests)不是要解析的字段
+        if (strncasecmp(m_parseStartPos, parser.keyName, parser.keyNameLen) != 0 ||
+            m_parseStartPos[parser.keyNameLen] != HEAD_FIELD_SPLIT_CHAR) {
             continue;
         }
-        m_parseStartPos += strlen(iter->first);
-        if (*m_parseStartPos != HEAD_FIELD_SPLIT_CHAR) {
-            printf("ERROR invalid head field:%s.\n", m_parseStartPos);
-            return PARSE_REQUEST_RETURN_CODE_ERROR;
-        }
-        m_parseStartPos += 1; // 跳过':'
+        m_parseStartPos += parser.keyNameLen + 1; // 跳过':'
         m_parseStartPos += strspn(m_parseStartPos, "\t ");
-        (this->*iter->second)();
+        (this->*parser.parseFunc)();
         m_parseStartPos += (strlen(m_parseStartPos) + 2); // 2表示跳过\r\n
         return PARSE_REQUEST_RETURN_CODE_CONTINUE;
     }
@@ -319,19 +652,56 @@ void HttpProcessor::ParseContentLength()
     printf("INFO m_contentLen:%u\n", m_contentLen);
 }
 
+// 值是逗号分隔的列表，浏览器发起WebSocket握手时可能是"keep-alive, Upgrade"
 void HttpProcessor::ParseConnection()
 {
-    if (strcasecmp(m_parseStartPos, KEEP_ALIVE_VALUE) == 0) {
-        m_keepAlive = true;
+    char *token = m_parseStartPos;
+    while (*token != END_CHAR) {
+        size_t tokenLen = strcspn(token, CONNECTION_TOKEN_SPLIT_CHARS);
+        if (tokenLen == strlen(KEEP_ALIVE_VALUE) && strncasecmp(token, KEEP_ALIVE_VALUE, tokenLen) == 0) {
+            m_keepAlive = true;
+        } else if (tokenLen == strlen(UPGRADE_VALUE) && strncasecmp(token, UPGRADE_VALUE, tokenLen) == 0) {
+            m_connectionUpgrade = true;
+        }
+        token += tokenLen;
+        token += strspn(token, CONNECTION_TOKEN_SPLIT_CHARS);
     }
     printf("INFO m_keepAlive:%u\n", m_keepAlive);
 }
 
+void HttpProcessor::ParseIfNoneMatch()
+{
+    m_ifNoneMatch = m_parseStartPos;
+    printf("INFO m_ifNoneMatch:%s\n", m_ifNoneMatch);
+}
+
+// 只区分是否接受gzip，不处理q值
+void HttpProcessor::ParseAcceptEncoding()
+{
+    m_acceptGzip = strcasestr(m_parseStartPos, GZIP_ENCODING_VALUE) != nullptr;
+    printf("INFO m_acceptGzip:%u\n", m_acceptGzip);
+}
+
+void HttpProcessor::ParseUpgrade()
+{
+    m_upgradeWebSocket = strcasecmp(m_parseStartPos, WEBSOCKET_VALUE) == 0;
+}
+
+void HttpProcessor::ParseWebSocketKey()
+{
+    m_webSocketKey = m_parseStartPos;
+}
+
+void HttpProcessor::ParseWebSocketVersion()
+{
+    m_webSocketVersion = static_cast<unsigned int>(atoi(m_parseStartPos));
+}
+
 ParseRequestReturnCode HttpProcessor::ParseContent()
 {
     unsigned int parseSize = m_parseStartPos - m_request; // 请求体前面信息所占字节数
     // 消息体所占字节数必须小于读缓冲区的剩余空间大小，预留一个结束符
-    if (m_contentLen >= sizeof(m_request) - parseSize) {
+    if (m_contentLen >= m_readBuffLen + 1 - parseSize) {
         printf("ERROR invalid Content-Length, m_contentLen = %u, parseSize = %u\n",
             m_contentLen, parseSize);
         return PARSE_REQUEST_RETURN_CODE_ERROR;
@@ -351,6 +721,8 @@ bool HttpProcessor::Response(const ParseRequestReturnCode returnCode)
     switch (returnCode) {
         case PARSE_REQUEST_RETURN_CODE_FINISH: {
             ResponseStatusCode statusCode = HandleRequest();
+            Trace(TRACE_POINT_HANDLE_END);
+            HTTP_PROBE6(handle, this, m_socketId, m_requestSeq, statusCode, m_url, m_fileSize);
             return FillResp(statusCode);
         }
         case PARSE_REQUEST_RETURN_CODE_ERROR: {
@@ -366,17 +738,74 @@ bool HttpProcessor::Response(const ParseRequestReturnCode returnCode)
     return false;
 }
 
+// URL去掉查询参数后在资源包中查找，每个请求只查找一次
+const AssetBundleEntry *HttpProcessor::FindAsset()
+{
+    if (m_assetLookedUp) {
+        return m_assetEntry;
+    }
+    m_assetLookedUp = true;
+    const AssetBundle *assetBundle = m_context->assetBundle;
+    if (assetBundle == nullptr || !assetBundle->IsOpen()) {
+        return nullptr;
+    }
+    m_assetEntry = assetBundle->Find(m_url, strcspn(m_url, URL_QUERY_CHARS));
+    return m_assetEntry;
+}
+
+// 资源包中的文件只需要查找哈希表和设置指针，不产生文件系统调用
+ResponseStatusCode HttpProcessor::HandleAssetRequest()
+{
+    if (m_ifNoneMatch != nullptr &&
+        (strcmp(m_ifNoneMatch, ANY_ETAG_VALUE) == 0 || strstr(m_ifNoneMatch, m_assetEntry->etag) != nullptr)) {
+        return RESPONSE_STATUS_CODE_NOT_MODIFIED;
+    }
+    const AssetBundle *assetBundle = m_context->assetBundle;
+    const AssetBundleVariant &variant = assetBundle->GetVariant(m_assetEntry, m_acceptGzip);
+    m_fileAddr = const_cast<char *>(assetBundle->GetData(variant));
+    m_fileSize = variant.length;
+    m_fileFromBundle = true;
+    return RESPONSE_STATUS_CODE_OK;
+}
+
+bool HttpProcessor::HandleWebSocketUpgrade(ResponseStatusCode &statusCode)
+{
+    WebSocketHandler *handler = m_context->webSocketRouter.Match(m_url, strcspn(m_url, URL_QUERY_CHARS));
+    if (handler == nullptr) {
+        return false;
+    }
+    if (!m_connectionUpgrade || m_webSocketKey == nullptr || strlen(m_webSocketKey) != WEBSOCKET_KEY_LEN ||
+        m_webSocketVersion != WEBSOCKET_VERSION) {
+        printf("ERROR Invalid websocket handshake, url:%s.\n", m_url);
+        statusCode = RESPONSE_STATUS_CODE_BAD_REQUEST;
+        return true;
+    }
+    m_webSocketHandler = handler;
+    statusCode = RESPONSE_STATUS_CODE_SWITCHING_PROTOCOLS;
+    return true;
+}
+
 ResponseStatusCode HttpProcessor::HandleRequest()
 {
-    char filePath[MAX_FILE_NAME_LEN] = { 0 };
-    int ret = sprintf(filePath, "%s%s", m_sourceDir.c_str(), m_url);
-    if (ret == -1) {
-       printf("ERROR Get file path fail, dir:%s, url:%s.\n", m_sourceDir.c_str(), m_url);
+    ResponseStatusCode upgradeStatusCode = RESPONSE_STATUS_CODE_OK;
+    if (m_upgradeWebSocket && HandleWebSocketUpgrade(upgradeStatusCode)) {
+        return upgradeStatusCode;
+    }
+    if (m_context->sseRouter.HasRoutes() &&
+        m_context->sseRouter.Match(m_url, strcspn(m_url, URL_QUERY_CHARS), m_sseChannel)) {
+        m_sseMatched = true;
+        return RESPONSE_STATUS_CODE_OK;
+    }
+    if (FindAsset() != nullptr) {
+        return HandleAssetRequest();
+    }
+    char *filePath = m_filePath;
+    if (!m_fileStatValid && !GetFilePath(m_filePath, MAX_FILE_NAME_LEN)) {
        return RESPONSE_STATUS_CODE_INTERNAL_SERVER_ERROR;
     }
 
-    struct stat fileStat{ 0 };
-    if (stat(filePath, &fileStat) == -1) {
+    struct stat &fileStat = m_fileStat;
+    if (!m_fileStatValid && stat(filePath, &fileStat) == -1) {
        printf("ERROR Get file stat fail, path:%s.\n", filePath);
        return RESPONSE_STATUS_CODE_NOT_FOUND;    
     }
@@ -404,8 +833,17 @@ ResponseStatusCode HttpProcessor::HandleRequest()
 
 bool HttpProcessor::FillResp(const ResponseStatusCode statusCode)
 {
+    if (m_logInfo != nullptr) {
+        m_logInfo->status = statusCode;
+    }
     if (statusCode == RESPONSE_STATUS_CODE_OK) {
-        return FillRespInNormalCase();
+        return m_sseMatched ? FillRespEventStream() : FillRespInNormalCase();
+    }
+    if (statusCode == RESPONSE_STATUS_CODE_NOT_MODIFIED) {
+        return FillRespNotModified();
+    }
+    if (statusCode == RESPONSE_STATUS_CODE_SWITCHING_PROTOCOLS) {
+        return FillRespSwitchingProtocols();
     }
     for (unsigned int i = 0; i < ERROR_STATUS_INFO_LIST_SIZE; ++i) {
         if (statusCode == ERROR_STATUS_INFO_LIST[i].statusCode) {
@@ -422,7 +860,8 @@ bool HttpProcessor::FillRespInNormalCase()
     if (!AddStatusLine(RESPONSE_STATUS_CODE_OK, OK_TITLE)) {
         return false;
     }
-    if (!AddHeadField(m_fileSize)) {
+    // 资源包中的变体以预置的头部和空行开头，这里只添加连接方式
+    if (m_fileFromBundle ? !AddConnectionField() : !AddHeadField(m_fileSize)) {
         return false;
     }
 
@@ -454,6 +893,77 @@ bool HttpProcessor::FillRespInErrorCase(const StatusInfo statusInfo)
     return true;
 }
 
+bool HttpProcessor::FillRespNotModified()
+{
+    if (!AddStatusLine(RESPONSE_STATUS_CODE_NOT_MODIFIED, NOT_MODIFIED_TITLE)) {
+        return false;
+    }
+    int ret = sprintf(m_writeBuff + m_writeSize, "ETag: %s\r\n", m_assetEntry->etag);
+    if (ret == -1) {
+        printf("ERROR Write buffer fail.\n");
+        return false;
+    }
+    m_writeSize += static_cast<unsigned int>(ret);
+    if (!AddConnectionField()) {
+        return false;
+    }
+    ret = sprintf(m_writeBuff + m_writeSize, "\r\n");
+    if (ret == -1) {
+        printf("ERROR Write buffer fail.\n");
+        return false;
+    }
+    m_writeSize += static_cast<unsigned int>(ret);
+
+    m_iov[STATUS_LINE_AND_HEAD_FIELD_VECTOR_INDEX].iov_base = m_writeBuff;
+    m_iov[STATUS_LINE_AND_HEAD_FIELD_VECTOR_INDEX].iov_len = m_writeSize;
+    m_cnt = 1;
+    m_leftRespSize = m_writeSize;
+    return true;
+}
+
+bool HttpProcessor::FillRespSwitchingProtocols()
+{
+    if (!AddStatusLine(RESPONSE_STATUS_CODE_SWITCHING_PROTOCOLS, SWITCHING_PROTOCOLS_TITLE)) {
+        return false;
+    }
+    char accept[WEBSOCKET_ACCEPT_LEN + 1];
+    WebSocketCodec::ComputeAccept(m_webSocketKey, accept);
+    int ret = sprintf(m_writeBuff + m_writeSize, "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: %s\r\n\r\n", accept);
+    if (ret == -1) {
+        printf("ERROR Write buffer fail.\n");
+        return false;
+    }
+    m_writeSize += static_cast<unsigned int>(ret);
+
+    m_iov[STATUS_LINE_AND_HEAD_FIELD_VECTOR_INDEX].iov_base = m_writeBuff;
+    m_iov[STATUS_LINE_AND_HEAD_FIELD_VECTOR_INDEX].iov_len = m_writeSize;
+    m_cnt = 1;
+    m_leftRespSize = m_writeSize;
+    return true;
+}
+
+// 事件流没有长度，头部之后的数据都由订阅者推送
+bool HttpProcessor::FillRespEventStream()
+{
+    if (!AddStatusLine(RESPONSE_STATUS_CODE_OK, OK_TITLE)) {
+        return false;
+    }
+    int ret = sprintf(m_writeBuff + m_writeSize, "Content-Type: text/event-stream\r\nCache-Control: no-cache\r\n"
+        "Connection: keep-alive\r\nX-Accel-Buffering: no\r\n\r\n");
+    if (ret == -1) {
+        printf("ERROR Write buffer fail.\n");
+        return false;
+    }
+    m_writeSize += static_cast<unsigned int>(ret);
+
+    m_iov[STATUS_LINE_AND_HEAD_FIELD_VECTOR_INDEX].iov_base = m_writeBuff;
+    m_iov[STATUS_LINE_AND_HEAD_FIELD_VECTOR_INDEX].iov_len = m_writeSize;
+    m_cnt = 1;
+    m_leftRespSize = m_writeSize;
+    return true;
+}
+
 bool HttpProcessor::AddStatusLine(const int status, const char *title)
 {
     int ret = sprintf(m_writeBuff, "%s %d %s\r\n",
@@ -481,14 +991,22 @@ bool HttpProcessor::AddHeadField(const unsigned int contentLen)
     }
     m_writeSize += static_cast<unsigned int>(ret);
     // 添加连接方式
-    ret = sprintf(m_writeBuff + m_writeSize, "Connection: %s\r\n", m_keepAlive ? KEEP_ALIVE_VALUE : CLOSE_ALIVE_VALUE);
+    if (!AddConnectionField()) {
+        return false;
+    }
+    // 添加空行
+    ret = sprintf(m_writeBuff + m_writeSize, "\r\n");
     if (ret == -1) {
         printf("ERROR Write buffer fail.\n");
         return false;
     }
     m_writeSize += static_cast<unsigned int>(ret);
-    // 添加空行
-    ret = sprintf(m_writeBuff + m_writeSize, "\r\n");
+    return true;
+}
+
+bool HttpProcessor::AddConnectionField()
+{
+    int ret = sprintf(m_writeBuff + m_writeSize, "Connection: %s\r\n", m_keepAlive ? KEEP_ALIVE_VALUE : CLOSE_ALIVE_VALUE);
     if (ret == -1) {
         printf("ERROR Write buffer fail.\n");
         return false;
@@ -1,11 +1,14 @@
 #include <sys/socket.h>
-#include <arpa/inet.h>
 #include <sys/epoll.h>
+#include <sys/wait.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <signal.h>
 #include <errno.h>
 #include <time.h>
+#include <string.h>
+#include "listener_handoff.h"
+#include "cpu_affinity.h"
 #include "http_server.h"
 
 enum PipeFdIdx {
@@ -14,13 +17,16 @@ enum PipeFdIdx {
 };
 
 const unsigned int CLIENT_EXPIRE_MIN_HEAP_DEFAULT_SIZE = 10; // 客户端过期时间最小堆默认大小为10
-const unsigned int TIMER_INTERVAL = 5; // 定时器间隔设置为5秒
-const unsigned int CLIENT_EXPIRE_INTERVAL = TIMER_INTERVAL * 3; // 客户端过期时间间隔设置为3个定时器间隔
-const unsigned int HANDLE_REQUEST_THREAD_NUM = 5; // 处理请求线程数量为5
+const unsigned long long NSEC_PER_SEC = 1000000000ULL;
+const unsigned int PROCESSOR_SLAB_SIZE = 256; // 每次为256个连接分配处理对象
+const unsigned int BUFFER_POOL_MAX_FREE_NUM = 1024; // 最多缓存1024个空闲缓冲区，约4MB
+const unsigned int SSE_READ_BUFF_LEN = 512; // 订阅者不会发送数据，读到的内容直接丢弃
+const unsigned int SSE_STATS_BUFF_LEN = 1024;
+const unsigned int UPGRADE_READY_TIMEOUT = 30; // 新进程30秒内没有初始化完成时认为升级失败
 
 int HttpServer::m_pipefd[PIPE_FD_NUM] { -1, -1 };
 
-HttpServer::HttpServer() : m_threadPool(HANDLE_REQUEST_THREAD_NUM)
+HttpServer::HttpServer() : m_processorPool(PROCESSOR_SLAB_SIZE), m_threadPool(DEFAULT_THREAD_NUM)
 {}
 
 HttpServer::~HttpServer()
@@ -34,18 +40,33 @@ HttpServer &HttpServer::GetInstance()
     return httpServer;
 }
 
-void HttpServer::Run(const char *ipAddr, const unsigned short int portId,  const unsigned int backlog,
-    const int epollSize, const char *sourceDir)
+void HttpServer::Run(HttpConfig &config)
 {
-    if (InitServer(ipAddr, portId, backlog) == false) {
+    m_config = &config;
+    const HttpServerConfig &serverConfig = config.Get();
+    ListenerHandoff::ResolveExecutable();
+    std::vector<ListenerConfig> listeners;
+    (void)HttpConfig::GetListeners(serverConfig, listeners); // 加载配置时已经校验过
+    if (!serverConfig.assetBundle.empty()) {
+        if (m_assetBundle.Open(serverConfig.assetBundle) == false) {
+            return;
+        }
+        printf("INFO Asset bundle %s loaded, %u entries.\n", serverConfig.assetBundle.c_str(),
+            m_assetBundle.GetEntryNum());
+    }
+    // 由旧进程平滑升级启动时，从旧进程接收监听套接字
+    int inheritChannel = ListenerHandoff::GetInheritedChannel();
+    if (inheritChannel != -1) {
+        if (InheritServer(inheritChannel, listeners) == false) {
+            close(inheritChannel);
+            return;
+        }
+    } else if (InitServer(listeners) == false) {
         return;
     }
 
-    if (InitEpollFd(epollSize) == false) {
-        if (m_server != -1) {
-            close(m_server);
-            m_server = -1;
-        }
+    if (InitEpollFd() == false) {
+        m_listenerSet.Close();
         return;
     }
 
@@ -59,6 +80,11 @@ void HttpServer::Run(const char *ipAddr, const unsigned short int portId,  const
         return;        
     }
 
+    if (m_coroutineDriver.Init(m_efd) == false) {
+        clear();
+        return;
+    }
+
     if (RegisterServerReadEvent() == false) {
         clear();
         return;
@@ -71,72 +97,260 @@ void HttpServer::Run(const char *ipAddr, const unsigned short int portId,  const
         clear();
         return;
     }
-    if (m_threadPool.Init() == false) {
+    if (RegisterHandleSignal(SIGHUP) == false) {
+        clear();
+        return;
+    }
+    if (RegisterHandleSignal(SIGUSR2) == false) {
+        clear();
+        return;
+    }
+    if (RegisterHandleSignal(SIGUSR1) == false) {
+        clear();
+        return;
+    }
+    if (RegisterHandleSignal(SIGTERM) == false || RegisterHandleSignal(SIGINT) == false) {
+        clear();
+        return;
+    }
+    if (BindThreads(serverConfig) == false) {
+        clear();
+        return;
+    }
+    ApplyConfig(serverConfig);
+    if (m_completionQueue.Init() == false || RegisterCompletionEvent() == false || m_threadPool.Init() == false) {
         clear();
         return;
     }
-    alarm(TIMER_INTERVAL); // 开启定时器
-    m_sourceDir = sourceDir;
-    EventLoop(epollSize);
+    if (serverConfig.diskIoThreads != 0 &&
+        (m_diskIoPool.Init(serverConfig.diskIoThreads) == false || RegisterDiskIoEvent() == false)) {
+        clear();
+        return;
+    }
+    if (SseHub::GetInstance().Init() == false || RegisterSseEvent() == false) {
+        clear();
+        return;
+    }
+    if (AccessLog::Init(serverConfig.accessLogDir, serverConfig.accessLogFileSize * 1024ULL * 1024ULL,
+        serverConfig.accessLogFiles) == false) {
+        clear();
+        return;
+    }
+    if (TrafficCapture::Init(serverConfig.captureFile, serverConfig.captureMaxSize * 1024ULL * 1024ULL) == false) {
+        clear();
+        return;
+    }
+    if (inheritChannel != -1) {
+        // 通知旧进程停止接收新连接
+        if (ListenerHandoff::SendReady(inheritChannel) == false) {
+            printf("ERROR  Send ready to old process fail.\n");
+        }
+        close(inheritChannel);
+    }
+    alarm(m_timerInterval); // 开启定时器
+    EventLoop();
     clear();
 }
 
-bool HttpServer::InitServer(const char *ipAddr, const unsigned short int portId,  const unsigned int backlog)
+// 绑定事件循环线程，处理线程在启动时绑定自己
+// 处理对象在事件循环线程中分配并清零，按首次写入原则内存位于事件循环线程所在节点，
+// 处理线程与其绑定在同一节点上时访问处理对象不会跨节点
+bool HttpServer::BindThreads(const HttpServerConfig &config)
 {
-    if (m_server != -1) {
-        printf("ERROR  Server alreadly exists.\n");
+    std::vector<int> reactorCpus;
+    if (CpuAffinity::ParseCpuList(config.reactorCpus, reactorCpus) == false ||
+        CpuAffinity::ParseCpuList(config.workerCpus, m_workerCpus) == false) {
         return false;
     }
-
-    m_server = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (m_server == -1) {
-        printf("ERROR  Create socket fail.\n");
+    if (CpuAffinity::BindCurrentThread(reactorCpus) == false) {
+        printf("ERROR  Bind event loop thread fail: %s.\n", config.reactorCpus.c_str());
         return false;
     }
+    m_reactorNode = CpuAffinity::GetCurrentNode();
+    m_threadPool.SetThreadInitFunction(HttpServer::InitWorkerThread, this);
+    printf("EVENT  Event loop on numa node %d of %d, cpus = %s, worker cpus = %s.\n", m_reactorNode,
+        CpuAffinity::GetNodeNum(), config.reactorCpus.empty() ? "any" : config.reactorCpus.c_str(),
+        config.workerCpus.empty() ? "any" : config.workerCpus.c_str());
+    return true;
+}
 
-    if (ipAddr == nullptr) {
-        close(m_server);
-        m_server = -1;
-        printf("ERROR  ipAddr is null.\n");
-        return false;
+void HttpServer::InitWorkerThread(const unsigned int threadIdx, void *arg)
+{
+    HttpServer *httpServer = reinterpret_cast<HttpServer *>(arg);
+    if (httpServer == nullptr || httpServer->m_workerCpus.empty()) {
+        return;
     }
-    in_addr_t ipNum = inet_addr(ipAddr);
-    if (ipNum == INADDR_NONE) {
-        close(m_server);
-        m_server = -1;       
-        printf("ERROR  Invalid ip address: %s.\n", ipAddr);
-        return false;
+    int cpu = httpServer->m_workerCpus[threadIdx % httpServer->m_workerCpus.size()];
+    if (CpuAffinity::BindCurrentThread(std::vector<int> { cpu }) == false) {
+        printf("ERROR  Bind worker thread %u to cpu %d fail.\n", threadIdx, cpu);
+        return;
+    }
+    printf("EVENT  Worker thread %u bound to cpu %d, numa node %d.\n", threadIdx, cpu,
+        CpuAffinity::GetNodeOfCpu(cpu));
+}
+
+// 应用可在运行时生效的配置项，已有连接不受影响
+void HttpServer::ApplyConfig(const HttpServerConfig &config)
+{
+    m_timerInterval = config.timerInterval;
+    m_clientExpireInterval = config.clientExpireInterval;
+    // 已有连接持有旧的上下文，不受影响
+    if (m_processorContext == nullptr) {
+        m_bufferPool.Init(HttpProcessor::GetBufferSize(config.maxReadBuffLen), BUFFER_POOL_MAX_FREE_NUM);
+    }
+    if (m_processorContext == nullptr || m_processorContext->sourceDir != config.sourceDir ||
+        m_processorContext->readBuffLen != config.maxReadBuffLen ||
+        m_processorContext->webSocketRoutes != config.webSocketRoutes ||
+        m_processorContext->webSocketMaxMessage != config.webSocketMaxMessage ||
+        m_processorContext->sseRoutes != config.sseRoutes || m_processorContext->sseMaxQueue != config.sseMaxQueue ||
+        m_processorContext->sseDropSlow != (config.sseSlowPolicy == SSE_SLOW_POLICY_DROP)) {
+        m_bufferPool.SetBufferSize(HttpProcessor::GetBufferSize(config.maxReadBuffLen));
+        WebSocketRouter webSocketRouter;
+        (void)webSocketRouter.Init(config.webSocketRoutes); // 加载配置时已经校验过
+        SseRouter sseRouter;
+        (void)sseRouter.Init(config.sseRoutes);
+        m_processorContext = std::make_shared<const HttpProcessorContext>(HttpProcessorContext {
+            config.sourceDir, config.maxReadBuffLen, &m_bufferPool, &m_assetBundle, config.webSocketRoutes,
+            webSocketRouter, config.webSocketMaxMessage, config.sseRoutes, sseRouter, config.sseMaxQueue,
+            config.sseSlowPolicy == SSE_SLOW_POLICY_DROP });
+    }
+    m_sseKeepaliveInterval = config.sseKeepaliveInterval;
+    if (m_sseKeepaliveComment == nullptr) {
+        m_sseKeepaliveComment = SseEvent::CreateComment("keep-alive");
     }
+    // 已升级的连接使用新的ping间隔，读缓冲区在第一次加载配置时分配
+    m_webSocketPingInterval = config.webSocketPingInterval;
+    if (m_webSocketReadBuff.empty()) {
+        m_webSocketReadBuff.resize(WEBSOCKET_READ_BUFF_LEN);
+    }
+    m_drainTimeout = config.drainTimeout;
+    m_events.resize(config.epollSize);
+    // 线程数量会自动调整，只有thread_num变化时才重新设置
+    if (config.threadNum != m_threadNum && m_threadPool.SetThreadNum(config.threadNum) == false) {
+        printf("ERROR  Set thread num fail: %u.\n", config.threadNum);
+    }
+    m_threadNum = config.threadNum;
+    (void)m_threadPool.SetElasticLimits(config.minThreads == 0 ? config.threadNum : config.minThreads,
+        config.maxThreads == 0 ? config.threadNum : config.maxThreads,
+        static_cast<unsigned long long>(config.targetQueueWaitUs) * 1000ULL,
+        static_cast<unsigned long long>(config.threadIdleTimeout) * NSEC_PER_SEC);
+    m_threadPool.SetQueueLimit(config.maxQueuePerThread,
+        static_cast<unsigned long long>(config.maxQueueWaitMs) * 1000000ULL);
+    m_maxConnections = config.maxConnections;
+    m_refuseOnOverload = config.overloadAction == OVERLOAD_ACTION_REFUSE;
+    if (config.retryAfter != m_retryAfter) {
+        m_retryAfter = config.retryAfter;
+        (void)m_overloadResponse.Init(RESPONSE_STATUS_CODE_SERVICE_UNAVAILABLE, m_retryAfter);
+        (void)m_rateLimitResponse.Init(RESPONSE_STATUS_CODE_TOO_MANY_REQUESTS, m_retryAfter);
+    }
+    ApplyRateLimitConfig(config);
+    (void)m_dispatchPolicy.Init(config.dispatchMode, config.dispatchRoutes); // 加载配置时已经校验过
+    m_inlineMaxRequestLen = config.inlineMaxRequestLen;
+    m_inlineMaxFileSize = config.inlineMaxFileSize;
+    (void)m_lanePolicy.Init(config.laneRoutes); // 加载配置时已经校验过
+    m_largeResponseSize = config.largeResponseSize;
+    std::vector<unsigned int> laneWeights(TASK_LANE_NUM);
+    laneWeights[TASK_LANE_SMALL] = config.smallLaneWeight;
+    laneWeights[TASK_LANE_LARGE] = config.largeLaneWeight;
+    (void)m_threadPool.SetLaneWeights(laneWeights);
+    m_useCoroutine = config.connectionDriver == CONNECTION_DRIVER_COROUTINE;
+    RequestTrace::Init(config.traceSample, config.traceRingSize);
+    m_traceFile = config.traceFile;
+    ApplySocketConfig(config);
+}
 
-    struct sockaddr_in server_addr = { 0 };
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_addr.s_addr = ipNum;
-    server_addr.sin_port = htons(portId);
-    if (bind(m_server, reinterpret_cast<struct sockaddr *>(&server_addr), sizeof(server_addr)) == -1) {
-        close(m_server);
-        m_server = -1;
-        printf("ERROR  server bind fail: %s:%hu.\n", ipAddr, portId);
+// 客户端套接字的选项对新建连接生效，epoll的忙轮询参数变化时立即设置
+void HttpServer::ApplySocketConfig(const HttpServerConfig &config)
+{
+    m_connectionOptions.noDelay = config.tcpNoDelay != 0;
+    m_connectionOptions.busyPoll = config.busyPoll;
+    if (config.busyPoll == m_epollBusyPoll &&
+        (config.busyPoll == 0 || config.busyPollBudget == m_epollBusyPollBudget)) {
+        return;
+    }
+    if (SocketOptions::ApplyEpollBusyPoll(m_efd, config.busyPoll, config.busyPollBudget)) {
+        printf("EVENT  Epoll busy poll applied, busy_poll = %u, budget = %u.\n", config.busyPoll,
+            config.busyPollBudget);
+    }
+    // 设置失败时也记录，避免每次重新加载都重复告警
+    m_epollBusyPoll = config.busyPoll;
+    m_epollBusyPollBudget = config.busyPollBudget;
+}
+
+// 限流参数变化时才重建限流表，否则重新加载配置会清空所有客户端的令牌桶
+void HttpServer::ApplyRateLimitConfig(const HttpServerConfig &config)
+{
+    m_rateLimitIdleNs = static_cast<unsigned long long>(config.rateLimitIdle) * NSEC_PER_SEC;
+    if (m_rateLimitApplied && config.rateLimit == m_rateLimitConfig.rateLimit &&
+        config.rateLimitBurst == m_rateLimitConfig.rateLimitBurst &&
+        config.rateLimitRoutes == m_rateLimitConfig.rateLimitRoutes &&
+        config.rateLimitTableSize == m_rateLimitConfig.rateLimitTableSize) {
+        return;
+    }
+    m_rateLimitApplied = true;
+    m_rateLimitConfig = config;
+    unsigned int burst = config.rateLimitBurst == 0 ? config.rateLimit : config.rateLimitBurst;
+    (void)m_ipRateLimiter.Init(config.rateLimitTableSize, config.rateLimit, burst);
+    (void)RateLimiter::ParseRouteLimits(config.rateLimitRoutes, m_routeLimits); // 加载配置时已经校验过
+    m_routeRateLimiters.clear();
+    m_routeRateLimiters.resize(m_routeLimits.size());
+    for (size_t i = 0; i < m_routeLimits.size(); ++i) {
+        (void)m_routeRateLimiters[i].Init(config.rateLimitTableSize, m_routeLimits[i].rate, m_routeLimits[i].burst);
+    }
+    printf("EVENT  Rate limit applied, rate = %u, burst = %u, routes = %zu.\n", config.rateLimit, burst,
+        m_routeLimits.size());
+}
+
+void HttpServer::ReloadConfig()
+{
+    if (m_config == nullptr) {
+        return;
+    }
+    HttpServerConfig oldConfig = m_config->Get();
+    if (m_config->Reload() == false) {
+        return;
+    }
+    const HttpServerConfig &newConfig = m_config->Get();
+    (void)HttpConfig::HasRestartOnlyChange(oldConfig, newConfig);
+    ApplyConfig(newConfig);
+    if (newConfig.timerInterval != oldConfig.timerInterval) {
+        alarm(m_timerInterval); // 按新的间隔重启定时器
+    }
+    printf("EVENT  Config reloaded, source_dir = %s, thread_num = %u.\n", newConfig.sourceDir.c_str(),
+        newConfig.threadNum);
+}
+
+bool HttpServer::InitServer(const std::vector<ListenerConfig> &listeners)
+{
+    if (!m_listenerSet.Empty()) {
+        printf("ERROR  Server alreadly exists.\n");
         return false;
     }
+    return m_listenerSet.Open(listeners);
+}
 
-    if (listen(m_server, backlog) == -1) {
-        close(m_server);
-        m_server = -1;
-        printf("ERROR  server listen fail.\n");
+bool HttpServer::InheritServer(const int channel, const std::vector<ListenerConfig> &listeners)
+{
+    if (!m_listenerSet.Empty()) {
+        printf("ERROR  Server alreadly exists.\n");
         return false;
     }
-    printf("EVENT server listen: %s:%hu.\n", ipAddr, portId);
-    return true;
+    std::vector<int> fds;
+    if (ListenerHandoff::RecvFds(channel, fds) == false) {
+        return false;
+    }
+    return m_listenerSet.Inherit(fds, listeners);
 }
 
-bool HttpServer::InitEpollFd(const int epollSize)
+bool HttpServer::InitEpollFd()
 {
     if (m_efd != -1) {
         printf("ERROR  Epoll alreadly exists.\n");
         return false;
     }
 
-    m_efd = epoll_create(epollSize);
+    // 所有套接字都设置close-on-exec，平滑升级启动新进程时不会泄露给新进程
+    m_efd = epoll_create1(EPOLL_CLOEXEC);
     if (m_efd == -1) {
         printf("ERROR  epoll_create fail.\n");
         return false;
@@ -148,7 +362,7 @@ bool HttpServer::InitEpollFd(const int epollSize)
 bool HttpServer::InitPipeFd()
 {
     ClosePipefd();
-    int ret = socketpair(AF_UNIX, SOCK_STREAM, 0, m_pipefd);
+    int ret = socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, m_pipefd);
     if (ret == -1) {
         printf("ERROR  socketpair fail.\n");
         return false;
@@ -158,13 +372,15 @@ bool HttpServer::InitPipeFd()
 
 bool HttpServer::RegisterServerReadEvent()
 {
-    struct epoll_event serverEvent = { 0 };
-    serverEvent.events = EPOLLIN;
-    serverEvent.data.fd = m_server;
-    int ret = epoll_ctl(m_efd, EPOLL_CTL_ADD, m_server, &serverEvent);
-    if (ret == -1) {
-        printf("ERROR  Register server read event fail.\n");
-        return false;
+    for (const Listener &listener : m_listenerSet.Get()) {
+        struct epoll_event serverEvent = { 0 };
+        serverEvent.events = EPOLLIN;
+        serverEvent.data.fd = listener.fd;
+        int ret = epoll_ctl(m_efd, EPOLL_CTL_ADD, listener.fd, &serverEvent);
+        if (ret == -1) {
+            printf("ERROR  Register server read event fail: %s.\n", listener.name.c_str());
+            return false;
+        }
     }
 
     return true;
@@ -183,6 +399,42 @@ bool HttpServer::RegisterPipeReadEvent()
     return true;
 }
 
+bool HttpServer::RegisterDiskIoEvent()
+{
+    struct epoll_event diskIoEvent = { 0 };
+    diskIoEvent.events = EPOLLIN;
+    diskIoEvent.data.fd = m_diskIoPool.GetEventFd();
+    if (epoll_ctl(m_efd, EPOLL_CTL_ADD, diskIoEvent.data.fd, &diskIoEvent) == -1) {
+        printf("ERROR  Register disk io event fail.\n");
+        return false;
+    }
+    return true;
+}
+
+bool HttpServer::RegisterCompletionEvent()
+{
+    struct epoll_event completionEvent = { 0 };
+    completionEvent.events = EPOLLIN;
+    completionEvent.data.fd = m_completionQueue.GetEventFd();
+    if (epoll_ctl(m_efd, EPOLL_CTL_ADD, completionEvent.data.fd, &completionEvent) == -1) {
+        printf("ERROR  Register completion event fail.\n");
+        return false;
+    }
+    return true;
+}
+
+bool HttpServer::RegisterSseEvent()
+{
+    struct epoll_event sseEvent = { 0 };
+    sseEvent.events = EPOLLIN;
+    sseEvent.data.fd = SseHub::GetInstance().GetEventFd();
+    if (epoll_ctl(m_efd, EPOLL_CTL_ADD, sseEvent.data.fd, &sseEvent) == -1) {
+        printf("ERROR  Register sse event fail.\n");
+        return false;
+    }
+    return true;
+}
+
 bool HttpServer::RegisterHandleSignal(const int signalId)
 {
     struct sigaction sa = { 0 };
@@ -205,91 +457,211 @@ void HttpServer::WriteSignalToPipeFd(int signalId)
     errno = tmpErrno;
 }
 
-void HttpServer::EventLoop(const int epollSize)
+void HttpServer::EventLoop()
 {
-    struct epoll_event *events = new struct epoll_event[epollSize];
-    if (events == nullptr) {
-        printf("ERROR  Allooc memory fail.\n");
-        return;
-    }
-
     bool stopFlag = false;
     while (!stopFlag) {
-        int ret = epoll_wait(m_efd, events, epollSize, -1);
+        struct epoll_event *events = m_events.data();
+        int ret = epoll_wait(m_efd, events, static_cast<int>(m_events.size()), -1);
         if (ret == -1) {
             printf("ERROR  epoll_wait fail, errno = %d.\n", errno);
             if (errno == EINTR) {
                 continue;
             } else {
-                delete[] events;
                 return;
             }
         }
         for (unsigned int i = 0; i < static_cast<unsigned int>(ret); ++i) {
             int socket = events[i].data.fd;
+            if (m_coroutineDriver.Owns(socket)) {
+                m_coroutineDriver.HandleEvent(socket, events[i].events);
+                continue;
+            }
             if (events[i].events & EPOLLIN) {
-                if (socket == m_server) {
-                    HandleServerReadEvent();
+                const Listener *listener = m_listenerSet.Find(socket);
+                if (listener != nullptr) {
+                    HandleServerReadEvent(*listener);
                 } else if (socket == m_pipefd[PIPE_READ_FD_INDEX]) {
                     HandlePipeReadEvent();
+                } else if (socket == m_upgradeChannel) {
+                    HandleUpgradeReadEvent();
+                } else if (socket == m_completionQueue.GetEventFd()) {
+                    HandleCompletionEvent();
+                } else if (socket == m_diskIoPool.GetEventFd()) {
+                    HandleDiskIoEvent();
+                } else if (socket == SseHub::GetInstance().GetEventFd()) {
+                    HandleSsePublishEvent();
                 } else {
-                    HandleClientReadEvent(socket);
+                    HandleClientReadEvent(socket, events[i].events);
                 }
             } else if (events[i].events & EPOLLOUT) {
                 HandleWriteEvent(socket);
+            } else if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                // 只有挂断或错误时按读事件处理，读取失败后关闭连接；不处理时epoll_wait会立即返回，事件循环空转
+                HandleClientReadEvent(socket, events[i].events);
             }
         }
+        FlushPendingWrites();
         if (m_checkClientExpire) {
             HandleClientExpire();
+            PublishStats();
+            TrafficCapture::Flush();
             m_checkClientExpire = false;
-            alarm(TIMER_INTERVAL); // 重启定时器
+            alarm(m_timerInterval); // 重启定时器
+        }
+        // 重新加载配置可能改变事件数组大小，放在本轮事件处理完之后
+        if (m_reloadConfig) {
+            ReloadConfig();
+            m_reloadConfig = false;
+        }
+        if (m_upgrade) {
+            StartUpgrade();
+            m_upgrade = false;
+        }
+        if (m_upgradeChannel != -1 && time(NULL) >= m_upgradeDeadline) {
+            printf("ERROR  New process %d not ready in %us, keep serving.\n", m_upgradePid, UPGRADE_READY_TIMEOUT);
+            AbortUpgrade();
+        }
+        // 第一次收到退出信号时与平滑升级一样等待连接处理完，排空过程中再次收到时立即退出
+        if (m_shutdown) {
+            if (m_draining) {
+                stopFlag = true;
+            } else {
+                StartDrain();
+            }
+            m_shutdown = false;
+        }
+        if (m_dumpStats) {
+            m_stats.Dump();
+            DumpPoolStats();
+            if (RequestTrace::IsEnabled()) {
+                (void)RequestTrace::Export(m_traceFile);
+            }
+            m_dumpStats = false;
+        }
+        // 连接数降到上限以下后恢复接收新连接
+        if (m_acceptPaused && (m_maxConnections == 0 || GetConnectionNum() < m_maxConnections)) {
+            ResumeAccept();
+        }
+        // 剩余连接处理完或超过等待时间后旧进程退出
+        if (m_draining && (GetConnectionNum() == 0 || time(NULL) >= m_drainDeadline)) {
+            printf("EVENT  Drain finish, %u connections left.\n", GetConnectionNum());
+            stopFlag = true;
         }
     }
-
-    delete []events;
-    return;
 }
 
-void HttpServer::HandleServerReadEvent()
+void HttpServer::HandleServerReadEvent(const Listener &listener)
 {
-    struct sockaddr_in clientAddr = { 0 };
+    struct sockaddr_storage clientAddr;
+    memset(&clientAddr, 0, sizeof(clientAddr));
     socklen_t clientAddrLen = sizeof(clientAddr);
-    int client = accept(m_server, reinterpret_cast<struct sockaddr *>(&clientAddr), &clientAddrLen);
+    int client = accept4(listener.fd, reinterpret_cast<struct sockaddr *>(&clientAddr), &clientAddrLen,
+        SOCK_CLOEXEC | SOCK_NONBLOCK);
     if (client == -1) {
-        printf("ERROR  accept fail.\n");
+        printf("ERROR  accept fail: %s.\n", listener.name.c_str());
         return;
     }
-    // 注册客户端的监听读事件
-    struct epoll_event clientEvent = { 0 };
-    clientEvent.events = EPOLLIN;
-    clientEvent.data.fd = client;
-    int ret = epoll_ctl(m_efd, EPOLL_CTL_ADD, client, &clientEvent);
-    if (ret == -1) {
-        printf("ERROR  epoll_ctl fail.\n");
-        close(client);
+    m_stats.acceptCount++;
+    if (CheckConnectionLimit(client) == false) {
+        return;
+    }
+    if (listener.family != LISTENER_FAMILY_UNIX) {
+        SocketOptions::ApplyConnection(client, m_connectionOptions);
+    }
+    char peerName[PEER_NAME_MAX_LEN] = { 0 };
+    unsigned long long clientKey = ListenerSet::IdentifyPeer(client, clientAddr, peerName, sizeof(peerName));
+    if (m_useCoroutine) {
+        printf("EVENT  new connect: client[%d] with %s on %s, coroutine driver.\n", client, peerName,
+            listener.name.c_str());
+        HTTP_PROBE3(accept, client, clientKey, static_cast<HttpProcessor *>(nullptr)); // 协程驱动的连接没有处理对象
+        StartCoroutineClient(client, clientKey, peerName);
         return;
     }
     // 创建客户端的请求处理器
-    HttpProcessor *httpProcessor = new HttpProcessor(client, m_sourceDir);
+    HttpProcessor *httpProcessor = m_processorPool.Create(client, m_processorContext);
     if (httpProcessor == nullptr) {
         printf("ERROR  Create HttpProcessor fail.\n");
-        epoll_ctl(m_efd, EPOLL_CTL_DEL, client, NULL);
         close(client);
         return;
     }
-    m_fdAndProcessorMap[client] = httpProcessor;
+    httpProcessor->SetClientKey(clientKey);
+    httpProcessor->SetPeerName(peerName);
+    if (AddClient(client, httpProcessor) == false) {
+        return;
+    }
+    printf("EVENT  new connect: client[%d] with %s on %s.\n", client, peerName, listener.name.c_str());
+    HTTP_PROBE3(accept, client, clientKey, httpProcessor);
+}
+
+// 注册读事件和过期时间，之后由事件回调驱动连接；失败时关闭连接并释放处理对象
+bool HttpServer::AddClient(const int client, HttpProcessor *httpProcessor)
+{
+    struct epoll_event clientEvent = { 0 };
+    clientEvent.events = EPOLLIN;
+    clientEvent.data.fd = client;
+    if (epoll_ctl(m_efd, EPOLL_CTL_ADD, client, &clientEvent) == -1) {
+        printf("ERROR  epoll_ctl fail.\n");
+        close(client);
+        m_processorPool.Destroy(httpProcessor);
+        return false;
+    }
+    if (static_cast<size_t>(client) >= m_processors.size()) {
+        m_processors.resize(client + 1, nullptr);
+    }
+    m_processors[client] = httpProcessor;
+    m_processorNum++;
     // 将客户端注册到过期时间最小堆
-    time_t curSec = time(NULL);
-    ClientExpire clientExpire = { .clientFd = client, .expire = curSec + CLIENT_EXPIRE_INTERVAL };
+    ClientExpire clientExpire = { .clientFd = client, .expire = time(NULL) + m_clientExpireInterval };
     if (m_clientExpireMinHeap.Push(clientExpire) == false) {
-        delete httpProcessor;
-        m_fdAndProcessorMap.erase(client);
-        epoll_ctl(m_efd, EPOLL_CTL_DEL, client, NULL);
+        DelClient(client);
+        return false;
+    }
+    return true;
+}
+
+// 超过连接数上限时回复503并关闭连接；达到上限且配置为refuse时暂停接收新连接，
+// 新连接留在内核的全连接队列中，队列满后由内核拒绝
+bool HttpServer::CheckConnectionLimit(const int client)
+{
+    if (m_maxConnections == 0) {
+        return true;
+    }
+    if (GetConnectionNum() >= m_maxConnections) {
+        m_stats.rejectConnCount++;
+        (void)m_overloadResponse.Send(client);
         close(client);
+        return false;
+    }
+    if (m_refuseOnOverload && GetConnectionNum() + 1 >= m_maxConnections) {
+        PauseAccept();
+    }
+    return true;
+}
+
+void HttpServer::PauseAccept()
+{
+    if (m_acceptPaused || m_listenerSet.Empty()) {
         return;
     }
-    printf("EVENT  new connect: client[%d] with %s:%hu.\n", client, inet_ntoa(clientAddr.sin_addr),
-        ntohs(clientAddr.sin_port));
+    for (const Listener &listener : m_listenerSet.Get()) {
+        if (epoll_ctl(m_efd, EPOLL_CTL_DEL, listener.fd, NULL) == -1) {
+            printf("ERROR  Pause accept fail: %s.\n", listener.name.c_str());
+        }
+    }
+    m_acceptPaused = true;
+    m_stats.pauseAcceptCount++;
+}
+
+void HttpServer::ResumeAccept()
+{
+    if (!m_acceptPaused) {
+        return;
+    }
+    m_acceptPaused = false;
+    if (RegisterServerReadEvent() == false) {
+        printf("ERROR  Resume accept fail.\n");
+    }
 }
 
 void HttpServer::HandlePipeReadEvent()
@@ -302,17 +674,41 @@ void HttpServer::HandlePipeReadEvent()
     printf("EVENT Recv Signal %d\n", signalid);
     if (signalid == SIGALRM) {
         m_checkClientExpire = true;
+    } else if (signalid == SIGHUP) {
+        m_reloadConfig = true;
+    } else if (signalid == SIGUSR2) {
+        m_upgrade = true;
+    } else if (signalid == SIGUSR1) {
+        m_dumpStats = true;
+    } else if (signalid == SIGTERM || signalid == SIGINT) {
+        m_shutdown = true;
     }
 }
 
-void HttpServer::HandleClientReadEvent(const int client)
+void HttpServer::HandleClientReadEvent(const int client, const unsigned int events)
 {
-    std::map<int, HttpProcessor*>::iterator iter = m_fdAndProcessorMap.find(client);
-    if (iter == m_fdAndProcessorMap.end()) {
+    HttpProcessor *httpProcessor = GetProcessor(client);
+    if (httpProcessor == nullptr) {
         printf("ERROR client[%d] not match processer.\n", client);
         return;
     }
-    HttpProcessor *httpProcessor = iter->second;
+    // 处理线程还在处理上一个请求时暂停监听该连接，否则水平触发的读事件会让事件循环空转，取出完成通知后恢复监听
+    // 暂停时从epoll中移除，只清空监听事件时挂断和错误仍会上报
+    if (httpProcessor->IsBusy()) {
+        if (httpProcessor->PauseEvents()) {
+            (void)epoll_ctl(m_efd, EPOLL_CTL_DEL, client, NULL);
+        }
+        return;
+    }
+    if (httpProcessor->GetWebSocket() != nullptr) {
+        // 读写同时就绪时在同一次回调中继续发送积压的帧，持续发送数据的客户端也能收到回复
+        HandleWebSocketEvent(client, httpProcessor, EPOLLIN | (events & EPOLLOUT));
+        return;
+    }
+    if (httpProcessor->GetSseSubscriber() != nullptr) {
+        HandleSseEvent(client, httpProcessor, EPOLLIN | (events & EPOLLOUT));
+        return;
+    }
     RecvRequestReturnCode returnCode = httpProcessor->Read();
     switch (returnCode) {
         case RECV_REQUEST_RETURN_CODE_AGAIN: { // 读缓冲区为空等待下一次读事件
@@ -323,11 +719,19 @@ void HttpServer::HandleClientReadEvent(const int client)
             break;
         }
         case RECV_REQUEST_RETURN_CODE_SUCCESS: { // 读消息成功处理请求
-            HttpReqProcessArg arg = { .httpServer = this, .httpProcessor = httpProcessor, .client = client };
-            Task<HttpReqProcessArg> task = { .function = HttpServer::ProcessReq, .arg = arg };
-            if (m_threadPool.AddTask(task) == false) {
+            if (CheckRateLimit(httpProcessor) == false) {
+                // 超过限流，不进入任务队列直接回复429
+                m_stats.rateLimitedCount++;
+                (void)m_rateLimitResponse.Send(client);
                 DelClient(client);
+                break;
+            }
+            if (GetDispatchMode(httpProcessor) == DISPATCH_MODE_INLINE) {
+                HandleInlineRequest(client, httpProcessor);
+                break;
             }
+            DispatchToPool(client, httpProcessor, false);
+            break;
         }
         default: { // 不会有其他响应码，编码规范要求要有default分支
             break;
@@ -335,25 +739,520 @@ void HttpServer::HandleClientReadEvent(const int client)
     }
 }
 
+// 升级后的连接只在事件循环线程中处理，握手回复发送完成后的第一个事件回调OnOpen
+// events为0时只打开连接，读到数据时把过期时间推迟一个ping间隔
+void HttpServer::HandleWebSocketEvent(const int client, HttpProcessor *httpProcessor, const unsigned int events)
+{
+    WebSocketConnection *webSocket = httpProcessor->GetWebSocket();
+    WebSocketEventResult result = WEBSOCKET_EVENT_RESULT_READ;
+    if (!webSocket->IsOpened()) {
+        m_stats.webSocketUpgradeCount++;
+        result = webSocket->Open();
+        ClientExpire clientExpire = { .clientFd = client, .expire = time(NULL) + m_webSocketPingInterval };
+        m_clientExpireMinHeap.Modify(clientExpire);
+    }
+    if (result != WEBSOCKET_EVENT_RESULT_CLOSE && (events & EPOLLIN) != 0) {
+        result = webSocket->OnReadable(m_webSocketReadBuff.data(), m_webSocketReadBuff.size());
+        ClientExpire clientExpire = { .clientFd = client, .expire = time(NULL) + m_webSocketPingInterval };
+        m_clientExpireMinHeap.Modify(clientExpire);
+    }
+    if (result != WEBSOCKET_EVENT_RESULT_CLOSE && (events & EPOLLOUT) != 0) {
+        result = webSocket->OnWritable();
+    }
+    ApplyWebSocketResult(client, webSocket, result);
+}
+
+// 只在需要监听的事件变化时调用epoll_ctl，有待发送数据时才监听写事件
+void HttpServer::ApplyWebSocketResult(const int client, WebSocketConnection *webSocket,
+    const WebSocketEventResult result)
+{
+    if (result == WEBSOCKET_EVENT_RESULT_CLOSE) {
+        DelClient(client);
+        return;
+    }
+    unsigned int events = result == WEBSOCKET_EVENT_RESULT_WRITE ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    if (events == webSocket->GetEvents()) {
+        return;
+    }
+    if (ModifyClientEvents(client, events) == false) {
+        printf("ERROR  Modify websocket client[%d] events fail.\n", client);
+        DelClient(client);
+        return;
+    }
+    webSocket->SetEvents(events);
+}
+
+// 事件流回复头部发送完成后的第一个事件加入频道，之后读事件只用于发现客户端断开，写事件继续发送积压的事件
+void HttpServer::HandleSseEvent(const int client, HttpProcessor *httpProcessor, const unsigned int events)
+{
+    SseSubscriber *subscriber = httpProcessor->GetSseSubscriber();
+    if (!subscriber->IsOpened()) {
+        m_stats.sseSubscribeCount++;
+        subscriber->Open();
+        ClientExpire clientExpire = { .clientFd = client, .expire = time(NULL) + m_sseKeepaliveInterval };
+        m_clientExpireMinHeap.Modify(clientExpire);
+    }
+    // 读写同时就绪时读完再继续发送积压的事件；events为0时刚加入频道，发送加入前积压的事件
+    SseEventResult result = SSE_EVENT_RESULT_READ;
+    if ((events & EPOLLIN) != 0) {
+        char buff[SSE_READ_BUFF_LEN];
+        result = subscriber->OnReadable(buff, sizeof(buff));
+    }
+    if (result != SSE_EVENT_RESULT_CLOSE && ((events & EPOLLOUT) != 0 || (events & EPOLLIN) == 0)) {
+        result = subscriber->OnWritable();
+    }
+    ApplySseResult(client, subscriber, result);
+}
+
+void HttpServer::ApplySseResult(const int client, SseSubscriber *subscriber, const SseEventResult result)
+{
+    if (result == SSE_EVENT_RESULT_CLOSE) {
+        DelClient(client);
+        return;
+    }
+    unsigned int events = result == SSE_EVENT_RESULT_WRITE ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    if (events == subscriber->GetEvents()) {
+        return;
+    }
+    if (ModifyClientEvents(client, events) == false) {
+        printf("ERROR  Modify sse client[%d] events fail.\n", client);
+        DelClient(client);
+        return;
+    }
+    subscriber->SetEvents(events);
+}
+
+// 每个事件只序列化一次，推送时订阅者的队列只增加引用；没有积压的订阅者每个事件一次系统调用
+void HttpServer::HandleSsePublishEvent()
+{
+    SseHub &hub = SseHub::GetInstance();
+    m_ssePublished.clear();
+    hub.PollPublished(m_ssePublished);
+    for (const SsePublished &published : m_ssePublished) {
+        const std::vector<SseSubscriber *> &subscribers = hub.GetSubscribers(published.channel);
+        unsigned long long dropNum = 0;
+        m_sseChanged.clear();
+        for (SseSubscriber *subscriber : subscribers) {
+            unsigned long long oldDropNum = subscriber->GetDropNum();
+            SseEventResult result = subscriber->Push(published.event);
+            dropNum += subscriber->GetDropNum() - oldDropNum;
+            unsigned int events = result == SSE_EVENT_RESULT_WRITE ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+            // 关闭连接会修改订阅者列表，遍历完后再处理
+            if (result == SSE_EVENT_RESULT_CLOSE || events != subscriber->GetEvents()) {
+                m_sseChanged.push_back(std::make_pair(subscriber->GetSocketId(), result));
+            }
+        }
+        m_stats.ssePublishCount++;
+        m_stats.ssePushCount += subscribers.size();
+        m_stats.sseDropCount += dropNum;
+        published.event->Unref();
+        for (const std::pair<int, SseEventResult> &changed : m_sseChanged) {
+            HttpProcessor *httpProcessor = GetProcessor(changed.first);
+            if (httpProcessor != nullptr && httpProcessor->GetSseSubscriber() != nullptr) {
+                ApplySseResult(changed.first, httpProcessor->GetSseSubscriber(), changed.second);
+            }
+        }
+    }
+}
+
+// 只在有订阅者时序列化运行统计
+void HttpServer::PublishStats()
+{
+    SseHub &hub = SseHub::GetInstance();
+    if (!hub.HasSubscribers(SSE_CHANNEL_STATS)) {
+        return;
+    }
+    char buff[SSE_STATS_BUFF_LEN];
+    int len = m_stats.Format(buff, sizeof(buff));
+    (void)hub.Publish(SSE_CHANNEL_STATS, SSE_CHANNEL_STATS, buff, len);
+}
+
+// 只在事件循环线程中调用，限流表不需要加锁
+bool HttpServer::CheckRateLimit(const HttpProcessor *httpProcessor)
+{
+    if (!m_ipRateLimiter.IsEnabled() && m_routeRateLimiters.empty()) {
+        return true;
+    }
+    struct timespec now = { 0 };
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    unsigned long long nowNs = static_cast<unsigned long long>(now.tv_sec) * NSEC_PER_SEC + now.tv_nsec;
+    unsigned long long clientKey = httpProcessor->GetClientKey();
+    if (m_ipRateLimiter.Allow(clientKey, nowNs) == false) {
+        return false;
+    }
+    const char *url = nullptr;
+    unsigned int urlLen = 0;
+    if (m_routeRateLimiters.empty() || httpProcessor->PeekUrl(url, urlLen) == false) {
+        return true;
+    }
+    for (size_t i = 0; i < m_routeLimits.size(); ++i) {
+        const std::string &prefix = m_routeLimits[i].prefix;
+        if (urlLen >= prefix.size() && memcmp(url, prefix.data(), prefix.size()) == 0) {
+            return m_routeRateLimiters[i].Allow(clientKey, nowNs);
+        }
+    }
+    return true;
+}
+
+unsigned int HttpServer::GetConnectionNum() const
+{
+    return m_processorNum + m_coroutineDriver.Size();
+}
+
+HttpProcessor *HttpServer::GetProcessor(const int client) const
+{
+    if (client < 0 || static_cast<size_t>(client) >= m_processors.size()) {
+        return nullptr;
+    }
+    return m_processors[client];
+}
+
+void HttpServer::StartCoroutineClient(const int client, const unsigned long long clientKey, const char *peerName)
+{
+    if (m_coroutineDriver.Attach(client) == false) {
+        close(client);
+        return;
+    }
+    HttpProcessor *httpProcessor = m_processorPool.Create(client, m_processorContext);
+    if (httpProcessor == nullptr) {
+        printf("ERROR  Create HttpProcessor fail.\n");
+        m_coroutineDriver.Detach(client);
+        close(client);
+        return;
+    }
+    httpProcessor->SetClientKey(clientKey);
+    httpProcessor->SetPeerName(peerName);
+    // 协程立即运行到第一次等待读事件，之后由事件循环恢复
+    (void)ServeConnection(client, httpProcessor);
+}
+
+// 连接的处理流程写成顺序代码，读写未就绪时挂起等待，请求在事件循环线程中直接处理
+// 连接退出时协程负责关闭套接字并释放处理对象，没有其他线程持有处理对象
+ConnectionTask HttpServer::ServeConnection(const int client, HttpProcessor *httpProcessor)
+{
+    bool keepAlive = true;
+    while (keepAlive) {
+        if (co_await m_coroutineDriver.Readable(client, m_clientExpireInterval) != IO_WAIT_RESULT_READY) {
+            break;
+        }
+        RecvRequestReturnCode recvRet = httpProcessor->Read();
+        if (recvRet == RECV_REQUEST_RETURN_CODE_AGAIN) {
+            continue;
+        }
+        if (recvRet != RECV_REQUEST_RETURN_CODE_SUCCESS) {
+            break;
+        }
+        if (CheckRateLimit(httpProcessor) == false) {
+            m_stats.rateLimitedCount++;
+            (void)m_rateLimitResponse.Send(client);
+            break;
+        }
+        m_stats.coroutineReqCount++;
+        (void)httpProcessor->ParseReadEvent();
+        if (httpProcessor->RespondReadEvent() == false) {
+            break;
+        }
+        // 文件不在页缓存中时等磁盘线程读完再发送，协程退出后磁盘线程不会访问处理对象
+        const char *coldPath = nullptr;
+        off_t coldLength = 0;
+        if (m_diskIoPool.IsEnabled() && httpProcessor->GetColdFile(coldPath, coldLength) &&
+            m_diskIoPool.Submit(client, httpProcessor, coldPath, coldLength)) {
+            m_stats.diskIoReqCount++;
+            IoWaitResult waitRet = co_await m_coroutineDriver.Sleep(client, m_clientExpireInterval, httpProcessor);
+            if (waitRet == IO_WAIT_RESULT_CLOSED) {
+                break;
+            }
+        }
+        SendResponseReturnCode sendRet = httpProcessor->Write();
+        while (sendRet == SEND_RESPONSE_RETURN_CODE_AGAIN) {
+            if (co_await m_coroutineDriver.Writable(client, m_clientExpireInterval) != IO_WAIT_RESULT_READY) {
+                break;
+            }
+            sendRet = httpProcessor->Write();
+        }
+        if (sendRet == SEND_RESPONSE_RETURN_CODE_STREAM && !m_draining) {
+            // 订阅者由事件回调推送事件，协程退出时不关闭连接
+            m_coroutineDriver.Detach(client);
+            if (AddClient(client, httpProcessor)) {
+                HandleSseEvent(client, httpProcessor, 0);
+            }
+            co_return;
+        }
+        if (sendRet == SEND_RESPONSE_RETURN_CODE_UPGRADE && !m_draining) {
+            // 升级后由本协程处理到连接关闭：空闲一个ping间隔发送ping，再过一个间隔仍没有数据则关闭
+            WebSocketConnection *webSocket = httpProcessor->GetWebSocket();
+            m_stats.webSocketUpgradeCount++;
+            WebSocketEventResult wsRet = webSocket->Open();
+            while (wsRet != WEBSOCKET_EVENT_RESULT_CLOSE) {
+                bool waitWrite = wsRet == WEBSOCKET_EVENT_RESULT_WRITE;
+                IoWaitResult waitRet = waitWrite ?
+                    co_await m_coroutineDriver.Writable(client, m_webSocketPingInterval) :
+                    co_await m_coroutineDriver.Readable(client, m_webSocketPingInterval);
+                if (waitRet == IO_WAIT_RESULT_CLOSED) {
+                    (void)webSocket->Close(WEBSOCKET_CLOSE_CODE_GOING_AWAY); // 尽力发送关闭帧，不再等待
+                    break;
+                }
+                if (waitRet == IO_WAIT_RESULT_TIMEOUT) {
+                    wsRet = waitWrite ? WEBSOCKET_EVENT_RESULT_CLOSE : webSocket->KeepAlive();
+                    m_stats.webSocketTimeoutCount += wsRet == WEBSOCKET_EVENT_RESULT_CLOSE ? 1 : 0;
+                    continue;
+                }
+                wsRet = waitWrite ? webSocket->OnWritable() :
+                    webSocket->OnReadable(m_webSocketReadBuff.data(), m_webSocketReadBuff.size());
+            }
+            break;
+        }
+        // 升级过程中不再保持长连接
+        keepAlive = sendRet == SEND_RESPONSE_RETURN_CODE_NEXT && !m_draining;
+    }
+    m_coroutineDriver.Detach(client);
+    close(client);
+    m_processorPool.Destroy(httpProcessor);
+}
+
+DispatchMode HttpServer::GetDispatchMode(const HttpProcessor *httpProcessor) const
+{
+    if (!m_dispatchPolicy.HasInline()) {
+        return DISPATCH_MODE_POOLED;
+    }
+    const char *url = nullptr;
+    unsigned int urlLen = 0;
+    if (httpProcessor->PeekUrl(url, urlLen) == false) {
+        url = "";
+    }
+    return m_dispatchPolicy.GetMode(url, urlLen);
+}
+
+void HttpServer::DispatchToPool(const int client, HttpProcessor *httpProcessor, const bool parsed)
+{
+    unsigned int largeResponseSize = 0;
+    TaskLane lane = GetTaskLane(httpProcessor, largeResponseSize);
+    httpProcessor->SetBusy();
+    HttpReqProcessArg arg = { .httpServer = this, .httpProcessor = httpProcessor, .client = client,
+        .parsed = parsed, .largeResponseSize = largeResponseSize };
+    Task<HttpReqProcessArg> task = { .function = HttpServer::ProcessReq, .arg = arg,
+        .dropFunction = HttpServer::DropReq, .lane = lane,
+        .probeId = reinterpret_cast<uintptr_t>(httpProcessor) };
+    httpProcessor->Trace(TRACE_POINT_ENQUEUE);
+    AddTaskReturnCode ret = m_threadPool.AddTask(task);
+    if (ret != ADD_TASK_RETURN_CODE_SUCCESS) {
+        (void)httpProcessor->ClearBusy(); // 任务没有进入队列，事件循环线程可以直接释放处理对象
+    }
+    if (ret == ADD_TASK_RETURN_CODE_FULL) {
+        // 任务队列已满，立即回复503
+        m_stats.shedQueueFullCount++;
+        (void)m_overloadResponse.Send(client);
+        DelClient(client);
+    } else if (ret != ADD_TASK_RETURN_CODE_SUCCESS) {
+        DelClient(client);
+    }
+}
+
+// 事件循环线程只按URL前缀选择队列，没有匹配的请求先进入小请求队列，由处理线程解析后按回复大小决定是否转到大请求队列
+TaskLane HttpServer::GetTaskLane(const HttpProcessor *httpProcessor, unsigned int &largeResponseSize) const
+{
+    TaskLane lane = TASK_LANE_SMALL;
+    const char *url = nullptr;
+    unsigned int urlLen = 0;
+    if (m_lanePolicy.HasRoutes() && httpProcessor->PeekUrl(url, urlLen) && m_lanePolicy.GetLane(url, urlLen, lane)) {
+        largeResponseSize = 0;
+        return lane;
+    }
+    largeResponseSize = m_largeResponseSize;
+    return TASK_LANE_SMALL;
+}
+
+// 在处理线程中解析请求并按回复大小判断：资源包中的资源取变体大小，其他文件stat
+// 大请求转到大请求队列，解析结果保留，处理线程不再重复解析；转交失败时由当前线程直接回复
+bool HttpServer::RequeueLargeReq(HttpReqProcessArg &arg)
+{
+    HttpProcessor *httpProcessor = arg.httpProcessor;
+    if (!arg.parsed) {
+        (void)httpProcessor->ParseReadEvent();
+        arg.parsed = true;
+    }
+    if (!httpProcessor->IsHeavyRequest(UINT_MAX, arg.largeResponseSize)) {
+        return false;
+    }
+    HttpReqProcessArg largeArg = arg;
+    largeArg.largeResponseSize = 0;
+    Task<HttpReqProcessArg> task = { .function = HttpServer::ProcessReq, .arg = largeArg,
+        .dropFunction = HttpServer::DropReq, .lane = TASK_LANE_LARGE,
+        .probeId = reinterpret_cast<uintptr_t>(httpProcessor) };
+    httpProcessor->Trace(TRACE_POINT_ENQUEUE);
+    return m_threadPool.AddTask(task) == ADD_TASK_RETURN_CODE_SUCCESS;
+}
+
+void HttpServer::DumpPoolStats()
+{
+    ThreadPoolSizingStats sizingStats = { 0 };
+    if (m_threadPool.GetSizingStats(sizingStats)) {
+        printf("STATS  threads = %u, live_threads = %u, min_threads = %u, max_threads = %u, grow = %llu, "
+            "retire = %llu, queue_wait_us = %.1f, blocked = %u%%\n", sizingStats.threadNum, sizingStats.liveThreadNum,
+            sizingStats.minThreadNum, sizingStats.maxThreadNum, sizingStats.growCount, sizingStats.retireCount,
+            sizingStats.queueWaitNs / 1000.0, sizingStats.blockedPercent);
+    }
+    ThreadPoolLaneStats stats = { 0 };
+    for (unsigned int lane = 0; lane < TASK_LANE_NUM && m_threadPool.GetLaneStats(lane, stats); ++lane) {
+        double waitAvgUs = stats.dequeueCount == 0 ? 0.0 :
+            static_cast<double>(stats.waitTotalNs) / stats.dequeueCount / 1000.0;
+        printf("STATS  lane = %s, weight = %u, queued = %u, dequeued = %llu, wait_avg_us = %.1f, "
+            "wait_max_us = %.1f\n", LanePolicy::GetLaneName(static_cast<TaskLane>(lane)), stats.weight,
+            stats.queueSize, stats.dequeueCount, waitAvgUs, stats.waitMaxNs / 1000.0);
+    }
+    fflush(stdout);
+}
+
+// 在事件循环线程中解析并回复，省去线程池的加锁、唤醒和线程切换；回复后立即发送，发送不完时才注册写事件
+// 请求报文或文件较大时仍交给线程池，避免阻塞其他连接
+void HttpServer::HandleInlineRequest(const int client, HttpProcessor *httpProcessor)
+{
+    (void)httpProcessor->ParseReadEvent();
+    if (httpProcessor->IsHeavyRequest(m_inlineMaxRequestLen, m_inlineMaxFileSize)) {
+        m_stats.offloadReqCount++;
+        DispatchToPool(client, httpProcessor, true);
+        return;
+    }
+    m_stats.inlineReqCount++;
+    if (httpProcessor->RespondReadEvent() == false) {
+        DelClient(client);
+        return;
+    }
+    ClientExpire clientExpire = { .clientFd = client, .expire = time(NULL) + m_clientExpireInterval };
+    m_clientExpireMinHeap.Modify(clientExpire);
+    if (SubmitDiskIo(client, httpProcessor)) {
+        return;
+    }
+    // 本轮事件处理完后统一发送，先处理完所有读事件再集中写
+    m_pendingWrites.push_back(std::make_pair(client, httpProcessor));
+}
+
+void HttpServer::FlushPendingWrites()
+{
+    for (const std::pair<int, HttpProcessor *> &pendingWrite : m_pendingWrites) {
+        // 本轮中连接可能已被关闭，套接字也可能被新连接复用
+        if (pendingWrite.second == nullptr || GetProcessor(pendingWrite.first) != pendingWrite.second) {
+            continue;
+        }
+        SendResponse(pendingWrite.first, pendingWrite.second, false);
+    }
+    m_pendingWrites.clear();
+}
+
+// 回复构造完成后立即尝试发送，只有发送不完时才注册写事件，由HandleWriteEvent继续发送
+void HttpServer::SendResponse(const int client, HttpProcessor *httpProcessor, const bool paused)
+{
+    ApplySendResult(client, httpProcessor, httpProcessor->Write(), paused);
+}
+
+// 按发送结果修改监听事件或关闭连接，只在事件循环线程中调用
+// paused表示连接已从epoll中移除，需要重新加入；发送完成且仍在监听读事件时不调用epoll_ctl
+void HttpServer::ApplySendResult(const int client, HttpProcessor *httpProcessor, const SendResponseReturnCode ret,
+    const bool paused)
+{
+    switch (ret) {
+        case SEND_RESPONSE_RETURN_CODE_AGAIN: {
+            bool ret = paused ? ResumeClientEvents(client, EPOLLOUT) : ModifyClientEvents(client, EPOLLOUT);
+            if (ret == false) {
+                printf("ERROR Register write event fail.\n");
+                DelClient(client);
+            }
+            break;
+        }
+        case SEND_RESPONSE_RETURN_CODE_NEXT: {
+            // 升级过程中不再保持长连接
+            if (m_draining) {
+                DelClient(client);
+                break;
+            }
+            if (paused && ResumeClientEvents(client, EPOLLIN) == false) {
+                printf("ERROR  register in event fail.\n");
+                DelClient(client);
+            }
+            break;
+        }
+        case SEND_RESPONSE_RETURN_CODE_UPGRADE: {
+            if (m_draining || (paused && ResumeClientEvents(client, EPOLLIN) == false)) {
+                DelClient(client);
+                break;
+            }
+            HandleWebSocketEvent(client, httpProcessor, 0); // 连接可能已关闭，监听的事件已设置
+            break;
+        }
+        case SEND_RESPONSE_RETURN_CODE_STREAM: {
+            if (m_draining || (paused && ResumeClientEvents(client, EPOLLIN) == false)) {
+                DelClient(client);
+                break;
+            }
+            HandleSseEvent(client, httpProcessor, 0);
+            break;
+        }
+        default: {
+            DelClient(client);
+            break;
+        }
+    }
+}
+
+bool HttpServer::ModifyClientEvents(const int client, const unsigned int events)
+{
+    struct epoll_event clientEvent = { 0 };
+    clientEvent.events = events;
+    clientEvent.data.fd = client;
+    return epoll_ctl(m_efd, EPOLL_CTL_MOD, client, &clientEvent) == 0;
+}
+
+// 忙时暂停监听的连接已从epoll中移除，清除忙状态后重新加入
+bool HttpServer::ResumeClientEvents(const int client, const unsigned int events)
+{
+    struct epoll_event clientEvent = { 0 };
+    clientEvent.events = events;
+    clientEvent.data.fd = client;
+    return epoll_ctl(m_efd, EPOLL_CTL_ADD, client, &clientEvent) == 0;
+}
+
+// 只在事件循环线程中调用
 void HttpServer::DelClient(const int client)
 {
+    HttpProcessor *httpProcessor = GetProcessor(client);
+    if (httpProcessor != nullptr && httpProcessor->IsBusy()) {
+        // 处理线程还在使用处理对象，只关闭读写，处理线程完成后事件循环线程读到连接结束时再释放
+        (void)shutdown(client, SHUT_RDWR);
+        m_clientExpireMinHeap.Delete(client);
+        return;
+    }
     epoll_ctl(m_efd, EPOLL_CTL_DEL, client, NULL);
     close(client);
-    std::map<int, HttpProcessor*>::iterator iter = m_fdAndProcessorMap.find(client);
-    if (iter != m_fdAndProcessorMap.end()) {
-        m_fdAndProcessorMap.erase(iter);
-    }
     m_clientExpireMinHeap.Delete(client);
+    if (httpProcessor == nullptr) {
+        return;
+    }
+    m_processors[client] = nullptr;
+    m_processorNum--;
+    // 处理对象会被新连接复用，从本轮待发送的列表中移除
+    for (std::pair<int, HttpProcessor *> &pendingWrite : m_pendingWrites) {
+        if (pendingWrite.second == httpProcessor) {
+            pendingWrite.second = nullptr;
+        }
+    }
+    m_processorPool.Destroy(httpProcessor);
 }
 
 void HttpServer::HandleWriteEvent(const int client)
 {
-    std::map<int, HttpProcessor*>::iterator iter = m_fdAndProcessorMap.find(client);
-    if (iter == m_fdAndProcessorMap.end()) {
+    HttpProcessor *httpProcessor = GetProcessor(client);
+    if (httpProcessor == nullptr) {
         printf("ERROR client[%d] not match processer.\n", client);
         return;
     }
-    HttpProcessor *httpProcessor = iter->second;
+    if (httpProcessor->GetWebSocket() != nullptr) {
+        HandleWebSocketEvent(client, httpProcessor, EPOLLOUT);
+        return;
+    }
+    if (httpProcessor->GetSseSubscriber() != nullptr) {
+        HandleSseEvent(client, httpProcessor, EPOLLOUT);
+        return;
+    }
     SendResponseReturnCode ret = httpProcessor->Write();
     printf("EVENT  Write ret:%u.\n", ret);
     switch (ret) {
@@ -362,6 +1261,11 @@ void HttpServer::HandleWriteEvent(const int client)
             break;
         }
         case SEND_RESPONSE_RETURN_CODE_NEXT: {
+            // 升级过程中不再保持长连接
+            if (m_draining) {
+                DelClient(client);
+                break;
+            }
             // 注册客户端的监听读事件
             struct epoll_event clientEvent = { 0 };
             clientEvent.events = EPOLLIN;
@@ -369,17 +1273,29 @@ void HttpServer::HandleWriteEvent(const int client)
             int res = epoll_ctl(m_efd, EPOLL_CTL_MOD, client, &clientEvent);
             if (res == -1) {
                 printf("ERROR  register in event fail.\n");
-                close(client);
-                epoll_ctl(m_efd, EPOLL_CTL_DEL, client, NULL);
-                m_fdAndProcessorMap.erase(iter);
+                DelClient(client);
+            }
+            break;
+        }
+        case SEND_RESPONSE_RETURN_CODE_UPGRADE: {
+            if (m_draining) {
+                DelClient(client);
+                break;
+            }
+            HandleWebSocketEvent(client, httpProcessor, 0);
+            break;
+        }
+        case SEND_RESPONSE_RETURN_CODE_STREAM: {
+            if (m_draining) {
+                DelClient(client);
+                break;
             }
+            HandleSseEvent(client, httpProcessor, 0);
             break;
         }
         default: {
-            close(client);
-            epoll_ctl(m_efd, EPOLL_CTL_DEL, client, NULL);
-            m_fdAndProcessorMap.erase(iter);
-            break;            
+            DelClient(client);
+            break;
         }
     }
 }
@@ -387,6 +1303,7 @@ void HttpServer::HandleWriteEvent(const int client)
 void HttpServer::HandleClientExpire()
 {
     time_t curSec = time(NULL);
+    m_coroutineDriver.HandleTimer(curSec);
     ClientExpire clientExpire = { 0 };
     bool ret;
     do {
@@ -397,23 +1314,167 @@ void HttpServer::HandleClientExpire()
         if (clientExpire.expire > curSec) {
             break;
         }
+        // 已升级的连接空闲时先发送ping，过期时间推迟一个间隔，仍没有回应时关闭
+        HttpProcessor *httpProcessor = GetProcessor(clientExpire.clientFd);
+        WebSocketConnection *webSocket = httpProcessor == nullptr ? nullptr : httpProcessor->GetWebSocket();
+        if (webSocket != nullptr && webSocket->IsOpened()) {
+            WebSocketEventResult result = webSocket->KeepAlive();
+            if (result == WEBSOCKET_EVENT_RESULT_CLOSE) {
+                m_stats.webSocketTimeoutCount++;
+            } else {
+                clientExpire.expire = curSec + m_webSocketPingInterval;
+                m_clientExpireMinHeap.Modify(clientExpire);
+            }
+            ApplyWebSocketResult(clientExpire.clientFd, webSocket, result);
+            continue;
+        }
+        // 订阅者按上次发送时间计算下次保活时间，推送事件时不修改堆
+        SseSubscriber *subscriber = httpProcessor == nullptr ? nullptr : httpProcessor->GetSseSubscriber();
+        if (subscriber != nullptr && subscriber->IsOpened()) {
+            time_t nextTime = 0;
+            SseEventResult result = subscriber->KeepAlive(m_sseKeepaliveComment, curSec, m_sseKeepaliveInterval,
+                nextTime);
+            if (result != SSE_EVENT_RESULT_CLOSE) {
+                clientExpire.expire = nextTime;
+                m_clientExpireMinHeap.Modify(clientExpire);
+            }
+            ApplySseResult(clientExpire.clientFd, subscriber, result);
+            continue;
+        }
+        HTTP_PROBE3(expire, httpProcessor, clientExpire.clientFd, clientExpire.expire);
         DelClient(clientExpire.clientFd);
     } while (true);
+    // 顺便淘汰长时间没有请求的客户端令牌桶
+    struct timespec now = { 0 };
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    unsigned long long nowNs = static_cast<unsigned long long>(now.tv_sec) * NSEC_PER_SEC + now.tv_nsec;
+    m_ipRateLimiter.EvictIdle(nowNs, m_rateLimitIdleNs);
+    for (RateLimiter &rateLimiter : m_routeRateLimiters) {
+        rateLimiter.EvictIdle(nowNs, m_rateLimitIdleNs);
+    }
+}
+
+// 启动新进程并把监听套接字交给它，新进程初始化完成后旧进程才停止接收新连接
+void HttpServer::StartUpgrade()
+{
+    if (m_upgradeChannel != -1 || m_draining || m_config == nullptr) {
+        printf("WARN  Upgrade already in progress.\n");
+        return;
+    }
+    pid_t childPid = -1;
+    int channel = ListenerHandoff::Spawn(m_config->GetArgs(), childPid);
+    if (channel == -1) {
+        return;
+    }
+    std::vector<int> fds = m_listenerSet.GetFds();
+    if (ListenerHandoff::SendFds(channel, fds) == false) {
+        close(channel); // 新进程收不到监听套接字会自行退出
+        return;
+    }
+    struct epoll_event channelEvent = { 0 };
+    channelEvent.events = EPOLLIN;
+    channelEvent.data.fd = channel;
+    if (epoll_ctl(m_efd, EPOLL_CTL_ADD, channel, &channelEvent) == -1) {
+        printf("ERROR  Register upgrade channel fail.\n");
+        close(channel);
+        return;
+    }
+    m_upgradeChannel = channel;
+    m_upgradePid = childPid;
+    m_upgradeDeadline = time(NULL) + UPGRADE_READY_TIMEOUT;
+    printf("EVENT  Upgrade start, new process pid = %d.\n", childPid);
+}
+
+void HttpServer::HandleUpgradeReadEvent()
+{
+    char flag = 0;
+    ssize_t ret = read(m_upgradeChannel, &flag, sizeof(flag));
+    if (ret == -1 && errno == EAGAIN) {
+        return;
+    }
+    if (ret != sizeof(flag) || flag != UPGRADE_READY_FLAG) {
+        // 新进程启动失败，旧进程继续提供服务
+        printf("ERROR  New process %d start fail, keep serving.\n", m_upgradePid);
+        AbortUpgrade();
+        return;
+    }
+    epoll_ctl(m_efd, EPOLL_CTL_DEL, m_upgradeChannel, NULL);
+    close(m_upgradeChannel);
+    m_upgradeChannel = -1;
+    StartDrain();
+}
+
+// 新进程可能卡在初始化中，先终止再回收，避免留下僵尸进程或与旧进程同时接收连接
+void HttpServer::AbortUpgrade()
+{
+    if (m_upgradeChannel != -1) {
+        epoll_ctl(m_efd, EPOLL_CTL_DEL, m_upgradeChannel, NULL);
+        close(m_upgradeChannel);
+        m_upgradeChannel = -1;
+    }
+    if (m_upgradePid > 0) {
+        (void)kill(m_upgradePid, SIGKILL);
+        while (waitpid(m_upgradePid, NULL, 0) == -1 && errno == EINTR) {
+        }
+    }
+    m_upgradePid = -1;
+}
+
+void HttpServer::StartDrain()
+{
+    if (!m_acceptPaused) {
+        for (int fd : m_listenerSet.GetFds()) {
+            epoll_ctl(m_efd, EPOLL_CTL_DEL, fd, NULL);
+        }
+    }
+    m_listenerSet.Close();
+    m_draining = true;
+    m_drainDeadline = time(NULL) + m_drainTimeout;
+    // 空闲的长连接直接关闭，客户端会重连到新进程
+    std::vector<int> idleClients;
+    for (size_t client = 0; client < m_processors.size(); ++client) {
+        if (m_processors[client] != nullptr && m_processors[client]->IsIdle()) {
+            idleClients.push_back(static_cast<int>(client));
+        }
+    }
+    for (int client : idleClients) {
+        // 已升级的连接发送关闭帧，发送完成后关闭，客户端会重连到新进程
+        WebSocketConnection *webSocket = m_processors[client]->GetWebSocket();
+        if (webSocket != nullptr && webSocket->IsOpened()) {
+            ApplyWebSocketResult(client, webSocket, webSocket->Close(WEBSOCKET_CLOSE_CODE_GOING_AWAY));
+            continue;
+        }
+        DelClient(client);
+    }
+    m_coroutineDriver.CancelReadWaiters();
+    printf("EVENT  Drain start, new process pid = %d, %u connections left, timeout = %us.\n", m_upgradePid,
+        GetConnectionNum(), m_drainTimeout);
 }
 
 void HttpServer::clear()
 {
-    if (m_server != -1) {
-        close(m_server);
-        m_server = -1;
+    m_threadPool.Stop(); // 处理线程退出后再释放处理对象
+    m_coroutineDriver.CancelAll(); // 让所有连接协程退出并释放协程帧
+    if (m_upgradeChannel != -1) {
+        AbortUpgrade(); // 升级还没有完成，新进程不能接管
     }
+    m_listenerSet.Close();
     if (m_efd != -1) {
         close(m_efd);
         m_efd = -1;
     }
-    for (auto iter = m_fdAndProcessorMap.begin(); iter != m_fdAndProcessorMap.end(); ++iter) {
-        close(iter->first);
-        delete iter->second;
+    for (size_t client = 0; client < m_processors.size(); ++client) {
+        if (m_processors[client] != nullptr) {
+            close(static_cast<int>(client));
+            m_processorPool.Destroy(m_processors[client]);
+        }
+    }
+    m_processors.clear();
+    m_processorNum = 0;
+    TrafficCapture::Stop(); // 包括刚关闭的连接的记录
+    if (m_sseKeepaliveComment != nullptr) {
+        m_sseKeepaliveComment->Unref(); // 订阅者已全部释放
+        m_sseKeepaliveComment = nullptr;
     }
     ClosePipefd();
 }
@@ -430,6 +1491,25 @@ void HttpServer::ClosePipefd()
     }
 }
 
+// 请求排队超时，回复503并关闭连接
+void HttpServer::DropReq(void *arg)
+{
+    HttpReqProcessArg *httpReqProcessArg = reinterpret_cast<HttpReqProcessArg *>(arg);
+    if (httpReqProcessArg == nullptr || httpReqProcessArg->httpServer == nullptr) {
+        return;
+    }
+    HttpServer *httpServer = httpReqProcessArg->httpServer;
+    HttpProcessor *httpProcessor = httpReqProcessArg->httpProcessor;
+    int client = httpReqProcessArg->client;
+    httpServer->m_stats.shedQueueWaitCount++;
+    (void)httpServer->m_overloadResponse.Send(client);
+    // 在处理线程中执行，与ProcessReq一样由事件循环线程关闭连接
+    if (httpProcessor != nullptr) {
+        httpServer->m_completionQueue.Push(httpProcessor->GetCompletionNode(), client, httpProcessor,
+            SEND_RESPONSE_RETURN_CODE_ERROR);
+    }
+}
+
 void HttpServer::ProcessReq(void *arg)
 {
     HttpReqProcessArg *httpReqProcessArg = reinterpret_cast<HttpReqProcessArg *>(arg);
@@ -442,23 +1522,102 @@ void HttpServer::ProcessReq(void *arg)
         return;
     }
     int client = httpReqProcessArg->client;
-    bool ret = httpProcessor->ProcessReadEvent();
-    if (!ret) {
-        httpServer->DelClient(client);
+    httpProcessor->Trace(TRACE_POINT_WORKER_START);
+    if (httpReqProcessArg->largeResponseSize != 0 && httpServer->RequeueLargeReq(*httpReqProcessArg)) {
         return;
     }
-    // 注册客户端的监听写事件
-    struct epoll_event clientEvent = { 0 };
-    clientEvent.events = EPOLLOUT;
-    clientEvent.data.fd = client;
-    int res = epoll_ctl(httpServer->m_efd, EPOLL_CTL_MOD, client, &clientEvent);
-    if (res == -1) {
-        printf("ERROR Register write event fail.\n");
-        httpServer->DelClient(client);
-        return;
+    bool ret = httpServer->ProcessReqInThread(httpProcessor, httpReqProcessArg->parsed);
+    if (ret && httpServer->SubmitDiskIo(client, httpProcessor)) {
+        return; // 由事件循环线程在磁盘线程完成后发送并清除忙状态
+    }
+    // 发送只涉及该连接自己的套接字和处理对象，在处理线程中完成，监听事件和过期时间交给事件循环线程修改
+    SendResponseReturnCode sendRet = ret ? httpProcessor->Write() : SEND_RESPONSE_RETURN_CODE_ERROR;
+    httpServer->m_completionQueue.Push(httpProcessor->GetCompletionNode(), client, httpProcessor, sendRet);
+}
+
+// 返回false表示需要关闭连接
+bool HttpServer::ProcessReqInThread(HttpProcessor *httpProcessor, const bool parsed)
+{
+    m_stats.processReqCount++;
+    if (CpuAffinity::GetCurrentNode() != m_reactorNode) {
+        m_stats.crossNodeReqCount++;
+    }
+    return parsed ? httpProcessor->RespondReadEvent() : httpProcessor->ProcessReadEvent();
+}
+
+// 一次取出本轮唤醒前所有处理线程的完成通知，在事件循环线程中清除忙状态、更新过期时间并按发送结果修改监听事件
+// 长连接发送完成且仍在监听读事件时不需要epoll_ctl，只有发送不完、监听已暂停或连接升级时才修改
+void HttpServer::HandleCompletionEvent()
+{
+    m_completions.clear();
+    m_completionQueue.PollCompletions(m_completions);
+    m_stats.completionWakeCount++;
+    time_t expire = time(NULL) + m_clientExpireInterval;
+    for (const Completion &completion : m_completions) {
+        int client = completion.client;
+        HttpProcessor *httpProcessor = GetProcessor(client);
+        if (httpProcessor == nullptr || httpProcessor != completion.owner) {
+            continue;
+        }
+        bool paused = httpProcessor->ClearBusy();
+        SendResponseReturnCode ret = static_cast<SendResponseReturnCode>(completion.result);
+        // 处理期间连接已被关闭读写并移出过期堆，现在可以释放处理对象
+        if (ret == SEND_RESPONSE_RETURN_CODE_ERROR || !m_clientExpireMinHeap.Contains(client)) {
+            DelClient(client);
+            continue;
+        }
+        ClientExpire clientExpire = { .clientFd = client, .expire = expire };
+        m_clientExpireMinHeap.Modify(clientExpire);
+        ApplySendResult(client, httpProcessor, ret, paused);
+    }
+}
+
+// 回复的文件不在页缓存中时交给磁盘线程，直接发送会在缺页时阻塞当前线程
+// 返回true表示已提交，处理对象保持忙，事件循环线程和处理线程都会调用
+bool HttpServer::SubmitDiskIo(const int client, HttpProcessor *httpProcessor)
+{
+    const char *path = nullptr;
+    off_t length = 0;
+    if (!m_diskIoPool.IsEnabled() || !httpProcessor->GetColdFile(path, length)) {
+        return false;
+    }
+    bool busy = httpProcessor->IsBusy(); // 处理线程中已经是忙状态
+    if (!busy) {
+        httpProcessor->SetBusy();
+    }
+    if (m_diskIoPool.Submit(client, httpProcessor, path, length) == false) {
+        if (!busy) {
+            (void)httpProcessor->ClearBusy();
+        }
+        return false;
+    }
+    m_stats.diskIoReqCount++;
+    return true;
+}
+
+// 磁盘线程完成后，协程驱动的连接恢复协程，其他连接清除忙状态并在本轮事件处理完后发送
+void HttpServer::HandleDiskIoEvent()
+{
+    m_diskIoCompletions.clear();
+    m_diskIoPool.PollCompletions(m_diskIoCompletions);
+    for (const DiskIoCompletion &completion : m_diskIoCompletions) {
+        int client = completion.client;
+        if (m_coroutineDriver.Owns(client)) {
+            m_coroutineDriver.Wake(client, completion.owner);
+            continue;
+        }
+        HttpProcessor *httpProcessor = GetProcessor(client);
+        if (httpProcessor == nullptr || httpProcessor != completion.owner) {
+            continue;
+        }
+        if (httpProcessor->ClearBusy()) {
+            (void)ResumeClientEvents(client, EPOLLIN);
+        }
+        // 处理线程提交的请求在这里更新过期时间，处理期间已被关闭的连接不在过期堆中
+        if (m_clientExpireMinHeap.Contains(client)) {
+            ClientExpire clientExpire = { .clientFd = client, .expire = time(NULL) + m_clientExpireInterval };
+            m_clientExpireMinHeap.Modify(clientExpire);
+        }
+        m_pendingWrites.push_back(std::make_pair(client, httpProcessor));
     }
-    // 更新客户端的过期时间
-    time_t curSec = time(NULL);
-    ClientExpire clientExpire = { .clientFd = client, .expire = curSec + CLIENT_EXPIRE_INTERVAL };
-    httpServer->m_clientExpireMinHeap.Modify(clientExpire);
 }
\ No newline at end of file
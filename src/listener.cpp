@@ -0,0 +1,418 @@
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "listener.h"
+
+const char *UNIX_ADDRESS_PREFIX = "unix:";
+const char LISTENER_SEPARATOR = ',';
+const char LISTENER_OPTION_SEPARATOR = ';';
+const unsigned int MAX_LISTENER_PORT = 65535;
+const unsigned int MAX_LISTENER_BACKLOG = 65535;
+const unsigned int MAX_DEFER_ACCEPT = 3600;
+const unsigned int MAX_FAST_OPEN_QUEUE = 65535;
+const unsigned int MAX_FILE_MODE = 0777;
+const unsigned long long CLIENT_KEY_IPV4_FLAG = 1ULL << 32; // 保证IPv4客户端的键不为0
+const unsigned long long CLIENT_KEY_UNIX_FLAG = 1ULL << 33;
+const unsigned long long CLIENT_KEY_IPV6_FLAG = 1ULL << 63;
+
+static std::string Trim(const std::string &value)
+{
+    size_t begin = value.find_first_not_of(" \t");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    size_t end = value.find_last_not_of(" \t");
+    return value.substr(begin, end - begin + 1);
+}
+
+static bool ParseUint(const std::string &value, const int base, const unsigned int maxValue, unsigned int &result)
+{
+    if (value.empty()) {
+        return false;
+    }
+    char *end = nullptr;
+    errno = 0;
+    unsigned long number = strtoul(value.c_str(), &end, base);
+    if (errno != 0 || *end != '\0' || value[0] == '-' || number > maxValue) {
+        return false;
+    }
+    result = static_cast<unsigned int>(number);
+    return true;
+}
+
+ListenerSet::ListenerSet()
+{}
+
+ListenerSet::~ListenerSet()
+{
+    Close();
+}
+
+bool ListenerSet::ParseList(const std::string &value, const ListenerConfig &defaults,
+    std::vector<ListenerConfig> &configs)
+{
+    configs.clear();
+    size_t begin = 0;
+    while (begin <= value.size()) {
+        size_t end = value.find(LISTENER_SEPARATOR, begin);
+        if (end == std::string::npos) {
+            end = value.size();
+        }
+        std::string item = Trim(value.substr(begin, end - begin));
+        begin = end + 1;
+        if (item.empty()) {
+            continue;
+        }
+        ListenerConfig config = defaults;
+        size_t optionBegin = item.find(LISTENER_OPTION_SEPARATOR);
+        if (!ParseAddress(Trim(item.substr(0, optionBegin)), config)) {
+            printf("ERROR Invalid listener address: %s.\n", item.c_str());
+            return false;
+        }
+        while (optionBegin != std::string::npos) {
+            size_t optionEnd = item.find(LISTENER_OPTION_SEPARATOR, optionBegin + 1);
+            std::string option = Trim(item.substr(optionBegin + 1,
+                optionEnd == std::string::npos ? std::string::npos : optionEnd - optionBegin - 1));
+            if (!ParseOption(option, config)) {
+                printf("ERROR Invalid listener option \"%s\" in %s.\n", option.c_str(), item.c_str());
+                return false;
+            }
+            optionBegin = optionEnd;
+        }
+        for (const ListenerConfig &other : configs) {
+            if (GetName(other) == GetName(config)) {
+                printf("ERROR Duplicate listener: %s.\n", GetName(config).c_str());
+                return false;
+            }
+        }
+        configs.push_back(config);
+    }
+    if (configs.empty()) {
+        printf("ERROR No listener configured.\n");
+        return false;
+    }
+    return true;
+}
+
+bool ListenerSet::ParseAddress(const std::string &address, ListenerConfig &config)
+{
+    size_t prefixLen = strlen(UNIX_ADDRESS_PREFIX);
+    if (address.compare(0, prefixLen, UNIX_ADDRESS_PREFIX) == 0) {
+        config.family = LISTENER_FAMILY_UNIX;
+        config.host = address.substr(prefixLen);
+        config.port = 0;
+        struct sockaddr_un unixAddr;
+        return !config.host.empty() && config.host.size() < sizeof(unixAddr.sun_path);
+    }
+    std::string portValue;
+    if (!address.empty() && address[0] == '[') {
+        size_t hostEnd = address.find("]:");
+        if (hostEnd == std::string::npos) {
+            return false;
+        }
+        config.family = LISTENER_FAMILY_IPV6;
+        config.host = address.substr(1, hostEnd - 1);
+        portValue = address.substr(hostEnd + 2);
+    } else {
+        size_t hostEnd = address.rfind(':');
+        if (hostEnd == std::string::npos) {
+            return false;
+        }
+        config.family = LISTENER_FAMILY_IPV4;
+        config.host = address.substr(0, hostEnd);
+        portValue = address.substr(hostEnd + 1);
+    }
+    unsigned int port = 0;
+    if (!ParseUint(portValue, 10, MAX_LISTENER_PORT, port) || port == 0) {
+        return false;
+    }
+    config.port = static_cast<unsigned short int>(port);
+    unsigned char buff[sizeof(struct in6_addr)];
+    return inet_pton(config.family == LISTENER_FAMILY_IPV6 ? AF_INET6 : AF_INET, config.host.c_str(), buff) == 1;
+}
+
+bool ListenerSet::ParseOption(const std::string &option, ListenerConfig &config)
+{
+    size_t splitPos = option.find('=');
+    if (splitPos == std::string::npos) {
+        return false;
+    }
+    std::string key = Trim(option.substr(0, splitPos));
+    std::string value = Trim(option.substr(splitPos + 1));
+    unsigned int number = 0;
+    if (key == "backlog") {
+        if (!ParseUint(value, 10, MAX_LISTENER_BACKLOG, number) || number == 0) {
+            return false;
+        }
+        config.backlog = number;
+    } else if (key == "defer_accept") {
+        if (!ParseUint(value, 10, MAX_DEFER_ACCEPT, config.options.deferAccept)) {
+            return false;
+        }
+    } else if (key == "fast_open") {
+        if (!ParseUint(value, 10, MAX_FAST_OPEN_QUEUE, config.options.fastOpenQueue)) {
+            return false;
+        }
+    } else if (key == "reuse_addr") {
+        if (!ParseUint(value, 10, 1, number)) {
+            return false;
+        }
+        config.options.reuseAddr = number != 0;
+    } else if (key == "v6only") {
+        if (!ParseUint(value, 10, 1, number) || config.family != LISTENER_FAMILY_IPV6) {
+            return false;
+        }
+        config.v6Only = number != 0;
+    } else if (key == "mode") {
+        if (!ParseUint(value, 8, MAX_FILE_MODE, config.fileMode) || config.family != LISTENER_FAMILY_UNIX) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::string ListenerSet::GetName(const ListenerConfig &config)
+{
+    if (config.family == LISTENER_FAMILY_UNIX) {
+        return UNIX_ADDRESS_PREFIX + config.host;
+    }
+    std::string host = config.family == LISTENER_FAMILY_IPV6 ? "[" + config.host + "]" : config.host;
+    return host + ":" + std::to_string(config.port);
+}
+
+bool ListenerSet::Open(const std::vector<ListenerConfig> &configs)
+{
+    Close();
+    for (const ListenerConfig &config : configs) {
+        Listener listener;
+        if (!OpenOne(config, listener)) {
+            Close();
+            return false;
+        }
+        m_listeners.push_back(listener);
+        printf("EVENT server listen: %s, backlog = %u.\n", listener.name.c_str(), config.backlog);
+    }
+    return true;
+}
+
+bool ListenerSet::OpenOne(const ListenerConfig &config, Listener &listener)
+{
+    listener.family = config.family;
+    listener.name = GetName(config);
+    struct sockaddr_storage addr;
+    memset(&addr, 0, sizeof(addr));
+    socklen_t addrLen = 0;
+    int domain = AF_INET;
+    if (config.family == LISTENER_FAMILY_UNIX) {
+        domain = AF_UNIX;
+        struct sockaddr_un *unixAddr = reinterpret_cast<struct sockaddr_un *>(&addr);
+        unixAddr->sun_family = AF_UNIX;
+        strncpy(unixAddr->sun_path, config.host.c_str(), sizeof(unixAddr->sun_path) - 1);
+        addrLen = sizeof(struct sockaddr_un);
+        // 上次退出时留下的套接字文件会导致bind失败，只删除套接字类型的文件
+        struct stat fileStat;
+        if (stat(config.host.c_str(), &fileStat) == 0 && S_ISSOCK(fileStat.st_mode)) {
+            unlink(config.host.c_str());
+        }
+    } else if (config.family == LISTENER_FAMILY_IPV6) {
+        domain = AF_INET6;
+        struct sockaddr_in6 ipv6Addr = { 0 };
+        ipv6Addr.sin6_family = AF_INET6;
+        ipv6Addr.sin6_port = htons(config.port);
+        (void)inet_pton(AF_INET6, config.host.c_str(), &ipv6Addr.sin6_addr); // 解析配置时已经校验过
+        memcpy(&addr, &ipv6Addr, sizeof(ipv6Addr));
+        addrLen = sizeof(ipv6Addr);
+    } else {
+        struct sockaddr_in ipv4Addr = { 0 };
+        ipv4Addr.sin_family = AF_INET;
+        ipv4Addr.sin_port = htons(config.port);
+        (void)inet_pton(AF_INET, config.host.c_str(), &ipv4Addr.sin_addr);
+        memcpy(&addr, &ipv4Addr, sizeof(ipv4Addr));
+        addrLen = sizeof(ipv4Addr);
+    }
+
+    listener.fd = socket(domain, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener.fd == -1) {
+        printf("ERROR  Create socket fail: %s.\n", listener.name.c_str());
+        return false;
+    }
+    bool ret = true;
+    if (config.family == LISTENER_FAMILY_IPV6) {
+        int v6Only = config.v6Only ? 1 : 0;
+        ret = setsockopt(listener.fd, IPPROTO_IPV6, IPV6_V6ONLY, &v6Only, sizeof(v6Only)) == 0;
+    }
+    if (ret && config.family != LISTENER_FAMILY_UNIX) {
+        ret = SocketOptions::ApplyListener(listener.fd, config.options);
+    }
+    if (ret && bind(listener.fd, reinterpret_cast<struct sockaddr *>(&addr), addrLen) == -1) {
+        printf("ERROR  server bind fail: %s, errno = %d.\n", listener.name.c_str(), errno);
+        ret = false;
+    }
+    if (ret && config.fileMode != 0 && chmod(config.host.c_str(), config.fileMode) == -1) {
+        printf("ERROR  chmod %s fail, errno = %d.\n", config.host.c_str(), errno);
+        ret = false;
+    }
+    if (ret && listen(listener.fd, static_cast<int>(config.backlog)) == -1) {
+        printf("ERROR  server listen fail: %s.\n", listener.name.c_str());
+        ret = false;
+    }
+    if (!ret) {
+        close(listener.fd);
+        listener.fd = -1;
+    }
+    return ret;
+}
+
+bool ListenerSet::Inherit(const std::vector<int> &fds, const std::vector<ListenerConfig> &configs)
+{
+    Close();
+    for (int fd : fds) {
+        Listener listener;
+        listener.fd = fd;
+        if (!Identify(fd, listener)) {
+            close(fd);
+            continue;
+        }
+        m_listeners.push_back(listener);
+        // 新进程可能修改了监听选项，TCP_DEFER_ACCEPT和TCP_FASTOPEN在监听状态下也可以设置
+        bool configured = false;
+        for (const ListenerConfig &config : configs) {
+            if (GetName(config) == listener.name) {
+                if (config.family != LISTENER_FAMILY_UNIX) {
+                    (void)SocketOptions::ApplyListener(fd, config.options);
+                }
+                configured = true;
+                break;
+            }
+        }
+        if (!configured) {
+            printf("WARN  Inherited listener %s is not configured, take effect after restart.\n",
+                listener.name.c_str());
+        }
+        printf("EVENT server inherit listener %s, fd %d from old process.\n", listener.name.c_str(), fd);
+    }
+    if (m_listeners.size() != configs.size()) {
+        printf("WARN  Inherit %zu listeners, %zu configured, take effect after restart.\n", m_listeners.size(),
+            configs.size());
+    }
+    return !m_listeners.empty();
+}
+
+// 接管的套接字没有配置信息，按本端地址得到族和名字
+bool ListenerSet::Identify(const int fd, Listener &listener)
+{
+    struct sockaddr_storage addr;
+    memset(&addr, 0, sizeof(addr));
+    socklen_t addrLen = sizeof(addr);
+    if (getsockname(fd, reinterpret_cast<struct sockaddr *>(&addr), &addrLen) == -1) {
+        printf("ERROR  getsockname fail, fd = %d.\n", fd);
+        return false;
+    }
+    ListenerConfig config;
+    char host[INET6_ADDRSTRLEN] = { 0 };
+    if (addr.ss_family == AF_UNIX) {
+        config.family = LISTENER_FAMILY_UNIX;
+        config.host = reinterpret_cast<struct sockaddr_un *>(&addr)->sun_path;
+    } else if (addr.ss_family == AF_INET6) {
+        struct sockaddr_in6 *ipv6Addr = reinterpret_cast<struct sockaddr_in6 *>(&addr);
+        config.family = LISTENER_FAMILY_IPV6;
+        config.host = inet_ntop(AF_INET6, &ipv6Addr->sin6_addr, host, sizeof(host));
+        config.port = ntohs(ipv6Addr->sin6_port);
+    } else if (addr.ss_family == AF_INET) {
+        struct sockaddr_in *ipv4Addr = reinterpret_cast<struct sockaddr_in *>(&addr);
+        config.family = LISTENER_FAMILY_IPV4;
+        config.host = inet_ntop(AF_INET, &ipv4Addr->sin_addr, host, sizeof(host));
+        config.port = ntohs(ipv4Addr->sin_port);
+    } else {
+        printf("ERROR  Unknown listener address family %u, fd = %d.\n", addr.ss_family, fd);
+        return false;
+    }
+    listener.family = config.family;
+    listener.name = GetName(config);
+    return true;
+}
+
+const std::vector<Listener> &ListenerSet::Get() const
+{
+    return m_listeners;
+}
+
+// 监听套接字只有几个，顺序查找比哈希表更快
+const Listener *ListenerSet::Find(const int fd) const
+{
+    for (const Listener &listener : m_listeners) {
+        if (listener.fd == fd) {
+            return &listener;
+        }
+    }
+    return nullptr;
+}
+
+std::vector<int> ListenerSet::GetFds() const
+{
+    std::vector<int> fds;
+    for (const Listener &listener : m_listeners) {
+        fds.push_back(listener.fd);
+    }
+    return fds;
+}
+
+bool ListenerSet::Empty() const
+{
+    return m_listeners.empty();
+}
+
+// 不删除Unix域套接字文件，平滑升级时新进程仍在使用，下次启动时再删除
+void ListenerSet::Close()
+{
+    for (const Listener &listener : m_listeners) {
+        close(listener.fd);
+    }
+    m_listeners.clear();
+}
+
+// IPv4映射的IPv6地址与IPv4地址得到相同的标识，Unix域套接字按对端用户区分
+unsigned long long ListenerSet::IdentifyPeer(const int client, const struct sockaddr_storage &addr, char *peerName,
+    const size_t peerNameLen)
+{
+    char host[INET6_ADDRSTRLEN] = { 0 };
+    if (addr.ss_family == AF_INET) {
+        const struct sockaddr_in *ipv4Addr = reinterpret_cast<const struct sockaddr_in *>(&addr);
+        snprintf(peerName, peerNameLen, "%s:%hu", inet_ntop(AF_INET, &ipv4Addr->sin_addr, host, sizeof(host)),
+            ntohs(ipv4Addr->sin_port));
+        return CLIENT_KEY_IPV4_FLAG | ipv4Addr->sin_addr.s_addr;
+    }
+    if (addr.ss_family == AF_INET6) {
+        const struct sockaddr_in6 *ipv6Addr = reinterpret_cast<const struct sockaddr_in6 *>(&addr);
+        snprintf(peerName, peerNameLen, "[%s]:%hu", inet_ntop(AF_INET6, &ipv6Addr->sin6_addr, host, sizeof(host)),
+            ntohs(ipv6Addr->sin6_port));
+        const unsigned char *bytes = ipv6Addr->sin6_addr.s6_addr;
+        if (IN6_IS_ADDR_V4MAPPED(&ipv6Addr->sin6_addr)) {
+            unsigned int ipv4 = 0;
+            memcpy(&ipv4, bytes + 12, sizeof(ipv4));
+            return CLIENT_KEY_IPV4_FLAG | ipv4;
+        }
+        // 运营商一般给每个用户分配一个/64前缀，接口标识可以随意更换，只按前64位区分客户端
+        unsigned long long prefix = 0;
+        memcpy(&prefix, bytes, sizeof(prefix));
+        return CLIENT_KEY_IPV6_FLAG | (prefix * 0x9e3779b97f4a7c15ULL);
+    }
+    // Unix域套接字的客户端一般不绑定路径，用对端进程号记录日志
+    struct ucred cred = { 0 };
+    socklen_t credLen = sizeof(cred);
+    if (addr.ss_family != AF_UNIX || getsockopt(client, SOL_SOCKET, SO_PEERCRED, &cred, &credLen) == -1) {
+        snprintf(peerName, peerNameLen, "unknown");
+        return CLIENT_KEY_UNIX_FLAG;
+    }
+    snprintf(peerName, peerNameLen, "unix:pid=%d", cred.pid);
+    return CLIENT_KEY_UNIX_FLAG | cred.uid;
+}
\ No newline at end of file
@@ -0,0 +1,172 @@
+#include <sys/socket.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "listener_handoff.h"
+
+extern char **environ;
+
+const char *UPGRADE_CHANNEL_ENV_NAME = "HTTP_SERVER_UPGRADE_CHANNEL";
+const unsigned int MAX_HANDOFF_FD_NUM = 64; // 单次最多传递的监听套接字数量
+
+enum ChannelFdIdx {
+    CHANNEL_PARENT_FD_INDEX = 0, // 旧进程使用的一端
+    CHANNEL_CHILD_FD_INDEX = 1, // 新进程使用的一端
+    CHANNEL_FD_NUM,
+};
+
+std::string ListenerHandoff::m_executable;
+
+// 升级时替换的是同一路径下的文件，所以只解析路径，不能在升级时直接执行/proc/self/exe(指向旧文件)
+void ListenerHandoff::ResolveExecutable()
+{
+    char path[PATH_MAX] = { 0 };
+    ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (len <= 0) {
+        printf("WARN  Resolve executable path fail, errno = %d, upgrade will search PATH.\n", errno);
+        return;
+    }
+    path[len] = '\0';
+    m_executable = path;
+}
+
+int ListenerHandoff::Spawn(const std::vector<std::string> &args, pid_t &childPid)
+{
+    if (args.empty()) {
+        printf("ERROR  No executable to spawn.\n");
+        return -1;
+    }
+    int channel[CHANNEL_FD_NUM] = { -1, -1 };
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, channel) == -1) {
+        printf("ERROR  Create upgrade channel fail, errno = %d.\n", errno);
+        return -1;
+    }
+    // fork后的子进程只能调用异步信号安全的函数，参数和环境变量在fork前准备好
+    std::string channelEnv = std::string(UPGRADE_CHANNEL_ENV_NAME) + "=" + std::to_string(channel[CHANNEL_CHILD_FD_INDEX]);
+    std::vector<char *> argv;
+    for (const std::string &arg : args) {
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+    const char *executable = m_executable.empty() ? argv[0] : m_executable.c_str();
+    std::vector<char *> envp;
+    size_t envNameLen = strlen(UPGRADE_CHANNEL_ENV_NAME);
+    for (char **env = environ; *env != nullptr; ++env) {
+        if (strncmp(*env, UPGRADE_CHANNEL_ENV_NAME, envNameLen) != 0 || (*env)[envNameLen] != '=') {
+            envp.push_back(*env);
+        }
+    }
+    envp.push_back(const_cast<char *>(channelEnv.c_str()));
+    envp.push_back(nullptr);
+
+    childPid = fork();
+    if (childPid == -1) {
+        printf("ERROR  fork fail, errno = %d.\n", errno);
+        close(channel[CHANNEL_PARENT_FD_INDEX]);
+        close(channel[CHANNEL_CHILD_FD_INDEX]);
+        return -1;
+    }
+    if (childPid == 0) {
+        // 子进程的通道套接字需要跨过exec
+        (void)fcntl(channel[CHANNEL_CHILD_FD_INDEX], F_SETFD, 0);
+        if (m_executable.empty()) {
+            execvpe(executable, argv.data(), envp.data());
+        } else {
+            execve(executable, argv.data(), envp.data());
+        }
+        _exit(127);
+    }
+    close(channel[CHANNEL_CHILD_FD_INDEX]);
+    return channel[CHANNEL_PARENT_FD_INDEX];
+}
+
+int ListenerHandoff::GetInheritedChannel()
+{
+    const char *value = getenv(UPGRADE_CHANNEL_ENV_NAME);
+    if (value == nullptr) {
+        return -1;
+    }
+    int channel = atoi(value);
+    (void)unsetenv(UPGRADE_CHANNEL_ENV_NAME); // 避免再次升级时传给下一个进程
+    if (channel < 0 || fcntl(channel, F_GETFD) == -1) {
+        printf("ERROR  Invalid upgrade channel: %s.\n", value);
+        return -1;
+    }
+    (void)fcntl(channel, F_SETFD, FD_CLOEXEC);
+    return channel;
+}
+
+bool ListenerHandoff::SendFds(const int channel, const std::vector<int> &fds)
+{
+    if (fds.empty() || fds.size() > MAX_HANDOFF_FD_NUM) {
+        printf("ERROR  Invalid handoff fd num: %zu.\n", fds.size());
+        return false;
+    }
+    unsigned int fdNum = fds.size();
+    size_t fdBytes = sizeof(int) * fdNum;
+    std::vector<char> control(CMSG_SPACE(fdBytes), 0);
+    struct iovec iov = { .iov_base = &fdNum, .iov_len = sizeof(fdNum) };
+    struct msghdr msg = { 0 };
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(fdBytes);
+    memcpy(CMSG_DATA(cmsg), fds.data(), fdBytes);
+    if (sendmsg(channel, &msg, MSG_NOSIGNAL) != sizeof(fdNum)) {
+        printf("ERROR  Send listener fds fail, errno = %d.\n", errno);
+        return false;
+    }
+    return true;
+}
+
+bool ListenerHandoff::RecvFds(const int channel, std::vector<int> &fds)
+{
+    unsigned int fdNum = 0;
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * MAX_HANDOFF_FD_NUM), 0);
+    struct iovec iov = { .iov_base = &fdNum, .iov_len = sizeof(fdNum) };
+    struct msghdr msg = { 0 };
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+    ssize_t ret;
+    do {
+        ret = recvmsg(channel, &msg, MSG_CMSG_CLOEXEC);
+    } while (ret == -1 && errno == EINTR);
+    if (ret != sizeof(fdNum)) {
+        printf("ERROR  Recv listener fds fail, ret = %zd, errno = %d.\n", ret, errno);
+        return false;
+    }
+    fds.clear();
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        unsigned int num = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        const int *data = reinterpret_cast<const int *>(CMSG_DATA(cmsg));
+        fds.insert(fds.end(), data, data + num);
+    }
+    if (fds.size() != fdNum || (msg.msg_flags & MSG_CTRUNC)) {
+        printf("ERROR  Recv %zu listener fds, expect %u.\n", fds.size(), fdNum);
+        for (int fd : fds) {
+            close(fd);
+        }
+        fds.clear();
+        return false;
+    }
+    return true;
+}
+
+bool ListenerHandoff::SendReady(const int channel)
+{
+    char flag = UPGRADE_READY_FLAG;
+    return send(channel, &flag, sizeof(flag), MSG_NOSIGNAL) == sizeof(flag);
+}
\ No newline at end of file
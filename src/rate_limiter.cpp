@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "route_list.h"
+#include "rate_limiter.h"
+
+const unsigned int RATE_LIMITER_SHARD_NUM = 16; // 分片数量，必须是2的幂
+const unsigned int RATE_LIMITER_MIN_SHARD_SLOTS = 64;
+const unsigned int RATE_LIMITER_EVICT_PROBE = 8; // 分片满时在新键起始槽位之后的8个桶中选择被替换的桶
+const double NSEC_PER_SEC_DOUBLE = 1000000000.0;
+const char ROUTE_LIMIT_FIELD_SPLIT_CHAR = ':';
+
+RateLimiter::RateLimiter()
+{}
+
+RateLimiter::~RateLimiter()
+{}
+
+bool RateLimiter::Init(const unsigned int tableSize, const double rate, const double burst)
+{
+    m_shards.clear();
+    m_rate = rate;
+    m_burst = burst < 1 ? 1 : burst;
+    if (rate <= 0) {
+        return true; // 不限流
+    }
+    // 每个分片的槽位数取不小于tableSize / 分片数的2的幂
+    unsigned int shardSlots = RATE_LIMITER_MIN_SHARD_SLOTS;
+    while (shardSlots * RATE_LIMITER_SHARD_NUM < tableSize) {
+        shardSlots *= 2;
+    }
+    m_shards.resize(RATE_LIMITER_SHARD_NUM);
+    for (Shard &shard : m_shards) {
+        shard.buckets.assign(shardSlots, TokenBucket { 0, 0, 0 });
+        shard.size = 0;
+    }
+    m_shardMask = RATE_LIMITER_SHARD_NUM - 1;
+    m_slotMask = shardSlots - 1;
+    m_maxShardSize = shardSlots / 4 * 3; // 负载因子不超过0.75
+    return true;
+}
+
+bool RateLimiter::IsEnabled() const
+{
+    return !m_shards.empty();
+}
+
+unsigned long long RateLimiter::HashKey(const unsigned long long value)
+{
+    // splitmix64
+    unsigned long long hash = value + 0x9e3779b97f4a7c15ULL;
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 31);
+}
+
+bool RateLimiter::Allow(const unsigned long long key, const unsigned long long now)
+{
+    if (m_shards.empty()) {
+        return true;
+    }
+    unsigned long long hash = HashKey(key);
+    // 高位选分片，低位选槽位，两者互不相关
+    Shard &shard = m_shards[(hash >> 59) & m_shardMask];
+    TokenBucket *bucket = Find(shard, key, hash);
+    if (bucket == nullptr) {
+        bucket = Insert(shard, key, hash, now);
+        if (bucket == nullptr) {
+            return true; // 键为0表示无法识别客户端
+        }
+    }
+    if (now > bucket->lastTime) {
+        bucket->tokens += (now - bucket->lastTime) / NSEC_PER_SEC_DOUBLE * m_rate;
+        if (bucket->tokens > m_burst) {
+            bucket->tokens = m_burst;
+        }
+        bucket->lastTime = now;
+    }
+    if (bucket->tokens < 1) {
+        return false;
+    }
+    bucket->tokens -= 1;
+    return true;
+}
+
+TokenBucket *RateLimiter::Find(Shard &shard, const unsigned long long key, const unsigned long long hash)
+{
+    unsigned int idx = static_cast<unsigned int>(hash) & m_slotMask;
+    while (shard.buckets[idx].key != 0) {
+        if (shard.buckets[idx].key == key) {
+            return &shard.buckets[idx];
+        }
+        idx = (idx + 1) & m_slotMask;
+    }
+    return nullptr;
+}
+
+TokenBucket *RateLimiter::Insert(Shard &shard, const unsigned long long key, const unsigned long long hash,
+    const unsigned long long now)
+{
+    if (key == 0) {
+        return nullptr;
+    }
+    unsigned int idx = static_cast<unsigned int>(hash) & m_slotMask;
+    if (shard.size >= m_maxShardSize) {
+        // 新键挤掉的是附近最久未访问的桶，大量新键只能互相替换，已经在表中的活跃客户端不受影响
+        unsigned int victim = idx;
+        unsigned long long oldest = ULLONG_MAX;
+        for (unsigned int i = 0, probe = idx; i < RATE_LIMITER_EVICT_PROBE; probe = (probe + 1) & m_slotMask) {
+            if (shard.buckets[probe].key == 0) {
+                continue;
+            }
+            if (shard.buckets[probe].lastTime < oldest) {
+                oldest = shard.buckets[probe].lastTime;
+                victim = probe;
+            }
+            i++;
+        }
+        Erase(shard, victim);
+    }
+    while (shard.buckets[idx].key != 0) {
+        idx = (idx + 1) & m_slotMask;
+    }
+    shard.buckets[idx] = TokenBucket { key, m_burst, now };
+    shard.size++;
+    return &shard.buckets[idx];
+}
+
+void RateLimiter::EvictIdle(const unsigned long long now, const unsigned long long idleTime)
+{
+    for (Shard &shard : m_shards) {
+        EvictShard(shard, now, idleTime);
+    }
+}
+
+// 删除后后面的桶可能移到当前槽位，同一槽位需要再检查一次
+void RateLimiter::EvictShard(Shard &shard, const unsigned long long now, const unsigned long long idleTime)
+{
+    unsigned int idx = 0;
+    while (idx <= m_slotMask) {
+        const TokenBucket &bucket = shard.buckets[idx];
+        if (bucket.key != 0 && bucket.lastTime + idleTime <= now) {
+            Erase(shard, idx);
+            continue;
+        }
+        idx++;
+    }
+}
+
+// 线性探测不能直接清空槽位，否则会截断探测链；把后面起始槽位不在空洞之后的桶依次前移填补空洞
+void RateLimiter::Erase(Shard &shard, unsigned int idx)
+{
+    unsigned int hole = idx;
+    unsigned int next = (hole + 1) & m_slotMask;
+    while (shard.buckets[next].key != 0) {
+        unsigned int home = static_cast<unsigned int>(HashKey(shard.buckets[next].key)) & m_slotMask;
+        if (((next - home) & m_slotMask) >= ((next - hole) & m_slotMask)) {
+            shard.buckets[hole] = shard.buckets[next];
+            hole = next;
+        }
+        next = (next + 1) & m_slotMask;
+    }
+    shard.buckets[hole].key = 0;
+    shard.size--;
+}
+
+unsigned int RateLimiter::Size() const
+{
+    unsigned int size = 0;
+    for (const Shard &shard : m_shards) {
+        size += shard.size;
+    }
+    return size;
+}
+
+bool RateLimiter::ParseRouteLimits(const std::string &value, std::vector<RouteLimit> &routeLimits)
+{
+    std::vector<RouteItem> items;
+    if (!RouteList::Parse(value, 2, "route limit", items)) {
+        return false;
+    }
+    routeLimits.clear();
+    for (const RouteItem &item : items) {
+        RouteLimit routeLimit;
+        routeLimit.prefix = item.prefix;
+        const char *rate = item.value.c_str();
+        const char *burst = strchr(rate, ROUTE_LIMIT_FIELD_SPLIT_CHAR);
+        routeLimit.rate = atof(rate);
+        routeLimit.burst = atof(burst + 1); // 按两个字段拆分过，一定有冒号
+        if (routeLimit.rate <= 0 || routeLimit.burst < 1) {
+            printf("ERROR Invalid route limit: %s:%s.\n", item.prefix.c_str(), rate);
+            return false;
+        }
+        routeLimits.push_back(routeLimit);
+    }
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <time.h>
+#include <stdio.h>
+#include <algorithm>
+#include "request_trace.h"
+
+typedef struct {
+    const char *pointName;
+    const char *spanName; // 以该时间点结束的区间名称
+} TracePointInfo;
+
+const TracePointInfo TRACE_POINT_INFO_LIST[TRACE_POINT_NUM] = {
+    { "accept", "accept" },
+    { "read", "read" },
+    { "enqueue", "dispatch" },
+    { "worker_start", "queue" },
+    { "parse_end", "parse" },
+    { "handle_end", "handle" },
+    { "first_byte", "respond" },
+    { "last_byte", "send" },
+};
+
+std::atomic<unsigned int> RequestTrace::m_sampleInterval { 0 };
+std::atomic<unsigned long long> RequestTrace::m_nextTraceId { 0 };
+unsigned int RequestTrace::m_ringSize { 0 };
+pthread_mutex_t RequestTrace::m_mutex = PTHREAD_MUTEX_INITIALIZER;
+std::vector<RequestTrace::Ring *> RequestTrace::m_rings;
+
+void RequestTrace::Init(const unsigned int sampleInterval, const unsigned int ringSize)
+{
+    (void)pthread_mutex_lock(&m_mutex);
+    if (m_rings.empty() && ringSize != 0) {
+        m_ringSize = ringSize;
+    }
+    (void)pthread_mutex_unlock(&m_mutex);
+    m_sampleInterval.store(sampleInterval, std::memory_order_relaxed);
+}
+
+// 每个线程独立计数，每sampleInterval个请求抽中一个
+unsigned long long RequestTrace::SampleSlow()
+{
+    static thread_local unsigned int requestCount = 0;
+    if (++requestCount < m_sampleInterval.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+    requestCount = 0;
+    return m_nextTraceId.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+RequestTrace::RingHolder::~RingHolder()
+{
+    if (ring == nullptr) {
+        return;
+    }
+    (void)pthread_mutex_lock(&m_mutex);
+    ring->owned = false;
+    (void)pthread_mutex_unlock(&m_mutex);
+}
+
+// 线程第一次记录事件时取一个没有线程使用的缓冲区，没有时新建
+RequestTrace::Ring *RequestTrace::GetRing()
+{
+    static thread_local RingHolder holder;
+    if (holder.ring != nullptr) {
+        return holder.ring;
+    }
+    (void)pthread_mutex_lock(&m_mutex);
+    for (Ring *ring : m_rings) {
+        if (!ring->owned) {
+            holder.ring = ring;
+            break;
+        }
+    }
+    if (holder.ring == nullptr) {
+        holder.ring = new Ring;
+        holder.ring->events.resize(m_ringSize);
+        m_rings.push_back(holder.ring);
+    }
+    holder.ring->owned = true;
+    (void)pthread_mutex_unlock(&m_mutex);
+    return holder.ring;
+}
+
+// 先写事件再发布head，导出时丢弃读取期间可能被覆盖的事件
+void RequestTrace::Record(const unsigned long long traceId, const int socketId, const TracePoint point)
+{
+    static thread_local int tid = static_cast<int>(syscall(SYS_gettid));
+    Ring *ring = GetRing();
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    unsigned long long head = ring->head.load(std::memory_order_relaxed);
+    TraceEvent &event = ring->events[head % ring->events.size()];
+    event.traceId = traceId;
+    event.time = static_cast<unsigned long long>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+    event.tid = tid;
+    event.socketId = socketId;
+    event.point = point;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void RequestTrace::CollectEvents(std::vector<TraceEvent> &events)
+{
+    (void)pthread_mutex_lock(&m_mutex);
+    std::vector<Ring *> rings = m_rings;
+    (void)pthread_mutex_unlock(&m_mutex);
+    for (Ring *ring : rings) {
+        unsigned long long size = ring->events.size();
+        unsigned long long head = ring->head.load(std::memory_order_acquire);
+        unsigned long long start = head > size ? head - size : 0;
+        size_t oldSize = events.size();
+        for (unsigned long long i = start; i < head; ++i) {
+            events.push_back(ring->events[i % size]);
+        }
+        // 复制期间写入线程又写入了事件，最早的一部分可能已被覆盖；newHead对应的槽位可能正在写入，也一并丢弃
+        unsigned long long newHead = ring->head.load(std::memory_order_acquire);
+        unsigned long long overwritten = newHead + 1 > start + size ? newHead + 1 - start - size : 0;
+        if (overwritten != 0) {
+            events.erase(events.begin() + oldSize,
+                events.begin() + oldSize + std::min<unsigned long long>(overwritten, head - start));
+        }
+    }
+}
+
+// 每个请求一行(tid为traceId)，时间点为瞬时事件，相邻时间点之间为区间，args中的thread是记录事件的线程
+bool RequestTrace::Export(const std::string &path)
+{
+    std::vector<TraceEvent> events;
+    CollectEvents(events);
+    std::sort(events.begin(), events.end(), [](const TraceEvent &left, const TraceEvent &right) {
+        return left.traceId != right.traceId ? left.traceId < right.traceId : left.time < right.time;
+    });
+    std::string tmpPath = path + ".tmp";
+    FILE *file = fopen(tmpPath.c_str(), "w");
+    if (file == nullptr) {
+        printf("ERROR Open trace file fail: %s.\n", tmpPath.c_str());
+        return false;
+    }
+    int pid = static_cast<int>(getpid());
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"http_server requests\"}}",
+        pid);
+    unsigned long long traceNum = 0;
+    for (size_t i = 0; i < events.size(); ++i) {
+        const TraceEvent &event = events[i];
+        const TracePointInfo &info = TRACE_POINT_INFO_LIST[event.point < TRACE_POINT_NUM ? event.point : 0];
+        double ts = event.time / 1000.0;
+        if (i == 0 || events[i - 1].traceId != event.traceId) {
+            traceNum++;
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%llu,"
+                "\"args\":{\"name\":\"request %llu fd %d\"}}", pid, event.traceId, event.traceId, event.socketId);
+        } else {
+            const TraceEvent &prev = events[i - 1];
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%llu,\"ts\":%.3f,\"dur\":%.3f,"
+                "\"args\":{\"thread\":%d}}", info.spanName, pid, event.traceId, prev.time / 1000.0,
+                (event.time - prev.time) / 1000.0, event.tid);
+        }
+        fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%llu,\"ts\":%.3f,"
+            "\"args\":{\"thread\":%d}}", info.pointName, pid, event.traceId, ts, event.tid);
+    }
+    fprintf(file, "\n]}\n");
+    bool ok = fflush(file) == 0 && ferror(file) == 0;
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) == -1) {
+        printf("ERROR Write trace file fail: %s.\n", path.c_str());
+        (void)unlink(tmpPath.c_str());
+        return false;
+    }
+    printf("EVENT  Trace exported to %s, requests = %llu, events = %zu.\n", path.c_str(), traceNum, events.size());
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#include <stdio.h>
+#include "route_list.h"
+
+const char ROUTE_LIST_SPLIT_CHAR = ',';
+const char ROUTE_LIST_FIELD_SPLIT_CHAR = ':';
+
+bool RouteList::Parse(const std::string &list, const unsigned int fieldNum, const char *name,
+    std::vector<RouteItem> &items)
+{
+    items.clear();
+    size_t start = 0;
+    while (start < list.size()) {
+        size_t end = list.find(ROUTE_LIST_SPLIT_CHAR, start);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        std::string item = list.substr(start, end - start);
+        start = end + 1;
+        if (item.empty()) {
+            continue;
+        }
+        size_t split = item.size();
+        for (unsigned int i = 0; i < fieldNum && split != std::string::npos && split != 0; ++i) {
+            split = item.rfind(ROUTE_LIST_FIELD_SPLIT_CHAR, split - 1);
+        }
+        if (split == std::string::npos || split == 0 || split + 1 == item.size() || item[0] != '/') {
+            printf("ERROR Invalid %s: %s.\n", name, item.c_str());
+            return false;
+        }
+        RouteItem routeItem;
+        routeItem.prefix = item.substr(0, split);
+        routeItem.value = item.substr(split + 1);
+        items.push_back(routeItem);
+    }
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#include <stdio.h>
+#include "server_stats.h"
+
+void ServerStats::Dump() const
+{
+    printf("STATS  accept = %lu, reject_conn = %lu, pause_accept = %lu, shed_queue_full = %lu, "
+        "shed_queue_wait = %lu, rate_limited = %lu, process_req = %lu, inline_req = %lu, offload_req = %lu, "
+        "coroutine_req = %lu, cross_node_req = %lu, disk_io_req = %lu, websocket_upgrade = %lu, "
+        "websocket_timeout = %lu, sse_subscribe = %lu, sse_publish = %lu, sse_push = %lu, sse_drop = %lu, "
+        "completion_wake = %lu\n",
+        acceptCount.load(), rejectConnCount.load(), pauseAcceptCount.load(), shedQueueFullCount.load(),
+        shedQueueWaitCount.load(), rateLimitedCount.load(), processReqCount.load(), inlineReqCount.load(),
+        offloadReqCount.load(), coroutineReqCount.load(), crossNodeReqCount.load(), diskIoReqCount.load(),
+        webSocketUpgradeCount.load(), webSocketTimeoutCount.load(), sseSubscribeCount.load(),
+        ssePublishCount.load(), ssePushCount.load(), sseDropCount.load(), completionWakeCount.load());
+    fflush(stdout);
+}
+
+int ServerStats::Format(char *buff, const size_t buffLen) const
+{
+    int ret = snprintf(buff, buffLen, "{\"accept\":%lu,\"reject_conn\":%lu,\"shed_queue_full\":%lu,"
+        "\"shed_queue_wait\":%lu,\"rate_limited\":%lu,\"process_req\":%lu,\"inline_req\":%lu,"
+        "\"coroutine_req\":%lu,\"disk_io_req\":%lu,\"websocket_upgrade\":%lu,\"sse_subscribe\":%lu,"
+        "\"sse_publish\":%lu,\"sse_drop\":%lu}", acceptCount.load(), rejectConnCount.load(),
+        shedQueueFullCount.load(), shedQueueWaitCount.load(), rateLimitedCount.load(), processReqCount.load(),
+        inlineReqCount.load(), coroutineReqCount.load(), diskIoReqCount.load(), webSocketUpgradeCount.load(),
+        sseSubscribeCount.load(), ssePublishCount.load(), sseDropCount.load());
+    if (ret < 0) {
+        return 0;
+    }
+    return static_cast<size_t>(ret) < buffLen ? ret : static_cast<int>(buffLen - 1);
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "socket_options.h"
+
+// 旧版本的内核头文件中没有epoll忙轮询参数的定义，按linux/eventpoll.h补充
+#ifndef EPIOCSPARAMS
+struct epoll_params {
+    uint32_t busy_poll_usecs;
+    uint16_t busy_poll_budget;
+    uint8_t prefer_busy_poll;
+    uint8_t __pad;
+};
+#define EPOLL_IOC_TYPE 0x8A
+#define EPIOCSPARAMS _IOW(EPOLL_IOC_TYPE, 0x01, struct epoll_params)
+#endif
+
+bool SocketOptions::ApplyListener(const int fd, const ListenerOptions &options)
+{
+    int value = options.reuseAddr ? 1 : 0;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &value, sizeof(value)) == -1) {
+        printf("ERROR  setsockopt SO_REUSEADDR fail, errno = %d.\n", errno);
+        return false;
+    }
+    value = static_cast<int>(options.deferAccept);
+    if (setsockopt(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &value, sizeof(value)) == -1) {
+        printf("ERROR  setsockopt TCP_DEFER_ACCEPT fail, errno = %d.\n", errno);
+        return false;
+    }
+    // 未启用时不设置，保持系统默认，内核关闭Fast Open时设置会失败，只打印告警
+    if (options.fastOpenQueue != 0) {
+        value = static_cast<int>(options.fastOpenQueue);
+        if (setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, &value, sizeof(value)) == -1) {
+            printf("WARN  setsockopt TCP_FASTOPEN fail, errno = %d, check net.ipv4.tcp_fastopen.\n", errno);
+        }
+    }
+    return true;
+}
+
+void SocketOptions::ApplyConnection(const int fd, const ConnectionOptions &options)
+{
+    if (options.noDelay) {
+        int value = 1;
+        if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value)) == -1) {
+            printf("WARN  setsockopt TCP_NODELAY fail, fd = %d, errno = %d.\n", fd, errno);
+        }
+    }
+    // 超过net.core.busy_read的值需要CAP_NET_ADMIN权限
+    if (options.busyPoll != 0) {
+        int value = static_cast<int>(options.busyPoll);
+        if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &value, sizeof(value)) == -1) {
+            printf("WARN  setsockopt SO_BUSY_POLL fail, fd = %d, errno = %d.\n", fd, errno);
+        }
+    }
+}
+
+bool SocketOptions::ApplyEpollBusyPoll(const int efd, const unsigned int busyPoll, const unsigned int budget)
+{
+    struct epoll_params params;
+    memset(&params, 0, sizeof(params));
+    params.busy_poll_usecs = busyPoll;
+    params.busy_poll_budget = static_cast<uint16_t>(budget);
+    params.prefer_busy_poll = busyPoll != 0 ? 1 : 0;
+    if (ioctl(efd, EPIOCSPARAMS, &params) == -1) {
+        printf("WARN  ioctl EPIOCSPARAMS fail, errno = %d, epoll busy poll needs linux 6.9 or later.\n", errno);
+        return false;
+    }
+    return true;
+}
\ No newline at end of file
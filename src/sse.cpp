@@ -0,0 +1,486 @@
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <new>
+#include "route_list.h"
+#include "sse.h"
+
+const char *SSE_SLOW_POLICY_DROP = "drop";
+const char *SSE_SLOW_POLICY_CLOSE = "close";
+const char *SSE_ID_FIELD = "id: ";
+const char *SSE_EVENT_FIELD = "event: ";
+const char *SSE_DATA_FIELD = "data: ";
+const char *SSE_FIELD_END_CHARS = "\r\n";
+
+SseEvent *SseEvent::Allocate(const size_t size)
+{
+    void *memory = malloc(sizeof(SseEvent) + size);
+    if (memory == nullptr) {
+        return nullptr;
+    }
+    SseEvent *event = new (memory) SseEvent();
+    event->m_size = size;
+    return event;
+}
+
+// 格式为"id: <id>\nevent: <event>\ndata: <行>\n...\n"，事件名中的换行之后的内容丢弃
+SseEvent *SseEvent::Create(const unsigned long long id, const char *event, const char *data, const size_t len)
+{
+    char idField[32];
+    int idLen = snprintf(idField, sizeof(idField), "%s%llu\n", SSE_ID_FIELD, id);
+    size_t eventLen = event == nullptr ? 0 : strcspn(event, SSE_FIELD_END_CHARS);
+    size_t lineNum = 1;
+    for (size_t i = 0; i < len; ++i) {
+        lineNum += data[i] == '\n' ? 1 : 0;
+    }
+    size_t size = idLen + (eventLen == 0 ? 0 : strlen(SSE_EVENT_FIELD) + eventLen + 1) +
+        lineNum * (strlen(SSE_DATA_FIELD) + 1) + len + 1;
+    SseEvent *sseEvent = Allocate(size);
+    if (sseEvent == nullptr) {
+        return nullptr;
+    }
+    char *pos = reinterpret_cast<char *>(sseEvent + 1);
+    memcpy(pos, idField, idLen);
+    pos += idLen;
+    if (eventLen != 0) {
+        pos += sprintf(pos, "%s%.*s\n", SSE_EVENT_FIELD, static_cast<int>(eventLen), event);
+    }
+    size_t start = 0;
+    while (true) {
+        const char *end = static_cast<const char *>(memchr(data + start, '\n', len - start));
+        size_t lineLen = end == nullptr ? len - start : end - (data + start);
+        size_t copyLen = lineLen > 0 && data[start + lineLen - 1] == '\r' ? lineLen - 1 : lineLen;
+        memcpy(pos, SSE_DATA_FIELD, strlen(SSE_DATA_FIELD));
+        pos += strlen(SSE_DATA_FIELD);
+        memcpy(pos, data + start, copyLen);
+        pos += copyLen;
+        *pos++ = '\n';
+        if (end == nullptr) {
+            break;
+        }
+        start += lineLen + 1;
+    }
+    *pos++ = '\n';
+    sseEvent->m_size = pos - reinterpret_cast<char *>(sseEvent + 1); // 去掉的'\r'不计入长度
+    return sseEvent;
+}
+
+SseEvent *SseEvent::CreateComment(const char *comment)
+{
+    size_t commentLen = strcspn(comment, SSE_FIELD_END_CHARS);
+    SseEvent *sseEvent = Allocate(commentLen + 3);
+    if (sseEvent == nullptr) {
+        return nullptr;
+    }
+    char *pos = reinterpret_cast<char *>(sseEvent + 1);
+    *pos++ = ':';
+    memcpy(pos, comment, commentLen);
+    pos[commentLen] = '\n';
+    pos[commentLen + 1] = '\n';
+    return sseEvent;
+}
+
+void SseEvent::Ref()
+{
+    m_refCount++;
+}
+
+void SseEvent::Unref()
+{
+    if (--m_refCount == 0) {
+        this->~SseEvent();
+        free(this);
+    }
+}
+
+const char *SseEvent::GetData() const
+{
+    return reinterpret_cast<const char *>(this + 1);
+}
+
+size_t SseEvent::GetSize() const
+{
+    return m_size;
+}
+
+SseRouter::SseRouter()
+{}
+
+SseRouter::~SseRouter()
+{}
+
+bool SseRouter::Init(const std::string &routes)
+{
+    std::vector<SseRoute> routeList;
+    if (!ParseRoutes(routes, routeList)) {
+        return false;
+    }
+    m_routes.swap(routeList);
+    return true;
+}
+
+bool SseRouter::Match(const char *url, const size_t urlLen, unsigned int &channel) const
+{
+    for (const SseRoute &route : m_routes) {
+        if (urlLen >= route.prefix.size() && memcmp(url, route.prefix.data(), route.prefix.size()) == 0) {
+            channel = route.channel;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SseRouter::HasRoutes() const
+{
+    return !m_routes.empty();
+}
+
+bool SseRouter::ParseRoutes(const std::string &value, std::vector<SseRoute> &routes)
+{
+    std::vector<RouteItem> items;
+    if (!RouteList::Parse(value, 1, "sse route", items)) {
+        return false;
+    }
+    routes.clear();
+    for (const RouteItem &item : items) {
+        SseRoute route;
+        route.prefix = item.prefix;
+        route.channel = SseHub::GetInstance().GetChannel(item.value);
+        routes.push_back(route);
+    }
+    return true;
+}
+
+SseSubscriber::SseSubscriber(const int socketId, const unsigned int channel, const unsigned int maxQueue,
+    const bool dropSlow)
+    : m_socketId(socketId), m_channel(channel), m_maxQueue(maxQueue), m_dropSlow(dropSlow)
+{}
+
+SseSubscriber::~SseSubscriber()
+{
+    if (m_opened) {
+        SseHub::GetInstance().Unsubscribe(this);
+    }
+    for (SseEvent *event : m_queue) {
+        event->Unref();
+    }
+}
+
+void SseSubscriber::Open()
+{
+    m_opened = true;
+    m_lastSendTime = time(NULL);
+    SseHub::GetInstance().Subscribe(this);
+}
+
+bool SseSubscriber::IsOpened() const
+{
+    return m_opened;
+}
+
+int SseSubscriber::GetSocketId() const
+{
+    return m_socketId;
+}
+
+unsigned int SseSubscriber::GetChannel() const
+{
+    return m_channel;
+}
+
+unsigned long long SseSubscriber::GetDropNum() const
+{
+    return m_dropNum;
+}
+
+void SseSubscriber::SetIndex(const size_t index)
+{
+    m_index = index;
+}
+
+size_t SseSubscriber::GetIndex() const
+{
+    return m_index;
+}
+
+void SseSubscriber::SetEvents(const unsigned int events)
+{
+    m_events = events;
+}
+
+unsigned int SseSubscriber::GetEvents() const
+{
+    return m_events;
+}
+
+SseEventResult SseSubscriber::GetResult() const
+{
+    if (m_broken) {
+        return SSE_EVENT_RESULT_CLOSE;
+    }
+    return m_queue.empty() ? SSE_EVENT_RESULT_READ : SSE_EVENT_RESULT_WRITE;
+}
+
+SseEventResult SseSubscriber::Push(SseEvent *event)
+{
+    if (m_broken) {
+        return SSE_EVENT_RESULT_CLOSE;
+    }
+    if (m_queue.size() >= m_maxQueue) {
+        if (!m_dropSlow) {
+            printf("WARN  SSE client[%d] receives too slowly, close it.\n", m_socketId);
+            m_broken = true;
+            return SSE_EVENT_RESULT_CLOSE;
+        }
+        // 正在发送的事件保留，避免客户端收到不完整的事件；客户端可以从id的间隔发现丢失
+        size_t dropIndex = m_frontOffset == 0 ? 0 : 1;
+        if (dropIndex < m_queue.size()) {
+            m_queue[dropIndex]->Unref();
+            m_queue.erase(m_queue.begin() + dropIndex);
+            m_dropNum++;
+        }
+    }
+    size_t sent = 0;
+    if (m_queue.empty()) {
+        // 没有积压时直接发送，全部发送完就不需要入队
+        ssize_t ret;
+        do {
+            ret = send(m_socketId, event->GetData(), event->GetSize(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        } while (ret == -1 && errno == EINTR);
+        if (ret == -1 && errno != EAGAIN) {
+            m_broken = true;
+            return SSE_EVENT_RESULT_CLOSE;
+        }
+        if (ret > 0) {
+            sent = static_cast<size_t>(ret);
+            m_lastSendTime = time(NULL);
+        }
+        if (sent == event->GetSize()) {
+            return SSE_EVENT_RESULT_READ;
+        }
+    }
+    event->Ref();
+    m_queue.push_back(event);
+    m_frontOffset = m_queue.size() == 1 ? sent : m_frontOffset;
+    return GetResult();
+}
+
+SseEventResult SseSubscriber::OnWritable()
+{
+    return Flush();
+}
+
+// 一次sendmsg发送队列中的多个事件，直到发送完或内核发送缓冲区满
+SseEventResult SseSubscriber::Flush()
+{
+    struct iovec iov[SSE_WRITEV_MAX_NUM];
+    while (!m_queue.empty() && !m_broken) {
+        unsigned int cnt = 0;
+        for (SseEvent *event : m_queue) {
+            size_t offset = cnt == 0 ? m_frontOffset : 0;
+            iov[cnt].iov_base = const_cast<char *>(event->GetData()) + offset;
+            iov[cnt].iov_len = event->GetSize() - offset;
+            if (++cnt == SSE_WRITEV_MAX_NUM) {
+                break;
+            }
+        }
+        struct msghdr msg = { 0 };
+        msg.msg_iov = iov;
+        msg.msg_iovlen = cnt;
+        ssize_t ret = sendmsg(m_socketId, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN) {
+                m_broken = true;
+            }
+            break;
+        }
+        m_lastSendTime = time(NULL);
+        size_t sent = static_cast<size_t>(ret);
+        while (sent > 0) {
+            size_t left = m_queue.front()->GetSize() - m_frontOffset;
+            if (sent < left) {
+                m_frontOffset += sent;
+                break;
+            }
+            sent -= left;
+            m_queue.front()->Unref();
+            m_queue.pop_front();
+            m_frontOffset = 0;
+        }
+    }
+    return GetResult();
+}
+
+SseEventResult SseSubscriber::OnReadable(char *buffer, const size_t bufferLen)
+{
+    ssize_t readSize = read(m_socketId, buffer, bufferLen);
+    if (readSize == 0 || (readSize < 0 && errno != EAGAIN && errno != EINTR)) {
+        return SSE_EVENT_RESULT_CLOSE;
+    }
+    return GetResult();
+}
+
+SseEventResult SseSubscriber::KeepAlive(SseEvent *comment, const time_t now, const unsigned int interval,
+    time_t &nextTime)
+{
+    if (!m_queue.empty()) {
+        // 有积压时不追加保活注释，一个间隔内没有发送出任何数据说明客户端已不再接收
+        if (now - m_lastSendTime >= static_cast<time_t>(interval)) {
+            printf("WARN  SSE client[%d] stalled for %us, close it.\n", m_socketId, interval);
+            return SSE_EVENT_RESULT_CLOSE;
+        }
+        nextTime = m_lastSendTime + interval;
+        return GetResult();
+    }
+    // 最近发送过事件时不需要保活，按上次发送时间重新计算
+    if (now - m_lastSendTime < static_cast<time_t>(interval)) {
+        nextTime = m_lastSendTime + interval;
+        return GetResult();
+    }
+    nextTime = now + interval;
+    return Push(comment);
+}
+
+SseHub &SseHub::GetInstance()
+{
+    static SseHub hub;
+    return hub;
+}
+
+SseHub::SseHub()
+{
+    pthread_mutex_init(&m_mutex, nullptr);
+}
+
+SseHub::~SseHub()
+{
+    for (SsePublished &published : m_published) {
+        published.event->Unref();
+    }
+    if (m_eventFd != -1) {
+        close(m_eventFd);
+        m_eventFd = -1;
+    }
+    pthread_mutex_destroy(&m_mutex);
+}
+
+bool SseHub::Init()
+{
+    if (m_eventFd != -1) {
+        return true;
+    }
+    m_eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_eventFd == -1) {
+        printf("ERROR  Create sse eventfd fail.\n");
+        return false;
+    }
+    return true;
+}
+
+int SseHub::GetEventFd() const
+{
+    return m_eventFd;
+}
+
+unsigned int SseHub::GetChannelLocked(const std::string &name)
+{
+    std::unordered_map<std::string, unsigned int>::const_iterator iter = m_channelIndex.find(name);
+    if (iter != m_channelIndex.end()) {
+        return iter->second;
+    }
+    unsigned int channel = static_cast<unsigned int>(m_channels.size());
+    m_channels.emplace_back();
+    m_channels.back().name = name;
+    m_channelIndex[name] = channel;
+    return channel;
+}
+
+unsigned int SseHub::GetChannel(const std::string &name)
+{
+    pthread_mutex_lock(&m_mutex);
+    unsigned int channel = GetChannelLocked(name);
+    pthread_mutex_unlock(&m_mutex);
+    return channel;
+}
+
+// 事件在发布线程中序列化，事件循环线程推送时只增加引用计数
+bool SseHub::Publish(const std::string &channel, const char *event, const char *data, const size_t len)
+{
+    if (m_eventFd == -1) {
+        return false;
+    }
+    pthread_mutex_lock(&m_mutex);
+    unsigned int index = GetChannelLocked(channel);
+    SseEvent *sseEvent = SseEvent::Create(++m_channels[index].lastId, event, data, len);
+    if (sseEvent != nullptr) {
+        SsePublished published = { .channel = index, .event = sseEvent };
+        m_published.push_back(published);
+    }
+    pthread_mutex_unlock(&m_mutex);
+    if (sseEvent == nullptr) {
+        return false;
+    }
+    uint64_t one = 1;
+    (void)write(m_eventFd, &one, sizeof(one));
+    return true;
+}
+
+bool SseHub::HasSubscribers(const std::string &channel)
+{
+    pthread_mutex_lock(&m_mutex);
+    std::unordered_map<std::string, unsigned int>::const_iterator iter = m_channelIndex.find(channel);
+    bool ret = iter != m_channelIndex.end() && !m_channels[iter->second].subscribers.empty();
+    pthread_mutex_unlock(&m_mutex);
+    return ret;
+}
+
+void SseHub::PollPublished(std::vector<SsePublished> &published)
+{
+    uint64_t count = 0;
+    (void)read(m_eventFd, &count, sizeof(count));
+    pthread_mutex_lock(&m_mutex);
+    published.swap(m_published);
+    pthread_mutex_unlock(&m_mutex);
+}
+
+// 频道只会增加，deque扩容不移动已有元素，返回的引用在加锁之外仍然有效
+const std::vector<SseSubscriber *> &SseHub::GetSubscribers(const unsigned int channel)
+{
+    pthread_mutex_lock(&m_mutex);
+    const std::vector<SseSubscriber *> &subscribers = m_channels[channel].subscribers;
+    pthread_mutex_unlock(&m_mutex);
+    return subscribers;
+}
+
+void SseHub::Subscribe(SseSubscriber *subscriber)
+{
+    pthread_mutex_lock(&m_mutex);
+    std::vector<SseSubscriber *> &subscribers = m_channels[subscriber->GetChannel()].subscribers;
+    pthread_mutex_unlock(&m_mutex);
+    subscriber->SetIndex(subscribers.size());
+    subscribers.push_back(subscriber);
+}
+
+// 与最后一个订阅者交换后删除，不移动其他订阅者
+void SseHub::Unsubscribe(SseSubscriber *subscriber)
+{
+    pthread_mutex_lock(&m_mutex);
+    std::vector<SseSubscriber *> &subscribers = m_channels[subscriber->GetChannel()].subscribers;
+    pthread_mutex_unlock(&m_mutex);
+    size_t index = subscriber->GetIndex();
+    if (index >= subscribers.size() || subscribers[index] != subscriber) {
+        return;
+    }
+    subscribers[index] = subscribers.back();
+    subscribers[index]->SetIndex(index);
+    subscribers.pop_back();
+}
\ No newline at end of file
@@ -0,0 +1,202 @@
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "traffic_capture.h"
+
+const char TRAFFIC_CAPTURE_MAGIC[8] = { 'H', 'T', 'T', 'P', 'C', 'A', 'P', 'T' };
+const size_t TRAFFIC_CAPTURE_BUFF_LEN = 1024 * 1024; // 缓冲区达到该长度时唤醒后台线程写入文件
+const size_t TRAFFIC_CAPTURE_MAX_PENDING = 64 * 1024 * 1024; // 等待写入的记录超过64MB时认为磁盘跟不上
+
+std::atomic<bool> TrafficCapture::m_enabled { false };
+std::atomic<uint32_t> TrafficCapture::m_nextConnection { 1 };
+int TrafficCapture::m_fd { -1 };
+unsigned long long TrafficCapture::m_maxSize { 0 };
+unsigned long long TrafficCapture::m_fileSize { 0 };
+unsigned long long TrafficCapture::m_baseTime { 0 };
+std::string TrafficCapture::m_buffer;
+bool TrafficCapture::m_flushRequested { false };
+bool TrafficCapture::m_stop { false };
+bool TrafficCapture::m_writerStarted { false };
+pthread_t TrafficCapture::m_writer;
+
+static pthread_mutex_t g_captureMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_captureCond = PTHREAD_COND_INITIALIZER;
+
+static unsigned long long NowNs(const clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return static_cast<unsigned long long>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+bool TrafficCapture::Init(const std::string &path, const unsigned long long maxSize)
+{
+    if (path.empty()) {
+        return true;
+    }
+    m_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (m_fd == -1) {
+        printf("ERROR Open capture file fail: %s, errno = %d.\n", path.c_str(), errno);
+        return false;
+    }
+    TrafficCaptureFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRAFFIC_CAPTURE_MAGIC, sizeof(header.magic));
+    header.version = TRAFFIC_CAPTURE_VERSION;
+    header.headerSize = sizeof(TrafficCaptureFileHeader);
+    header.baseRealtime = NowNs(CLOCK_REALTIME);
+    m_baseTime = NowNs(CLOCK_MONOTONIC);
+    m_maxSize = maxSize;
+    m_buffer.reserve(TRAFFIC_CAPTURE_BUFF_LEN);
+    m_buffer.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    m_fileSize = sizeof(header);
+    if (pthread_create(&m_writer, nullptr, WriterThread, nullptr) != 0) {
+        printf("ERROR Create capture writer thread fail.\n");
+        close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    m_writerStarted = true;
+    m_enabled.store(true, std::memory_order_relaxed);
+    printf("EVENT  Traffic capture enabled, file = %s, max size = %llu.\n", path.c_str(), maxSize);
+    return true;
+}
+
+uint32_t TrafficCapture::Open()
+{
+    if (!IsEnabled()) {
+        return 0;
+    }
+    uint32_t connection = m_nextConnection.fetch_add(1, std::memory_order_relaxed);
+    Append(TRAFFIC_CAPTURE_RECORD_OPEN, connection, nullptr, 0);
+    return connection;
+}
+
+void TrafficCapture::Data(const uint32_t connection, const char *data, const size_t len)
+{
+    Append(TRAFFIC_CAPTURE_RECORD_DATA, connection, data, len);
+}
+
+void TrafficCapture::Close(const uint32_t connection)
+{
+    Append(TRAFFIC_CAPTURE_RECORD_CLOSE, connection, nullptr, 0);
+}
+
+// 时间在加锁后获取，文件中的记录按时间递增；锁内只复制数据，不做系统调用
+void TrafficCapture::Append(const uint16_t type, const uint32_t connection, const char *data, const size_t len)
+{
+    if (!IsEnabled()) {
+        return;
+    }
+    (void)pthread_mutex_lock(&g_captureMutex);
+    if (!IsEnabled()) {
+        (void)pthread_mutex_unlock(&g_captureMutex);
+        return;
+    }
+    if (m_fileSize + sizeof(TrafficCaptureRecord) + len > m_maxSize ||
+        m_buffer.size() + sizeof(TrafficCaptureRecord) + len > TRAFFIC_CAPTURE_MAX_PENDING) {
+        // 已经打开的连接之后的记录也不再写入，回放时文件结束视为所有连接关闭
+        m_enabled.store(false, std::memory_order_relaxed);
+        m_flushRequested = true;
+        (void)pthread_cond_signal(&g_captureCond);
+        printf("EVENT  Traffic capture stopped, file reaches %llu bytes, %zu bytes pending.\n", m_fileSize,
+            m_buffer.size());
+        (void)pthread_mutex_unlock(&g_captureMutex);
+        return;
+    }
+    TrafficCaptureRecord record;
+    memset(&record, 0, sizeof(record));
+    record.type = type;
+    record.connection = connection;
+    record.time = NowNs(CLOCK_MONOTONIC) - m_baseTime;
+    record.length = static_cast<uint32_t>(len);
+    m_buffer.append(reinterpret_cast<const char *>(&record), sizeof(record));
+    if (len > 0) {
+        m_buffer.append(data, len);
+    }
+    m_fileSize += sizeof(record) + len;
+    if (m_buffer.size() >= TRAFFIC_CAPTURE_BUFF_LEN && !m_flushRequested) {
+        m_flushRequested = true;
+        (void)pthread_cond_signal(&g_captureCond);
+    }
+    (void)pthread_mutex_unlock(&g_captureMutex);
+}
+
+// 在锁内换出缓冲区，锁外写文件；写入出错后停止抓包，之后换出的记录直接丢弃
+void *TrafficCapture::WriterThread(void *arg)
+{
+    (void)arg;
+    std::string buffer;
+    buffer.reserve(TRAFFIC_CAPTURE_BUFF_LEN);
+    bool failed = false;
+    (void)pthread_mutex_lock(&g_captureMutex);
+    while (true) {
+        while (!m_flushRequested && !m_stop) {
+            (void)pthread_cond_wait(&g_captureCond, &g_captureMutex);
+        }
+        bool stop = m_stop;
+        m_flushRequested = false;
+        buffer.swap(m_buffer);
+        (void)pthread_mutex_unlock(&g_captureMutex);
+        if (!buffer.empty() && !failed && !Write(buffer.data(), buffer.size())) {
+            printf("ERROR Write capture file fail, errno = %d, stop capture.\n", errno);
+            m_enabled.store(false, std::memory_order_relaxed);
+            failed = true;
+        }
+        buffer.clear();
+        if (stop) {
+            return nullptr;
+        }
+        (void)pthread_mutex_lock(&g_captureMutex);
+    }
+}
+
+bool TrafficCapture::Write(const char *data, const size_t len)
+{
+    size_t offset = 0;
+    while (offset < len) {
+        ssize_t ret = write(m_fd, data + offset, len - offset);
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        offset += static_cast<size_t>(ret);
+    }
+    return true;
+}
+
+// 定时器调用，进程异常退出最多丢失一个定时器间隔的记录
+void TrafficCapture::Flush()
+{
+    if (m_fd == -1) {
+        return;
+    }
+    (void)pthread_mutex_lock(&g_captureMutex);
+    if (!m_buffer.empty()) {
+        m_flushRequested = true;
+        (void)pthread_cond_signal(&g_captureCond);
+    }
+    (void)pthread_mutex_unlock(&g_captureMutex);
+}
+
+void TrafficCapture::Stop()
+{
+    if (!m_writerStarted) {
+        return;
+    }
+    (void)pthread_mutex_lock(&g_captureMutex);
+    m_enabled.store(false, std::memory_order_relaxed);
+    m_stop = true;
+    (void)pthread_cond_signal(&g_captureCond);
+    (void)pthread_mutex_unlock(&g_captureMutex);
+    (void)pthread_join(m_writer, nullptr);
+    m_writerStarted = false;
+    close(m_fd);
+    m_fd = -1;
+}
\ No newline at end of file
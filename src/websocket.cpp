@@ -0,0 +1,577 @@
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "route_list.h"
+#include "websocket.h"
+
+const char *WEBSOCKET_HANDLER_ECHO_NAME = "echo";
+const char *WEBSOCKET_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+const unsigned char WEBSOCKET_FIN_BIT = 0x80;
+const unsigned char WEBSOCKET_RSV_BITS = 0x70;
+const unsigned char WEBSOCKET_OPCODE_BITS = 0x0F;
+const unsigned char WEBSOCKET_MASK_BIT = 0x80;
+const unsigned char WEBSOCKET_LEN_BITS = 0x7F;
+const unsigned char WEBSOCKET_LEN_16 = 126;
+const unsigned char WEBSOCKET_LEN_64 = 127;
+const size_t WEBSOCKET_PENDING_FACTOR = 4; // 待发送数据上限为最大消息长度的4倍
+const char *BASE64_CHARS = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+const unsigned int SHA1_DIGEST_LEN = 20;
+const unsigned int SHA1_BLOCK_LEN = 64;
+
+// 原样返回收到的消息
+class WebSocketEchoHandler : public WebSocketHandler {
+public:
+    void OnMessage(WebSocketConnection &connection, const WebSocketOpcode opcode, const char *data,
+        const size_t len) override
+    {
+        (void)connection.Send(opcode, data, len);
+    }
+};
+
+static inline uint32_t RotateLeft(const uint32_t value, const unsigned int bits)
+{
+    return (value << bits) | (value >> (32 - bits));
+}
+
+static void Sha1Block(uint32_t *state, const unsigned char *block)
+{
+    uint32_t w[80];
+    for (unsigned int i = 0; i < 16; ++i) {
+        w[i] = (static_cast<uint32_t>(block[i * 4]) << 24) | (static_cast<uint32_t>(block[i * 4 + 1]) << 16) |
+            (static_cast<uint32_t>(block[i * 4 + 2]) << 8) | static_cast<uint32_t>(block[i * 4 + 3]);
+    }
+    for (unsigned int i = 16; i < 80; ++i) {
+        w[i] = RotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+    uint32_t a = state[0];
+    uint32_t b = state[1];
+    uint32_t c = state[2];
+    uint32_t d = state[3];
+    uint32_t e = state[4];
+    for (unsigned int i = 0; i < 80; ++i) {
+        uint32_t f;
+        uint32_t k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        uint32_t temp = RotateLeft(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = RotateLeft(b, 30);
+        b = a;
+        a = temp;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+// 只用于握手，输入很短，不需要流式接口
+static void Sha1(const unsigned char *data, const size_t len, unsigned char *digest)
+{
+    uint32_t state[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    size_t offset = 0;
+    for (; offset + SHA1_BLOCK_LEN <= len; offset += SHA1_BLOCK_LEN) {
+        Sha1Block(state, data + offset);
+    }
+    unsigned char tail[SHA1_BLOCK_LEN * 2] = { 0 };
+    size_t tailLen = len - offset;
+    memcpy(tail, data + offset, tailLen);
+    tail[tailLen] = 0x80;
+    size_t paddedLen = tailLen + 1 + 8 <= SHA1_BLOCK_LEN ? SHA1_BLOCK_LEN : SHA1_BLOCK_LEN * 2;
+    uint64_t bitLen = static_cast<uint64_t>(len) * 8;
+    for (unsigned int i = 0; i < 8; ++i) {
+        tail[paddedLen - 1 - i] = static_cast<unsigned char>(bitLen >> (i * 8));
+    }
+    for (size_t i = 0; i < paddedLen; i += SHA1_BLOCK_LEN) {
+        Sha1Block(state, tail + i);
+    }
+    for (unsigned int i = 0; i < 5; ++i) {
+        digest[i * 4] = static_cast<unsigned char>(state[i] >> 24);
+        digest[i * 4 + 1] = static_cast<unsigned char>(state[i] >> 16);
+        digest[i * 4 + 2] = static_cast<unsigned char>(state[i] >> 8);
+        digest[i * 4 + 3] = static_cast<unsigned char>(state[i]);
+    }
+}
+
+static void Base64Encode(const unsigned char *data, const size_t len, char *out)
+{
+    size_t pos = 0;
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t value = static_cast<uint32_t>(data[i]) << 16;
+        if (i + 1 < len) {
+            value |= static_cast<uint32_t>(data[i + 1]) << 8;
+        }
+        if (i + 2 < len) {
+            value |= data[i + 2];
+        }
+        out[pos++] = BASE64_CHARS[(value >> 18) & 0x3F];
+        out[pos++] = BASE64_CHARS[(value >> 12) & 0x3F];
+        out[pos++] = i + 1 < len ? BASE64_CHARS[(value >> 6) & 0x3F] : '=';
+        out[pos++] = i + 2 < len ? BASE64_CHARS[value & 0x3F] : '=';
+    }
+    out[pos] = '\0';
+}
+
+void WebSocketCodec::ComputeAccept(const char *key, char *accept)
+{
+    std::string input = std::string(key) + WEBSOCKET_GUID;
+    unsigned char digest[SHA1_DIGEST_LEN];
+    Sha1(reinterpret_cast<const unsigned char *>(input.data()), input.size(), digest);
+    Base64Encode(digest, sizeof(digest), accept);
+}
+
+// 掩码按4字节循环，32、16、8字节的分段都是4的倍数，每段开始时掩码相位相同
+void WebSocketCodec::Unmask(char *data, const size_t len, const unsigned char *mask)
+{
+    uint32_t mask32;
+    memcpy(&mask32, mask, sizeof(mask32));
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m256i mask256 = _mm256_set1_epi32(static_cast<int>(mask32));
+    for (; i + 32 <= len; i += 32) {
+        __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(data + i), _mm256_xor_si256(value, mask256));
+    }
+#endif
+#if defined(__SSE2__)
+    __m128i mask128 = _mm_set1_epi32(static_cast<int>(mask32));
+    for (; i + 16 <= len; i += 16) {
+        __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(data + i), _mm_xor_si128(value, mask128));
+    }
+#endif
+    uint64_t mask64 = (static_cast<uint64_t>(mask32) << 32) | mask32;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t value;
+        memcpy(&value, data + i, sizeof(value));
+        value ^= mask64;
+        memcpy(data + i, &value, sizeof(value));
+    }
+    for (; i < len; ++i) {
+        data[i] ^= mask[i & (WEBSOCKET_MASK_LEN - 1)];
+    }
+}
+
+unsigned int WebSocketCodec::EncodeHeader(const WebSocketOpcode opcode, const bool fin, const uint64_t payloadLen,
+    unsigned char *header)
+{
+    header[0] = static_cast<unsigned char>((fin ? WEBSOCKET_FIN_BIT : 0) | opcode);
+    if (payloadLen < WEBSOCKET_LEN_16) {
+        header[1] = static_cast<unsigned char>(payloadLen);
+        return 2;
+    }
+    if (payloadLen <= 0xFFFF) {
+        header[1] = WEBSOCKET_LEN_16;
+        header[2] = static_cast<unsigned char>(payloadLen >> 8);
+        header[3] = static_cast<unsigned char>(payloadLen);
+        return 4;
+    }
+    header[1] = WEBSOCKET_LEN_64;
+    for (unsigned int i = 0; i < 8; ++i) {
+        header[2 + i] = static_cast<unsigned char>(payloadLen >> ((7 - i) * 8));
+    }
+    return 10;
+}
+
+WebSocketRouter::WebSocketRouter()
+{}
+
+WebSocketRouter::~WebSocketRouter()
+{}
+
+std::vector<std::pair<std::string, WebSocketHandler *>> &WebSocketRouter::GetHandlers()
+{
+    static WebSocketEchoHandler echoHandler;
+    static std::vector<std::pair<std::string, WebSocketHandler *>> handlers {
+        { WEBSOCKET_HANDLER_ECHO_NAME, &echoHandler },
+    };
+    return handlers;
+}
+
+bool WebSocketRouter::RegisterHandler(const std::string &name, WebSocketHandler *handler)
+{
+    if (name.empty() || handler == nullptr) {
+        return false;
+    }
+    for (std::pair<std::string, WebSocketHandler *> &item : GetHandlers()) {
+        if (item.first == name) {
+            printf("ERROR WebSocket handler %s already registered.\n", name.c_str());
+            return false;
+        }
+    }
+    GetHandlers().push_back(std::make_pair(name, handler));
+    return true;
+}
+
+bool WebSocketRouter::Init(const std::string &routes)
+{
+    std::vector<WebSocketRoute> routeList;
+    if (!ParseRoutes(routes, routeList)) {
+        return false;
+    }
+    m_routes.swap(routeList);
+    return true;
+}
+
+WebSocketHandler *WebSocketRouter::Match(const char *url, const size_t urlLen) const
+{
+    for (const WebSocketRoute &route : m_routes) {
+        if (urlLen >= route.prefix.size() && memcmp(url, route.prefix.data(), route.prefix.size()) == 0) {
+            return route.handler;
+        }
+    }
+    return nullptr;
+}
+
+bool WebSocketRouter::HasRoutes() const
+{
+    return !m_routes.empty();
+}
+
+bool WebSocketRouter::ParseRoutes(const std::string &value, std::vector<WebSocketRoute> &routes)
+{
+    std::vector<RouteItem> items;
+    if (!RouteList::Parse(value, 1, "websocket route", items)) {
+        return false;
+    }
+    routes.clear();
+    for (const RouteItem &item : items) {
+        WebSocketRoute route;
+        route.prefix = item.prefix;
+        route.handler = nullptr;
+        const std::string &name = item.value;
+        for (const std::pair<std::string, WebSocketHandler *> &handler : GetHandlers()) {
+            if (handler.first == name) {
+                route.handler = handler.second;
+                break;
+            }
+        }
+        if (route.handler == nullptr) {
+            printf("ERROR Unknown websocket handler: %s.\n", name.c_str());
+            return false;
+        }
+        routes.push_back(route);
+    }
+    return true;
+}
+
+WebSocketConnection::WebSocketConnection(const int socketId, WebSocketHandler *handler, const size_t maxMessageLen)
+    : m_socketId(socketId), m_handler(handler), m_maxMessageLen(maxMessageLen),
+      m_maxPendingLen(maxMessageLen * WEBSOCKET_PENDING_FACTOR)
+{}
+
+WebSocketConnection::~WebSocketConnection()
+{
+    if (m_opened) {
+        m_closing = true; // 回调中不能再发送
+        m_handler->OnClose(*this);
+    }
+}
+
+WebSocketEventResult WebSocketConnection::Open()
+{
+    m_opened = true;
+    m_handler->OnOpen(*this);
+    return GetResult();
+}
+
+bool WebSocketConnection::IsOpened() const
+{
+    return m_opened;
+}
+
+int WebSocketConnection::GetSocketId() const
+{
+    return m_socketId;
+}
+
+void WebSocketConnection::SetUserData(void *userData)
+{
+    m_userData = userData;
+}
+
+void *WebSocketConnection::GetUserData() const
+{
+    return m_userData;
+}
+
+void WebSocketConnection::SetEvents(const unsigned int events)
+{
+    m_events = events;
+}
+
+unsigned int WebSocketConnection::GetEvents() const
+{
+    return m_events;
+}
+
+WebSocketEventResult WebSocketConnection::GetResult() const
+{
+    if (m_broken || (m_closing && m_pendingOffset == m_pending.size())) {
+        return WEBSOCKET_EVENT_RESULT_CLOSE;
+    }
+    return m_pendingOffset == m_pending.size() ? WEBSOCKET_EVENT_RESULT_READ : WEBSOCKET_EVENT_RESULT_WRITE;
+}
+
+// 每次读事件只读一次，水平触发下剩余数据在下一轮继续读，避免一个连接占满事件循环
+WebSocketEventResult WebSocketConnection::OnReadable(char *buffer, const size_t bufferLen)
+{
+    ssize_t readSize = read(m_socketId, buffer, bufferLen);
+    if (readSize == 0) {
+        return WEBSOCKET_EVENT_RESULT_CLOSE;
+    }
+    if (readSize < 0) {
+        return errno == EAGAIN || errno == EINTR ? GetResult() : WEBSOCKET_EVENT_RESULT_CLOSE;
+    }
+    m_pingPending = false;
+    if (m_closing) {
+        return GetResult(); // 已发送关闭帧，丢弃之后收到的数据
+    }
+    size_t consumed = 0;
+    if (m_partial.empty()) {
+        if (ProcessFrames(buffer, readSize, consumed) && consumed < static_cast<size_t>(readSize)) {
+            m_partial.assign(buffer + consumed, readSize - consumed);
+        }
+        return GetResult();
+    }
+    m_partial.append(buffer, readSize);
+    if (ProcessFrames(&m_partial[0], m_partial.size(), consumed)) {
+        m_partial.erase(0, consumed);
+    }
+    return GetResult();
+}
+
+// 依次处理完整的帧，consumed为已处理的长度；协议错误时发送关闭帧并返回false
+bool WebSocketConnection::ProcessFrames(char *data, const size_t len, size_t &consumed)
+{
+    consumed = 0;
+    while (len - consumed >= 2) {
+        unsigned char *frame = reinterpret_cast<unsigned char *>(data + consumed);
+        size_t left = len - consumed;
+        bool fin = (frame[0] & WEBSOCKET_FIN_BIT) != 0;
+        WebSocketOpcode opcode = static_cast<WebSocketOpcode>(frame[0] & WEBSOCKET_OPCODE_BITS);
+        if ((frame[0] & WEBSOCKET_RSV_BITS) != 0 || (frame[1] & WEBSOCKET_MASK_BIT) == 0) {
+            Fail(WEBSOCKET_CLOSE_CODE_PROTOCOL_ERROR); // 没有协商扩展，客户端发来的帧必须带掩码
+            return false;
+        }
+        uint64_t payloadLen = frame[1] & WEBSOCKET_LEN_BITS;
+        size_t headerLen = 2;
+        if (payloadLen == WEBSOCKET_LEN_16) {
+            headerLen += 2;
+        } else if (payloadLen == WEBSOCKET_LEN_64) {
+            headerLen += 8;
+        }
+        if (left < headerLen + WEBSOCKET_MASK_LEN) {
+            break;
+        }
+        if (payloadLen == WEBSOCKET_LEN_16) {
+            payloadLen = (static_cast<uint64_t>(frame[2]) << 8) | frame[3];
+        } else if (payloadLen == WEBSOCKET_LEN_64) {
+            payloadLen = 0;
+            for (unsigned int i = 0; i < 8; ++i) {
+                payloadLen = (payloadLen << 8) | frame[2 + i];
+            }
+        }
+        // 帧头中的长度超过上限时立即关闭，不等待接收完整的帧
+        if (payloadLen > m_maxMessageLen) {
+            Fail(WEBSOCKET_CLOSE_CODE_MESSAGE_TOO_BIG);
+            return false;
+        }
+        const unsigned char *mask = frame + headerLen;
+        headerLen += WEBSOCKET_MASK_LEN;
+        if (left - headerLen < payloadLen) {
+            break;
+        }
+        char *payload = data + consumed + headerLen;
+        WebSocketCodec::Unmask(payload, payloadLen, mask);
+        consumed += headerLen + payloadLen;
+        if (!HandleFrame(opcode, fin, payload, payloadLen)) {
+            return false;
+        }
+        if (m_closing || m_broken) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool WebSocketConnection::HandleFrame(const WebSocketOpcode opcode, const bool fin, char *payload,
+    const size_t payloadLen)
+{
+    switch (opcode) {
+        case WEBSOCKET_OPCODE_PING:
+        case WEBSOCKET_OPCODE_PONG:
+        case WEBSOCKET_OPCODE_CLOSE: {
+            if (!fin || payloadLen > WEBSOCKET_MAX_CONTROL_PAYLOAD_LEN) {
+                Fail(WEBSOCKET_CLOSE_CODE_PROTOCOL_ERROR);
+                return false;
+            }
+            if (opcode == WEBSOCKET_OPCODE_PING) {
+                return SendFrame(WEBSOCKET_OPCODE_PONG, payload, payloadLen);
+            }
+            if (opcode == WEBSOCKET_OPCODE_CLOSE) {
+                // 回复相同的状态码，发送完成后关闭连接
+                (void)SendFrame(WEBSOCKET_OPCODE_CLOSE, payload, payloadLen >= 2 ? 2 : 0);
+                m_closing = true;
+            }
+            return true;
+        }
+        case WEBSOCKET_OPCODE_TEXT:
+        case WEBSOCKET_OPCODE_BINARY: {
+            if (m_messageOpcode != WEBSOCKET_OPCODE_CONTINUATION) {
+                Fail(WEBSOCKET_CLOSE_CODE_PROTOCOL_ERROR); // 上一条分片消息还没有结束
+                return false;
+            }
+            if (fin) {
+                m_handler->OnMessage(*this, opcode, payload, payloadLen); // 未分片的消息直接使用读缓冲区
+                return true;
+            }
+            m_messageOpcode = opcode;
+            m_message.assign(payload, payloadLen);
+            return true;
+        }
+        case WEBSOCKET_OPCODE_CONTINUATION: {
+            if (m_messageOpcode == WEBSOCKET_OPCODE_CONTINUATION) {
+                Fail(WEBSOCKET_CLOSE_CODE_PROTOCOL_ERROR);
+                return false;
+            }
+            if (m_message.size() + payloadLen > m_maxMessageLen) {
+                Fail(WEBSOCKET_CLOSE_CODE_MESSAGE_TOO_BIG);
+                return false;
+            }
+            m_message.append(payload, payloadLen);
+            if (fin) {
+                WebSocketOpcode messageOpcode = m_messageOpcode;
+                m_messageOpcode = WEBSOCKET_OPCODE_CONTINUATION;
+                m_handler->OnMessage(*this, messageOpcode, m_message.data(), m_message.size());
+                m_message.clear();
+            }
+            return true;
+        }
+        default: {
+            Fail(WEBSOCKET_CLOSE_CODE_PROTOCOL_ERROR);
+            return false;
+        }
+    }
+}
+
+bool WebSocketConnection::Send(const WebSocketOpcode opcode, const char *data, const size_t len)
+{
+    if (m_closing || m_broken || (opcode != WEBSOCKET_OPCODE_TEXT && opcode != WEBSOCKET_OPCODE_BINARY)) {
+        return false;
+    }
+    return SendFrame(opcode, data, len);
+}
+
+// 没有待发送数据时帧头和消息体直接交给内核，发送不完或已有待发送数据时才复制
+bool WebSocketConnection::SendFrame(const WebSocketOpcode opcode, const char *data, const size_t len)
+{
+    if (m_broken) {
+        return false;
+    }
+    unsigned char header[WEBSOCKET_MAX_HEADER_LEN];
+    unsigned int headerLen = WebSocketCodec::EncodeHeader(opcode, true, len, header);
+    size_t sent = 0;
+    if (m_pendingOffset == m_pending.size()) {
+        struct iovec iov[2] = { { header, headerLen }, { const_cast<char *>(data), len } };
+        struct msghdr msg = { 0 };
+        msg.msg_iov = iov;
+        msg.msg_iovlen = len == 0 ? 1 : 2;
+        ssize_t ret;
+        do {
+            ret = sendmsg(m_socketId, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        } while (ret == -1 && errno == EINTR);
+        if (ret == -1 && errno != EAGAIN) {
+            m_broken = true;
+            return false;
+        }
+        sent = ret == -1 ? 0 : static_cast<size_t>(ret);
+        if (sent == headerLen + len) {
+            return true;
+        }
+        m_pending.clear();
+        m_pendingOffset = 0;
+    }
+    if (m_pending.size() - m_pendingOffset + headerLen + len - sent > m_maxPendingLen) {
+        printf("WARN  WebSocket client[%d] receives too slowly, close it.\n", m_socketId);
+        m_broken = true;
+        return false;
+    }
+    if (sent < headerLen) {
+        m_pending.append(reinterpret_cast<const char *>(header) + sent, headerLen - sent);
+        sent = headerLen;
+    }
+    if (len > sent - headerLen) {
+        m_pending.append(data + (sent - headerLen), len - (sent - headerLen));
+    }
+    return true;
+}
+
+WebSocketEventResult WebSocketConnection::OnWritable()
+{
+    while (m_pendingOffset < m_pending.size()) {
+        ssize_t ret = send(m_socketId, m_pending.data() + m_pendingOffset, m_pending.size() - m_pendingOffset,
+            MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN) {
+                m_broken = true;
+            }
+            return GetResult();
+        }
+        m_pendingOffset += static_cast<size_t>(ret);
+    }
+    // 全部发送完后释放内存，空闲连接不保留发送缓冲区
+    std::string().swap(m_pending);
+    m_pendingOffset = 0;
+    return GetResult();
+}
+
+WebSocketEventResult WebSocketConnection::KeepAlive()
+{
+    if (m_pingPending || m_closing) {
+        return WEBSOCKET_EVENT_RESULT_CLOSE;
+    }
+    m_pingPending = true;
+    (void)SendFrame(WEBSOCKET_OPCODE_PING, nullptr, 0);
+    return GetResult();
+}
+
+WebSocketEventResult WebSocketConnection::Close(const WebSocketCloseCode code)
+{
+    if (!m_closing) {
+        char payload[2] = { static_cast<char>(code >> 8), static_cast<char>(code & 0xFF) };
+        (void)SendFrame(WEBSOCKET_OPCODE_CLOSE, payload, sizeof(payload));
+        m_closing = true;
+    }
+    return GetResult();
+}
+
+void WebSocketConnection::Fail(const WebSocketCloseCode code)
+{
+    printf("ERROR WebSocket client[%d] protocol error, close code = %u.\n", m_socketId, code);
+    (void)Close(code);
+}
\ No newline at end of file
@@ -0,0 +1,207 @@
+// 解码服务端写入的二进制访问日志，用法：access_log_dump [-j] <file>...
+// 多个文件的记录按开始时间合并输出，默认每行一条文本记录，-j时每行一个JSON对象，错误信息输出到标准错误
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "access_log.h"
+
+struct DecodedRecord {
+    long long time; // CLOCK_REALTIME，单位纳秒
+    AccessLogRecord record;
+    std::string url;
+    std::string peer;
+};
+
+static bool ReadFile(const char *path, std::vector<char> &data)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        fprintf(stderr, "ERROR Open %s fail.\n", path);
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) == -1) {
+        fprintf(stderr, "ERROR Stat %s fail.\n", path);
+        close(fd);
+        return false;
+    }
+    data.resize(fileStat.st_size);
+    size_t offset = 0;
+    while (offset < data.size()) {
+        ssize_t ret = read(fd, data.data() + offset, data.size() - offset);
+        if (ret <= 0) {
+            break;
+        }
+        offset += ret;
+    }
+    close(fd);
+    data.resize(offset);
+    return true;
+}
+
+// 偏移处必须是文件内完整的字符串条目
+static bool GetString(const std::vector<char> &data, const uint64_t dataEnd, const uint32_t offset,
+    std::string &str)
+{
+    if (offset < sizeof(AccessLogFileHeader) || offset % ACCESS_LOG_ENTRY_ALIGN != 0 ||
+        offset + sizeof(AccessLogString) > dataEnd) {
+        return false;
+    }
+    const AccessLogString *entry = reinterpret_cast<const AccessLogString *>(data.data() + offset);
+    if (entry->head.type != ACCESS_LOG_ENTRY_STRING || entry->head.size < sizeof(AccessLogString) ||
+        offset + entry->head.size > dataEnd) {
+        return false;
+    }
+    str.assign(entry->data, entry->head.size - sizeof(AccessLogString));
+    return true;
+}
+
+static bool DecodeFile(const char *path, std::vector<DecodedRecord> &records)
+{
+    std::vector<char> data;
+    if (!ReadFile(path, data)) {
+        return false;
+    }
+    if (data.size() < sizeof(AccessLogFileHeader)) {
+        fprintf(stderr, "ERROR %s is too short.\n", path);
+        return false;
+    }
+    AccessLogFileHeader header;
+    memcpy(&header, data.data(), sizeof(header));
+    if (memcmp(header.magic, ACCESS_LOG_MAGIC, sizeof(header.magic)) != 0 || header.version != ACCESS_LOG_VERSION ||
+        header.headerSize < sizeof(AccessLogFileHeader)) {
+        fprintf(stderr, "ERROR %s is not an access log file.\n", path);
+        return false;
+    }
+    // 换文件时文件被截断到dataEnd，正在写入的文件dataEnd之后的内容还不完整
+    uint64_t dataEnd = std::min<uint64_t>(header.dataEnd, data.size());
+    uint64_t offset = (header.headerSize + ACCESS_LOG_ENTRY_ALIGN - 1) / ACCESS_LOG_ENTRY_ALIGN * ACCESS_LOG_ENTRY_ALIGN;
+    unsigned long long badNum = 0;
+    while (offset + sizeof(AccessLogEntryHead) <= dataEnd) {
+        AccessLogEntryHead head;
+        memcpy(&head, data.data() + offset, sizeof(head));
+        if (head.size < sizeof(AccessLogEntryHead) || offset + head.size > dataEnd) {
+            fprintf(stderr, "ERROR %s has a broken entry at offset %llu.\n", path,
+                static_cast<unsigned long long>(offset));
+            break;
+        }
+        if (head.type == ACCESS_LOG_ENTRY_RECORD && head.size >= sizeof(AccessLogRecord)) {
+            DecodedRecord decoded;
+            memcpy(&decoded.record, data.data() + offset, sizeof(AccessLogRecord));
+            if (GetString(data, dataEnd, decoded.record.urlOffset, decoded.url) &&
+                GetString(data, dataEnd, decoded.record.peerOffset, decoded.peer)) {
+                decoded.time = static_cast<long long>(header.baseRealtime) +
+                    (static_cast<long long>(decoded.record.startTime) - static_cast<long long>(header.baseMonotonic));
+                records.push_back(std::move(decoded));
+            } else {
+                badNum++;
+            }
+        }
+        offset += (head.size + ACCESS_LOG_ENTRY_ALIGN - 1) / ACCESS_LOG_ENTRY_ALIGN * ACCESS_LOG_ENTRY_ALIGN;
+    }
+    if (badNum != 0) {
+        fprintf(stderr, "ERROR %s has %llu records with invalid string offsets.\n", path, badNum);
+    }
+    return true;
+}
+
+static void FormatTime(const long long time, char *buff, const size_t buffLen)
+{
+    time_t sec = static_cast<time_t>(time / 1000000000LL);
+    struct tm tmTime;
+    gmtime_r(&sec, &tmTime);
+    size_t len = strftime(buff, buffLen, "%Y-%m-%dT%H:%M:%S", &tmTime);
+    (void)snprintf(buff + len, buffLen - len, ".%06lldZ", time % 1000000000LL / 1000);
+}
+
+static void PrintJsonString(const std::string &str)
+{
+    putchar('"');
+    for (unsigned char c : str) {
+        if (c == '"' || c == '\\') {
+            printf("\\%c", c);
+        } else if (c < 0x20) {
+            printf("\\u%04x", c);
+        } else {
+            putchar(c);
+        }
+    }
+    putchar('"');
+}
+
+static void PrintText(const DecodedRecord &decoded, const char *timeStr)
+{
+    const AccessLogRecord &record = decoded.record;
+    std::string flags;
+    if ((record.flags & ACCESS_LOG_FLAG_KEEP_ALIVE) != 0) {
+        flags += ",keepalive";
+    }
+    if ((record.flags & ACCESS_LOG_FLAG_BUNDLE) != 0) {
+        flags += ",bundle";
+    }
+    if ((record.flags & ACCESS_LOG_FLAG_POOLED) != 0) {
+        flags += ",pooled";
+    }
+    printf("%s %s %s %s %u %u total=%uus queue=%uus handle=%uus send=%uus flags=%s\n", timeStr,
+        decoded.peer.c_str(), AccessLog::GetMethodName(record.method), decoded.url.c_str(), record.status,
+        record.bytes, record.totalUs, record.queueUs, record.handleUs, record.sendUs,
+        flags.empty() ? "-" : flags.c_str() + 1);
+}
+
+static void PrintJson(const DecodedRecord &decoded, const char *timeStr)
+{
+    const AccessLogRecord &record = decoded.record;
+    printf("{\"time\":\"%s\",\"peer\":", timeStr);
+    PrintJsonString(decoded.peer);
+    printf(",\"method\":\"%s\",\"url\":", AccessLog::GetMethodName(record.method));
+    PrintJsonString(decoded.url);
+    printf(",\"url_hash\":\"%08x\",\"status\":%u,\"bytes\":%u,\"total_us\":%u,\"queue_us\":%u,\"handle_us\":%u,"
+        "\"send_us\":%u,\"keep_alive\":%s,\"bundle\":%s,\"pooled\":%s}\n", record.urlHash, record.status,
+        record.bytes, record.totalUs, record.queueUs, record.handleUs, record.sendUs,
+        (record.flags & ACCESS_LOG_FLAG_KEEP_ALIVE) != 0 ? "true" : "false",
+        (record.flags & ACCESS_LOG_FLAG_BUNDLE) != 0 ? "true" : "false",
+        (record.flags & ACCESS_LOG_FLAG_POOLED) != 0 ? "true" : "false");
+}
+
+int main(int argc, char *argv[])
+{
+    bool json = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "jh")) != -1) {
+        if (opt == 'j') {
+            json = true;
+        } else {
+            fprintf(stderr, "Usage: %s [-j] <file>...\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "Usage: %s [-j] <file>...\n", argv[0]);
+        return 1;
+    }
+    std::vector<DecodedRecord> records;
+    bool ok = true;
+    for (int i = optind; i < argc; ++i) {
+        ok = DecodeFile(argv[i], records) && ok;
+    }
+    std::stable_sort(records.begin(), records.end(), [](const DecodedRecord &left, const DecodedRecord &right) {
+        return left.time < right.time;
+    });
+    char timeStr[64];
+    for (const DecodedRecord &decoded : records) {
+        FormatTime(decoded.time, timeStr, sizeof(timeStr));
+        if (json) {
+            PrintJson(decoded, timeStr);
+        } else {
+            PrintText(decoded, timeStr);
+        }
+    }
+    return ok ? 0 : 1;
+}
\ No newline at end of file
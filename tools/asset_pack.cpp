@@ -0,0 +1,327 @@
+// 把目录打包为服务端可以直接映射的资源包，用法：asset_pack <source_dir> <bundle_file>
+// 每个文件生成原始和gzip两个变体，变体由预置的头部和消息体组成，服务端命中后不再访问文件系统
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <zlib.h>
+#include <string>
+#include <vector>
+#include "asset_bundle.h"
+
+const size_t PAGE_ALIGN = 4096;
+const size_t VARIANT_ALIGN = 64; // 变体起始地址按缓存行对齐
+const size_t MAX_ASSET_SIZE = 0xffffffffU - 1024; // 变体长度用32位记录，预留头部空间
+const char *INDEX_FILE_NAME = "index.html";
+const char *DEFAULT_CONTENT_TYPE = "application/octet-stream";
+
+typedef struct {
+    const char *extension;
+    const char *contentType;
+    bool compressible;
+} ContentTypeInfo;
+
+const ContentTypeInfo CONTENT_TYPE_LIST[] = {
+    { ".html", "text/html; charset=utf-8", true },
+    { ".htm", "text/html; charset=utf-8", true },
+    { ".css", "text/css; charset=utf-8", true },
+    { ".js", "application/javascript; charset=utf-8", true },
+    { ".json", "application/json", true },
+    { ".txt", "text/plain; charset=utf-8", true },
+    { ".xml", "application/xml", true },
+    { ".svg", "image/svg+xml", true },
+    { ".ico", "image/x-icon", true },
+    { ".wasm", "application/wasm", true },
+    { ".png", "image/png", false },
+    { ".jpg", "image/jpeg", false },
+    { ".jpeg", "image/jpeg", false },
+    { ".gif", "image/gif", false },
+    { ".webp", "image/webp", false },
+    { ".woff", "font/woff", false },
+    { ".woff2", "font/woff2", false },
+    { ".pdf", "application/pdf", false },
+    { ".gz", "application/gzip", false },
+    { ".zip", "application/zip", false },
+};
+const unsigned int CONTENT_TYPE_LIST_SIZE = sizeof(CONTENT_TYPE_LIST) / sizeof(CONTENT_TYPE_LIST[0]);
+
+struct PackedAsset {
+    std::string path; // URL路径，以'/'开头
+    std::string contentType;
+    std::string etag;
+    std::string variants[ASSET_VARIANT_NUM]; // 预置头部加消息体，空表示没有该变体
+    unsigned int bodyLengths[ASSET_VARIANT_NUM] { 0 };
+    unsigned int dataIdx { 0 }; // 别名与原文件共用数据
+};
+
+static size_t AlignUp(const size_t value, const size_t align)
+{
+    return (value + align - 1) / align * align;
+}
+
+static const ContentTypeInfo *GetContentType(const std::string &path)
+{
+    size_t pos = path.rfind('.');
+    if (pos == std::string::npos || path.find('/', pos) != std::string::npos) {
+        return nullptr;
+    }
+    for (unsigned int i = 0; i < CONTENT_TYPE_LIST_SIZE; ++i) {
+        if (strcasecmp(path.c_str() + pos, CONTENT_TYPE_LIST[i].extension) == 0) {
+            return &CONTENT_TYPE_LIST[i];
+        }
+    }
+    return nullptr;
+}
+
+static bool ReadFile(const std::string &filePath, std::string &content)
+{
+    FILE *file = fopen(filePath.c_str(), "rb");
+    if (file == nullptr) {
+        printf("ERROR Open file fail: %s.\n", filePath.c_str());
+        return false;
+    }
+    char buff[65536];
+    size_t readSize;
+    content.clear();
+    while ((readSize = fread(buff, 1, sizeof(buff), file)) > 0) {
+        content.append(buff, readSize);
+    }
+    bool ret = ferror(file) == 0;
+    fclose(file);
+    if (!ret) {
+        printf("ERROR Read file fail: %s.\n", filePath.c_str());
+    }
+    return ret;
+}
+
+static bool Gzip(const std::string &content, std::string &compressed)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // windowBits加16生成gzip格式
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        printf("ERROR deflateInit2 fail.\n");
+        return false;
+    }
+    compressed.resize(deflateBound(&stream, content.size()));
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(content.data()));
+    stream.avail_in = content.size();
+    stream.next_out = reinterpret_cast<Bytef *>(&compressed[0]);
+    stream.avail_out = compressed.size();
+    int ret = deflate(&stream, Z_FINISH);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    if (ret != Z_STREAM_END) {
+        printf("ERROR deflate fail, ret = %d.\n", ret);
+        return false;
+    }
+    return true;
+}
+
+static std::string BuildVariant(const PackedAsset &asset, const std::string &body, const bool gzip, const bool vary)
+{
+    char head[512];
+    int len = snprintf(head, sizeof(head), "Content-Type: %s\r\nContent-Length: %zu\r\nETag: %s\r\n%s%s\r\n",
+        asset.contentType.c_str(), body.size(), asset.etag.c_str(), gzip ? "Content-Encoding: gzip\r\n" : "",
+        vary ? "Vary: Accept-Encoding\r\n" : "");
+    return std::string(head, len) + body;
+}
+
+static bool PackFile(const std::string &filePath, const std::string &urlPath, std::vector<PackedAsset> &assets)
+{
+    std::string content;
+    if (!ReadFile(filePath, content)) {
+        return false;
+    }
+    if (content.size() > MAX_ASSET_SIZE) {
+        printf("ERROR File too large: %s.\n", filePath.c_str());
+        return false;
+    }
+    PackedAsset asset;
+    asset.path = urlPath;
+    const ContentTypeInfo *typeInfo = GetContentType(urlPath);
+    asset.contentType = typeInfo != nullptr ? typeInfo->contentType : DEFAULT_CONTENT_TYPE;
+    char etag[ASSET_BUNDLE_ETAG_LEN];
+    snprintf(etag, sizeof(etag), "\"%016llx\"",
+        static_cast<unsigned long long>(AssetBundle::HashPath(content.data(), content.size())));
+    asset.etag = etag;
+    std::string compressed;
+    // 只保留比原始内容小的压缩变体
+    bool gzip = typeInfo != nullptr && typeInfo->compressible && Gzip(content, compressed) &&
+        compressed.size() < content.size();
+    asset.variants[ASSET_VARIANT_INDEX_IDENTITY] = BuildVariant(asset, content, false, gzip);
+    asset.bodyLengths[ASSET_VARIANT_INDEX_IDENTITY] = content.size();
+    if (gzip) {
+        asset.variants[ASSET_VARIANT_INDEX_GZIP] = BuildVariant(asset, compressed, true, true);
+        asset.bodyLengths[ASSET_VARIANT_INDEX_GZIP] = compressed.size();
+    }
+    asset.dataIdx = assets.size();
+    assets.push_back(asset);
+    // 目录的URL指向其中的index.html
+    size_t nameLen = strlen(INDEX_FILE_NAME);
+    if (urlPath.size() >= nameLen + 1 && urlPath.compare(urlPath.size() - nameLen, nameLen, INDEX_FILE_NAME) == 0 &&
+        urlPath[urlPath.size() - nameLen - 1] == '/') {
+        PackedAsset alias;
+        alias.path = urlPath.substr(0, urlPath.size() - nameLen);
+        alias.dataIdx = asset.dataIdx;
+        assets.push_back(alias);
+    }
+    return true;
+}
+
+static bool PackDir(const std::string &dirPath, const std::string &urlPath, std::vector<PackedAsset> &assets)
+{
+    DIR *dir = opendir(dirPath.c_str());
+    if (dir == nullptr) {
+        printf("ERROR Open dir fail: %s.\n", dirPath.c_str());
+        return false;
+    }
+    std::vector<std::string> names;
+    struct dirent *dirEntry;
+    while ((dirEntry = readdir(dir)) != nullptr) {
+        if (strcmp(dirEntry->d_name, ".") != 0 && strcmp(dirEntry->d_name, "..") != 0) {
+            names.push_back(dirEntry->d_name);
+        }
+    }
+    closedir(dir);
+    bool ret = true;
+    for (const std::string &name : names) {
+        std::string filePath = dirPath + "/" + name;
+        struct stat fileStat;
+        if (stat(filePath.c_str(), &fileStat) == -1) {
+            printf("ERROR Get file stat fail, path:%s.\n", filePath.c_str());
+            ret = false;
+            continue;
+        }
+        // 与服务端从source_dir读取时的权限检查一致
+        if ((fileStat.st_mode & S_IROTH) == 0) {
+            printf("WARN  Skip unreadable file: %s.\n", filePath.c_str());
+            continue;
+        }
+        if (S_ISDIR(fileStat.st_mode)) {
+            ret = PackDir(filePath, urlPath + name + "/", assets) && ret;
+        } else if (S_ISREG(fileStat.st_mode)) {
+            ret = PackFile(filePath, urlPath + name, assets) && ret;
+        }
+    }
+    return ret;
+}
+
+static bool WriteBundle(const std::vector<PackedAsset> &assets, const std::string &bundlePath)
+{
+    uint32_t entryNum = assets.size();
+    uint32_t slotNum = 2;
+    while (slotNum < entryNum * 2) {
+        slotNum *= 2; // 装载因子不超过0.5，至少留一个空槽保证查找结束
+    }
+    AssetBundleHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ASSET_BUNDLE_MAGIC, sizeof(header.magic));
+    header.version = ASSET_BUNDLE_VERSION;
+    header.entryNum = entryNum;
+    header.slotNum = slotNum;
+    header.slotOffset = AlignUp(sizeof(header), sizeof(uint64_t));
+    header.entryOffset = AlignUp(header.slotOffset + slotNum * sizeof(AssetBundleSlot), sizeof(uint64_t));
+    header.pathOffset = header.entryOffset + entryNum * sizeof(AssetBundleEntry);
+
+    std::vector<AssetBundleSlot> slots(slotNum);
+    memset(slots.data(), 0, slots.size() * sizeof(AssetBundleSlot));
+    std::vector<AssetBundleEntry> entries(entryNum);
+    memset(entries.data(), 0, entries.size() * sizeof(AssetBundleEntry));
+    std::string paths;
+    for (uint32_t i = 0; i < entryNum; ++i) {
+        const PackedAsset &asset = assets[i];
+        AssetBundleEntry &entry = entries[i];
+        entry.pathHash = AssetBundle::HashPath(asset.path.data(), asset.path.size());
+        entry.pathOffset = paths.size();
+        entry.pathLen = asset.path.size();
+        paths += asset.path;
+        uint32_t slotIdx = static_cast<uint32_t>(entry.pathHash) & (slotNum - 1);
+        while (slots[slotIdx].entryIdx != ASSET_BUNDLE_EMPTY_SLOT) {
+            slotIdx = (slotIdx + 1) & (slotNum - 1);
+        }
+        slots[slotIdx].entryIdx = i + 1;
+        slots[slotIdx].hashTag = static_cast<uint32_t>(entry.pathHash >> 32);
+    }
+
+    // 数据区从页边界开始，每个变体按缓存行对齐
+    header.dataOffset = AlignUp(header.pathOffset + paths.size(), PAGE_ALIGN);
+    uint64_t offset = header.dataOffset;
+    for (uint32_t i = 0; i < entryNum; ++i) {
+        const PackedAsset &asset = assets[i];
+        if (asset.dataIdx != i) {
+            continue;
+        }
+        for (unsigned int j = 0; j < ASSET_VARIANT_NUM; ++j) {
+            if (asset.variants[j].empty()) {
+                continue;
+            }
+            entries[i].variants[j].offset = offset;
+            entries[i].variants[j].length = asset.variants[j].size();
+            entries[i].variants[j].bodyLength = asset.bodyLengths[j];
+            offset = AlignUp(offset + asset.variants[j].size(), VARIANT_ALIGN);
+        }
+        snprintf(entries[i].etag, sizeof(entries[i].etag), "%s", asset.etag.c_str());
+    }
+    for (uint32_t i = 0; i < entryNum; ++i) {
+        if (assets[i].dataIdx != i) {
+            memcpy(entries[i].variants, entries[assets[i].dataIdx].variants, sizeof(entries[i].variants));
+            memcpy(entries[i].etag, entries[assets[i].dataIdx].etag, sizeof(entries[i].etag));
+        }
+    }
+    header.fileSize = offset;
+
+    std::string bundle(offset, '\0');
+    memcpy(&bundle[0], &header, sizeof(header));
+    memcpy(&bundle[header.slotOffset], slots.data(), slots.size() * sizeof(AssetBundleSlot));
+    memcpy(&bundle[header.entryOffset], entries.data(), entries.size() * sizeof(AssetBundleEntry));
+    memcpy(&bundle[header.pathOffset], paths.data(), paths.size());
+    for (uint32_t i = 0; i < entryNum; ++i) {
+        for (unsigned int j = 0; j < ASSET_VARIANT_NUM; ++j) {
+            if (assets[i].dataIdx == i && !assets[i].variants[j].empty()) {
+                memcpy(&bundle[entries[i].variants[j].offset], assets[i].variants[j].data(), assets[i].variants[j].size());
+            }
+        }
+    }
+
+    // 先写临时文件再改名，运行中的服务端映射的旧文件不受影响
+    std::string tmpPath = bundlePath + ".tmp";
+    FILE *file = fopen(tmpPath.c_str(), "wb");
+    if (file == nullptr) {
+        printf("ERROR Open file fail: %s.\n", tmpPath.c_str());
+        return false;
+    }
+    bool ret = fwrite(bundle.data(), 1, bundle.size(), file) == bundle.size();
+    ret = fclose(file) == 0 && ret;
+    if (!ret || rename(tmpPath.c_str(), bundlePath.c_str()) == -1) {
+        printf("ERROR Write bundle fail: %s.\n", bundlePath.c_str());
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    printf("INFO Packed %u entries into %s, %zu bytes.\n", entryNum, bundlePath.c_str(), bundle.size());
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3) {
+        printf("Usage: %s <source_dir> <bundle_file>\n", argv[0]);
+        return 1;
+    }
+    std::string sourceDir = argv[1];
+    while (sourceDir.size() > 1 && sourceDir.back() == '/') {
+        sourceDir.pop_back();
+    }
+    std::vector<PackedAsset> assets;
+    if (!PackDir(sourceDir, "/", assets)) {
+        return 1;
+    }
+    for (const PackedAsset &asset : assets) {
+        const PackedAsset &data = assets[asset.dataIdx];
+        printf("INFO %s -> %u bytes%s\n", asset.path.c_str(), data.bodyLengths[ASSET_VARIANT_INDEX_IDENTITY],
+            data.variants[ASSET_VARIANT_INDEX_GZIP].empty() ? "" : ", gzip");
+    }
+    return WriteBundle(assets, argv[2]) ? 0 : 1;
+}
\ No newline at end of file